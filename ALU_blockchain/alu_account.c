@@ -41,13 +41,15 @@ alu_account *create_alu_account(void)
 }
 
 /**
- * serialize_alu_account - Saves ALU account data to a file
+ * serialize_alu_account - Saves ALU account data to a file through the journal
  * @account: Pointer to the ALU account
  * Return: 1 on success, 0 on failure
  */
 int serialize_alu_account(alu_account *account)
 {
-    FILE *file = fopen(ALU_ACCOUNT_FILE, "wb");
+    char *data = NULL;
+    size_t size = 0;
+    FILE *file = open_memstream(&data, &size);
     if (!file)
     {
         fprintf(stderr, "Failed to open file for writing\n");
@@ -59,7 +61,9 @@ int serialize_alu_account(alu_account *account)
     fwrite(account->token, sizeof(Token), 1, file);
 
     fclose(file);
-    return 1;
+    int result = journal_write(ALU_ACCOUNT_FILE, 0, 1, data, size);
+    free(data);
+    return result;
 }
 
 /**
@@ -68,7 +72,8 @@ int serialize_alu_account(alu_account *account)
  */
 alu_account *deserialize_alu_account(void)
 {
-    FILE *file = fopen(ALU_ACCOUNT_FILE, "rb");
+    journal_recover();
+    FILE *file = fopen(generation_path(ALU_ACCOUNT_FILE), "rb");
     if (!file)
     {
         fprintf(stderr, "Failed to open file for reading\n");
@@ -0,0 +1,3036 @@
+#define _GNU_SOURCE
+#include "blockchain.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+static volatile sig_atomic_t stop;
+static _Thread_local node_job_t *running_job;
+
+/**
+ * handle_stop - asks the accept loop to exit
+ * @signum: signal number
+ */
+static void handle_stop(int signum)
+{
+    (void)signum;
+    stop = 1;
+}
+
+/**
+ * file_stamp - stamps a file without touching any cache
+ * @path: file path
+ * @stamp: where to store the stamp
+ */
+static void file_stamp(const char *path, file_stamp_t *stamp)
+{
+    struct stat st;
+
+    memset(stamp, 0, sizeof(*stamp));
+    if (stat(path, &st) == 0)
+    {
+        stamp->mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+        stamp->size = st.st_size;
+        stamp->inode = st.st_ino;
+    }
+}
+
+/**
+ * stamp_changed - checks whether a file changed since it was last stamped
+ * @path: file path
+ * @stamp: last stamp of the file, updated
+ * Return: 1 if the file changed else 0
+ */
+static int stamp_changed(const char *path, file_stamp_t *stamp)
+{
+    file_stamp_t now;
+
+    file_stamp(path, &now);
+    if (memcmp(&now, stamp, sizeof(now)) == 0)
+        return 0;
+    *stamp = now;
+    return 1;
+}
+
+/**
+ * node_chain - blockchain as currently on disk
+ * @node: daemon state
+ * Return: loaded blockchain or NULL on failure
+ */
+static Blockchain *node_chain(node_state_t *node)
+{
+    if (stamp_changed(BLOCKCHAIN_DATABASE, &node->chain_stamp) || !node->chain)
+    {
+        block_tree_free(&node->tree);
+        if (node->chain)
+            free_blockchain(node->chain);
+        node->chain = deserialize_blockchain();
+        node->chain_failed = -2;
+    }
+    return node->chain;
+}
+
+/**
+ * node_tree - block tree indexing the blockchain as currently on disk
+ * @node: daemon state
+ * Return: block tree or NULL if the blockchain is empty or cannot be loaded
+ */
+static block_tree_t *node_tree(node_state_t *node)
+{
+    Blockchain *blockchain = node_chain(node);
+
+    if (!blockchain || !blockchain->tail || !block_tree_update(&node->tree, blockchain))
+        return NULL;
+    return &node->tree;
+}
+
+/**
+ * node_pool - pool of unspent transactions as currently on disk
+ * @node: daemon state
+ * Return: loaded pool, empty if there is no pool file, or NULL on failure
+ */
+static utxo_t *node_pool(node_state_t *node)
+{
+    if (stamp_changed(UTXO_DATABASE, &node->pool_stamp) || !node->pool)
+    {
+        free_transactions(node->pool);
+        node->pool = access(UTXO_DATABASE, F_OK) == 0 ? deserialize_utxo() : calloc(1, sizeof(utxo_t));
+    }
+    return node->pool;
+}
+
+/**
+ * node_users - users as currently on disk
+ * @node: daemon state
+ * Return: loaded users or NULL on failure
+ */
+static lusers *node_users(node_state_t *node)
+{
+    if (stamp_changed(USERS_DATABASE, &node->users_stamp) || !node->users)
+    {
+        if (node->users)
+            free_users(node->users);
+        node->users = deserialize_users();
+    }
+    return node->users;
+}
+
+/**
+ * node_account - ALU account as currently on disk
+ * @node: daemon state
+ * Return: loaded account or NULL on failure
+ */
+static alu_account *node_account(node_state_t *node)
+{
+    if (stamp_changed(ALU_ACCOUNT_FILE, &node->account_stamp) || !node->account)
+    {
+        if (node->account)
+            free_alu_account(node->account);
+        node->account = deserialize_alu_account();
+    }
+    return node->account;
+}
+
+/**
+ * node_session - logged in user, looked up among the loaded users
+ * @node: daemon state
+ * Return: user or NULL if nobody valid is logged in
+ */
+static user_t *node_session(node_state_t *node)
+{
+    lusers *users = node_users(node);
+
+    if (stamp_changed(SESSION_USER, &node->session_stamp) || !node->has_session)
+    {
+        FILE *file = fopen(SESSION_USER, "rb");
+
+        node->has_session = file &&
+                            fread(&node->session.role, sizeof(node->session.role), 1, file) == 1 &&
+                            fread(&node->session.index, sizeof(node->session.index), 1, file) == 1 &&
+                            fread(node->session.name, sizeof(node->session.name), 1, file) == 1;
+        if (file)
+            fclose(file);
+        node->session.name[sizeof(node->session.name) - 1] = '\0';
+    }
+    if (!node->has_session)
+    {
+        fprintf(stderr, "Failed to read session user data\n");
+        return NULL;
+    }
+    for (user_t *user = users ? users->head : NULL; user; user = user->next)
+    {
+        if (strcmp(user->name, node->session.name) == 0 && user->index == node->session.index)
+            return user;
+    }
+    return NULL;
+}
+
+/**
+ * find_address - looks up the user owning a wallet address
+ * @users: loaded users, may be NULL
+ * @address: wallet address
+ * Return: user or NULL if no user owns the address
+ */
+static user_t *find_address(lusers *users, const unsigned char *address)
+{
+    for (user_t *user = users ? users->head : NULL; user; user = user->next)
+    {
+        if (user->wallet && memcmp(user->wallet->address, address, ADDRESS_SIZE) == 0)
+            return user;
+    }
+    return NULL;
+}
+
+/**
+ * handle_login - logs in a user, as load_user does
+ * @node: daemon state
+ * @request: user index then user name
+ * Return: 1 on success else 0
+ */
+static int handle_login(node_state_t *node, buffer_t *request)
+{
+    char name[DATASIZE_MAX];
+    int64_t index;
+    size_t len;
+    lusers *users;
+
+    if (!buffer_get_svarint(request, &index) || (len = request->len - request->pos) >= sizeof(name))
+    {
+        fprintf(stderr, "Name not valid\n");
+        return 0;
+    }
+    memcpy(name, request->data + request->pos, len);
+    name[len] = '\0';
+    users = node_users(node);
+    if (!users)
+    {
+        fprintf(stderr, "Could not get all users for loading\n");
+        return 0;
+    }
+    for (user_t *user = users->head; user; user = user->next)
+    {
+        if (strcmp(user->name, name) == 0 && user->index == index)
+            return save_session(user);
+    }
+    fprintf(stderr, "Could not verify user\n");
+    return 0;
+}
+
+/**
+ * handle_balance - prints the balance of the logged in user, as
+ * view_balance does
+ * @node: daemon state
+ * Return: 1 on success else 0
+ */
+static int handle_balance(node_state_t *node)
+{
+    user_t *user = node_session(node);
+
+    if (!user)
+    {
+        fprintf(stderr, "User invalid\n");
+        return 0;
+    }
+    if (!user->wallet)
+    {
+        fprintf(stderr, "User has not wallet\n");
+        return 0;
+    }
+    printf("Balance: %dalunium(ALU)\n", user->wallet->balance);
+    return 1;
+}
+
+/**
+ * handle_submit - adds a transaction to the pool, as add_transaction does
+ * @node: daemon state
+ * @request: sender, receiver, amount and sequence number, -1 for the next
+ * @result: filled with the transaction ID
+ * @announce: filled with the PEER_TX frame of the transaction, which peers
+ * are offered by ID
+ * Return: 1 on success else 0
+ */
+static int handle_submit(node_state_t *node, buffer_t *request, buffer_t *result, buffer_t *announce)
+{
+    unsigned char sender[ADDRESS_SIZE], receiver[ADDRESS_SIZE], id[TXID_SIZE];
+    int64_t amount, sequence;
+    const char *error = NULL;
+    user_t *user, *recv;
+    utxo_t *pool;
+
+    if (!buffer_get(request, sender, ADDRESS_SIZE) || !buffer_get(request, receiver, ADDRESS_SIZE) ||
+        !buffer_get_svarint(request, &amount) || !buffer_get_svarint(request, &sequence) ||
+        amount <= 0 || amount > INT32_MAX)
+    {
+        fprintf(stderr, "Wrong details\n");
+        return 0;
+    }
+
+    /* Same checks as verify_transaction, against the loaded users */
+    user = node_session(node);
+    if (!user)
+        error = "Sender details not valid";
+    else if (!user->wallet)
+        error = "Sender has no wallet";
+    else if (memcmp(user->wallet->address, sender, ADDRESS_SIZE) != 0)
+        error = "Unverified sender";
+    else if (!(recv = find_address(node->users, receiver)))
+        error = "Receiver details not valid";
+    else if (!recv->wallet)
+        error = "Recevier has no wallet";
+    if (error)
+    {
+        fprintf(stderr, "%s\nCould not verify transaction\n", error);
+        return 0;
+    }
+    printf("Details verified\n");
+
+    if (!txid_rebuild())
+    {
+        fprintf(stderr, "Could not rebuild transaction ID index\n");
+        return 0;
+    }
+    /* The pool and the sequence are read and written back under one lock */
+    if (!journal_lock())
+        return 0;
+    pool = node_pool(node);
+    if (!pool)
+    {
+        fprintf(stderr, "Error deserializing unspent transactions\n");
+        journal_unlock();
+        return 0;
+    }
+    if (!pool_add(pool, sender, receiver, (int)amount, (long)sequence, id))
+    {
+        journal_unlock();
+        return 0;
+    }
+    stamp_changed(UTXO_DATABASE, &node->pool_stamp);
+    journal_unlock();
+
+    buffer_t payload;
+    buffer_init(&payload);
+    if (!peer_put_transaction(&payload, pool->tail) || !node_frame_put(announce, PEER_TX, &payload))
+        fprintf(stderr, "Transaction not relayed to peers\n");
+    buffer_free(&payload);
+    return buffer_put(result, id, TXID_SIZE);
+}
+
+/**
+ * relay_block - appends the frame announcing a block to peers, a compact
+ * block unless the node relays full blocks
+ * @node: daemon state
+ * @out: buffer to append to
+ * @block: block to announce
+ * Return: 1 on success else 0
+ */
+static int relay_block(node_state_t *node, buffer_t *out, Block *block)
+{
+    buffer_t payload;
+    int result;
+
+    buffer_init(&payload);
+    result = node->full_blocks ? peer_put_block(&payload, block) && node_frame_put(out, PEER_BLOCK, &payload)
+                               : compact_put(&payload, block) && node_frame_put(out, PEER_COMPACT_BLOCK, &payload);
+    buffer_free(&payload);
+    return result;
+}
+
+/**
+ * handle_mine - mines the pending pool into the loaded blockchain
+ * Called holding the state lock like every handler, it lets the lock go
+ * while the nonce is ground so the other jobs are answered meanwhile; a
+ * block the tip moved past is mined again on the new tip
+ * @node: daemon state
+ * @announce: filled with the PEER_BLOCK frame relaying the new block
+ * Return: 1 on success else 0
+ */
+static int handle_mine(node_state_t *node, buffer_t *announce)
+{
+    utxo_t failed = {NULL, NULL, 0};
+    Blockchain *blockchain;
+    Transaction *next;
+    Block *block;
+    int length, difficulty;
+
+    while (1)
+    {
+        blockchain = node_chain(node);
+        if (!blockchain)
+        {
+            fprintf(stderr, "Could not deserialize blockchain\n");
+            return 0;
+        }
+        if (!blockchain->tail)
+        {
+            fprintf(stderr, "Blockchain is empty. Initializing new blockchain...\n");
+            free_blockchain(blockchain);
+            blockchain = node->chain = init_blockchain();
+        }
+        block = mine_template(blockchain, &failed);
+        if (!block)
+            return 0;
+        difficulty = blockchain->difficulty;
+
+        pthread_mutex_unlock(&node->state);
+        printf("------MINING BLOCK------\n");
+        mine_block(block, difficulty);
+        pthread_mutex_lock(&node->state);
+
+        blockchain = node_chain(node);
+        if (blockchain && blockchain->tail && blockchain->tail->index + 1 == block->index &&
+            memcmp(block->previous_hash, blockchain->tail->current_hash, SHA256_DIGEST_LENGTH) == 0)
+            break;
+        printf("Tip moved while mining block %u, mining again on the new tip\n", block->index);
+        free_blocks(block);
+        for (Transaction *trans = failed.head; trans; trans = next)
+        {
+            next = trans->next;
+            free(trans);
+        }
+        memset(&failed, 0, sizeof(failed));
+    }
+
+    length = blockchain->length;
+    if (!mine_commit(blockchain, block, &failed))
+    {
+        /* A block added before the failure was never written */
+        if (blockchain->length != length)
+        {
+            block_tree_free(&node->tree);
+            free_blockchain(blockchain);
+            node->chain = NULL;
+        }
+        return 0;
+    }
+    /* The tip was validated while mining, an earlier result still holds */
+    stamp_changed(BLOCKCHAIN_DATABASE, &node->chain_stamp);
+
+    if (!relay_block(node, announce, blockchain->tail))
+        fprintf(stderr, "Block not relayed to peers\n");
+    return 1;
+}
+
+/**
+ * handle_info - validates and prints the blockchain, as blockchain_info
+ * does; the chain is only validated again after it changed on disk
+ * @node: daemon state
+ * Return: 1 on success else 0
+ */
+static int handle_info(node_state_t *node)
+{
+    Blockchain *blockchain = node_chain(node);
+    alu_account *account;
+
+    if (!blockchain)
+    {
+        fprintf(stderr, "Could not get blockchain info\n");
+        return 0;
+    }
+    if (!blockchain->head)
+    {
+        printf("Blockchain is empty\n");
+        return 1;
+    }
+    if (node->chain_failed == -2)
+        node->chain_failed = validate_chain_parallel(blockchain, VALIDATION_THREADS);
+    if (node->chain_failed == -1)
+        printf("Blockchain is valid (%d blocks)\n\n", blockchain->length);
+    else if (node->chain_failed == VALIDATION_ERROR)
+    {
+        /* Nothing was learned about the chain, the next request tries again */
+        fprintf(stderr, "Could not validate blockchain\n\n");
+        node->chain_failed = -2;
+    }
+    else
+        fprintf(stderr, "Blockchain is not valid: first bad block at height %d\n\n", node->chain_failed);
+
+    account = node_account(node);
+    if (!account)
+        fprintf(stderr, "Could not get alu account info\n");
+    print_blockchain(blockchain);
+    if (account)
+        print_alu_account(account);
+    return 1;
+}
+
+/**
+ * handle_get_blocks - answers a peer asking for blocks or headers with the
+ * ones the block file holds from the first height asked for
+ * Pruned blocks cannot be checked by the peer and end an answer with
+ * blocks; their headers are still sent
+ * @request: first height and number of blocks wanted
+ * @frames: filled with the PEER_BLOCKS or PEER_HEADERS frame
+ * @headers: 1 to send headers only
+ * Return: 1 on success else 0
+ */
+static int handle_get_blocks(buffer_t *request, buffer_t *frames, int headers)
+{
+    block_reader_t reader;
+    buffer_t blocks, payload;
+    uint64_t from, count, sent = 0;
+    Block *block;
+    int result;
+
+    if (!buffer_get_varint(request, &from) || !buffer_get_varint(request, &count))
+    {
+        fprintf(stderr, "Malformed block request\n");
+        return 0;
+    }
+    if (count > (headers ? PEER_HEADERS_MAX : PEER_BATCH_BLOCKS))
+        count = headers ? PEER_HEADERS_MAX : PEER_BATCH_BLOCKS;
+
+    buffer_init(&blocks);
+    result = block_reader_open(&reader, (int64_t)from, 1);
+    if (result)
+    {
+        while (result && sent < count && blocks.len < PEER_MESSAGE_MAX / 2 && (block = block_reader_next(&reader)))
+        {
+            if (block->index >= from && block->pruned && !headers)
+                count = sent;
+            else if (block->index >= from && headers)
+            {
+                result = peer_put_header(&blocks, block);
+                sent++;
+            }
+            else if (block->index >= from)
+            {
+                result = peer_put_block(&blocks, block);
+                sent++;
+            }
+            free_transactions(block->transactions);
+            free(block);
+        }
+        block_reader_close(&reader);
+    }
+
+    buffer_init(&payload);
+    result = result && buffer_put_varint(&payload, sent) && buffer_put(&payload, blocks.data, blocks.len) &&
+             node_frame_put(frames, headers ? PEER_HEADERS : PEER_BLOCKS, &payload);
+    buffer_free(&payload);
+    buffer_free(&blocks);
+    return result;
+}
+
+/**
+ * accept_from_peer - appends blocks a peer sent to the loaded blockchain
+ * @node: daemon state
+ * @blocks: blocks linked through next, owned by the function
+ * Return: number of blocks added, 0 if they were rejected
+ */
+static int accept_from_peer(node_state_t *node, Block *blocks)
+{
+    Blockchain *blockchain = node_chain(node);
+    int added;
+
+    if (!blockchain || !blockchain->tail)
+    {
+        fprintf(stderr, "Blockchain has to be initialized before syncing\n");
+        free_blocks(blocks);
+        return 0;
+    }
+    added = accept_blocks(blockchain, blocks);
+    if (added < 0)
+    {
+        /* The chain holds blocks that were never written */
+        block_tree_free(&node->tree);
+        free_blockchain(blockchain);
+        node->chain = NULL;
+        return 0;
+    }
+    if (added > 0)
+        stamp_changed(BLOCKCHAIN_DATABASE, &node->chain_stamp);
+    return added;
+}
+
+/**
+ * handle_sync_commit - commits blocks downloaded while syncing
+ * @node: daemon state
+ * @job: job holding the blocks, its announcement is set to a PEER_HELLO
+ * with the new tip so other lagging peers sync from this node
+ * Return: 1 on success else 0
+ */
+static int handle_sync_commit(node_state_t *node, node_job_t *job)
+{
+    Block *blocks = job->blocks;
+    int added;
+
+    job->blocks = NULL;
+    added = accept_from_peer(node, blocks);
+    if (added <= 0)
+        return 0;
+    printf("Synced blocks %u to %u\n", node->chain->tail->index - added + 1, node->chain->tail->index);
+    return peer_put_hello(&job->announce, node->chain->tail->index, node->chain->tail->current_hash);
+}
+
+/**
+ * side_block - keeps a checked block that forks from the best chain, and
+ * reorganizes to its branch once the branch has more work
+ * @node: daemon state
+ * @tree: block tree of the loaded blockchain
+ * @parent: node of the previous block
+ * @block: the block, owned by the function
+ * Return: 1 if the block was kept, or its branch is now the best chain,
+ * else 0 if it was rejected
+ */
+static int side_block(node_state_t *node, block_tree_t *tree, block_node_t *parent, Block *block)
+{
+    block_node_t *side = NULL;
+    int result;
+
+    if (parent->block && check_block(block, parent->block, parent->difficulty))
+        side = block_tree_add(tree, parent, block);
+    if (!side)
+    {
+        free_transactions(block->transactions);
+        free(block);
+        return 0;
+    }
+    if (side->work <= tree->tip->work)
+    {
+        printf("Kept block %ld from peer on a side branch\n", side->height);
+        return 1;
+    }
+    result = reorganize_chain(node->chain, tree, side);
+    if (result < 0)
+    {
+        /* The chain holds blocks that were never written */
+        block_tree_free(&node->tree);
+        free_blockchain(node->chain);
+        node->chain = NULL;
+    }
+    else
+        stamp_changed(BLOCKCHAIN_DATABASE, &node->chain_stamp);
+    return result > 0;
+}
+
+/**
+ * receive_block - adds a block a peer announced and relays it. A block
+ * extending the tip is applied, one forking from the best chain is kept
+ * on a side branch until that branch has the most work; a block whose
+ * parent is unknown makes the node sync when it is ahead, one already
+ * known is dropped
+ * @node: daemon state
+ * @job: job of the peer message
+ * @block: the block, owned by the function
+ * Return: 1 on success else 0
+ */
+static int receive_block(node_state_t *node, node_job_t *job, Block *block)
+{
+    block_tree_t *tree = node_tree(node);
+    block_node_t *parent;
+    buffer_t relay;
+    int result;
+
+    job->height = block->index;
+    parent = tree ? block_tree_find(tree, block->previous_hash) : NULL;
+    if (!parent || block_tree_find(tree, block->current_hash))
+    {
+        free_transactions(block->transactions);
+        free(block);
+        return 1;
+    }
+    /* Encoded while the block is still ours, a rejected one is freed */
+    buffer_init(&relay);
+    if (!relay_block(node, &relay, block))
+    {
+        buffer_free(&relay);
+        free_transactions(block->transactions);
+        free(block);
+        return 0;
+    }
+    if (parent == tree->tip)
+    {
+        result = accept_from_peer(node, block);
+        if (result)
+            printf("Accepted block %ld from peer\n", parent->height + 1);
+    }
+    else
+        result = side_block(node, tree, parent, block);
+    result = result && buffer_put(&job->announce, relay.data, relay.len);
+    buffer_free(&relay);
+    return result;
+}
+
+/**
+ * handle_block - adds a block a peer sent with all its transactions
+ * @node: daemon state
+ * @job: job holding the PEER_BLOCK payload
+ * Return: 1 on success else 0
+ */
+static int handle_block(node_state_t *node, node_job_t *job)
+{
+    Block *block = peer_get_block(&job->request);
+
+    if (!block)
+    {
+        fprintf(stderr, "Malformed block from peer\n");
+        return 0;
+    }
+    return receive_block(node, job, block);
+}
+
+/**
+ * pending_link - finds a compact block waiting for transactions
+ * @node: daemon state
+ * @hash: block hash
+ * Return: link pointing at the compact block, or at NULL if none waits
+ */
+static compact_block_t **pending_link(node_state_t *node, const unsigned char *hash)
+{
+    compact_block_t **link = &node->pending;
+
+    while (*link && memcmp((*link)->block->current_hash, hash, SHA256_DIGEST_LENGTH) != 0)
+        link = &(*link)->next;
+    return link;
+}
+
+/**
+ * request_txs - asks the peer that announced a compact block for its
+ * missing transactions and keeps the block until they come; the oldest
+ * blocks past PEER_PENDING_BLOCKS are given up
+ * @node: daemon state
+ * @compact: compact block, owned by the function
+ * @result: filled with the PEER_GET_BLOCK_TXS frame
+ * Return: 1 on success else 0
+ */
+static int request_txs(node_state_t *node, compact_block_t *compact, buffer_t *result)
+{
+    compact_block_t **link = &node->pending, *dropped;
+    buffer_t payload;
+    int count = 0, sent;
+
+    buffer_init(&payload);
+    sent = compact_put_request(&payload, compact) && node_frame_put(result, PEER_GET_BLOCK_TXS, &payload);
+    buffer_free(&payload);
+    if (!sent)
+    {
+        compact_free(compact);
+        return 0;
+    }
+    compact->next = node->pending;
+    node->pending = compact;
+    while (*link && count++ < PEER_PENDING_BLOCKS)
+        link = &(*link)->next;
+    while ((dropped = *link))
+    {
+        *link = dropped->next;
+        compact_free(dropped);
+    }
+    return 1;
+}
+
+/**
+ * rebuild_block - adds the block of a compact block holding all its
+ * transactions. A short ID that matched the wrong pool transaction shows
+ * as a block not hashing to its header, and every transaction is asked
+ * for again
+ * @node: daemon state
+ * @job: job of the peer message
+ * @compact: compact block, owned by the function
+ * @result: filled with the PEER_GET_BLOCK_TXS frame when asking again
+ * @retry: 0 if the peer sent every transaction, which leaves nothing to ask
+ * Return: 1 on success else 0
+ */
+static int rebuild_block(node_state_t *node, node_job_t *job, compact_block_t *compact, buffer_t *result,
+                         int retry)
+{
+    Block *block = compact_finish(compact);
+
+    if (block)
+        return receive_block(node, job, block);
+    if (!retry || compact->missing == 0)
+    {
+        fprintf(stderr, "Block %u does not match its header\n", compact->block->index);
+        compact_free(compact);
+        return 0;
+    }
+    printf("Block %u does not match its short IDs, asking for all its transactions\n", compact->block->index);
+    return request_txs(node, compact, result);
+}
+
+/**
+ * handle_compact_block - rebuilds a block a peer announced by short IDs
+ * from the pool, asking the peer only for the transactions the pool lacks
+ * @node: daemon state
+ * @job: job holding the PEER_COMPACT_BLOCK payload
+ * @result: filled with the PEER_GET_BLOCK_TXS frame if some are missing
+ * Return: 1 on success else 0
+ */
+static int handle_compact_block(node_state_t *node, node_job_t *job, buffer_t *result)
+{
+    compact_block_t *compact = compact_get(&job->request);
+    block_tree_t *tree = node_tree(node);
+
+    if (!compact)
+    {
+        fprintf(stderr, "Malformed compact block from peer\n");
+        return 0;
+    }
+    job->height = compact->block->index;
+    /* Known blocks and blocks waiting for transactions arrive once per peer */
+    if (!tree || !block_tree_find(tree, compact->block->previous_hash) ||
+        block_tree_find(tree, compact->block->current_hash) || *pending_link(node, compact->block->current_hash))
+    {
+        compact_free(compact);
+        return 1;
+    }
+    if (!compact_match(compact, node_pool(node)))
+    {
+        compact_free(compact);
+        return 0;
+    }
+    if (compact->missing == 0)
+        return rebuild_block(node, job, compact, result, 1);
+    printf("Asking peer for %d of the %d transactions of block %u\n", compact->missing, compact->nb_trans,
+           compact->block->index);
+    return request_txs(node, compact, result);
+}
+
+/**
+ * handle_get_block_txs - answers a peer asking for transactions of a
+ * block it could not rebuild from its pool
+ * @node: daemon state
+ * @job: job holding the PEER_GET_BLOCK_TXS payload
+ * @result: filled with the PEER_BLOCK_TXS frame
+ * Return: 1 on success else 0
+ */
+static int handle_get_block_txs(node_state_t *node, node_job_t *job, buffer_t *result)
+{
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    block_tree_t *tree = node_tree(node);
+    block_node_t *found = NULL;
+    buffer_t payload;
+    int sent;
+
+    if (!buffer_get(&job->request, hash, sizeof(hash)))
+    {
+        fprintf(stderr, "Malformed transaction request from peer\n");
+        return 0;
+    }
+    if (tree)
+        found = block_tree_find(tree, hash);
+    if (!found || !found->block || found->block->pruned)
+    {
+        fprintf(stderr, "Peer asked for the transactions of an unknown block\n");
+        return 0;
+    }
+    buffer_init(&payload);
+    sent = compact_put_txs(&payload, found->block, &job->request) &&
+           node_frame_put(result, PEER_BLOCK_TXS, &payload);
+    buffer_free(&payload);
+    return sent;
+}
+
+/**
+ * handle_block_txs - completes a compact block with the transactions the
+ * peer sent
+ * @node: daemon state
+ * @job: job holding the PEER_BLOCK_TXS payload
+ * @result: filled with the PEER_GET_BLOCK_TXS frame when asking again
+ * Return: 1 on success else 0
+ */
+static int handle_block_txs(node_state_t *node, node_job_t *job, buffer_t *result)
+{
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    compact_block_t **link, *compact;
+    int retry;
+
+    if (!buffer_get(&job->request, hash, sizeof(hash)))
+    {
+        fprintf(stderr, "Malformed block transactions from peer\n");
+        return 0;
+    }
+    /* The block was given up, or another peer sent it first */
+    link = pending_link(node, hash);
+    compact = *link;
+    if (!compact)
+        return 1;
+    *link = compact->next;
+    compact->next = NULL;
+    job->height = compact->block->index;
+    retry = compact->missing < compact->nb_trans;
+    if (!compact_fill(compact, &job->request))
+    {
+        fprintf(stderr, "Malformed block transactions from peer\n");
+        compact_free(compact);
+        return 0;
+    }
+    return rebuild_block(node, job, compact, result, retry);
+}
+
+/**
+ * announce_list - appends the PEER_TX frame of each transaction of a list,
+ * which peers are offered by ID
+ * @announce: buffer to append the frames to
+ * @txs: transactions added to the pool
+ */
+static void announce_list(buffer_t *announce, utxo_t *txs)
+{
+    buffer_t payload;
+
+    buffer_init(&payload);
+    for (Transaction *trans = txs->head; trans; trans = trans->next)
+    {
+        payload.len = 0;
+        if (!peer_put_transaction(&payload, trans) || !node_frame_put(announce, PEER_TX, &payload))
+        {
+            fprintf(stderr, "Transactions not relayed to peers\n");
+            break;
+        }
+    }
+    buffer_free(&payload);
+}
+
+/**
+ * handle_transactions - adds a batch of transactions peers relayed to the
+ * pool in one journal group and announces the ones added; known ones, out
+ * of sequence ones and ones naming unknown accounts are dropped
+ * @node: daemon state
+ * @job: job holding the PEER_TX payloads one after the other
+ * Return: 1 on success else 0
+ */
+static int handle_transactions(node_state_t *node, node_job_t *job)
+{
+    utxo_t *txs = (utxo_t *)calloc(1, sizeof(utxo_t)), *pool;
+    Transaction *trans;
+    lusers *users;
+    int received = 0, result, locked;
+
+    result = txs && txid_rebuild();
+    if (!result)
+    {
+        fprintf(stderr, "Could not rebuild transaction ID index\n");
+        free(txs);
+        return 0;
+    }
+    users = node_users(node);
+    while (result && job->request.pos < job->request.len)
+    {
+        trans = (Transaction *)malloc(sizeof(Transaction));
+        result = trans && peer_get_transaction(&job->request, trans);
+        if (!result)
+        {
+            free(trans);
+            break;
+        }
+        received++;
+        if (!users || !find_address(users, trans->sender) || !find_address(users, trans->receiver))
+        {
+            fprintf(stderr, "Transaction from peer names an unknown account\n");
+            free(trans);
+            continue;
+        }
+        if (txs->tail)
+            txs->tail->next = trans;
+        else
+            txs->head = trans;
+        txs->tail = trans;
+        txs->nb_trans++;
+    }
+    /* The pool and the sequences are read and written back under one lock */
+    locked = result && journal_lock();
+    pool = locked ? node_pool(node) : NULL;
+    result = pool && (!txs->head || pool_add_list(pool, txs));
+    if (result)
+        stamp_changed(UTXO_DATABASE, &node->pool_stamp);
+    if (locked)
+        journal_unlock();
+    if (!result)
+    {
+        free_transactions(txs);
+        return 0;
+    }
+    printf("%d of %d transactions from peers added to the pool\n", txs->nb_trans, received);
+    announce_list(&job->announce, txs);
+    free(txs);
+    return 1;
+}
+
+/**
+ * handle_ring - adds the transactions drained from the submission ring to
+ * the pool in one journal group and announces the ones added
+ * Each is checked as handle_submit checks it: only the logged in user can
+ * send; known and out of sequence ones are dropped
+ * @node: daemon state
+ * @job: job holding the ring records one after the other
+ * Return: 1 on success else 0
+ */
+static int handle_ring(node_state_t *node, node_job_t *job)
+{
+    utxo_t *txs = (utxo_t *)calloc(1, sizeof(utxo_t)), *pool;
+    tx_ring_record_t record;
+    Transaction *trans;
+    user_t *user, *recv;
+    int received = 0, result, locked;
+
+    result = txs && txid_rebuild();
+    if (!result)
+    {
+        fprintf(stderr, "Could not rebuild transaction ID index\n");
+        free(txs);
+        return 0;
+    }
+    user = node_session(node);
+    while (result && buffer_get(&job->request, &record, sizeof(record)))
+    {
+        received++;
+        if (!user || !user->wallet || memcmp(user->wallet->address, record.sender, ADDRESS_SIZE) != 0 ||
+            !(recv = find_address(node->users, record.receiver)) || !recv->wallet || record.amount <= 0 ||
+            record.sequence < -1 || record.sequence > INT32_MAX)
+        {
+            fprintf(stderr, "Could not verify transaction from the submission ring\n");
+            continue;
+        }
+        trans = (Transaction *)calloc(1, sizeof(Transaction));
+        result = trans != NULL;
+        if (!result)
+            break;
+        memcpy(trans->sender, record.sender, ADDRESS_SIZE);
+        memcpy(trans->receiver, record.receiver, ADDRESS_SIZE);
+        trans->amount = record.amount;
+        trans->index = (int)record.sequence;
+        trans->status = INITIATED;
+        if (txs->tail)
+            txs->tail->next = trans;
+        else
+            txs->head = trans;
+        txs->tail = trans;
+        txs->nb_trans++;
+    }
+    /* The pool and the sequences are read and written back under one lock */
+    locked = result && journal_lock();
+    pool = locked ? node_pool(node) : NULL;
+    result = pool && (!txs->head || pool_add_list(pool, txs));
+    if (result)
+        stamp_changed(UTXO_DATABASE, &node->pool_stamp);
+    if (locked)
+        journal_unlock();
+    if (!result)
+    {
+        free_transactions(txs);
+        return 0;
+    }
+    printf("%d of %d transactions from the submission ring added to the pool\n", txs->nb_trans, received);
+    announce_list(&job->announce, txs);
+    free(txs);
+    return 1;
+}
+
+/**
+ * handle_pool_template - builds the block template the pool workers mine:
+ * the transactions tx_for_mining picks, on top of the tip, with the fees
+ * credited to the logged in user
+ * Nothing is written, the pool only changes once the block is added
+ * @node: daemon state
+ * @job: job to fill with the template and its difficulty
+ * Return: 1 on success else 0 if there is nothing to mine
+ */
+static int handle_pool_template(node_state_t *node, node_job_t *job)
+{
+    Blockchain *blockchain = node_chain(node);
+    user_t *session = node_session(node);
+    utxo_t *unspent, *txs, failed = {NULL, NULL, 0};
+    Transaction *next;
+    Block *block;
+
+    if (!blockchain || !blockchain->tail || !session || !session->wallet)
+    {
+        fprintf(stderr, "Pool needs an initialized blockchain and a logged in user\n");
+        return 0;
+    }
+    unspent = deserialize_utxo();
+    if (!unspent)
+    {
+        fprintf(stderr, "Could not deserialize unspent transactions\n");
+        return 0;
+    }
+    /* tx_for_mining saves the pool without the picked transactions, that write is dropped */
+    journal_begin();
+    txs = tx_for_mining(unspent, &failed);
+    journal_abort();
+    free_transactions(unspent);
+    for (Transaction *trans = failed.head; trans; trans = next)
+    {
+        next = trans->next;
+        free(trans);
+    }
+    if (!txs || txs->nb_trans == 0)
+    {
+        free_transactions(txs);
+        return 0;
+    }
+
+    block = (Block *)calloc(1, sizeof(Block));
+    if (!block)
+    {
+        fprintf(stderr, "Could not allocate block template\n");
+        free_transactions(txs);
+        return 0;
+    }
+    block->index = blockchain->tail->index + 1;
+    block->timestamp = block_timestamp(blockchain->tail);
+    memcpy(block->previous_hash, blockchain->tail->current_hash, SHA256_DIGEST_LENGTH);
+    block->transactions = txs;
+    memcpy(block->miner, session->wallet->address, ADDRESS_SIZE);
+    job->blocks = block;
+    job->difficulty = blockchain->difficulty;
+    printf("Pool template for block %u with %d transactions at difficulty %d\n", block->index, txs->nb_trans,
+           job->difficulty);
+    return 1;
+}
+
+/**
+ * handle_pool_block - adds a block the pool workers solved and relays it
+ * @node: daemon state
+ * @job: job holding the block, its announcement set to the
+ * relay of the block
+ * Return: 1 on success else 0
+ */
+static int handle_pool_block(node_state_t *node, node_job_t *job)
+{
+    Blockchain *blockchain = node_chain(node);
+    Block *block = job->blocks;
+    unsigned int index = block->index;
+
+    job->blocks = NULL;
+    if (!blockchain || !blockchain->tail ||
+        memcmp(block->previous_hash, blockchain->tail->current_hash, SHA256_DIGEST_LENGTH) != 0)
+    {
+        fprintf(stderr, "Block %u solved by the pool no longer extends the tip\n", index);
+        free_blocks(block);
+        return 0;
+    }
+    /* Encoded while the block is still ours, a rejected one is freed */
+    if (!relay_block(node, &job->announce, block))
+        fprintf(stderr, "Block not relayed to peers\n");
+    if (!accept_from_peer(node, block))
+    {
+        job->announce.len = 0;
+        return 0;
+    }
+    printf("Pool block %u added, new difficulty level: %d\n", index, node->chain->difficulty);
+    return 1;
+}
+
+/**
+ * log_captured - writes what a job printed to one of the daemon's streams
+ * @data: bytes printed
+ * @size: number of bytes
+ * @fd: daemon stream
+ */
+static void log_captured(const char *data, size_t size, int fd)
+{
+    ssize_t got;
+
+    for (size_t offset = 0; offset < size; offset += got)
+    {
+        got = write(fd, data + offset, size - offset);
+        if (got <= 0)
+            break;
+    }
+}
+
+/**
+ * route_stdout - writes what a thread prints to stdout to the output of
+ * the job it runs, or to the daemon's stdout outside of jobs
+ * @cookie: daemon state
+ * @data: bytes printed
+ * @size: number of bytes
+ * Return: bytes written or -1 on failure
+ */
+static ssize_t route_stdout(void *cookie, const char *data, size_t size)
+{
+    node_state_t *node = (node_state_t *)cookie;
+
+    if (running_job)
+        return fwrite(data, 1, size, running_job->out) == size ? (ssize_t)size : -1;
+    return write(node->saved_out, data, size);
+}
+
+/**
+ * route_stderr - writes what a thread prints to stderr to the errors of
+ * the job it runs, or to the daemon's stderr outside of jobs
+ * @cookie: daemon state
+ * @data: bytes printed
+ * @size: number of bytes
+ * Return: bytes written or -1 on failure
+ */
+static ssize_t route_stderr(void *cookie, const char *data, size_t size)
+{
+    node_state_t *node = (node_state_t *)cookie;
+
+    if (running_job)
+        return fwrite(data, 1, size, running_job->err) == size ? (ssize_t)size : -1;
+    return write(node->saved_err, data, size);
+}
+
+/**
+ * publish_tip - makes the tip of the loaded chain visible to the event
+ * loop, which introduces the node to peers with it
+ * Called holding the state lock and @lock, or before the workers start
+ * @node: daemon state
+ */
+static void publish_tip(node_state_t *node)
+{
+    if (!node->chain || !node->chain->tail)
+        return;
+    node->height = node->chain->tail->index;
+    memcpy(node->tip, node->chain->tail->current_hash, SHA256_DIGEST_LENGTH);
+    node->tip_time = node->chain->tail->timestamp;
+    node->difficulty = node->chain->difficulty;
+}
+
+/**
+ * dispatch_job - runs the handler of a request
+ * @node: daemon state
+ * @job: job to run
+ * @result: filled with the result bytes following the output
+ */
+static void dispatch_job(node_state_t *node, node_job_t *job, buffer_t *result)
+{
+    switch (job->type)
+    {
+    case NODE_LOGIN:
+        job->status = handle_login(node, &job->request);
+        break;
+    case NODE_BALANCE:
+        job->status = handle_balance(node);
+        break;
+    case NODE_SUBMIT:
+        job->status = job->conn ? handle_submit(node, &job->request, result, &job->announce) : handle_ring(node, job);
+        break;
+    case NODE_MINE:
+        job->status = handle_mine(node, &job->announce);
+        break;
+    case NODE_INFO:
+        job->status = handle_info(node);
+        break;
+    case PEER_GET_BLOCKS:
+    case PEER_GET_HEADERS:
+        job->status = handle_get_blocks(&job->request, result, job->type == PEER_GET_HEADERS);
+        break;
+    case PEER_BLOCKS:
+        job->status = handle_sync_commit(node, job);
+        break;
+    case PEER_BLOCK:
+        job->status = handle_block(node, job);
+        break;
+    case PEER_COMPACT_BLOCK:
+        job->status = handle_compact_block(node, job, result);
+        break;
+    case PEER_GET_BLOCK_TXS:
+        job->status = handle_get_block_txs(node, job, result);
+        break;
+    case PEER_BLOCK_TXS:
+        job->status = handle_block_txs(node, job, result);
+        break;
+    case PEER_TX:
+        job->status = handle_transactions(node, job);
+        break;
+    case POOL_WORK:
+        job->status = handle_pool_template(node, job);
+        break;
+    case POOL_SHARE:
+        job->status = handle_pool_block(node, job);
+        break;
+    default:
+        fprintf(stderr, "Unknown node request %u\n", job->type);
+    }
+}
+
+/**
+ * run_job - runs one request with what it prints to stdout and stderr
+ * going to streams of its own, and keeps that output as its response
+ * Handlers are the same code paths the CLIs run, so a client sees exactly
+ * what it would have printed itself. They share the caches and the
+ * journal, so each runs holding the state lock
+ * @node: daemon state
+ * @job: job to run
+ */
+static void run_job(node_state_t *node, node_job_t *job)
+{
+    char *out = NULL, *err = NULL;
+    size_t out_size = 0, err_size = 0;
+    buffer_t result;
+    int captured;
+
+    buffer_init(&result);
+    job->out = open_memstream(&out, &out_size);
+    job->err = open_memstream(&err, &err_size);
+    captured = job->out && job->err;
+    pthread_mutex_lock(&node->state);
+    if (captured)
+    {
+        running_job = job;
+        dispatch_job(node, job, &result);
+        running_job = NULL;
+    }
+    if (job->out && fclose(job->out) != 0)
+        captured = 0;
+    if (job->err && fclose(job->err) != 0)
+        captured = 0;
+    job->out = job->err = NULL;
+
+    /* Peers are sent frames, not output, which goes to the node's log as
+     * does the output of the node's own jobs */
+    if (captured && (job->type >= PEER_HELLO || !job->conn))
+    {
+        log_captured(out, out_size, node->saved_out);
+        log_captured(err, err_size, node->saved_err);
+        if (!buffer_put(&job->response, result.data, result.len))
+            job->status = 0;
+    }
+    else if (!captured || !buffer_put_varint(&job->response, out_size) || !buffer_put(&job->response, out, out_size) ||
+             !buffer_put_varint(&job->response, err_size) || !buffer_put(&job->response, err, err_size) ||
+             !buffer_put(&job->response, result.data, result.len))
+    {
+        dprintf(node->saved_err, "Could not capture the output of request %u\n", job->type);
+        job->response.len = 0;
+        job->status = 0;
+        buffer_put_varint(&job->response, 0);
+        buffer_put_varint(&job->response, 0);
+    }
+    free(out);
+    free(err);
+    buffer_free(&result);
+
+    pthread_mutex_lock(&node->lock);
+    publish_tip(node);
+    if (job->type == NODE_BALANCE)
+    {
+        /* Stamps of the files the balance was read from, not of the files now */
+        node->balance.valid = 1;
+        node->balance.status = job->status;
+        node->balance.users_stamp = node->users_stamp;
+        node->balance.session_stamp = node->session_stamp;
+        node->balance.response.len = 0;
+        node->balance.valid = buffer_put(&node->balance.response, job->response.data, job->response.len);
+    }
+    pthread_mutex_unlock(&node->lock);
+    pthread_mutex_unlock(&node->state);
+}
+
+/**
+ * job_thread - runs queued jobs until the node stops
+ * NODE_WORKERS of them take jobs off the queue, so while one grinds the
+ * nonce of a block the others keep answering; mining and validation
+ * spread over their own threads inside a job
+ * @arg: daemon state
+ * Return: NULL
+ */
+static void *job_thread(void *arg)
+{
+    node_state_t *node = (node_state_t *)arg;
+    uint64_t one = 1;
+    node_job_t *job;
+
+    pthread_mutex_lock(&node->lock);
+    while (1)
+    {
+        while (!node->queue && !node->stopping)
+            pthread_cond_wait(&node->ready, &node->lock);
+        job = node->queue;
+        if (!job)
+            break;
+        node->queue = job->next;
+        pthread_mutex_unlock(&node->lock);
+
+        run_job(node, job);
+
+        pthread_mutex_lock(&node->lock);
+        job->next = node->done;
+        node->done = job;
+        if (write(node->wake_fd, &one, sizeof(one)) != sizeof(one))
+            dprintf(node->saved_err, "Could not wake the event loop\n");
+    }
+    pthread_mutex_unlock(&node->lock);
+    return NULL;
+}
+
+/**
+ * cached_balance - answers a balance request from the last balance response
+ * when neither the users nor the session changed since
+ * @node: daemon state
+ * @out: connection output to append the response to
+ * Return: 1 if answered else 0 if the request needs the job threads
+ */
+static int cached_balance(node_state_t *node, buffer_t *out)
+{
+    file_stamp_t users, session;
+    int answered = 0;
+
+    file_stamp(USERS_DATABASE, &users);
+    file_stamp(SESSION_USER, &session);
+    pthread_mutex_lock(&node->lock);
+    if (node->balance.valid && memcmp(&users, &node->balance.users_stamp, sizeof(users)) == 0 &&
+        memcmp(&session, &node->balance.session_stamp, sizeof(session)) == 0)
+        answered = node_frame_put(out, (uint32_t)node->balance.status, &node->balance.response);
+    pthread_mutex_unlock(&node->lock);
+    return answered;
+}
+
+/**
+ * conn_limit - pending input that pauses reading a connection; a peer link
+ * has to hold its largest message
+ * @conn: connection
+ * Return: number of bytes
+ */
+static size_t conn_limit(const node_conn_t *conn)
+{
+    return conn->remote ? PEER_MESSAGE_MAX + sizeof(node_frame_t) : NODE_BUFFER_MAX;
+}
+
+/**
+ * conn_watch - watches the events a connection is ready for: reading while
+ * its input is not backed up, writing while output is pending
+ * @epoll_fd: event loop
+ * @conn: connection
+ */
+static void conn_watch(int epoll_fd, node_conn_t *conn)
+{
+    struct epoll_event event;
+    uint32_t events = 0;
+
+    if (conn->in.len - conn->in.pos < conn_limit(conn))
+        events |= EPOLLIN;
+    if (conn->out.len > conn->out.pos)
+        events |= EPOLLOUT;
+    if (events == conn->events)
+        return;
+    event.events = events;
+    event.data.ptr = conn;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+    conn->events = events;
+}
+
+/**
+ * conn_free - releases a connection
+ * @node: daemon state
+ * @conn: connection, already closed
+ */
+static void conn_free(node_state_t *node, node_conn_t *conn)
+{
+    if (conn->prev)
+        conn->prev->next = conn->next;
+    else
+        node->conns = conn->next;
+    if (conn->next)
+        conn->next->prev = conn->prev;
+    buffer_free(&conn->in);
+    buffer_free(&conn->out);
+    free(conn);
+}
+
+/**
+ * conn_close - closes a connection, released later by conn_reap
+ * @node: daemon state
+ * @conn: connection
+ */
+static void conn_close(node_state_t *node, node_conn_t *conn)
+{
+    close(conn->fd);
+    conn->fd = -1;
+    node->nb_closed++;
+    if (conn->worker)
+        node->mining.nb_workers--;
+    if (conn->peer)
+    {
+        if (conn->hello)
+            dprintf(node->saved_out, "Lost peer %s\n", conn->peer->name);
+        conn->peer->conn = NULL;
+    }
+    /* Other peers take over its downloads once the event batch is done */
+    if (node->sync.header_conn == conn)
+    {
+        node->sync.header_conn = NULL;
+        node->resync = 1;
+    }
+    for (sync_window_t *window = node->sync.windows; window; window = window->next)
+    {
+        if (window->conn == conn)
+        {
+            window->conn = NULL;
+            node->resync = 1;
+        }
+    }
+}
+
+/**
+ * conn_reap - releases closed connections no job refers to any more
+ * @node: daemon state
+ */
+static void conn_reap(node_state_t *node)
+{
+    node_conn_t *next;
+
+    for (node_conn_t *conn = node->conns; node->nb_closed > 0 && conn; conn = next)
+    {
+        next = conn->next;
+        if (conn->fd < 0 && !conn->busy)
+        {
+            conn_free(node, conn);
+            node->nb_closed--;
+        }
+    }
+}
+
+/**
+ * conn_flush - sends as much pending output as the socket takes
+ * @conn: connection
+ * Return: 1 on success else 0 if the connection failed
+ */
+static int conn_flush(node_conn_t *conn)
+{
+    while (conn->out.pos < conn->out.len)
+    {
+        ssize_t written = write(conn->fd, conn->out.data + conn->out.pos, conn->out.len - conn->out.pos);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 1;
+        if (written <= 0)
+            return 0;
+        conn->out.pos += (size_t)written;
+    }
+    conn->out.len = conn->out.pos = 0;
+    return 1;
+}
+
+/**
+ * queue_job - hands a job to the job threads
+ * @node: daemon state
+ * @job: job to run
+ */
+static void queue_job(node_state_t *node, node_job_t *job)
+{
+    pthread_mutex_lock(&node->lock);
+    if (node->queue)
+        node->queue_tail->next = job;
+    else
+        node->queue = job;
+    node->queue_tail = job;
+    pthread_cond_signal(&node->ready);
+    pthread_mutex_unlock(&node->lock);
+}
+
+/**
+ * check_txs - hands the transactions received from peers to the job
+ * thread as one batch, unless a batch is being checked; the ones received
+ * meanwhile make the next batch, so the commits keep up with the rate
+ * @node: daemon state
+ */
+static void check_txs(node_state_t *node)
+{
+    node_job_t *job;
+
+    if (node->tx_checking || node->tx_batch.len == 0 || !(job = (node_job_t *)calloc(1, sizeof(node_job_t))))
+        return;
+    job->type = PEER_TX;
+    job->height = -1;
+    job->request = node->tx_batch;
+    buffer_init(&node->tx_batch);
+    node->tx_checking = 1;
+    queue_job(node, job);
+}
+
+/**
+ * ring_take - reads what local clients pushed to the submission ring, as
+ * much as the ring holds; the slots are released by ring_added
+ * @node: daemon state
+ * Return: job holding the records, or NULL if there are none
+ */
+static node_job_t *ring_take(node_state_t *node)
+{
+    tx_ring_record_t record;
+    node_job_t *job = NULL;
+    int popped;
+
+    for (int i = 0; i < TX_RING_SLOTS; i++)
+    {
+        popped = tx_ring_pop(node->ring, &node->ring_read, &record, &node->ring_stalled);
+        if (popped < 0)
+            dprintf(node->saved_err, "Skipped a submission its client never published\n");
+        if (popped <= 0)
+            break;
+        if (!job && !(job = (node_job_t *)calloc(1, sizeof(node_job_t))))
+        {
+            /* Read again by the next drain */
+            node->ring_read = atomic_load_explicit(&node->ring->tail, memory_order_relaxed);
+            return NULL;
+        }
+        if (!buffer_put(&job->request, &record, sizeof(record)))
+            dprintf(node->saved_err, "Dropped a submission from the ring\n");
+    }
+    if (job)
+    {
+        job->type = NODE_SUBMIT;
+        job->height = -1;
+    }
+    return job;
+}
+
+/**
+ * ring_added - releases the ring slots of a batch the job threads added,
+ * or reads the batch again if it could not be added
+ * @node: daemon state
+ * @job: job holding the batch
+ */
+static void ring_added(node_state_t *node, node_job_t *job)
+{
+    if (job->status)
+        tx_ring_release(node->ring, node->ring_read);
+    else
+        node->ring_read = atomic_load_explicit(&node->ring->tail, memory_order_relaxed);
+}
+
+/**
+ * ring_drain - hands the submissions of the ring to the job threads as one
+ * batch, unless a batch is being added; like check_txs, the ones pushed
+ * meanwhile make the next batch
+ * @node: daemon state
+ */
+static void ring_drain(node_state_t *node)
+{
+    node_job_t *job;
+
+    if (!node->ring || node->ring_draining || node->stopping || !(job = ring_take(node)))
+        return;
+    node->ring_draining = 1;
+    queue_job(node, job);
+}
+
+/**
+ * sync_reset - forgets the header chain and the windows of a catch-up
+ * Commit jobs already queued are still counted
+ * @sync: catch-up state
+ */
+static void sync_reset(node_sync_t *sync)
+{
+    int committing = sync->committing;
+    sync_window_t *next;
+
+    for (sync_window_t *window = sync->windows; window; window = next)
+    {
+        next = window->next;
+        free_blocks(window->blocks);
+        free(window);
+    }
+    free(sync->hashes);
+    memset(sync, 0, sizeof(*sync));
+    sync->base = -1;
+    sync->committing = committing;
+}
+
+/**
+ * sync_hash - hash the header chain holds for a height
+ * @sync: catch-up state
+ * @height: height between the base and the last verified header
+ * Return: SHA256_DIGEST_LENGTH bytes
+ */
+static unsigned char *sync_hash(node_sync_t *sync, long height)
+{
+    return height == sync->base ? sync->base_hash : sync->hashes[height - sync->base - 1];
+}
+
+/**
+ * sync_request - asks a peer for a range of blocks or headers
+ * @epoll_fd: event loop
+ * @conn: peer link
+ * @type: PEER_GET_BLOCKS or PEER_GET_HEADERS
+ * @first: first height
+ * @count: number of blocks
+ * Return: 1 on success else 0
+ */
+static int sync_request(int epoll_fd, node_conn_t *conn, NodeRequest type, long first, long count)
+{
+    buffer_t payload;
+    int result;
+
+    buffer_init(&payload);
+    result = buffer_put_varint(&payload, (uint64_t)first) && buffer_put_varint(&payload, (uint64_t)count) &&
+             node_frame_put(&conn->out, type, &payload);
+    buffer_free(&payload);
+    if (result)
+        conn_watch(epoll_fd, conn);
+    return result;
+}
+
+/**
+ * sync_assign - spreads the download of the bodies the header chain covers
+ * over every peer that has them, a few windows in flight per peer
+ * Windows a peer failed to deliver go first; downloads stay within
+ * PEER_SYNC_AHEAD blocks of the committed tip
+ * @node: daemon state
+ * @epoll_fd: event loop
+ */
+static void sync_assign(node_state_t *node, int epoll_fd)
+{
+    node_sync_t *sync = &node->sync;
+    long end = sync->base + sync->nb_headers, height;
+    sync_window_t *window, **tail;
+    int in_flight, progress = 1;
+
+    if (sync->base < 0)
+        return;
+    pthread_mutex_lock(&node->lock);
+    height = node->height;
+    pthread_mutex_unlock(&node->lock);
+
+    /* One window per peer and round, so every peer gets a share */
+    while (progress)
+    {
+        progress = 0;
+        for (node_conn_t *conn = node->conns; conn; conn = conn->next)
+        {
+            if (conn->fd < 0 || !conn->hello)
+                continue;
+            in_flight = 0;
+            window = NULL;
+            for (tail = &sync->windows; *tail; tail = &(*tail)->next)
+            {
+                in_flight += (*tail)->conn == conn;
+                if (!window && !(*tail)->conn && !(*tail)->blocks &&
+                    (*tail)->first + (*tail)->count - 1 <= conn->peer_height)
+                    window = *tail;
+            }
+            if (in_flight >= PEER_WINDOWS_PER_PEER)
+                continue;
+            if (!window && sync->next <= end && sync->next <= conn->peer_height &&
+                sync->next <= height + PEER_SYNC_AHEAD && (window = calloc(1, sizeof(sync_window_t))))
+            {
+                window->first = sync->next;
+                window->count = PEER_WINDOW_BLOCKS;
+                if (window->first + window->count - 1 > end)
+                    window->count = (int)(end - window->first + 1);
+                if (window->first + window->count - 1 > conn->peer_height)
+                    window->count = (int)(conn->peer_height - window->first + 1);
+                sync->next += window->count;
+                *tail = window;
+            }
+            if (!window || !sync_request(epoll_fd, conn, PEER_GET_BLOCKS, window->first, window->count))
+                continue;
+            window->conn = conn;
+            window->asked = ++sync->asked;
+            progress = 1;
+        }
+    }
+}
+
+/**
+ * sync_commit - hands the verified windows at the committed height to the
+ * job threads, consecutive ones merged into one journal group
+ * One commit runs at a time, so the windows verified meanwhile make the
+ * next group larger
+ * @node: daemon state
+ */
+static void sync_commit(node_state_t *node)
+{
+    node_sync_t *sync = &node->sync;
+    sync_window_t *window;
+    Block *last = NULL;
+    node_job_t *job;
+    long count = 0;
+
+    if (sync->committing || !sync->windows || !sync->windows->blocks ||
+        !(job = (node_job_t *)calloc(1, sizeof(node_job_t))))
+        return;
+    job->type = PEER_BLOCKS;
+    job->height = -1;
+    while ((window = sync->windows) && window->blocks && count + window->count <= PEER_COMMIT_BLOCKS)
+    {
+        if (last)
+            last->next = window->blocks;
+        else
+            job->blocks = window->blocks;
+        for (last = window->blocks; last->next; last = last->next)
+            ;
+        count += window->count;
+        sync->committed = window->first + window->count - 1;
+        sync->windows = window->next;
+        free(window);
+    }
+    if (!job->blocks)
+    {
+        free(job);
+        return;
+    }
+    sync->committing = 1;
+    queue_job(node, job);
+}
+
+/**
+ * sync_finish - reports and ends a catch-up once no header is being
+ * fetched, no window is left and every commit is done
+ * @node: daemon state
+ */
+static void sync_finish(node_state_t *node)
+{
+    node_sync_t *sync = &node->sync;
+    struct timespec now;
+    double elapsed;
+    long count = sync->committed - sync->base;
+
+    if (sync->base < 0 || sync->header_conn || sync->windows || sync->committing)
+        return;
+    if (count > 0)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        elapsed = (now.tv_sec - sync->start.tv_sec) + (now.tv_nsec - sync->start.tv_nsec) / 1e9;
+        dprintf(node->saved_out, "Synced %ld blocks in %.3f seconds (%.0f blocks/s)\n", count, elapsed,
+                elapsed > 0 ? count / elapsed : 0.0);
+    }
+    sync_reset(sync);
+}
+
+/**
+ * peer_sync - fetches the next headers from the tallest peer ahead of the
+ * header chain, starting a catch-up from the tip when none is going on,
+ * then hands out body downloads
+ * @node: daemon state
+ * @epoll_fd: event loop
+ */
+static void peer_sync(node_state_t *node, int epoll_fd)
+{
+    unsigned char tip[SHA256_DIGEST_LENGTH];
+    node_sync_t *sync = &node->sync;
+    node_conn_t *best = NULL;
+    long height, known;
+    int64_t tip_time;
+    int difficulty;
+
+    pthread_mutex_lock(&node->lock);
+    height = node->height;
+    memcpy(tip, node->tip, sizeof(tip));
+    tip_time = node->tip_time;
+    difficulty = node->difficulty;
+    pthread_mutex_unlock(&node->lock);
+    known = sync->base >= 0 ? sync->base + sync->nb_headers : height;
+    for (node_conn_t *conn = node->conns; conn; conn = conn->next)
+    {
+        if (conn->fd >= 0 && conn->hello && conn->peer_height > known &&
+            (!best || conn->peer_height > best->peer_height))
+            best = conn;
+    }
+
+    /* A new catch-up starts from the tip once the commits of the last one are done */
+    if (best && !sync->header_conn && height >= 0 && (sync->base >= 0 || !sync->committing))
+    {
+        if (sync->base < 0)
+        {
+            sync->base = sync->committed = height;
+            sync->next = height + 1;
+            memcpy(sync->base_hash, tip, sizeof(tip));
+            sync->time = tip_time;
+            sync->difficulty = difficulty;
+            clock_gettime(CLOCK_MONOTONIC, &sync->start);
+        }
+        if (sync_request(epoll_fd, best, PEER_GET_HEADERS, known + 1, PEER_HEADERS_MAX))
+            sync->header_conn = best;
+    }
+    sync_assign(node, epoll_fd);
+    sync_finish(node);
+}
+
+/**
+ * peer_headers - extends the header chain with the headers a peer sent,
+ * checking each links to the one before, has a valid timestamp and meets
+ * the difficulty the schedule sets for its height. A hash covers the block's transactions, so
+ * it is only recomputed once the body is committed
+ * @node: daemon state
+ * @epoll_fd: event loop
+ * @conn: peer link
+ * @payload: PEER_HEADERS payload
+ * @len: payload length
+ * Return: 1 on success else -1 if the payload is malformed
+ */
+static int peer_headers(node_state_t *node, int epoll_fd, node_conn_t *conn, unsigned char *payload, uint32_t len)
+{
+    buffer_t headers = {payload, len, len, 0};
+    node_sync_t *sync = &node->sync;
+    Block header;
+    uint64_t count, i;
+    long height, cap;
+    void *hashes;
+
+    /* Headers asked for by a catch-up that was given up */
+    if (conn != sync->header_conn)
+        return 1;
+    sync->header_conn = NULL;
+    if (!buffer_get_varint(&headers, &count) || count > PEER_HEADERS_MAX)
+        return -1;
+    if (sync->nb_headers + (long)count > sync->cap)
+    {
+        for (cap = sync->cap ? sync->cap : PEER_HEADERS_MAX; cap < sync->nb_headers + (long)count; cap *= 2)
+            ;
+        hashes = realloc(sync->hashes, cap * SHA256_DIGEST_LENGTH);
+        if (!hashes)
+            return -1;
+        sync->hashes = (unsigned char (*)[SHA256_DIGEST_LENGTH])hashes;
+        sync->cap = cap;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        height = sync->base + sync->nb_headers;
+        if (!peer_get_header(&headers, &header))
+            return -1;
+        if ((long)header.index != height + 1 ||
+            memcmp(header.previous_hash, sync_hash(sync, height), SHA256_DIGEST_LENGTH) != 0 ||
+            !valid_timestamp(header.timestamp, sync->time) || !is_valid_hash(header.current_hash, sync->difficulty))
+        {
+            dprintf(node->saved_err, "Peer sent an invalid header at height %ld\n", height + 1);
+            break;
+        }
+        memcpy(sync->hashes[sync->nb_headers++], header.current_hash, SHA256_DIGEST_LENGTH);
+        sync->difficulty = adjust_difficulty(sync->time, header.timestamp, sync->difficulty);
+        sync->time = header.timestamp;
+    }
+    /* A peer that stopped short has nothing past the headers it sent */
+    if (i < count || count < PEER_HEADERS_MAX)
+        conn->peer_height = sync->base + sync->nb_headers;
+    peer_sync(node, epoll_fd);
+    return 1;
+}
+
+/**
+ * sync_verify - checks the blocks a peer sent for a window against the
+ * header chain; windows are verified in whatever order they arrive, the
+ * hashes are recomputed by a job thread when the blocks are committed
+ * @sync: catch-up state
+ * @window: window the blocks were asked for, filled on success
+ * @message: PEER_BLOCKS payload
+ * Return: 1 if every block matches its header else 0
+ */
+static int sync_verify(node_sync_t *sync, sync_window_t *window, buffer_t *message)
+{
+    Block *block, *last = NULL;
+    uint64_t count;
+    long height;
+    int i;
+
+    if (!buffer_get_varint(message, &count) || count != (uint64_t)window->count)
+        return 0;
+    for (i = 0; i < window->count; i++)
+    {
+        height = window->first + i;
+        block = peer_get_block(message);
+        if (!block)
+            break;
+        if (last)
+            last->next = block;
+        else
+            window->blocks = block;
+        last = block;
+        if ((long)block->index != height ||
+            memcmp(block->previous_hash, sync_hash(sync, height - 1), SHA256_DIGEST_LENGTH) != 0 ||
+            memcmp(block->current_hash, sync_hash(sync, height), SHA256_DIGEST_LENGTH) != 0)
+            break;
+    }
+    if (i == window->count)
+        return 1;
+    free_blocks(window->blocks);
+    window->blocks = NULL;
+    return 0;
+}
+
+/**
+ * peer_blocks - verifies the blocks a peer sent for its oldest window and
+ * commits whatever is now in height order
+ * @node: daemon state
+ * @epoll_fd: event loop
+ * @conn: peer link
+ * @payload: PEER_BLOCKS payload
+ * @len: payload length
+ * Return: 1
+ */
+static int peer_blocks(node_state_t *node, int epoll_fd, node_conn_t *conn, unsigned char *payload, uint32_t len)
+{
+    buffer_t message = {payload, len, len, 0};
+    sync_window_t *window = NULL;
+
+    for (sync_window_t *other = node->sync.windows; other; other = other->next)
+    {
+        if (other->conn == conn && (!window || other->asked < window->asked))
+            window = other;
+    }
+    /* Blocks asked for by a catch-up that was given up */
+    if (!window)
+        return 1;
+    window->conn = NULL;
+    if (!sync_verify(&node->sync, window, &message))
+    {
+        dprintf(node->saved_err, "Peer sent invalid blocks %ld to %ld\n", window->first,
+                window->first + window->count - 1);
+        /* Other peers download them again */
+        conn->peer_height = window->first - 1;
+    }
+    sync_commit(node);
+    peer_sync(node, epoll_fd);
+    return 1;
+}
+
+/**
+ * peer_hello - handles a peer introducing itself or announcing its tip
+ * @node: daemon state
+ * @epoll_fd: event loop
+ * @conn: peer link
+ * @payload: PEER_HELLO payload
+ * @len: payload length
+ * Return: 1 on success else -1 if the payload is malformed
+ */
+static int peer_hello(node_state_t *node, int epoll_fd, node_conn_t *conn, unsigned char *payload, uint32_t len)
+{
+    buffer_t hello = {payload, len, len, 0};
+    unsigned char tip[SHA256_DIGEST_LENGTH];
+    uint64_t height;
+
+    if (!buffer_get_varint(&hello, &height) || !buffer_get(&hello, tip, sizeof(tip)) || height > INT32_MAX)
+        return -1;
+    if (!conn->hello)
+        dprintf(node->saved_out, "Peer %s at height %lu\n", conn->peer ? conn->peer->name : "connected",
+                (unsigned long)height);
+    conn->hello = 1;
+    conn->peer_height = (long)height;
+    peer_sync(node, epoll_fd);
+    return 1;
+}
+
+/**
+ * inv_ids - reads the transaction IDs of a PEER_INV or PEER_GET_TXS payload
+ * @payload: payload
+ * @len: payload length
+ * @count: where to store the number of IDs
+ * Return: the IDs, TXID_SIZE bytes each, or NULL if the payload is malformed
+ */
+static unsigned char *inv_ids(unsigned char *payload, uint32_t len, uint64_t *count)
+{
+    buffer_t inv = {payload, len, len, 0};
+
+    if (!buffer_get_varint(&inv, count) || *count > PEER_INV_MAX || inv.len - inv.pos != *count * TXID_SIZE)
+        return NULL;
+    return payload + inv.pos;
+}
+
+/**
+ * peer_inv - asks a peer for the transactions it announced that the node
+ * did not hear of; they are remembered as asked for, so another peer
+ * announcing them is not asked again
+ * @node: daemon state
+ * @conn: peer link
+ * @payload: PEER_INV payload
+ * @len: payload length
+ * Return: 1 on success else -1 if the payload is malformed
+ */
+static int peer_inv(node_state_t *node, node_conn_t *conn, unsigned char *payload, uint32_t len)
+{
+    unsigned char *ids;
+    uint64_t count;
+    buffer_t wanted;
+
+    if (!(ids = inv_ids(payload, len, &count)))
+        return -1;
+    buffer_init(&wanted);
+    for (uint64_t i = 0; i < count; i++)
+    {
+        if (!tx_seen_find(&node->seen, ids + i * TXID_SIZE) && tx_seen_add(&node->seen, ids + i * TXID_SIZE) &&
+            !buffer_put(&wanted, ids + i * TXID_SIZE, TXID_SIZE))
+            break;
+    }
+    if (!inv_put(&conn->out, PEER_GET_TXS, wanted.data, wanted.len / TXID_SIZE))
+        dprintf(node->saved_err, "Could not ask a peer for transactions\n");
+    buffer_free(&wanted);
+    return 1;
+}
+
+/**
+ * peer_get_txs - sends a peer the transactions it asked for that the node
+ * still remembers
+ * @node: daemon state
+ * @conn: peer link
+ * @payload: PEER_GET_TXS payload
+ * @len: payload length
+ * Return: 1 on success else -1 if the payload is malformed
+ */
+static int peer_get_txs(node_state_t *node, node_conn_t *conn, unsigned char *payload, uint32_t len)
+{
+    tx_seen_entry_t *entry;
+    unsigned char *ids;
+    uint64_t count;
+
+    if (!(ids = inv_ids(payload, len, &count)))
+        return -1;
+    for (uint64_t i = 0; i < count; i++)
+    {
+        entry = tx_seen_find(&node->seen, ids + i * TXID_SIZE);
+        if (!entry || !entry->len)
+            continue;
+        buffer_t tx = {entry->tx, entry->len, entry->len, 0};
+        if (!node_frame_put(&conn->out, PEER_TX, &tx))
+            break;
+    }
+    return 1;
+}
+
+/**
+ * peer_tx - queues a transaction a peer sent for checking, unless the node
+ * got it already; it is then kept to serve peers once it is announced
+ * @node: daemon state
+ * @payload: PEER_TX payload
+ * @len: payload length
+ * Return: 1 on success else -1 if the payload is malformed
+ */
+static int peer_tx(node_state_t *node, unsigned char *payload, uint32_t len)
+{
+    buffer_t message = {payload, len, len, 0};
+    unsigned char id[TXID_SIZE];
+    tx_seen_entry_t *entry;
+    Transaction trans;
+
+    if (len > PEER_TX_SIZE_MAX || !peer_get_transaction(&message, &trans) || message.pos != len)
+        return -1;
+    transaction_id(&trans, id);
+    entry = tx_seen_add(&node->seen, id);
+    /* Sent by two peers, or again */
+    if (!entry || entry->len)
+        return 1;
+    if (!buffer_put(&node->tx_batch, payload, len))
+        return 1;
+    memcpy(entry->tx, payload, len);
+    entry->len = (unsigned char)len;
+    check_txs(node);
+    return 1;
+}
+
+/**
+ * peer_broadcast - queues frames for every peer but the one they came from
+ * A peer that stopped reading is dropped rather than buffered for
+ * @node: daemon state
+ * @epoll_fd: event loop
+ * @frames: frames to send
+ * @from: connection the frames came from, may be a local client
+ */
+static void peer_broadcast(node_state_t *node, int epoll_fd, const buffer_t *frames, node_conn_t *from)
+{
+    for (node_conn_t *conn = node->conns; conn; conn = conn->next)
+    {
+        if (conn == from || conn->fd < 0 || !conn->hello)
+            continue;
+        if (conn->out.len - conn->out.pos > PEER_MESSAGE_MAX || !buffer_put(&conn->out, frames->data, frames->len))
+            conn_close(node, conn);
+        else
+            conn_watch(epoll_fd, conn);
+    }
+}
+
+/**
+ * announce_txs - offers peers the transactions a job added to the pool by
+ * their IDs, and keeps them to serve the peers that ask
+ * The peer a transaction came from is offered it too and ignores it
+ * @node: daemon state
+ * @epoll_fd: event loop
+ * @job: finished NODE_SUBMIT or PEER_TX job, its announcement holding the
+ * PEER_TX frame of each transaction added
+ */
+static void announce_txs(node_state_t *node, int epoll_fd, node_job_t *job)
+{
+    unsigned char id[TXID_SIZE];
+    tx_seen_entry_t *entry;
+    buffer_t ids, frames;
+    Transaction trans;
+    uint32_t type, len;
+
+    buffer_init(&ids);
+    buffer_init(&frames);
+    while (node_frame_parse(&job->announce, PEER_TX_SIZE_MAX, &type, &len) == 1)
+    {
+        buffer_t message = {job->announce.data + job->announce.pos, len, len, 0};
+
+        job->announce.pos += len;
+        if (type != PEER_TX || !peer_get_transaction(&message, &trans))
+            continue;
+        transaction_id(&trans, id);
+        entry = tx_seen_add(&node->seen, id);
+        if (entry && !entry->len)
+        {
+            memcpy(entry->tx, message.data, len);
+            entry->len = (unsigned char)len;
+        }
+        if (!buffer_put(&ids, id, TXID_SIZE))
+            break;
+    }
+    if (ids.len > 0 && inv_put(&frames, PEER_INV, ids.data, ids.len / TXID_SIZE))
+        peer_broadcast(node, epoll_fd, &frames, NULL);
+    buffer_free(&ids);
+    buffer_free(&frames);
+}
+
+/**
+ * work_assign - hands a pool worker the next nonce range of the template,
+ * or no work while there is none
+ * Once the nonces of a timestamp are handed out the timestamp moves on by
+ * a microsecond, which changes every hash of the template
+ * @node: daemon state
+ * @conn: worker link
+ * Return: 1 on success else 0
+ */
+static int work_assign(node_state_t *node, node_conn_t *conn)
+{
+    mining_pool_t *mining = &node->mining;
+    buffer_t payload;
+    int result;
+
+    if (mining->work.block)
+    {
+        if (mining->next_nonce + POOL_RANGE_NONCES > UINT32_MAX)
+        {
+            mining->work.timestamp++;
+            mining->next_nonce = 0;
+        }
+        mining->work.first = (uint32_t)mining->next_nonce;
+        mining->work.count = POOL_RANGE_NONCES;
+        mining->next_nonce += POOL_RANGE_NONCES;
+    }
+    buffer_init(&payload);
+    result = pool_put_work(&payload, &mining->work) && node_frame_put(&conn->out, POOL_WORK, &payload);
+    buffer_free(&payload);
+    return result;
+}
+
+/**
+ * workers_notify - hands every pool worker a range of a new template, or
+ * stops them all when there is no work; they drop what they were mining
+ * @node: daemon state
+ * @epoll_fd: event loop
+ */
+static void workers_notify(node_state_t *node, int epoll_fd)
+{
+    for (node_conn_t *conn = node->conns; conn; conn = conn->next)
+    {
+        if (conn->fd < 0 || !conn->worker)
+            continue;
+        if (!work_assign(node, conn))
+            conn_close(node, conn);
+        else
+            conn_watch(epoll_fd, conn);
+    }
+}
+
+/**
+ * worker_get_work - answers a pool worker done with its range
+ * @node: daemon state
+ * @conn: worker link
+ * @payload: POOL_GET_WORK payload, the hashes tried since its last message
+ * @len: payload length
+ * Return: 1 on success else -1 if the message is malformed
+ */
+static int worker_get_work(node_state_t *node, node_conn_t *conn, unsigned char *payload, uint32_t len)
+{
+    buffer_t message = {payload, len, len, 0};
+    uint64_t hashes;
+
+    if (!buffer_get_varint(&message, &hashes) || message.pos != message.len)
+        return -1;
+    node->mining.hashes += hashes;
+    return work_assign(node, conn) ? 1 : -1;
+}
+
+/**
+ * worker_share - checks a share a pool worker found; the first one solving
+ * the template is handed to the job threads and the other workers stop
+ * Shares for an earlier template, or for one already solved, are late and
+ * ignored
+ * @node: daemon state
+ * @epoll_fd: event loop
+ * @payload: POOL_SHARE payload
+ * @len: payload length
+ * Return: 1 on success else -1 if the message is malformed or the share
+ * does not solve the template
+ */
+static int worker_share(node_state_t *node, int epoll_fd, unsigned char *payload, uint32_t len)
+{
+    mining_pool_t *mining = &node->mining;
+    buffer_t message = {payload, len, len, 0};
+    Block *block = mining->work.block;
+    pool_share_t share;
+    int64_t now;
+    node_job_t *job;
+
+    if (!pool_get_share(&message, &share))
+        return -1;
+    mining->hashes += share.hashes;
+    if (!block || share.job != mining->work.job)
+        return 1;
+    if (share.timestamp < mining->started || share.timestamp > mining->work.timestamp)
+        return -1;
+    block->timestamp = share.timestamp;
+    block->nonce = share.nonce;
+    calculate_hash(block, block->current_hash);
+    if (!is_valid_hash(block->current_hash, mining->work.difficulty))
+        return -1;
+
+    job = (node_job_t *)calloc(1, sizeof(node_job_t));
+    if (!job)
+    {
+        /* The template is kept, another share may solve it */
+        return 1;
+    }
+    job->type = POOL_SHARE;
+    job->height = -1;
+    job->blocks = block;
+    mining->work.block = NULL;
+    now = current_timestamp();
+    mining->busy += now - mining->started;
+    /* Workers report their hashes late, so the rate is taken over all the templates */
+    dprintf(node->saved_out, "Pool solved block %u in %.3f s, %d workers at %.0f hashes/s\n", block->index,
+            (double)(now - mining->started) / TIMESTAMP_RESOLUTION, mining->nb_workers,
+            mining->busy > 0 ? (double)mining->hashes * TIMESTAMP_RESOLUTION / mining->busy : 0.0);
+    queue_job(node, job);
+    workers_notify(node, epoll_fd);
+    return 1;
+}
+
+/**
+ * pool_refresh - has the template built again once the tip moved, and
+ * when it is stale: the pool changed while it had room for transactions,
+ * or its block was solved
+ * @node: daemon state
+ */
+static void pool_refresh(node_state_t *node)
+{
+    mining_pool_t *mining = &node->mining;
+    node_job_t *job;
+
+    if (mining->fd < 0)
+        return;
+    if (mining->work.block)
+    {
+        pthread_mutex_lock(&node->lock);
+        if (memcmp(node->tip, mining->work.block->previous_hash, SHA256_DIGEST_LENGTH) != 0)
+            mining->stale = 1;
+        pthread_mutex_unlock(&node->lock);
+    }
+    if (mining->building || !mining->stale || mining->nb_workers == 0 ||
+        !(job = (node_job_t *)calloc(1, sizeof(node_job_t))))
+        return;
+    job->type = POOL_WORK;
+    job->height = -1;
+    mining->building = 1;
+    mining->stale = 0;
+    queue_job(node, job);
+}
+
+/**
+ * pool_installed - makes a template a job thread built the one workers
+ * mine, and hands it to them
+ * @node: daemon state
+ * @epoll_fd: event loop
+ * @job: finished template job, its template taken over
+ */
+static void pool_installed(node_state_t *node, int epoll_fd, node_job_t *job)
+{
+    mining_pool_t *mining = &node->mining;
+
+    mining->building = 0;
+    if (mining->work.block)
+        mining->busy += current_timestamp() - mining->started;
+    free_blocks(mining->work.block);
+    mining->work.block = NULL;
+    if (job->status && job->blocks)
+    {
+        mining->work.block = job->blocks;
+        job->blocks = NULL;
+        mining->work.job++;
+        mining->work.difficulty = job->difficulty;
+        mining->work.timestamp = mining->started = mining->work.block->timestamp;
+        mining->next_nonce = 0;
+    }
+    workers_notify(node, epoll_fd);
+}
+
+/**
+ * conn_dispatch - handles the complete requests of a connection in order
+ * until one has to wait for the job threads, then sends what is ready
+ * @node: daemon state
+ * @epoll_fd: event loop
+ * @conn: connection
+ */
+static void conn_dispatch(node_state_t *node, int epoll_fd, node_conn_t *conn)
+{
+    static const unsigned char no_output[] = {0, 0};
+    buffer_t empty = {(unsigned char *)no_output, sizeof(no_output), sizeof(no_output), 0};
+    uint32_t type, len;
+    int found = 1;
+    node_job_t *job;
+
+    while (!conn->busy && conn->out.len - conn->out.pos < NODE_BUFFER_MAX &&
+           (found = node_frame_parse(&conn->in, conn->remote ? PEER_MESSAGE_MAX : NODE_REQUEST_MAX, &type,
+                                     &len)) == 1)
+    {
+        unsigned char *payload = conn->in.data + conn->in.pos;
+
+        conn->in.pos += len;
+        /* Peer links only carry peer messages and worker links pool
+         * messages, local clients neither */
+        if (conn->remote != (type >= PEER_HELLO && type < POOL_GET_WORK) || conn->worker != (type >= POOL_GET_WORK))
+        {
+            found = -1;
+            break;
+        }
+        /* Workers are answered here, mining does not wait for the job threads */
+        if (conn->worker)
+        {
+            found = type == POOL_GET_WORK ? worker_get_work(node, conn, payload, len)
+                    : type == POOL_SHARE  ? worker_share(node, epoll_fd, payload, len)
+                                          : -1;
+            if (found < 0)
+                break;
+            continue;
+        }
+        /* Sync answers are checked here so verification is not queued
+         * behind the commits */
+        if (type == PEER_HELLO || type == PEER_HEADERS || type == PEER_BLOCKS)
+        {
+            found = type == PEER_HELLO     ? peer_hello(node, epoll_fd, conn, payload, len)
+                    : type == PEER_HEADERS ? peer_headers(node, epoll_fd, conn, payload, len)
+                                           : peer_blocks(node, epoll_fd, conn, payload, len);
+            if (found < 0)
+                break;
+            continue;
+        }
+        /* So is gossip; only transactions the node did not have reach the
+         * job threads, in batches */
+        if (type == PEER_INV || type == PEER_GET_TXS || type == PEER_TX)
+        {
+            found = type == PEER_INV       ? peer_inv(node, conn, payload, len)
+                    : type == PEER_GET_TXS ? peer_get_txs(node, conn, payload, len)
+                                           : peer_tx(node, payload, len);
+            if (found < 0)
+                break;
+            continue;
+        }
+        if (type == NODE_PING)
+        {
+            found = node_frame_put(&conn->out, 1, &empty);
+            continue;
+        }
+        if (type == NODE_BALANCE && cached_balance(node, &conn->out))
+            continue;
+
+        job = (node_job_t *)calloc(1, sizeof(node_job_t));
+        if (!job || !buffer_put(&job->request, payload, len))
+        {
+            free(job);
+            found = -1;
+            break;
+        }
+        job->conn = conn;
+        job->type = type;
+        job->height = -1;
+        conn->busy = 1;
+        queue_job(node, job);
+    }
+    if (found < 0)
+    {
+        dprintf(node->saved_err, "Dropped a connection sending a malformed request\n");
+        conn_close(node, conn);
+        return;
+    }
+
+    /* Keep the unparsed tail at the start so the buffer does not creep */
+    if (conn->in.pos > 0)
+    {
+        memmove(conn->in.data, conn->in.data + conn->in.pos, conn->in.len - conn->in.pos);
+        conn->in.len -= conn->in.pos;
+        conn->in.pos = 0;
+    }
+    if (!conn_flush(conn))
+    {
+        conn_close(node, conn);
+        return;
+    }
+    conn_watch(epoll_fd, conn);
+}
+
+/**
+ * conn_read - reads what a connection sent and handles it
+ * @node: daemon state
+ * @epoll_fd: event loop
+ * @conn: connection
+ */
+static void conn_read(node_state_t *node, int epoll_fd, node_conn_t *conn)
+{
+    while (conn->in.len - conn->in.pos < conn_limit(conn))
+    {
+        if (!buffer_reserve(&conn->in, 65536))
+        {
+            conn_close(node, conn);
+            return;
+        }
+        ssize_t got = read(conn->fd, conn->in.data + conn->in.len, conn->in.cap - conn->in.len);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (got <= 0)
+        {
+            conn_close(node, conn);
+            return;
+        }
+        conn->in.len += (size_t)got;
+    }
+    conn_dispatch(node, epoll_fd, conn);
+}
+
+/**
+ * node_hello - appends the PEER_HELLO frame of the node's current tip
+ * @node: daemon state
+ * @out: buffer to append to
+ * Return: 1 on success else 0
+ */
+static int node_hello(node_state_t *node, buffer_t *out)
+{
+    int result;
+
+    pthread_mutex_lock(&node->lock);
+    result = peer_put_hello(out, node->height < 0 ? 0 : node->height, node->tip);
+    pthread_mutex_unlock(&node->lock);
+    return result;
+}
+
+/**
+ * conn_add - watches a new connection; a peer link starts by introducing
+ * the node
+ * @node: daemon state
+ * @epoll_fd: event loop
+ * @fd: non-blocking socket, closed on failure
+ * @remote: whether the connection is a TCP link to another node
+ * Return: connection or NULL on failure
+ */
+static node_conn_t *conn_add(node_state_t *node, int epoll_fd, int fd, int remote)
+{
+    struct epoll_event event;
+    node_conn_t *conn = (node_conn_t *)calloc(1, sizeof(node_conn_t));
+
+    event.events = EPOLLIN;
+    event.data.ptr = conn;
+    if (!conn || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+    {
+        dprintf(node->saved_err, "Could not watch node client\n");
+        free(conn);
+        close(fd);
+        return NULL;
+    }
+    conn->fd = fd;
+    conn->events = EPOLLIN;
+    conn->remote = remote;
+    conn->peer_height = -1;
+    conn->next = node->conns;
+    if (node->conns)
+        node->conns->prev = conn;
+    node->conns = conn;
+    if (remote && !node_hello(node, &conn->out))
+        conn_close(node, conn);
+    else if (remote)
+        conn_watch(epoll_fd, conn);
+    return conn->fd >= 0 ? conn : NULL;
+}
+
+/**
+ * accept_clients - accepts every pending connection
+ * @node: daemon state
+ * @epoll_fd: event loop
+ * @server: listening socket
+ * @remote: whether the socket accepts peers over TCP
+ * @worker: whether the socket accepts pool workers over TCP
+ */
+static void accept_clients(node_state_t *node, int epoll_fd, int server, int remote, int worker)
+{
+    node_conn_t *conn;
+    int one = 1, fd;
+
+    while ((fd = accept(server, NULL, NULL)) >= 0)
+    {
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        if (remote || worker)
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        conn = conn_add(node, epoll_fd, fd, remote);
+        if (conn && worker)
+        {
+            conn->worker = 1;
+            node->mining.nb_workers++;
+        }
+    }
+    /* The first worker has the template built */
+    if (worker)
+        pool_refresh(node);
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        dprintf(node->saved_err, "Failed to accept node client: %s\n", strerror(errno));
+}
+
+/**
+ * peers_connect - connects to the configured peers that are not linked,
+ * at most once every PEER_RETRY seconds each
+ * @node: daemon state
+ * @epoll_fd: event loop
+ */
+static void peers_connect(node_state_t *node, int epoll_fd)
+{
+    struct timespec now;
+    node_conn_t *conn;
+    int fd;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    for (int i = 0; i < node->nb_peers; i++)
+    {
+        node_peer_t *peer = &node->peers[i];
+
+        if (peer->conn || peer->retry_at > now.tv_sec)
+            continue;
+        peer->retry_at = now.tv_sec + PEER_RETRY;
+        fd = peer_connect(&peer->addr);
+        conn = fd >= 0 ? conn_add(node, epoll_fd, fd, 1) : NULL;
+        if (conn)
+        {
+            conn->peer = peer;
+            peer->conn = conn;
+        }
+    }
+}
+
+/**
+ * peer_finished - sends what a peer job answered; a block announced ahead
+ * of the tip makes the node sync
+ * @node: daemon state
+ * @epoll_fd: event loop
+ * @job: finished peer job
+ */
+static void peer_finished(node_state_t *node, int epoll_fd, node_job_t *job)
+{
+    node_conn_t *conn = job->conn;
+
+    if (job->height > conn->peer_height)
+        conn->peer_height = job->height;
+    if (conn->fd >= 0 && !buffer_put(&conn->out, job->response.data, job->response.len))
+        conn_close(node, conn);
+    else if (conn->fd >= 0)
+        conn_dispatch(node, epoll_fd, conn);
+    if (job->type == PEER_BLOCK || job->type == PEER_COMPACT_BLOCK || job->type == PEER_BLOCK_TXS)
+        peer_sync(node, epoll_fd);
+}
+
+/**
+ * sync_committed - moves a catch-up on once a job thread committed
+ * downloaded blocks; a failed commit gives the catch-up up, and the next
+ * one starts from the tip
+ * @node: daemon state
+ * @epoll_fd: event loop
+ * @job: finished commit job
+ */
+static void sync_committed(node_state_t *node, int epoll_fd, node_job_t *job)
+{
+    node->sync.committing = 0;
+    if (!job->status && node->sync.base >= 0)
+    {
+        dprintf(node->saved_err, "Sync stopped, downloaded blocks could not be committed\n");
+        sync_reset(&node->sync);
+    }
+    sync_commit(node);
+    peer_sync(node, epoll_fd);
+}
+
+/**
+ * finish_jobs - sends the responses of the jobs the job threads finished
+ * and resumes the requests pipelined behind them
+ * @node: daemon state
+ * @epoll_fd: event loop
+ */
+static void finish_jobs(node_state_t *node, int epoll_fd)
+{
+    node_job_t *done, *job, *reversed = NULL;
+    uint64_t count;
+
+    if (read(node->wake_fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        dprintf(node->saved_err, "Could not read job wakeups\n");
+    pthread_mutex_lock(&node->lock);
+    done = node->done;
+    node->done = NULL;
+    pthread_mutex_unlock(&node->lock);
+    /* Finished jobs were pushed newest first */
+    while (done)
+    {
+        job = done;
+        done = done->next;
+        job->next = reversed;
+        reversed = job;
+    }
+
+    while ((job = reversed))
+    {
+        node_conn_t *conn = job->conn;
+
+        reversed = job->next;
+        if (conn)
+            conn->busy = 0;
+        /* Transactions added while the template has room make it stale */
+        if ((job->type == NODE_SUBMIT || job->type == PEER_TX) && job->announce.len > 0 &&
+            (!node->mining.work.block || node->mining.work.block->transactions->nb_trans < TRANSACTION_VOLUME))
+            node->mining.stale = 1;
+        if (job->type == NODE_SUBMIT || job->type == PEER_TX)
+            announce_txs(node, epoll_fd, job);
+        else if (job->announce.len > 0)
+            peer_broadcast(node, epoll_fd, &job->announce, conn);
+        /* A client that went away is released by conn_reap */
+        if (!conn && job->type == PEER_TX)
+        {
+            node->tx_checking = 0;
+            check_txs(node);
+        }
+        else if (!conn && job->type == NODE_SUBMIT)
+        {
+            ring_added(node, job);
+            node->ring_draining = 0;
+            ring_drain(node);
+        }
+        else if (!conn && job->type == POOL_WORK)
+            pool_installed(node, epoll_fd, job);
+        else if (!conn && job->type == POOL_SHARE)
+            node->mining.stale = 1;
+        else if (!conn)
+            sync_committed(node, epoll_fd, job);
+        else if (job->type >= PEER_HELLO)
+            peer_finished(node, epoll_fd, job);
+        else if (conn->fd >= 0 && !node_frame_put(&conn->out, (uint32_t)job->status, &job->response))
+            conn_close(node, conn);
+        else if (conn->fd >= 0)
+            conn_dispatch(node, epoll_fd, conn);
+        buffer_free(&job->request);
+        buffer_free(&job->response);
+        buffer_free(&job->announce);
+        free_blocks(job->blocks);
+        free(job);
+    }
+    pool_refresh(node);
+}
+
+/**
+ * node_listen - binds the node socket, replacing a stale one
+ * Return: non-blocking listening socket or -1 on failure
+ */
+static int node_listen(void)
+{
+    struct sockaddr_un addr;
+    int fd = node_connect();
+
+    if (fd >= 0)
+    {
+        fprintf(stderr, "A node is already running on %s\n", NODE_SOCKET);
+        close(fd);
+        return -1;
+    }
+    /* Nobody answers on a socket left behind by a node that crashed */
+    unlink(NODE_SOCKET);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        perror("Failed to create node socket");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, NODE_SOCKET, sizeof(addr.sun_path) - 1);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || chmod(NODE_SOCKET, 0600) < 0 ||
+        listen(fd, NODE_BACKLOG) < 0)
+    {
+        perror("Failed to listen on node socket");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * node_init - routes what jobs print to their own streams, sets up the
+ * job queues and the event loop
+ * @node: daemon state to fill, peers already configured
+ * @server: listening socket
+ * Return: epoll descriptor or -1 on failure
+ */
+static int node_init(node_state_t *node, int server)
+{
+    cookie_io_functions_t out = {NULL, route_stdout, NULL, NULL}, err = {NULL, route_stderr, NULL, NULL};
+    struct epoll_event event;
+    struct rlimit limit;
+    FILE *routed_out, *routed_err;
+    int epoll_fd;
+
+    node->chain_failed = -2;
+    node->height = -1;
+    node->tree.prune_at = BLOCK_TREE_SIDE_MIN;
+    node->sync.base = -1;
+    fflush(stdout);
+    fflush(stderr);
+    node->saved_out = dup(STDOUT_FILENO);
+    node->saved_err = dup(STDERR_FILENO);
+    routed_out = fopencookie(node, "w", out);
+    routed_err = fopencookie(node, "w", err);
+    node->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (!routed_out || !routed_err || node->saved_out < 0 || node->saved_err < 0 || node->wake_fd < 0 ||
+        epoll_fd < 0)
+    {
+        perror("Failed to set up the node");
+        return -1;
+    }
+    /* Unbuffered, so each thread's output is routed while it prints */
+    setvbuf(routed_out, NULL, _IONBF, 0);
+    setvbuf(routed_err, NULL, _IONBF, 0);
+    stdout = routed_out;
+    stderr = routed_err;
+    pthread_mutex_init(&node->state, NULL);
+    pthread_mutex_init(&node->lock, NULL);
+    pthread_cond_init(&node->ready, NULL);
+
+    /* The listening socket is tagged NULL, the job wakeups with the node */
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server, &event) < 0)
+        return -1;
+    event.data.ptr = node;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, node->wake_fd, &event) < 0)
+        return -1;
+    /* and the peer and pool sockets with their own descriptors */
+    event.data.ptr = &node->peer_fd;
+    if (node->peer_fd >= 0 && epoll_ctl(epoll_fd, EPOLL_CTL_ADD, node->peer_fd, &event) < 0)
+        return -1;
+    event.data.ptr = &node->mining.fd;
+    if (node->mining.fd >= 0 && epoll_ctl(epoll_fd, EPOLL_CTL_ADD, node->mining.fd, &event) < 0)
+        return -1;
+
+    /* Every client holds a descriptor */
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    return epoll_fd;
+}
+
+/**
+ * node_configure - reads the peer and pool options of the daemon
+ * @node: daemon state to fill
+ * @argc: number of arguments
+ * @argv: --listen=HOST:PORT to accept peers, --peer=HOST:PORT for each
+ * peer to keep a link to, --full-blocks to relay blocks with all their
+ * transactions instead of compact blocks, --pool=HOST:PORT to accept
+ * pool workers mining blocks for the node
+ * Return: 1 on success else 0
+ */
+static int node_configure(node_state_t *node, int argc, char **argv)
+{
+    struct sockaddr_in addr;
+
+    node->peer_fd = -1;
+    node->mining.fd = -1;
+    node->mining.stale = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--listen=", 9) == 0 && node->peer_fd < 0 && peer_address(argv[i] + 9, &addr))
+        {
+            node->peer_fd = peer_listen(&addr);
+            if (node->peer_fd < 0)
+                return 0;
+        }
+        else if (strncmp(argv[i], "--pool=", 7) == 0 && node->mining.fd < 0 && peer_address(argv[i] + 7, &addr))
+        {
+            node->mining.fd = peer_listen(&addr);
+            if (node->mining.fd < 0)
+                return 0;
+        }
+        else if (strncmp(argv[i], "--peer=", 7) == 0 && node->nb_peers < PEERS_MAX &&
+                 strlen(argv[i] + 7) < sizeof(node->peers[0].name) &&
+                 peer_address(argv[i] + 7, &node->peers[node->nb_peers].addr))
+            strcpy(node->peers[node->nb_peers++].name, argv[i] + 7);
+        else if (strcmp(argv[i], "--full-blocks") == 0)
+            node->full_blocks = 1;
+        else
+        {
+            fprintf(stderr, "Usage: %s [--listen=HOST:PORT] [--peer=HOST:PORT]... [--full-blocks] [--pool=HOST:PORT]\n",
+                    argv[0]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * main - serves the chain, pool and accounts from memory over a UNIX socket
+ * until interrupted, keeps them in step with peer nodes over TCP and has
+ * pool workers mine its blocks
+ * One event loop does all socket I/O without blocking and drains the
+ * submission ring local clients push transactions to, a job thread runs
+ * the requests that need the node's state
+ * @argc: number of arguments
+ * @argv: peer and pool options, see node_configure
+ * Return: 0 on clean shutdown else 1
+ */
+int main(int argc, char **argv)
+{
+    struct epoll_event events[NODE_EVENTS_MAX];
+    struct sigaction action;
+    pthread_t workers[NODE_WORKERS];
+    node_state_t node;
+    node_job_t *job;
+    int server, epoll_fd, nb_events, nb_workers = 0;
+
+    memset(&node, 0, sizeof(node));
+    if (!node_configure(&node, argc, argv))
+    {
+        if (node.peer_fd >= 0)
+            close(node.peer_fd);
+        if (node.mining.fd >= 0)
+            close(node.mining.fd);
+        return 1;
+    }
+    server = node_listen();
+    if (server < 0)
+        return 1;
+    epoll_fd = node_init(&node, server);
+    if (epoll_fd < 0)
+    {
+        close(server);
+        unlink(NODE_SOCKET);
+        return 1;
+    }
+
+    /* No SA_RESTART, so a signal interrupts epoll_wait */
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_stop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    /* Warm the caches so the first request does not pay for loading */
+    if (!node_chain(&node))
+        fprintf(stderr, "Could not deserialize blockchain\n");
+    node_pool(&node);
+    node_users(&node);
+    publish_tip(&node);
+    while (nb_workers < NODE_WORKERS && pthread_create(&workers[nb_workers], NULL, job_thread, &node) == 0)
+        nb_workers++;
+    if (nb_workers == 0)
+    {
+        fprintf(stderr, "Could not start the job threads\n");
+        return 1;
+    }
+    node.ring = tx_ring_create(&node.ring_fd);
+    printf("Node listening on %s at height %ld\n", NODE_SOCKET, node.height);
+    fflush(stdout);
+
+    while (!stop)
+    {
+        /* Wake up regularly to drain the submission ring, and while
+         * configured peers may need reconnecting */
+        peers_connect(&node, epoll_fd);
+        nb_events = epoll_wait(epoll_fd, events, NODE_EVENTS_MAX,
+                               node.ring ? TX_RING_POLL_MS : node.nb_peers ? 1000 : -1);
+        for (int i = 0; i < nb_events; i++)
+        {
+            node_conn_t *conn = (node_conn_t *)events[i].data.ptr;
+
+            if (!conn)
+                accept_clients(&node, epoll_fd, server, 0, 0);
+            else if (events[i].data.ptr == (void *)&node.peer_fd)
+                accept_clients(&node, epoll_fd, node.peer_fd, 1, 0);
+            else if (events[i].data.ptr == (void *)&node.mining.fd)
+                accept_clients(&node, epoll_fd, node.mining.fd, 0, 1);
+            else if (events[i].data.ptr == (void *)&node)
+                finish_jobs(&node, epoll_fd);
+            else if (conn->fd >= 0 && (events[i].events & (EPOLLERR | EPOLLHUP)) && !(events[i].events & EPOLLIN))
+                conn_close(&node, conn);
+            else if (conn->fd >= 0 && (events[i].events & EPOLLIN))
+                conn_read(&node, epoll_fd, conn);
+            else if (conn->fd >= 0 && (events[i].events & EPOLLOUT))
+            {
+                if (conn_flush(conn))
+                    conn_dispatch(&node, epoll_fd, conn);
+                else
+                    conn_close(&node, conn);
+            }
+        }
+        /* Only now no received event can refer to a closed connection */
+        if (node.nb_closed)
+            conn_reap(&node);
+        if (node.resync)
+        {
+            node.resync = 0;
+            peer_sync(&node, epoll_fd);
+        }
+        ring_drain(&node);
+    }
+
+    /* Clients fall back to the socket, what they pushed is still added */
+    if (node.ring)
+        tx_ring_retire(node.ring, node.ring_fd);
+    /* Let the job threads finish what was queued, a block being mined included */
+    pthread_mutex_lock(&node.lock);
+    node.stopping = 1;
+    pthread_cond_broadcast(&node.ready);
+    pthread_mutex_unlock(&node.lock);
+    for (int i = 0; i < nb_workers; i++)
+        pthread_join(workers[i], NULL);
+    finish_jobs(&node, epoll_fd);
+    if (node.ring && (job = ring_take(&node)))
+    {
+        run_job(&node, job);
+        ring_added(&node, job);
+        buffer_free(&job->request);
+        buffer_free(&job->response);
+        buffer_free(&job->announce);
+        free(job);
+    }
+    tx_ring_close(node.ring);
+    while (node.conns)
+    {
+        if (node.conns->fd >= 0)
+            close(node.conns->fd);
+        conn_free(&node, node.conns);
+    }
+
+    close(server);
+    if (node.peer_fd >= 0)
+        close(node.peer_fd);
+    if (node.mining.fd >= 0)
+        close(node.mining.fd);
+    close(epoll_fd);
+    close(node.wake_fd);
+    unlink(NODE_SOCKET);
+    for (compact_block_t *compact = node.pending; compact; compact = node.pending)
+    {
+        node.pending = compact->next;
+        compact_free(compact);
+    }
+    free_blocks(node.mining.work.block);
+    tx_seen_free(&node.seen);
+    buffer_free(&node.tx_batch);
+    block_tree_free(&node.tree);
+    if (node.chain)
+        free_blockchain(node.chain);
+    free_transactions(node.pool);
+    if (node.users)
+        free_users(node.users);
+    if (node.account)
+        free_alu_account(node.account);
+    buffer_free(&node.balance.response);
+    sync_reset(&node.sync);
+    printf("Node stopped\n");
+    return 0;
+}
@@ -0,0 +1,336 @@
+#include "blockchain.h"
+
+static const char *role_names[] = {"Students", "Faculty", "Vendors", "Other"};
+
+/**
+ * compare_keys - orders account keys by address
+ * @a: first key
+ * @b: second key
+ * Return: comparison result for qsort and bsearch
+ */
+static int compare_keys(const void *a, const void *b)
+{
+    return memcmp(((const account_key_t *)a)->address, ((const account_key_t *)b)->address, ADDRESS_SIZE);
+}
+
+/**
+ * account_id - id of the account owning an address
+ * @part: worker slice holding the sorted keys
+ * @address: transaction address
+ * Return: account id, or -1 if no account owns the address
+ */
+static int account_id(const rich_part_t *part, const unsigned char *address)
+{
+    account_key_t key;
+    const account_key_t *found;
+
+    memcpy(key.address, address, ADDRESS_SIZE);
+    found = bsearch(&key, part->keys, part->nb_keys, sizeof(key), compare_keys);
+    return found ? found->id : -1;
+}
+
+/**
+ * insert_top - keeps a user among the largest balances if it belongs there
+ * @users: every user, indexed by id
+ * @top: ids sorted by decreasing balance
+ * @nb_top: number of ids in top, updated
+ * @limit: size of top
+ * @id: user to insert
+ */
+static void insert_top(user_t **users, int *top, int *nb_top, int limit, int id)
+{
+    int i;
+
+    if (*nb_top < limit)
+        i = (*nb_top)++;
+    else if (users[top[limit - 1]]->wallet->balance < users[id]->wallet->balance)
+        i = limit - 1;
+    else
+        return;
+    for (; i > 0 && users[top[i - 1]]->wallet->balance < users[id]->wallet->balance; i--)
+        top[i] = top[i - 1];
+    top[i] = id;
+}
+
+/**
+ * scan_part - aggregates one slice of the account store and of the chain
+ * Each worker reads the block file through its own reader, positioned by
+ * the time index, and only writes to its own partial aggregates
+ * @arg: pointer to the rich_part_t to fill
+ * Return: NULL
+ */
+static void *scan_part(void *arg)
+{
+    rich_part_t *part = (rich_part_t *)arg;
+    block_reader_t reader;
+    Block *block;
+
+    for (int id = part->first_user; id < part->end_user; id++)
+    {
+        user_t *user = part->users[id];
+        int role = user->role >= 0 && user->role < ROLE_COUNT ? (int)user->role : ROLE_COUNT;
+
+        part->role_users[role]++;
+        if (!user->wallet)
+            continue;
+        part->role_balance[role] += user->wallet->balance;
+        insert_top(part->users, part->top, &part->nb_top, part->limit, id);
+    }
+
+    if (part->first_block < 0)
+        return NULL;
+    if (!block_reader_open(&reader, part->first_block, 1))
+    {
+        part->failed = 1;
+        return NULL;
+    }
+    while ((block = block_reader_next(&reader)))
+    {
+        long height = block->index;
+        if (height >= part->first_block && (part->end_block < 0 || height < part->end_block))
+        {
+            part->pruned += block->pruned;
+            for (Transaction *trans = block->transactions->head; trans; trans = trans->next)
+            {
+                int sender = account_id(part, trans->sender), receiver = account_id(part, trans->receiver);
+                /* The genesis transfer is minted, not mined */
+                int fee = height > 0 ? TRANSACTION_FEE : 0;
+
+                part->transactions++;
+                part->volume += trans->amount;
+                part->fees += fee;
+                if (height == 0)
+                    continue;
+                if (sender >= 0)
+                {
+                    part->flows[sender].sent += trans->amount;
+                    part->flows[sender].fees += fee;
+                }
+                if (receiver >= 0)
+                    part->flows[receiver].received += trans->amount;
+                else
+                    part->unowned += trans->amount;
+            }
+        }
+        free_transactions(block->transactions);
+        free(block);
+        if (part->end_block >= 0 && height + 1 >= part->end_block)
+            break;
+    }
+    block_reader_close(&reader);
+    return NULL;
+}
+
+/**
+ * merge_parts - folds the partial aggregates of every worker into the first
+ * @parts: worker slices
+ * @nb_parts: number of slices
+ * @nb_accounts: number of entries in each flows array
+ */
+static void merge_parts(rich_part_t *parts, int nb_parts, int nb_accounts)
+{
+    rich_part_t *total = &parts[0];
+
+    for (int t = 1; t < nb_parts; t++)
+    {
+        for (int id = 0; id < nb_accounts; id++)
+        {
+            total->flows[id].sent += parts[t].flows[id].sent;
+            total->flows[id].received += parts[t].flows[id].received;
+            total->flows[id].fees += parts[t].flows[id].fees;
+        }
+        for (int r = 0; r <= ROLE_COUNT; r++)
+        {
+            total->role_balance[r] += parts[t].role_balance[r];
+            total->role_users[r] += parts[t].role_users[r];
+        }
+        total->unowned += parts[t].unowned;
+        total->transactions += parts[t].transactions;
+        total->volume += parts[t].volume;
+        total->fees += parts[t].fees;
+        total->pruned += parts[t].pruned;
+        total->failed |= parts[t].failed;
+        /* Each worker kept its own largest balances, the overall ones are among them */
+        for (int i = 0; i < parts[t].nb_top; i++)
+            insert_top(total->users, total->top, &total->nb_top, total->limit, parts[t].top[i]);
+    }
+}
+
+/**
+ * print_report - prints the merged aggregates
+ * @total: merged aggregates
+ * @account: ALU account, holding the token supply
+ * @nb_users: number of users
+ */
+static void print_report(rich_part_t *total, alu_account *account, int nb_users)
+{
+    int64_t held = 0;
+    char hex[ADDRESS_SIZE * 2 + 1];
+
+    printf("Top %d balances:\n", total->nb_top);
+    for (int i = 0; i < total->nb_top; i++)
+    {
+        user_t *user = total->users[total->top[i]];
+        account_flow_t *flow = &total->flows[total->top[i]];
+        bytes_to_hex(user->wallet->address, ADDRESS_SIZE, hex);
+        printf("%3d. %-20s %-9s %12d  %s  received %ld  sent %ld  fees %ld\n", i + 1, user->name,
+               role_names[user->role >= 0 && user->role < ROLE_COUNT ? user->role : ROLE_COUNT],
+               user->wallet->balance, hex, (long)flow->received, (long)flow->sent, (long)flow->fees);
+    }
+
+    printf("\nBalances by role:\n");
+    for (int r = 0; r <= ROLE_COUNT; r++)
+    {
+        held += total->role_balance[r];
+        if (total->role_users[r])
+            printf("%-9s %5ld users  %ld\n", role_names[r], total->role_users[r], (long)total->role_balance[r]);
+    }
+
+    int64_t difference = (int64_t)account->token->circulating_supply - held - account->wallet->balance;
+    printf("\nSupply reconciliation:\n");
+    printf("Circulating supply: %u\n", account->token->circulating_supply);
+    printf("Held by %d users: %ld\n", nb_users, (long)held);
+    printf("Held by %s: %d\n", account->name, account->wallet->balance);
+    printf("Difference: %ld%s\n", (long)difference, difference ? "  MISMATCH" : "  OK");
+    printf("On-chain: %lu transactions, volume %ld, fees %ld\n", (unsigned long)total->transactions,
+           (long)total->volume, (long)total->fees);
+    if (total->unowned)
+        printf("Received by addresses no account owns: %ld\n", (long)total->unowned);
+    if (total->pruned)
+        printf("Pruned blocks not scanned: %ld\n", total->pruned);
+}
+
+/**
+ * print_rich_list - prints the largest balances, balances per role and a
+ * reconciliation of balances against the circulating token supply
+ * Users and block heights are split into one slice per worker; workers
+ * aggregate into their own slice and the slices are merged at the end
+ * @limit: number of balances to list
+ * @nb_threads: number of workers, 0 for one per online CPU
+ * Return: 1 on success else 0
+ */
+int print_rich_list(int limit, int nb_threads)
+{
+    pthread_t threads[VALIDATION_THREADS_MAX];
+    rich_part_t parts[VALIDATION_THREADS_MAX];
+    int started[VALIDATION_THREADS_MAX];
+    checkpoint_t checkpoint;
+    lusers *users;
+    alu_account *account;
+    user_t **by_id;
+    account_key_t *keys;
+    int nb_users = 0, nb_keys = 0, result = 1;
+
+    journal_recover();
+    users = deserialize_users();
+    account = deserialize_alu_account();
+    if (!users || !account)
+    {
+        fprintf(stderr, "Could not load users and ALU account\n");
+        if (users)
+            free_users(users);
+        if (account)
+            free_alu_account(account);
+        return 0;
+    }
+    for (user_t *user = users->head; user; user = user->next)
+        nb_users++;
+    by_id = (user_t **)malloc(sizeof(user_t *) * (nb_users + 1));
+    keys = (account_key_t *)malloc(sizeof(account_key_t) * (nb_users + 1));
+    if (!by_id || !keys)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        free(by_id), free(keys);
+        free_users(users);
+        free_alu_account(account);
+        return 0;
+    }
+    nb_users = 0;
+    for (user_t *user = users->head; user; user = user->next)
+    {
+        if (user->wallet)
+        {
+            memcpy(keys[nb_keys].address, user->wallet->address, ADDRESS_SIZE);
+            keys[nb_keys++].id = nb_users;
+        }
+        by_id[nb_users++] = user;
+    }
+    memcpy(keys[nb_keys].address, account->wallet->address, ADDRESS_SIZE);
+    keys[nb_keys++].id = nb_users;
+    qsort(keys, nb_keys, sizeof(*keys), compare_keys);
+
+    if (nb_threads <= 0)
+        nb_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (nb_threads < 1)
+        nb_threads = 1;
+    if (nb_threads > VALIDATION_THREADS_MAX)
+        nb_threads = VALIDATION_THREADS_MAX;
+
+    /* The tip is only used to size the block slices, the last one reads to the end */
+    long tip = stats_height();
+    if (load_checkpoint(&checkpoint) && checkpoint.height > tip)
+        tip = checkpoint.height;
+    long blocks_per_part = (tip + 1 + nb_threads - 1) / nb_threads;
+    int users_per_part = (nb_users + nb_threads - 1) / nb_threads;
+    if (blocks_per_part < 1)
+        blocks_per_part = 1;
+
+    memset(parts, 0, sizeof(parts));
+    for (int t = 0; t < nb_threads; t++)
+    {
+        parts[t].users = by_id;
+        parts[t].first_user = t * users_per_part < nb_users ? t * users_per_part : nb_users;
+        parts[t].end_user = parts[t].first_user + users_per_part < nb_users ? parts[t].first_user + users_per_part
+                                                                              : nb_users;
+        parts[t].keys = keys;
+        parts[t].nb_keys = nb_keys;
+        parts[t].first_block = t * blocks_per_part <= tip || t == 0 ? t * blocks_per_part : -1;
+        parts[t].end_block = t == nb_threads - 1 || (t + 1) * blocks_per_part > tip ? -1 : (t + 1) * blocks_per_part;
+        parts[t].flows = (account_flow_t *)calloc(nb_users + 1, sizeof(account_flow_t));
+        parts[t].top = (int *)malloc(sizeof(int) * limit);
+        parts[t].limit = limit;
+        result = result && parts[t].flows && parts[t].top;
+    }
+    /* A worker past the tip has no blocks, the slice before it reads to the end */
+    for (int t = 1; t < nb_threads; t++)
+    {
+        if (parts[t].first_block < 0 && parts[t - 1].first_block >= 0)
+            parts[t - 1].end_block = -1;
+    }
+
+    if (result)
+    {
+        /* The calling thread takes the first slice itself */
+        for (int t = 1; t < nb_threads; t++)
+            started[t] = pthread_create(&threads[t], NULL, scan_part, &parts[t]) == 0;
+        scan_part(&parts[0]);
+        for (int t = 1; t < nb_threads; t++)
+        {
+            if (started[t])
+                pthread_join(threads[t], NULL);
+            else
+                scan_part(&parts[t]);
+        }
+        merge_parts(parts, nb_threads, nb_users + 1);
+        if (parts[0].failed)
+        {
+            fprintf(stderr, "Could not read the blockchain\n");
+            result = 0;
+        }
+        else
+            print_report(&parts[0], account, nb_users);
+    }
+    else
+        fprintf(stderr, "Memory allocation failed\n");
+
+    for (int t = 0; t < nb_threads; t++)
+    {
+        free(parts[t].flows);
+        free(parts[t].top);
+    }
+    free(by_id);
+    free(keys);
+    free_users(users);
+    free_alu_account(account);
+    return result;
+}
@@ -6,6 +6,11 @@
  */
 int main(void)
 {
+    if (node_call(NODE_BALANCE, NULL, NULL) >= 0)
+        return 0;
+    /* Without a running node the user files are read directly, from the
+     * generation last published while a mine_block may be writing */
+    generation_pin();
     view_balance();
     return 0;
 }
\ No newline at end of file
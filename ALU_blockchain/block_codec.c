@@ -0,0 +1,591 @@
+#include "blockchain.h"
+
+/**
+ * codec_state_init - resets the delta state before the first block of a file
+ * @state: pointer to codec state
+ */
+void codec_state_init(codec_state_t *state)
+{
+    state->prev_index = -1;
+    state->prev_time = 0;
+    memset(state->prev_hash, 0, SHA256_DIGEST_LENGTH);
+    state->segment_blocks = 0;
+    state->dict = NULL;
+    state->dict_count = 0;
+    state->dict_cap = 0;
+    state->slots = NULL;
+    state->nb_slots = 0;
+    state->bloom_bytes = BLOOM_FILTER_BYTES;
+}
+
+/**
+ * codec_state_free - releases the segment address dictionary
+ * @state: pointer to codec state
+ */
+void codec_state_free(codec_state_t *state)
+{
+    free(state->dict);
+    free(state->slots);
+    codec_state_init(state);
+}
+
+/**
+ * address_slot - finds the hash slot of an address in the dictionary
+ * Addresses are hash outputs, so their first bytes are already uniform
+ * @state: pointer to codec state
+ * @address: address to look up
+ * Return: slot holding the address, or the empty slot where it belongs
+ */
+static uint32_t address_slot(codec_state_t *state, const unsigned char *address)
+{
+    uint32_t slot;
+
+    memcpy(&slot, address, sizeof(slot));
+    slot &= state->nb_slots - 1;
+    while (state->slots[slot] != -1 &&
+           memcmp(state->dict[state->slots[slot]], address, ADDRESS_SIZE) != 0)
+        slot = (slot + 1) & (state->nb_slots - 1);
+    return slot;
+}
+
+/**
+ * index_dictionary - rebuilds the hash slots over the whole dictionary, sized
+ * for its current capacity
+ * @state: pointer to codec state
+ * Return: 1 on success else 0
+ */
+static int index_dictionary(codec_state_t *state)
+{
+    free(state->slots);
+    state->nb_slots = state->dict_cap * 2;
+    state->slots = (int32_t *)malloc(sizeof(*state->slots) * state->nb_slots);
+    if (!state->slots)
+    {
+        fprintf(stderr, "Failed to grow address dictionary\n");
+        state->nb_slots = 0;
+        return 0;
+    }
+    memset(state->slots, -1, sizeof(*state->slots) * state->nb_slots);
+    for (uint32_t i = 0; i < state->dict_count; i++)
+        state->slots[address_slot(state, state->dict[i])] = (int32_t)i;
+    return 1;
+}
+
+/**
+ * dict_append - adds an address to the segment dictionary
+ * @state: pointer to codec state
+ * @address: address to add
+ * @index_slots: 1 to also index the address for encoder lookups
+ * Return: 1 on success else 0
+ */
+static int dict_append(codec_state_t *state, const unsigned char *address, int index_slots)
+{
+    if (state->dict_count == state->dict_cap)
+    {
+        uint32_t cap = state->dict_cap ? state->dict_cap * 2 : 256;
+        unsigned char (*dict)[ADDRESS_SIZE] = realloc(state->dict, sizeof(*dict) * cap);
+        if (!dict)
+        {
+            fprintf(stderr, "Failed to grow address dictionary\n");
+            return 0;
+        }
+        state->dict = dict;
+        state->dict_cap = cap;
+    }
+    memcpy(state->dict[state->dict_count], address, ADDRESS_SIZE);
+
+    if (index_slots && state->nb_slots < state->dict_cap * 2 && !index_dictionary(state))
+        return 0;
+    if (index_slots)
+        state->slots[address_slot(state, address)] = (int32_t)state->dict_count;
+    state->dict_count++;
+    return 1;
+}
+
+/**
+ * start_segment - empties the address dictionary and the deltas at a
+ * segment boundary, so a segment can be decoded from its first record
+ * @state: pointer to codec state
+ */
+static void start_segment(codec_state_t *state)
+{
+    state->prev_index = -1;
+    state->prev_time = 0;
+    memset(state->prev_hash, 0, SHA256_DIGEST_LENGTH);
+    state->segment_blocks = 0;
+    state->dict_count = 0;
+    if (state->slots)
+        memset(state->slots, -1, sizeof(*state->slots) * state->nb_slots);
+}
+
+/**
+ * encode_address - resolves an address to its segment dictionary position,
+ * queuing it in the record's list of new addresses on first use
+ * @state: pointer to codec state
+ * @address: address to encode
+ * @added: buffer collecting addresses first seen in this record
+ * @ref: pointer to store dictionary position
+ * Return: 1 on success else 0
+ */
+static int encode_address(codec_state_t *state, const unsigned char *address, buffer_t *added, uint64_t *ref)
+{
+    if (state->nb_slots)
+    {
+        int32_t found = state->slots[address_slot(state, address)];
+        if (found != -1)
+        {
+            *ref = (uint64_t)found;
+            return 1;
+        }
+    }
+    *ref = state->dict_count;
+    return dict_append(state, address, 1) && buffer_put(added, address, ADDRESS_SIZE);
+}
+
+/**
+ * bloom_bits - derives the filter bit positions of an address by double
+ * hashing one FNV-1a hash
+ * @address: address to hash
+ * @nb_bits: number of bits in the filter
+ * @bits: array of BLOOM_HASHES positions to fill
+ */
+static void bloom_bits(const unsigned char *address, uint32_t nb_bits, uint32_t *bits)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (int i = 0; i < ADDRESS_SIZE; i++)
+    {
+        hash ^= address[i];
+        hash *= 0x100000001b3ULL;
+    }
+    uint32_t h1 = (uint32_t)hash, h2 = (uint32_t)(hash >> 32) | 1;
+    for (int i = 0; i < BLOOM_HASHES; i++)
+        bits[i] = (h1 + i * h2) % nb_bits;
+}
+
+/**
+ * block_bloom - builds the address filter of a block's transactions
+ * @block: pointer to block
+ * @bloom: filter to fill
+ * @size: filter size in bytes
+ */
+void block_bloom(Block *block, unsigned char *bloom, unsigned int size)
+{
+    uint32_t bits[BLOOM_HASHES];
+
+    memset(bloom, 0, size);
+    for (Transaction *trans = block->transactions ? block->transactions->head : NULL; trans; trans = trans->next)
+    {
+        bloom_bits(trans->sender, size * 8, bits);
+        for (int i = 0; i < BLOOM_HASHES; i++)
+            bloom[bits[i] / 8] |= 1 << (bits[i] % 8);
+        bloom_bits(trans->receiver, size * 8, bits);
+        for (int i = 0; i < BLOOM_HASHES; i++)
+            bloom[bits[i] / 8] |= 1 << (bits[i] % 8);
+    }
+}
+
+/**
+ * bloom_contains - tests an address against a block filter
+ * @bloom: filter
+ * @size: filter size in bytes, 0 when the block has no filter
+ * @address: address to test
+ * Return: 0 if the address is surely absent, 1 if it may be present
+ */
+int bloom_contains(const unsigned char *bloom, unsigned int size, const unsigned char *address)
+{
+    uint32_t bits[BLOOM_HASHES];
+
+    if (size == 0)
+        return 1;
+    bloom_bits(address, size * 8, bits);
+    for (int i = 0; i < BLOOM_HASHES; i++)
+    {
+        if (!(bloom[bits[i] / 8] & (1 << (bits[i] % 8))))
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * encode_block_compact - appends a block to a record buffer using the
+ * compact (version 3) layout: varint integers, height and timestamp
+ * deltas, previous hash omitted when it links to the prior block, and addresses referenced through a dictionary shared by every
+ * block of a CODEC_SEGMENT_BLOCKS segment. The header carries a Bloom
+ * filter of the block's addresses; pruned blocks keep their header only
+ * @block: pointer to block to encode
+ * @buffer: record buffer
+ * @state: delta state carried from the previous block in the file
+ * Return: 1 on success else 0
+ */
+int encode_block_compact(Block *block, buffer_t *buffer, codec_state_t *state)
+{
+    int nb_trans = block->transactions ? block->transactions->nb_trans : 0;
+    unsigned char flags = 0, bloom[BLOOM_FILTER_BYTES_MAX];
+    unsigned int bloom_size = 0;
+    uint64_t *refs;
+    buffer_t added;
+    Transaction *trans;
+    int i, result = 1;
+
+    if (state->prev_index < 0 || state->segment_blocks >= CODEC_SEGMENT_BLOCKS)
+    {
+        flags |= CODEC_NEW_SEGMENT;
+        start_segment(state);
+    }
+    /* A state left by the decoder has no lookup slots yet */
+    if (state->dict_cap && state->nb_slots < state->dict_cap * 2 && !index_dictionary(state))
+        return 0;
+    if (block->pruned)
+    {
+        flags |= CODEC_PRUNED;
+        nb_trans = 0;
+        bloom_size = block->bloom_size;
+        memcpy(bloom, block->bloom, bloom_size);
+    }
+    else if (state->bloom_bytes > 0 && state->bloom_bytes <= BLOOM_FILTER_BYTES_MAX)
+    {
+        bloom_size = state->bloom_bytes;
+        block_bloom(block, bloom, bloom_size);
+    }
+    if (bloom_size > 0)
+        flags |= CODEC_BLOOM;
+    if (memcmp(block->previous_hash, state->prev_hash, SHA256_DIGEST_LENGTH) != 0)
+        flags |= CODEC_PREVIOUS_HASH;
+
+    refs = (uint64_t *)malloc(sizeof(*refs) * (nb_trans * 2 + 1));
+    if (!refs)
+    {
+        fprintf(stderr, "Failed to allocate address references\n");
+        return 0;
+    }
+    buffer_init(&added);
+    for (i = 0, trans = block->transactions ? block->transactions->head : NULL;
+         result && trans && i < nb_trans; trans = trans->next, i++)
+    {
+        result = encode_address(state, trans->sender, &added, &refs[i * 2]) &&
+                 encode_address(state, trans->receiver, &added, &refs[i * 2 + 1]);
+    }
+    nb_trans = i;
+
+    result = result &&
+             buffer_put(buffer, &flags, sizeof(flags)) &&
+             buffer_put_svarint(buffer, (int64_t)block->index - state->prev_index - 1) &&
+             buffer_put_svarint(buffer, block->timestamp - state->prev_time) &&
+             buffer_put_varint(buffer, block->nonce) &&
+             buffer_put(buffer, block->miner, ADDRESS_SIZE) &&
+             (!(flags & CODEC_PREVIOUS_HASH) ||
+              buffer_put(buffer, block->previous_hash, SHA256_DIGEST_LENGTH)) &&
+             buffer_put(buffer, block->current_hash, SHA256_DIGEST_LENGTH) &&
+             (!(flags & CODEC_BLOOM) ||
+              (buffer_put_varint(buffer, bloom_size) && buffer_put(buffer, bloom, bloom_size))) &&
+             ((flags & CODEC_PRUNED) ||
+              (buffer_put_varint(buffer, added.len / ADDRESS_SIZE) &&
+               (!added.len || buffer_put(buffer, added.data, added.len)) &&
+               buffer_put_varint(buffer, (uint64_t)nb_trans)));
+    for (i = 0, trans = block->transactions ? block->transactions->head : NULL;
+         result && i < nb_trans; trans = trans->next, i++)
+    {
+        result = buffer_put_svarint(buffer, trans->index) &&
+                 buffer_put_varint(buffer, refs[i * 2]) &&
+                 buffer_put_varint(buffer, refs[i * 2 + 1]) &&
+                 buffer_put_svarint(buffer, trans->amount) &&
+                 buffer_put_varint(buffer, trans->status);
+    }
+    buffer_free(&added);
+    free(refs);
+
+    if (result)
+    {
+        state->prev_index = block->index;
+        state->prev_time = block->timestamp;
+        memcpy(state->prev_hash, block->current_hash, SHA256_DIGEST_LENGTH);
+        state->segment_blocks++;
+    }
+    return result;
+}
+
+/**
+ * decode_compact_addresses - adds a record's new addresses to the segment
+ * dictionary, which later records rely on even when this body is skipped
+ * @buffer: record buffer positioned at the record's new addresses
+ * @state: codec state holding the segment dictionary
+ * Return: 1 on success else 0 if the record is malformed
+ */
+static int decode_compact_addresses(buffer_t *buffer, codec_state_t *state)
+{
+    uint64_t nb_added;
+
+    if (!buffer_get_varint(buffer, &nb_added) ||
+        nb_added > (buffer->len - buffer->pos) / ADDRESS_SIZE)
+        return 0;
+    for (uint64_t i = 0; i < nb_added; i++)
+    {
+        if (!dict_append(state, buffer->data + buffer->pos, 0))
+            return 0;
+        buffer->pos += ADDRESS_SIZE;
+    }
+    return 1;
+}
+
+/**
+ * decode_compact_transactions - rebuilds a block's transaction list from a
+ * compact record
+ * @buffer: record buffer positioned after the record's new addresses
+ * @state: codec state holding the segment dictionary
+ * @transactions: list to append to
+ * Return: 1 on success else 0 if the record is malformed
+ */
+static int decode_compact_transactions(buffer_t *buffer, codec_state_t *state, utxo_t *transactions)
+{
+    uint64_t nb_trans, sender, receiver, status;
+    int64_t index, amount;
+
+    if (!buffer_get_varint(buffer, &nb_trans))
+        return 0;
+    for (uint64_t i = 0; i < nb_trans; i++)
+    {
+        if (!buffer_get_svarint(buffer, &index) ||
+            !buffer_get_varint(buffer, &sender) ||
+            !buffer_get_varint(buffer, &receiver) ||
+            !buffer_get_svarint(buffer, &amount) ||
+            !buffer_get_varint(buffer, &status) ||
+            sender >= state->dict_count || receiver >= state->dict_count || status > FAILED)
+            return 0;
+
+        Transaction *trans = (Transaction *)malloc(sizeof(Transaction));
+        if (!trans)
+        {
+            perror("Failed to allocate memory for transaction");
+            return 0;
+        }
+        trans->index = (int)index;
+        memcpy(trans->sender, state->dict[sender], ADDRESS_SIZE);
+        memcpy(trans->receiver, state->dict[receiver], ADDRESS_SIZE);
+        trans->amount = (int)amount;
+        trans->status = (Status)status;
+
+        trans->next = NULL;
+        if (transactions->head == NULL)
+            transactions->head = transactions->tail = trans;
+        else
+        {
+            transactions->tail->next = trans;
+            transactions->tail = trans;
+        }
+        transactions->nb_trans++;
+    }
+    return buffer->pos == buffer->len;
+}
+
+/**
+ * decode_block_compact - rebuilds a block from a compact record
+ * @buffer: record buffer
+ * @state: delta state carried from the previous block in the file
+ * Return: pointer to block or NULL if the record is malformed
+ */
+Block *decode_block_compact(buffer_t *buffer, codec_state_t *state)
+{
+    return decode_block_filtered(buffer, state, NULL, NULL);
+}
+
+/**
+ * decode_block_filtered - rebuilds a block from a compact record, leaving
+ * the transaction list empty when the block filter rules the address out
+ * @buffer: record buffer
+ * @state: delta state carried from the previous block in the file
+ * @address: address a scan looks for, or NULL to always decode the body
+ * @skipped: set to 1 if the body was skipped else 0, may be NULL
+ * Return: pointer to block or NULL if the record is malformed
+ */
+Block *decode_block_filtered(buffer_t *buffer, codec_state_t *state, const unsigned char *address, int *skipped)
+{
+    Block *block = (Block *)malloc(sizeof(Block));
+    utxo_t *transactions = (utxo_t *)malloc(sizeof(utxo_t));
+    unsigned char flags;
+    int64_t index_delta, time_delta = 0;
+    uint64_t nonce, bloom_size;
+    int ok, skip = 0;
+
+    if (!block || !transactions)
+    {
+        perror("Failed to allocate memory for block");
+        free(block);
+        free(transactions);
+        return NULL;
+    }
+    transactions->head = transactions->tail = NULL;
+    transactions->nb_trans = 0;
+    block->transactions = transactions;
+    block->pruned = 0;
+    block->bloom_size = 0;
+    block->next = NULL;
+
+    ok = buffer_get(buffer, &flags, sizeof(flags));
+    if (ok && (flags & CODEC_NEW_SEGMENT))
+        start_segment(state);
+    ok = ok && buffer_get_svarint(buffer, &index_delta) &&
+         buffer_get_svarint(buffer, &time_delta) &&
+         buffer_get_varint(buffer, &nonce) &&
+         buffer_get(buffer, block->miner, ADDRESS_SIZE);
+    if (ok && (flags & CODEC_PREVIOUS_HASH))
+        ok = buffer_get(buffer, block->previous_hash, SHA256_DIGEST_LENGTH);
+    else if (ok)
+        memcpy(block->previous_hash, state->prev_hash, SHA256_DIGEST_LENGTH);
+    ok = ok && buffer_get(buffer, block->current_hash, SHA256_DIGEST_LENGTH);
+    if (ok && (flags & CODEC_BLOOM))
+    {
+        ok = buffer_get_varint(buffer, &bloom_size) && bloom_size <= BLOOM_FILTER_BYTES_MAX &&
+             buffer_get(buffer, block->bloom, bloom_size);
+        block->bloom_size = (unsigned int)bloom_size;
+        skip = ok && address && !bloom_contains(block->bloom, block->bloom_size, address);
+    }
+    if (ok && (flags & CODEC_PRUNED))
+    {
+        block->pruned = 1;
+        ok = buffer->pos == buffer->len;
+    }
+    else if (ok && skip)
+    {
+        ok = decode_compact_addresses(buffer, state);
+        buffer->pos = buffer->len;
+    }
+    else if (ok)
+        ok = decode_compact_addresses(buffer, state) &&
+             decode_compact_transactions(buffer, state, transactions);
+    if (skipped)
+        *skipped = skip;
+    if (!ok)
+    {
+        free_transactions(transactions);
+        free(block);
+        return NULL;
+    }
+
+    block->index = (unsigned int)(state->prev_index + 1 + index_delta);
+    block->nonce = (unsigned int)nonce;
+    block->timestamp = state->prev_time + time_delta;
+    state->prev_time = block->timestamp;
+    state->prev_index = block->index;
+    memcpy(state->prev_hash, block->current_hash, SHA256_DIGEST_LENGTH);
+    state->segment_blocks++;
+    return block;
+}
+
+/**
+ * encode_block_fixed - appends a block and its transactions to a record
+ * buffer using the fixed-width (version 1) layout
+ * @block: pointer to block to encode
+ * @buffer: record buffer
+ * Return: 1 on success else 0
+ */
+int encode_block_fixed(Block *block, buffer_t *buffer)
+{
+    int nb_trans = block->transactions ? block->transactions->nb_trans : 0;
+
+    if (!buffer_put(buffer, &block->index, sizeof(block->index)) ||
+        !buffer_put(buffer, &block->timestamp, sizeof(block->timestamp)) ||
+        !buffer_put(buffer, &block->nonce, sizeof(block->nonce)) ||
+        !buffer_put(buffer, block->miner, ADDRESS_SIZE) ||
+        !buffer_put(buffer, block->previous_hash, SHA256_DIGEST_LENGTH) ||
+        !buffer_put(buffer, block->current_hash, SHA256_DIGEST_LENGTH) ||
+        !buffer_put(buffer, &nb_trans, sizeof(nb_trans)))
+        return 0;
+
+    if (!block->transactions)
+        return 1;
+    Transaction *trans = block->transactions->head;
+    while (trans)
+    {
+        if (!buffer_put(buffer, &trans->index, sizeof(trans->index)) ||
+            !buffer_put(buffer, trans->sender, sizeof(trans->sender)) ||
+            !buffer_put(buffer, trans->receiver, sizeof(trans->receiver)) ||
+            !buffer_put(buffer, &trans->amount, sizeof(trans->amount)) ||
+            !buffer_put(buffer, &trans->status, sizeof(trans->status)))
+            return 0;
+        trans = trans->next;
+    }
+    return 1;
+}
+
+/**
+ * decode_transactions - rebuilds a block's transaction list from a record
+ * @buffer: record buffer positioned at the first transaction
+ * @transactions: list to append to
+ * @nb_trans: number of transactions in record
+ * Return: 1 on success else 0 if the record is malformed
+ */
+static int decode_transactions(buffer_t *buffer, utxo_t *transactions, int nb_trans)
+{
+    for (int i = 0; i < nb_trans; i++)
+    {
+        Transaction *trans = (Transaction *)malloc(sizeof(Transaction));
+        if (!trans)
+        {
+            perror("Failed to allocate memory for transaction");
+            return 0;
+        }
+
+        if (!buffer_get(buffer, &trans->index, sizeof(trans->index)) ||
+            !buffer_get(buffer, trans->sender, sizeof(trans->sender)) ||
+            !buffer_get(buffer, trans->receiver, sizeof(trans->receiver)) ||
+            !buffer_get(buffer, &trans->amount, sizeof(trans->amount)) ||
+            !buffer_get(buffer, &trans->status, sizeof(trans->status)))
+        {
+            free(trans);
+            return 0;
+        }
+
+        trans->next = NULL;
+        if (transactions->head == NULL)
+            transactions->head = transactions->tail = trans;
+        else
+        {
+            transactions->tail->next = trans;
+            transactions->tail = trans;
+        }
+        transactions->nb_trans++;
+    }
+    return buffer->pos == buffer->len;
+}
+
+/**
+ * decode_block_fixed - rebuilds a block from a fixed-width record
+ * @buffer: record buffer
+ * Return: pointer to block or NULL if the record is malformed
+ */
+Block *decode_block_fixed(buffer_t *buffer)
+{
+    Block *block = (Block *)malloc(sizeof(Block));
+    utxo_t *transactions = (utxo_t *)malloc(sizeof(utxo_t));
+    int nb_trans;
+
+    if (!block || !transactions)
+    {
+        perror("Failed to allocate memory for block");
+        free(block);
+        free(transactions);
+        return NULL;
+    }
+    transactions->head = transactions->tail = NULL;
+    transactions->nb_trans = 0;
+    block->transactions = transactions;
+    block->pruned = 0;
+    block->bloom_size = 0;
+    block->next = NULL;
+
+    if (!buffer_get(buffer, &block->index, sizeof(block->index)) ||
+        !buffer_get(buffer, &block->timestamp, sizeof(block->timestamp)) ||
+        !buffer_get(buffer, &block->nonce, sizeof(block->nonce)) ||
+        !buffer_get(buffer, block->miner, ADDRESS_SIZE) ||
+        !buffer_get(buffer, block->previous_hash, SHA256_DIGEST_LENGTH) ||
+        !buffer_get(buffer, block->current_hash, SHA256_DIGEST_LENGTH) ||
+        !buffer_get(buffer, &nb_trans, sizeof(nb_trans)) ||
+        !decode_transactions(buffer, transactions, nb_trans))
+    {
+        free_transactions(transactions);
+        free(block);
+        return NULL;
+    }
+    return block;
+}
@@ -0,0 +1,338 @@
+#include "blockchain.h"
+
+/**
+ * tree_slot - linear probe for a block hash in a node table
+ * Hashes start with the zero bytes of their proof of work, so the table is
+ * indexed by their last bytes
+ * @slots: node table
+ * @nb_slots: number of slots, a power of two
+ * @hash: block hash
+ * Return: slot holding the hash, or the empty slot where it belongs
+ */
+static uint32_t tree_slot(block_node_t **slots, uint32_t nb_slots, const unsigned char *hash)
+{
+    uint32_t slot;
+
+    memcpy(&slot, hash + SHA256_DIGEST_LENGTH - sizeof(slot), sizeof(slot));
+    slot &= nb_slots - 1;
+    while (slots[slot] && memcmp(slots[slot]->hash, hash, SHA256_DIGEST_LENGTH) != 0)
+        slot = (slot + 1) & (nb_slots - 1);
+    return slot;
+}
+
+/**
+ * rehash_tree - moves every node kept to a new table of a given size
+ * @tree: block tree
+ * @nb_slots: number of slots of the new table, a power of two
+ * @drop: nodes to leave out, NULL-terminated, may be NULL
+ * Return: 1 on success else 0
+ */
+static int rehash_tree(block_tree_t *tree, uint32_t nb_slots, block_node_t **drop)
+{
+    block_node_t **slots = (block_node_t **)calloc(nb_slots, sizeof(block_node_t *)), *node;
+    int dropped;
+
+    if (!slots)
+    {
+        fprintf(stderr, "Failed to grow block tree\n");
+        return 0;
+    }
+    tree->count = 0;
+    for (uint32_t i = 0; i < tree->nb_slots; i++)
+    {
+        node = tree->slots[i];
+        dropped = 0;
+        for (int j = 0; node && drop && drop[j] && !dropped; j++)
+            dropped = drop[j] == node;
+        if (!node || dropped)
+            continue;
+        slots[tree_slot(slots, nb_slots, node->hash)] = node;
+        tree->count++;
+    }
+    free(tree->slots);
+    tree->slots = slots;
+    tree->nb_slots = nb_slots;
+    return 1;
+}
+
+/**
+ * tree_insert - adds a node to the table, growing it past half full
+ * @tree: block tree
+ * @node: node whose hash is not in the tree yet
+ * Return: 1 on success else 0
+ */
+static int tree_insert(block_tree_t *tree, block_node_t *node)
+{
+    if ((tree->count + 1) * 2 > tree->nb_slots &&
+        !rehash_tree(tree, tree->nb_slots ? tree->nb_slots * 2 : BLOCK_TREE_MIN_SLOTS, NULL))
+        return 0;
+    tree->slots[tree_slot(tree->slots, tree->nb_slots, node->hash)] = node;
+    tree->count++;
+    return 1;
+}
+
+/**
+ * new_node - builds the node of a block
+ * @block: the block
+ * @parent: node of the previous block, NULL for the genesis block
+ * Return: node or NULL on failure
+ */
+static block_node_t *new_node(Block *block, block_node_t *parent)
+{
+    block_node_t *node = (block_node_t *)calloc(1, sizeof(block_node_t));
+
+    if (!node)
+    {
+        fprintf(stderr, "Failed to allocate block tree node\n");
+        return NULL;
+    }
+    memcpy(node->hash, block->current_hash, SHA256_DIGEST_LENGTH);
+    node->height = block->index;
+    node->work = (parent ? parent->work : 0) + block_work(block);
+    node->difficulty = next_difficulty(parent ? parent->block : NULL, block,
+                                       parent ? parent->difficulty : INITIAL_DIFFICULTY);
+    node->parent = parent;
+    node->block = block;
+    return node;
+}
+
+/**
+ * free_side_block - frees the block a side branch node owns
+ * @node: side branch node
+ */
+static void free_side_block(block_node_t *node)
+{
+    if (!node->block)
+        return;
+    free_transactions(node->block->transactions);
+    free(node->block);
+    node->block = NULL;
+}
+
+/**
+ * fork_height - height a side branch leaves the best chain at
+ * @node: node of the branch
+ * Return: height of the last best chain block below the node, -1 if none
+ */
+static long fork_height(block_node_t *node)
+{
+    while (node && !node->best)
+        node = node->parent;
+    return node ? node->height : -1;
+}
+
+/**
+ * prune_tree - frees the side branches that fork too deep below the tip to
+ * ever be reorganized to
+ * Nodes are collected first, since a branch is walked through its parents
+ * @tree: block tree
+ */
+static void prune_tree(block_tree_t *tree)
+{
+    block_node_t **drop = (block_node_t **)calloc(tree->nb_side + 1, sizeof(block_node_t *)), *node;
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; drop && i < tree->nb_slots; i++)
+    {
+        node = tree->slots[i];
+        if (node && !node->best && count < tree->nb_side &&
+            fork_height(node) < tree->tip->height - REORG_DEPTH_MAX)
+            drop[count++] = node;
+    }
+    if (count > 0 && rehash_tree(tree, tree->nb_slots, drop))
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            free_side_block(drop[i]);
+            free(drop[i]);
+        }
+        tree->nb_side -= count;
+    }
+    free(drop);
+    tree->prune_at = tree->nb_side * 2 > BLOCK_TREE_SIDE_MIN ? tree->nb_side * 2 : BLOCK_TREE_SIDE_MIN;
+}
+
+/**
+ * block_tree_update - indexes the blocks appended to the best chain since
+ * the last update, or the whole chain once the tree was freed
+ * A block the tree knew on a side branch moves to the best chain
+ * @tree: block tree indexing @blockchain
+ * @blockchain: loaded blockchain
+ * Return: 1 on success else 0
+ */
+int block_tree_update(block_tree_t *tree, Blockchain *blockchain)
+{
+    block_node_t *node;
+
+    for (Block *block = tree->tip ? tree->tip->block->next : blockchain->head; block; block = block->next)
+    {
+        node = block_tree_find(tree, block->current_hash);
+        if (node && !node->best)
+        {
+            free_side_block(node);
+            node->block = block;
+            node->parent = tree->tip;
+            tree->nb_side--;
+        }
+        else if (!(node = new_node(block, tree->tip)) || !tree_insert(tree, node))
+        {
+            free(node);
+            return 0;
+        }
+        node->best = 1;
+        tree->tip = node;
+    }
+    if (tree->nb_side >= tree->prune_at)
+        prune_tree(tree);
+    return 1;
+}
+
+/**
+ * block_tree_find - looks up a block by hash
+ * @tree: block tree
+ * @hash: block hash
+ * Return: node of the block, or NULL if the tree does not know it
+ */
+block_node_t *block_tree_find(block_tree_t *tree, const unsigned char *hash)
+{
+    return tree->nb_slots ? tree->slots[tree_slot(tree->slots, tree->nb_slots, hash)] : NULL;
+}
+
+/**
+ * block_tree_add - adds a checked block that does not extend the tip as a
+ * side branch node
+ * Branches forking deeper than REORG_DEPTH_MAX below the tip are refused
+ * @tree: block tree
+ * @parent: node of the previous block
+ * @block: the block, owned by the tree on success
+ * Return: node of the block or NULL if it was not added
+ */
+block_node_t *block_tree_add(block_tree_t *tree, block_node_t *parent, Block *block)
+{
+    block_node_t *node;
+
+    if (fork_height(parent) < tree->tip->height - REORG_DEPTH_MAX)
+    {
+        fprintf(stderr, "Block %u forks more than %d blocks below the tip\n", block->index, REORG_DEPTH_MAX);
+        return NULL;
+    }
+    node = new_node(block, parent);
+    if (!node || !tree_insert(tree, node))
+    {
+        free(node);
+        return NULL;
+    }
+    tree->nb_side++;
+    return node;
+}
+
+/**
+ * connect_branch - connects the side branch ending at a node on top of the
+ * tip of the best chain
+ * @tree: block tree
+ * @blockchain: loaded blockchain ending at the tip of the tree
+ * @tip: last node of the branch
+ * Return: 1 on success, 0 if the branch was rejected and its blocks are
+ * marked rejected, or -1 if the commit failed and the blockchain has to be
+ * reloaded
+ */
+static int connect_branch(block_tree_t *tree, Blockchain *blockchain, block_node_t *tip)
+{
+    long count = tip->height - tree->tip->height, i = count;
+    block_node_t **path = (block_node_t **)malloc(count * sizeof(block_node_t *));
+    int result = 0;
+
+    if (path)
+    {
+        for (block_node_t *node = tip; node != tree->tip; node = node->parent)
+            path[--i] = node;
+        for (i = 0; i < count; i++)
+            path[i]->block->next = i + 1 < count ? path[i + 1]->block : NULL;
+        result = accept_blocks(blockchain, path[0]->block);
+
+        /* Blocks are owned by the chain once linked to it, and freed when rejected */
+        for (i = 0; i < count; i++)
+        {
+            path[i]->best = result > 0;
+            if (result <= 0)
+                path[i]->block = NULL;
+        }
+    }
+    if (result > 0)
+    {
+        tree->nb_side -= count;
+        tree->tip = tip;
+    }
+    free(path);
+    return result > 0 ? 1 : result;
+}
+
+/**
+ * reorganize_chain - makes a side branch with more work the best chain
+ * The best chain is rewound to the block the branch forks from with the
+ * undo records of the blocks it disconnects, which stay in the tree as a
+ * side branch, then the branch is connected. The work is proportional to
+ * the depth of the reorganization. If the branch turns out to be invalid
+ * its blocks are rejected and the previous best chain is connected again
+ * @blockchain: loaded blockchain indexed by @tree
+ * @tree: block tree
+ * @tip: side branch node to make the tip
+ * Return: 1 if @tip is the new tip, 0 if the best chain was kept, or -1 if
+ * a commit failed and the blockchain has to be reloaded
+ */
+int reorganize_chain(Blockchain *blockchain, block_tree_t *tree, block_node_t *tip)
+{
+    block_node_t *fork = tip, *old_tip = tree->tip, *node;
+    Block *removed = NULL, *next;
+    long depth;
+    int result;
+
+    for (; !fork->best; fork = fork->parent)
+    {
+        if (!fork->block)
+            return 0;
+    }
+    depth = old_tip->height - fork->height;
+    result = depth ? rewind_chain(blockchain, fork->block, &removed) : 1;
+    if (result <= 0)
+        return result;
+
+    /* The disconnected blocks become a side branch the tree owns */
+    for (node = old_tip; node != fork; node = node->parent)
+        node->best = 0;
+    for (; removed; removed = next)
+    {
+        next = removed->next;
+        removed->next = NULL;
+    }
+    tree->nb_side += depth;
+    tree->tip = fork;
+
+    result = connect_branch(tree, blockchain, tip);
+    if (result == 0 && depth > 0)
+    {
+        fprintf(stderr, "Branch of block %ld rejected, reconnecting the previous best chain\n", tip->height);
+        result = connect_branch(tree, blockchain, old_tip) < 0 ? -1 : 0;
+    }
+    else if (result > 0)
+        printf("Reorganized to block %ld, %ld blocks disconnected\n", tip->height, depth);
+    return result;
+}
+
+/**
+ * block_tree_free - frees every node and the side branch blocks, leaving
+ * an empty tree that indexes the whole chain at the next update
+ * @tree: block tree
+ */
+void block_tree_free(block_tree_t *tree)
+{
+    for (uint32_t i = 0; i < tree->nb_slots; i++)
+    {
+        if (tree->slots[i] && !tree->slots[i]->best)
+            free_side_block(tree->slots[i]);
+        free(tree->slots[i]);
+    }
+    free(tree->slots);
+    memset(tree, 0, sizeof(*tree));
+    tree->prune_at = BLOCK_TREE_SIDE_MIN;
+}
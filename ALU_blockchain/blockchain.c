@@ -44,6 +44,40 @@ utxo_t *create_genesis_transaction(unsigned char *sender, unsigned char *receive
 }
 
 
+/**
+ * current_timestamp - reads the wall clock as a block timestamp
+ * Return: microseconds since the Unix epoch
+ */
+int64_t current_timestamp(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (int64_t)now.tv_sec * TIMESTAMP_RESOLUTION + now.tv_nsec / (1000000000 / TIMESTAMP_RESOLUTION);
+}
+
+/**
+ * format_timestamp - renders a block timestamp as local time with
+ * microseconds, "yyyy-mm-dd hh:mm:ss.uuuuuu"
+ * @timestamp: microseconds since the Unix epoch
+ * @output: buffer of at least 32 bytes
+ */
+void format_timestamp(int64_t timestamp, char *output)
+{
+    int64_t micros = timestamp % TIMESTAMP_RESOLUTION;
+    time_t seconds = (time_t)(timestamp / TIMESTAMP_RESOLUTION);
+    struct tm local;
+
+    if (micros < 0)
+    {
+        micros += TIMESTAMP_RESOLUTION;
+        seconds--;
+    }
+    localtime_r(&seconds, &local);
+    size_t len = strftime(output, 32, "%Y-%m-%d %H:%M:%S", &local);
+    snprintf(output + len, 32 - len, ".%06d", (int)micros);
+}
+
 /**
  * create_block - creates new block
  * @index: block index
@@ -60,7 +94,7 @@ Block *create_block(int index, utxo_t *transactions, const unsigned char *previo
     }
 
     new_block->index = index;
-    strcpy(new_block->timestamp, ctime(&(time_t){time(NULL)}));
+    new_block->timestamp = current_timestamp();
     new_block->transactions = transactions;
     if (previous_hash)
         memcpy(new_block->previous_hash, previous_hash, SHA256_DIGEST_LENGTH);
@@ -69,6 +103,9 @@ Block *create_block(int index, utxo_t *transactions, const unsigned char *previo
     memset(new_block->current_hash, 0, SHA256_DIGEST_LENGTH);
     new_block->next = NULL;
     new_block->nonce = 0;
+    memset(new_block->miner, 0, ADDRESS_SIZE);
+    new_block->pruned = 0;
+    new_block->bloom_size = 0;
 
     mine_block(new_block, difficulty);
     return new_block;
@@ -117,34 +154,143 @@ Blockchain *init_blockchain(void)
     blockchain->head = genesisBlock;
     blockchain->tail = blockchain->head;
     blockchain->length = 1;
+    blockchain->stored = 0;
+    blockchain->stored_size = 0;
+    blockchain->codec = NULL;
 
     return blockchain;
 }
 
 
 /**
- * validate_chain - ensures that previous block's hash matches with new block's hash
+ * validate_range - worker hashing a contiguous range of blocks
+ * @arg: pointer to validate_range_t describing the range
+ * Return: NULL always, result is stored in range->failed
+ */
+static void *validate_range(void *arg)
+{
+    validate_range_t *range = (validate_range_t *)arg;
+    unsigned char calculatedHash[SHA256_DIGEST_LENGTH];
+    unsigned char bloom[BLOOM_FILTER_BYTES_MAX];
+    Block *block;
+
+    range->failed = -1;
+    for (int i = range->start; i < range->end; i++)
+    {
+        /* Pruned blocks lost their bodies, only their linkage is checked */
+        block = range->blocks[i];
+        if (block->pruned)
+            continue;
+        calculate_hash(block, calculatedHash);
+        /* The address filter is not hashed, so it is checked against the body */
+        if (block->bloom_size)
+            block_bloom(block, bloom, block->bloom_size);
+        if (memcmp(block->current_hash, calculatedHash, SHA256_DIGEST_LENGTH) != 0 ||
+            (block->bloom_size && memcmp(block->bloom, bloom, block->bloom_size) != 0))
+        {
+            range->failed = i;
+            break;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * validate_chain_parallel - re-hashes blocks on worker threads, then checks
+ * the previous_hash linkage and the proof of work each block owes at its
+ * height in a single sequential pass
  * @blockchain: pointer to blockchain to validate
- * Return: 1 if valid, or 0 if invalid
+ * @nb_threads: number of worker threads, 0 for one per online CPU
+ * Return: -1 if valid, VALIDATION_ERROR if there is no chain or memory ran
+ * out, else height of the lowest invalid block
  */
-int validate_chain(Blockchain *blockchain)
+int validate_chain_parallel(Blockchain *blockchain, int nb_threads)
 {
-    if (!blockchain || !blockchain->head)
-        return 0;
     unsigned char tmpHash[SHA256_DIGEST_LENGTH] = {0};
-    unsigned char calculatedHash[SHA256_DIGEST_LENGTH];
-    Block *current = blockchain->head;
+    pthread_t threads[VALIDATION_THREADS_MAX];
+    validate_range_t ranges[VALIDATION_THREADS_MAX];
+    int started[VALIDATION_THREADS_MAX];
+    Block **blocks;
+    Block *current;
+    int length = 0, failed = -1, chunk, difficulty = INITIAL_DIFFICULTY;
+
+    if (!blockchain || !blockchain->head)
+        return VALIDATION_ERROR;
 
-    while (current)
+    for (current = blockchain->head; current; current = current->next)
+        length++;
+    blocks = (Block **)malloc(sizeof(Block *) * length);
+    if (!blocks)
     {
-        calculate_hash(current, calculatedHash);
-        if (memcmp(current->current_hash, calculatedHash, SHA256_DIGEST_LENGTH) != 0 || memcmp(current->previous_hash, tmpHash, SHA256_DIGEST_LENGTH) != 0) {
-            return 0;
-        }    
-        memcpy(tmpHash, current->current_hash, SHA256_DIGEST_LENGTH);
-        current = current->next;
+        perror("Failed to allocate memory for block list");
+        return VALIDATION_ERROR;
+    }
+    length = 0;
+    for (current = blockchain->head; current; current = current->next)
+        blocks[length++] = current;
+
+    if (nb_threads <= 0)
+        nb_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (nb_threads < 1)
+        nb_threads = 1;
+    if (nb_threads > VALIDATION_THREADS_MAX)
+        nb_threads = VALIDATION_THREADS_MAX;
+    if (nb_threads > length)
+        nb_threads = length;
+
+    /* Hash check: every block is independent, split into ranges */
+    chunk = (length + nb_threads - 1) / nb_threads;
+    for (int t = 0; t < nb_threads; t++)
+    {
+        ranges[t].blocks = blocks;
+        ranges[t].start = t * chunk;
+        ranges[t].end = ranges[t].start + chunk > length ? length : ranges[t].start + chunk;
+        ranges[t].failed = -1;
+        /* The calling thread takes the first range itself */
+        started[t] = t > 0 && pthread_create(&threads[t], NULL, validate_range, &ranges[t]) == 0;
+    }
+    validate_range(&ranges[0]);
+    for (int t = 1; t < nb_threads; t++)
+    {
+        if (started[t])
+            pthread_join(threads[t], NULL);
+        else
+            validate_range(&ranges[t]);
+    }
+    for (int t = 0; t < nb_threads; t++)
+    {
+        if (ranges[t].failed != -1)
+        {
+            failed = ranges[t].failed;
+            break;
+        }
+    }
+
+    /* Linkage and proof of work check: cheap, but depends on ordering */
+    for (int i = 0; i < length && (failed == -1 || i < failed); i++)
+    {
+        if (memcmp(blocks[i]->previous_hash, tmpHash, SHA256_DIGEST_LENGTH) != 0 ||
+            !is_valid_hash(blocks[i]->current_hash, difficulty))
+        {
+            failed = i;
+            break;
+        }
+        memcpy(tmpHash, blocks[i]->current_hash, SHA256_DIGEST_LENGTH);
+        difficulty = next_difficulty(i ? blocks[i - 1] : NULL, blocks[i], difficulty);
     }
-    return 1;
+
+    free(blocks);
+    return failed;
+}
+
+/**
+ * validate_chain - ensures that previous block's hash matches with new block's hash
+ * @blockchain: pointer to blockchain to validate
+ * Return: 1 if valid, or 0 if invalid
+ */
+int validate_chain(Blockchain *blockchain)
+{
+    return validate_chain_parallel(blockchain, VALIDATION_THREADS) == -1;
 }
 
 /**
@@ -155,38 +301,29 @@ int validate_chain(Blockchain *blockchain)
 void print_blockchain(Blockchain *blockchain)
 {
     Block *current = blockchain->head;
+    char timestamp[32], sender[ADDRESS_SIZE * 2 + 1], receiver[ADDRESS_SIZE * 2 + 1];
+    char previous[SHA256_DIGEST_LENGTH * 2 + 1], hash[SHA256_DIGEST_LENGTH * 2 + 1];
+    sender[ADDRESS_SIZE * 2] = receiver[ADDRESS_SIZE * 2] = '\0';
     while (current) {
+        format_timestamp(current->timestamp, timestamp);
         printf("Block %d\n", current->index);
-        printf("Timestamp: %s\n", current->timestamp);
+        printf("Timestamp: %s\n", timestamp);
+        bytes_to_hex(current->miner, ADDRESS_SIZE, sender);
+        printf("Miner: %s\n", sender);
+        if (current->pruned)
+            printf("\tTransactions pruned\n");
         Transaction *trans = current->transactions->head;
         while (trans)
         {
-
-            printf("\tTransaction %d: ", trans->index);
-
-            for (int i = 0; i < ADDRESS_SIZE; i++) {
-                printf("%02x", trans->sender[i]);
-            }
-
-            printf(" -> ");
-            for (int i = 0; i < ADDRESS_SIZE; i++) {
-                printf("%02x", trans->receiver[i]);
-            }
-            printf(" Amount: %d\n", trans->amount);
+            bytes_to_hex(trans->sender, ADDRESS_SIZE, sender);
+            bytes_to_hex(trans->receiver, ADDRESS_SIZE, receiver);
+            printf("\tTransaction %d: %s -> %s Amount: %d\n", trans->index, sender, receiver, trans->amount);
             trans = trans->next;
         }
 
-        printf("Previous Hash: ");
-        for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-            printf("%02x", current->previous_hash[i]);
-        }
-        printf("\n");
-
-        printf("Current Hash: ");
-        for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-            printf("%02x", current->current_hash[i]);
-        }
-        printf("\n\n");
+        hash_to_hex(current->previous_hash, previous);
+        hash_to_hex(current->current_hash, hash);
+        printf("Previous Hash: %s\nCurrent Hash: %s\n\n", previous, hash);
 
         current = current->next;
     }
@@ -206,22 +343,89 @@ void free_blockchain(Blockchain *blockchain)
         free(current);
         current = next;
     }
+    if (blockchain->codec)
+    {
+        codec_state_free(blockchain->codec);
+        free(blockchain->codec);
+    }
     free(blockchain);
 }
 
 /**
  * adjust_difficulty - adjusts mining difficulty based on block time
- * @prevTime: timestamp of previous block
- * @currentTime: timestamp of current block
+ * @prevTime: timestamp mining started at
+ * @currentTime: timestamp mining ended at
  * @currentDifficulty: current difficulty level
  * Return: new difficulty level
  */
-int adjust_difficulty(uint64_t prevTime, uint64_t currentTime, int currentDifficulty)
+int adjust_difficulty(int64_t prevTime, int64_t currentTime, int currentDifficulty)
 {
-    double timeDiff = difftime(currentTime, prevTime);
+    double timeDiff = (double)(currentTime - prevTime) / TIMESTAMP_RESOLUTION;
     if (timeDiff < 10)
         return currentDifficulty + 1;  // Increase difficulty
     else if (timeDiff > 40 && currentDifficulty > 1)
         return currentDifficulty - 1;  // Decrease difficulty
     return currentDifficulty;
+}
+
+/**
+ * next_difficulty - difficulty the block after a block has to meet
+ * It follows the time between the two last blocks, so every node derives
+ * the same schedule from the headers alone
+ * @previous: block before @block, NULL if @block is the genesis block
+ * @block: block the next one extends
+ * @difficulty: difficulty @block had to meet
+ * Return: difficulty of the next block
+ */
+int next_difficulty(Block *previous, Block *block, int difficulty)
+{
+    if (!previous)
+        return difficulty;
+    return adjust_difficulty(previous->timestamp, block->timestamp, difficulty);
+}
+
+/**
+ * block_timestamp - timestamp of a block mined on a tip
+ * @previous: tip the block extends, NULL for the genesis block
+ * Return: the current time, or just after the tip when the tip is ahead of
+ * the clock, since timestamps have to increase
+ */
+int64_t block_timestamp(Block *previous)
+{
+    int64_t now = current_timestamp();
+
+    return previous && previous->timestamp >= now ? previous->timestamp + 1 : now;
+}
+
+/**
+ * valid_timestamp - checks the timestamp of a block received from a peer;
+ * the difficulty follows timestamps, so a peer free to pick them could
+ * set it at will
+ * @timestamp: block timestamp
+ * @previous: timestamp of the block it extends
+ * Return: 1 if it is after @previous and at most BLOCK_TIME_DRIFT seconds
+ * ahead of the local clock else 0
+ */
+int valid_timestamp(int64_t timestamp, int64_t previous)
+{
+    return timestamp > previous &&
+           timestamp <= current_timestamp() + (int64_t)BLOCK_TIME_DRIFT * TIMESTAMP_RESOLUTION;
+}
+
+/**
+ * chain_difficulty - difficulty the next block of a chain has to meet
+ * @blockchain: pointer to blockchain
+ * Return: difficulty following the schedule from the genesis block
+ */
+int chain_difficulty(Blockchain *blockchain)
+{
+    int difficulty = INITIAL_DIFFICULTY;
+    Block *previous = NULL;
+
+    for (Block *current = blockchain->head; current; current = current->next)
+    {
+        difficulty = next_difficulty(previous, current, difficulty);
+        previous = current;
+    }
+    return difficulty;
 }
\ No newline at end of file
@@ -6,7 +6,11 @@
 #include <string.h>
 #include <stdint.h>
 #include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <arpa/inet.h>
+#include <netinet/in.h>
 #include <openssl/sha.h>
 #include <openssl/evp.h>
 
@@ -16,12 +20,111 @@
 #define USERS_DATABASE "users.dat"
 #define SESSION_USER "current_user.dat"
 #define ALU_ACCOUNT_FILE "alu_account.dat"
+#define CHECKPOINT_DATABASE "checkpoint.dat"
+#define JOURNAL_DATABASE "journal.dat"
+#define ARCHIVE_DATABASE "archive.dat"
+#define UNDO_DATABASE "undo.dat"
+#define UNDO_INDEX "undo_index.dat"
+#define REORG_DEPTH_MAX 100 /* Blocks a reorganization disconnects at most */
+#define BLOCK_TREE_MIN_SLOTS 1024
+#define BLOCK_TREE_SIDE_MIN 64 /* Side branch blocks kept before pruning is considered */
+#define PRUNE_DEPTH 1000 /* Blocks whose transaction bodies are kept by default */
+#define JOURNAL_MAGIC 0x4a554c41 /* "ALUJ" */
+#define JOURNAL_PATH_MAX 256
+#define JOURNAL_CHECKPOINT_SIZE (1024 * 1024) /* Sync data files and empty the journal past this size */
+#define JOURNAL_INLINE_MAX (1024 * 1024) /* Larger whole-file writes go to a synced side file */
+#define JOURNAL_REPLACE 2 /* Entry names a synced side file that replaces its target */
+#define JOURNAL_SIDE_SUFFIX ".replace"
+#define JOURNAL_APPLIED "journal_applied.dat"
+#define JOURNAL_BOOT_ID "/proc/sys/kernel/random/boot_id"
+#define JOURNAL_BOOT_ID_SIZE 40
+#define MANIFEST_DATABASE "manifest.dat"
+#define GENERATION_DIR "generations"
+#define GENERATION_MAGIC 0x47554c41 /* "ALUG" */
+#define GENERATION_COPY_SUFFIX ".new"
+#define GENERATION_PIN_TRIES 8 /* Manifest reads before a reader falls back to the live files */
+#define GENERATION_FILES 3 /* Chain, users and ALU account */
+#define HISTORY_DATABASE "history.dat"
+#define HISTORY_INDEX "history_index.dat"
+#define HISTORY_MAGIC 0x48554c41 /* "ALUH" */
+#define HISTORY_PAGE_SIZE 20 /* Transfers shown per tx_history page */
+#define TXID_INDEX "txid_index.dat"
+#define TX_SEQUENCE_INDEX "tx_sequence.dat"
+#define TXID_SIZE SHA256_DIGEST_LENGTH
+#define DISK_TABLE_MAGIC 0x54554c41 /* "ALUT" */
+#define DISK_TABLE_MIN_SLOTS 1024
+#define DISK_TABLE_KEY_MAX 64
+#define TIME_INDEX_DATABASE "time_index.dat"
+#define STATS_DATABASE "stats.dat"
+#define STATS_WORK_BYTES_MAX 7 /* Leading zero bytes counted as work, keeps totals in 64 bits */
+#define TIMESTAMP_RESOLUTION 1000000 /* Block timestamp units per second */
+#define EXPORT_BUFFER_SIZE (1 << 20) /* Bytes buffered before each write by export_chain */
+#define COLUMNS_DIR "ledger_columns"
+#define COLUMNS_MAGIC 0x43554c41 /* "ALUC" */
+#define COLUMN_CHUNK_ROWS 65536 /* Rows summarized by one min/max chunk record */
+#define COLUMN_COUNT 6
+#define SNAPSHOT_FILE "snapshot.dat"
+#define SNAPSHOT_MAGIC 0x53554c41 /* "ALUS" */
+#define SNAPSHOT_VERSION 3
+#define SNAPSHOT_HEADERS_PER_RECORD 1024
+#define NB_SNAPSHOT_FILES 4 /* state files a snapshot carries */
+#define NB_CHAIN_INDEXES 7 /* per-chain files an import resets */
+#define SNAPSHOT_UNVERIFIED "--unverified"
+#define BLOCKCHAIN_MAGIC 0x42554c41 /* "ALUB" */
+#define BLOCKCHAIN_VERSION 5 /* 1: fixed-width records, 2: compact records, 3: binary timestamps,
+                               4: sequence numbers hashed, 5: miner in the record and hash */
+#define CODEC_PREVIOUS_HASH 0x02 /* Previous hash does not link to prior record */
+#define CODEC_NEW_SEGMENT 0x04 /* First record of a segment, dictionary and deltas restart */
+#define CODEC_PRUNED 0x08 /* Header only, no transaction section */
+#define CODEC_BLOOM 0x10 /* Address Bloom filter follows the block hash */
+#define CODEC_SEGMENT_BLOCKS 1024 /* Blocks sharing one address dictionary */
+#define BLOOM_FILTER_BYTES 16 /* Address filter size per block, 0 disables filters */
+#define BLOOM_FILTER_BYTES_MAX 64
+#define BLOOM_HASHES 4 /* Bits set per address */
+#define RECORD_SIZE_MAX (16 * 1024 * 1024) /* Larger length prefixes are corruption */
+#define NODE_SOCKET "alu_node.sock"
+#define NODE_MAGIC 0x4e554c41 /* "ALUN" */
+#define NODE_BACKLOG 1024
+#define NODE_EVENTS_MAX 256 /* Socket events alu_noded handles per wakeup */
+#define NODE_WORKERS 4 /* Threads running alu_noded jobs, one at a time but while a block is mined */
+#define NODE_REQUEST_MAX 65536 /* Larger request frames are malformed */
+#define NODE_RESPONSE_MAX (256 * 1024 * 1024) /* Captured output of blockchain_info on big chains */
+#define NODE_BUFFER_MAX (1024 * 1024) /* Pending bytes per connection that pause reading it */
+#define PEERS_MAX 16
+#define PEER_RETRY 2 /* Seconds between attempts to reach a configured peer */
+#define PEER_MESSAGE_MAX (64 * 1024 * 1024) /* Larger peer frames are malformed */
+#define PEER_BATCH_BLOCKS 500 /* Blocks a node sends per request at most */
+#define PEER_HEADERS_MAX 2000 /* Headers a node sends per request at most */
+#define PEER_WINDOW_BLOCKS 128 /* Blocks per body download window */
+#define PEER_WINDOWS_PER_PEER 4 /* Windows in flight per peer while syncing */
+#define PEER_SYNC_AHEAD 8192 /* Blocks downloaded past the committed height at most */
+#define PEER_COMMIT_BLOCKS 2048 /* Downloaded blocks committed per journal group at most */
+#define PEER_SHORT_ID_SIZE 6 /* Bytes of a transaction ID a compact block carries */
+#define PEER_PENDING_BLOCKS 16 /* Compact blocks waiting for transactions at most */
+#define PEER_INV_MAX 4096 /* Transaction IDs per inventory or request at most */
+#define PEER_SEEN_TXS 32768 /* Transaction IDs a node remembers per generation */
+#define PEER_TX_SIZE_MAX (ADDRESS_SIZE * 2 + 20) /* Addresses and two varints of a PEER_TX payload */
+#define PEER_BENCH_INTERVAL 10 /* Seconds between the timestamps of peer_bench blocks at least, the difficulty holds */
+#define POOL_RANGE_NONCES (1 << 20) /* Nonces handed to a pool worker per request */
+#define POOL_POLL_HASHES 4096 /* Hashes a pool worker tries between checks for new work */
+#define TX_RING_MAGIC 0x52554c41 /* "ALUR" */
+#define TX_RING_SLOTS 4096 /* Submissions the shared memory ring holds, a power of two */
+#define TX_RING_POLL_MS 5 /* Milliseconds between checks of the submission ring by alu_noded */
+#define TX_RING_STALL_MS 1000 /* Milliseconds a claimed slot may stay unpublished before alu_noded skips it */
+#define TX_RING_WAIT_MS 5000 /* Milliseconds a client waits for the node to log its submission */
 #define TRANSACTION_FEE 250
 #define TRANSACTION_VOLUME 5 /* Number of transaction to be mined in a block */
 #define ADDRESS_SIZE (SHA256_DIGEST_LENGTH / 2)
 #define GIFT_TOKENS 2000000
 
 #define INITIAL_DIFFICULTY 1  /* Starting difficulty level */
+#define BLOCK_TIME_DRIFT 7200  /* Seconds a peer block timestamp may be ahead of the local clock */
+#define VALIDATION_THREADS 0  /* Chain validation workers, 0 = one per online CPU */
+#define VALIDATION_THREADS_MAX 64
+#define VALIDATION_ERROR -3 /* validate_chain_parallel found no chain or ran out of memory */
+#define ANALYTICS_THREADS 0  /* rich_list workers, 0 = one per online CPU, capped at VALIDATION_THREADS_MAX */
+#define RICH_LIST_SIZE 10  /* Balances shown by rich_list by default */
+#define FULL_VALIDATION_INTERVAL 100  /* Re-validate from genesis every N blocks */
 
 typedef enum
 {
@@ -30,6 +133,63 @@ typedef enum
     VENDOR,
 } Role;
 
+#define ROLE_COUNT 3
+
+typedef enum
+{
+    RECORD_CORRUPT = -1,
+    RECORD_EOF,
+    RECORD_OK,
+} RecordStatus;
+
+typedef enum
+{
+    SNAPSHOT_META = 1,
+    SNAPSHOT_STATE_FILE,
+    SNAPSHOT_HEADERS,
+    SNAPSHOT_HASH,
+} SnapshotSection;
+
+typedef enum
+{
+    EXPORT_TEXT,
+    EXPORT_JSON,
+    EXPORT_CSV,
+} ExportFormat;
+
+typedef enum
+{
+    HISTORY_SENT,
+    HISTORY_RECEIVED,
+} HistoryDirection;
+
+typedef enum
+{
+    NODE_PING = 1,
+    NODE_LOGIN,
+    NODE_BALANCE,
+    NODE_SUBMIT,
+    NODE_MINE,
+    NODE_INFO,
+    /* Peer messages, only carried by TCP links between nodes */
+    PEER_HELLO = 32,
+    PEER_GET_BLOCKS,
+    PEER_BLOCKS,
+    PEER_BLOCK,
+    PEER_TX,
+    PEER_GET_HEADERS,
+    PEER_HEADERS,
+    PEER_COMPACT_BLOCK,
+    PEER_GET_BLOCK_TXS,
+    PEER_BLOCK_TXS,
+    PEER_INV,
+    PEER_GET_TXS,
+    /* Mining pool messages, only carried by TCP links to pool workers */
+    POOL_GET_WORK = 64,
+    POOL_WORK,
+    POOL_SHARE,
+} NodeRequest;
+
 typedef enum
 {
     INITIATED,
@@ -71,19 +231,29 @@ typedef struct utxo_s {
  * struct Block_s: block structure
  * @index: block index
  * @previous_hash: previous block hash
- * @timestamp: block creation timestamp
+ * @timestamp: block creation time in microseconds since the Unix epoch
  * @nonce: block nonce
+ * @miner: address credited with the fees, covered by the hash; all zero
+ * to credit nobody
  * @transactions: list of transactions in block
  * @current_hash: block's hash
+ * @pruned: 1 if only the header is kept and transactions is empty, so the
+ * hash can no longer be recomputed
+ * @bloom: Bloom filter over sender and receiver addresses
+ * @bloom_size: number of filter bytes in use, 0 if the block has no filter
  * @next: pointer to next block in blockchain
  */
 typedef struct Block_s {
     unsigned int index;
     unsigned char previous_hash[SHA256_DIGEST_LENGTH];
-    char timestamp[30];
+    int64_t timestamp;
     unsigned int nonce;
+    unsigned char miner[ADDRESS_SIZE];
     utxo_t *transactions; // Transactions included in the block.
     unsigned char current_hash[SHA256_DIGEST_LENGTH];
+    int pruned;
+    unsigned char bloom[BLOOM_FILTER_BYTES_MAX];
+    unsigned int bloom_size;
     struct Block_s *next;
 } Block;
 
@@ -93,14 +263,370 @@ typedef struct Block_s {
  * @tail: last block in chain
  * @difficulty: current block difficulty
  * @length: length of blockchain
+ * @stored: number of leading blocks already in the block file
+ * @stored_size: size of the block file holding them
+ * @codec: encoder state after the last stored block, NULL if the file has
+ * to be rewritten from scratch
  */
 typedef struct Blockchain {
     Block *head;
     Block *tail;
     int length;
     int difficulty;
+    int stored;
+    long stored_size;
+    struct codec_state_s *codec;
 } Blockchain;
 
+/**
+ * struct validate_range_s - range of blocks hashed by one validation worker
+ * @blocks: array of all blocks in chain order
+ * @start: first block position in range
+ * @end: one past the last block position in range
+ * @failed: position of first block with a bad hash, or -1
+ */
+typedef struct validate_range_s {
+    Block **blocks;
+    int start;
+    int end;
+    int failed;
+} validate_range_t;
+
+/**
+ * struct checkpoint_s - last block the chain is known valid up to
+ * @height: height of the validated block
+ * @hash: hash of the validated block
+ */
+typedef struct checkpoint_s {
+    int height;
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+} checkpoint_t;
+
+/**
+ * struct buffer_s - growable byte buffer used to build and parse records
+ * @data: buffer bytes
+ * @len: number of bytes in use
+ * @cap: allocated size
+ * @pos: read position
+ */
+typedef struct buffer_s {
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+    size_t pos;
+} buffer_t;
+
+/**
+ * struct codec_state_s - delta state carried between compact block records
+ * @prev_index: index of the previous block in the file, -1 before the first
+ * @prev_time: timestamp of the previous block in the file
+ * @prev_hash: hash of the previous block in the file
+ * @segment_blocks: number of blocks coded in the current segment
+ * @dict: addresses seen so far in the current segment
+ * @dict_count: number of addresses in dictionary
+ * @dict_cap: allocated dictionary entries
+ * @slots: open addressing table of dictionary positions (encoder only)
+ * @nb_slots: number of slots, a power of two
+ * @bloom_bytes: size of the address filter written with each block
+ */
+typedef struct codec_state_s {
+    int64_t prev_index;
+    int64_t prev_time;
+    unsigned char prev_hash[SHA256_DIGEST_LENGTH];
+    int segment_blocks;
+    unsigned char (*dict)[ADDRESS_SIZE];
+    uint32_t dict_count;
+    uint32_t dict_cap;
+    int32_t *slots;
+    uint32_t nb_slots;
+    uint32_t bloom_bytes;
+} codec_state_t;
+
+/**
+ * struct journal_entry_s - one file write staged in a journal group
+ * @path: file the write targets
+ * @offset: position of the write in the file
+ * @truncate: 1 to cut the file right after the written bytes, or
+ * JOURNAL_REPLACE when @data holds the name of a side file replacing it
+ * @data: bytes to write
+ * @len: number of bytes
+ * @next: next write in the group
+ */
+typedef struct journal_entry_s {
+    char path[JOURNAL_PATH_MAX];
+    long offset;
+    int truncate;
+    unsigned char *data;
+    size_t len;
+    struct journal_entry_s *next;
+} journal_entry_t;
+
+/**
+ * struct journal_applied_s - how much of the journal is applied to the data
+ * files, in the page cache of the boot that applied it
+ * @boot_id: kernel boot ID when the groups were applied
+ * @end: journal offset past the last applied group
+ */
+typedef struct journal_applied_s {
+    char boot_id[JOURNAL_BOOT_ID_SIZE];
+    uint64_t end;
+} journal_applied_t;
+
+/**
+ * struct time_index_entry_s - sparse time index entry, one per codec
+ * segment of the block file
+ * @timestamp: timestamp of the segment's first block
+ * @offset: file offset of the segment's first record
+ * @height: height of the segment's first block
+ */
+typedef struct time_index_entry_s {
+    int64_t timestamp;
+    int64_t offset;
+    int64_t height;
+} time_index_entry_t;
+
+/**
+ * struct block_reader_s - streaming reader over the block file
+ * @file: block file
+ * @header_size: offset of the first record
+ * @difficulty: difficulty stored in the file header
+ * @state: decoder state
+ * @record: record buffer
+ * @expected: height the first record read must have
+ * @nb_read: number of blocks decoded
+ */
+typedef struct block_reader_s {
+    FILE *file;
+    long header_size;
+    int difficulty;
+    codec_state_t state;
+    buffer_t record;
+    int64_t expected;
+    int nb_read;
+} block_reader_t;
+
+/**
+ * struct out_buffer_s - large output buffer flushed with one fwrite
+ * @data: EXPORT_BUFFER_SIZE bytes
+ * @len: number of bytes buffered
+ * @file: stream the buffer is flushed to
+ * @failed: 1 once a write failed
+ */
+typedef struct out_buffer_s {
+    char *data;
+    size_t len;
+    FILE *file;
+    int failed;
+} out_buffer_t;
+
+/**
+ * struct column_chunk_s - min/max statistics of COLUMN_CHUNK_ROWS rows,
+ * used to skip or take whole chunks when scanning
+ * @rows: number of rows in the chunk
+ * @min_height: lowest block height
+ * @max_height: highest block height
+ * @min_amount: smallest amount
+ * @max_amount: largest amount
+ * @reserved: zero, keeps the timestamps aligned in the file
+ * @min_time: earliest block timestamp
+ * @max_time: latest block timestamp
+ */
+typedef struct column_chunk_s {
+    uint32_t rows;
+    uint32_t min_height;
+    uint32_t max_height;
+    int32_t min_amount;
+    int32_t max_amount;
+    uint32_t reserved;
+    int64_t min_time;
+    int64_t max_time;
+} column_chunk_t;
+
+/**
+ * struct columns_meta_s - header file of a column export
+ * @magic: COLUMNS_MAGIC
+ * @chunk_rows: COLUMN_CHUNK_ROWS at export time
+ * @rows: number of transactions exported
+ * @nb_chunks: number of chunk records
+ * @nb_addresses: number of addresses in the dictionary
+ */
+typedef struct columns_meta_s {
+    uint32_t magic;
+    uint32_t chunk_rows;
+    uint64_t rows;
+    uint32_t nb_chunks;
+    uint32_t nb_addresses;
+} columns_meta_t;
+
+/**
+ * struct ledger_columns_s - transactions stored as one array per field
+ * @height: block height of each row
+ * @timestamp: block timestamp of each row
+ * @sender: address id of each sender
+ * @receiver: address id of each receiver
+ * @amount: amount of each row
+ * @status: Status of each row
+ * @rows: number of rows
+ * @cap_rows: number of rows allocated
+ * @chunks: min/max statistics per chunk
+ * @nb_chunks: number of chunks
+ * @addresses: address of each id
+ * @nb_addresses: number of addresses
+ * @cap_addresses: number of addresses allocated
+ * @slots: open addressing table of ids, only used while exporting
+ * @nb_slots: number of slots, a power of two
+ */
+typedef struct ledger_columns_s {
+    uint32_t *height;
+    int64_t *timestamp;
+    uint32_t *sender;
+    uint32_t *receiver;
+    int32_t *amount;
+    uint8_t *status;
+    uint64_t rows;
+    uint64_t cap_rows;
+    column_chunk_t *chunks;
+    uint32_t nb_chunks;
+    unsigned char (*addresses)[ADDRESS_SIZE];
+    uint32_t nb_addresses;
+    uint32_t cap_addresses;
+    int32_t *slots;
+    uint32_t nb_slots;
+} ledger_columns_t;
+
+/**
+ * struct chain_stats_s - totals from the genesis block up to a height
+ * @timestamp: timestamp of the block at that height
+ * @transactions: number of transactions
+ * @volume: amount transferred
+ * @fees: transaction fees paid to miners
+ * @role_volume: amount transferred by senders of each role, the last entry
+ * for addresses no user owns
+ * @work: expected number of hashes spent mining
+ * @hash: hash of the block at that height
+ */
+typedef struct chain_stats_s {
+    int64_t timestamp;
+    uint64_t transactions;
+    int64_t volume;
+    int64_t fees;
+    int64_t role_volume[ROLE_COUNT + 1];
+    uint64_t work;
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+} chain_stats_t;
+
+/**
+ * struct disk_table_s - open addressing table of fixed-size keys to
+ * non-zero 64-bit values, kept in one file
+ * @path: table file
+ * @key_size: size of the keys
+ * @nb_slots: number of slots, a power of two
+ * @count: number of keys stored
+ * @slots: key and value of every slot, a zero value marks an empty slot
+ * @dirty: 1 for each slot changed since the last save
+ * @rewrite: 1 if the whole file has to be written on save
+ */
+typedef struct disk_table_s {
+    char path[JOURNAL_PATH_MAX];
+    uint32_t key_size;
+    uint32_t nb_slots;
+    uint32_t count;
+    unsigned char *slots;
+    unsigned char *dirty;
+    int rewrite;
+} disk_table_t;
+
+/**
+ * struct history_header_s - header of the transaction history file
+ * @magic: HISTORY_MAGIC
+ * @indexed: number of leading blocks indexed
+ * @tip_hash: hash of the last indexed block
+ */
+typedef struct history_header_s {
+    uint32_t magic;
+    uint32_t indexed;
+    unsigned char tip_hash[SHA256_DIGEST_LENGTH];
+} history_header_t;
+
+/**
+ * struct history_posting_s - one transfer in an address history
+ * @prev: offset of the previous posting for the same address, 0 if none
+ * @height: height of the block holding the transaction
+ * @position: position of the transaction in the block
+ * @amount: amount transferred
+ * @direction: HISTORY_SENT or HISTORY_RECEIVED
+ * @counterparty: the other address of the transfer
+ */
+typedef struct history_posting_s {
+    uint64_t prev;
+    uint32_t height;
+    uint32_t position;
+    int32_t amount;
+    uint32_t direction;
+    unsigned char counterparty[ADDRESS_SIZE];
+} history_posting_t;
+
+/**
+ * struct undo_log_s - undo records of blocks being committed, staged with
+ * their journal group
+ * Each record holds the balances a block changed as they were before it,
+ * so the block can be disconnected without replaying the chain
+ * @file: memory stream collecting the framed records
+ * @data: bytes written to @file
+ * @size: number of bytes in @data
+ * @first: height of the first record, -1 before any
+ * @offsets: UNDO_DATABASE offset of every record, relative to the end of
+ * the file
+ */
+typedef struct undo_log_s {
+    FILE *file;
+    char *data;
+    size_t size;
+    long first;
+    buffer_t offsets;
+} undo_log_t;
+
+/**
+ * struct block_node_s - block a node knows, on the best chain or on a side
+ * branch
+ * @hash: block hash, the key of the node
+ * @height: block height
+ * @work: work of the chain from genesis up to and including the block
+ * @difficulty: difficulty the schedule sets for a block extending this one
+ * @parent: node of the previous block, NULL for the genesis block
+ * @block: the block, owned by the blockchain on the best chain and by the
+ * tree on a side branch; NULL once the block was rejected
+ * @best: 1 if the block is on the best chain
+ */
+typedef struct block_node_s {
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    long height;
+    uint64_t work;
+    int difficulty;
+    struct block_node_s *parent;
+    Block *block;
+    int best;
+} block_node_t;
+
+/**
+ * struct block_tree_s - every block of the best chain and of the side
+ * branches that may still overtake it, keyed by hash
+ * @slots: open addressing table of nodes
+ * @nb_slots: number of slots, a power of two
+ * @count: number of nodes
+ * @nb_side: number of side branch nodes
+ * @prune_at: number of side branch nodes that triggers the next pruning
+ * @tip: tip of the best chain, NULL until a chain is indexed
+ */
+typedef struct block_tree_s {
+    block_node_t **slots;
+    uint32_t nb_slots;
+    uint32_t count;
+    uint32_t nb_side;
+    uint32_t prune_at;
+    block_node_t *tip;
+} block_tree_t;
+
 /**
  * Wallet: user wallet structure
  * @address: user public address for wallet
@@ -129,6 +655,73 @@ typedef struct user_s {
     struct user_s *next;
 } user_t;
 
+/**
+ * struct account_key_s - wallet address of an account, sorted for lookups
+ * @address: first ADDRESS_SIZE bytes of the wallet address
+ * @id: position of the user, or the number of users for the ALU account
+ */
+typedef struct account_key_s {
+    unsigned char address[ADDRESS_SIZE];
+    int id;
+} account_key_t;
+
+/**
+ * struct account_flow_s - on-chain totals of one account
+ * @sent: amount sent
+ * @received: amount received
+ * @fees: transaction fees paid
+ */
+typedef struct account_flow_s {
+    int64_t sent;
+    int64_t received;
+    int64_t fees;
+} account_flow_t;
+
+/**
+ * struct rich_part_s - slice of the account store and of the chain scanned
+ * by one rich_list worker, with its partial aggregates
+ * @users: every user, indexed by id
+ * @first_user: first user of the slice
+ * @end_user: one past the last user of the slice
+ * @keys: sorted account addresses shared by every worker
+ * @nb_keys: number of keys
+ * @first_block: first height of the slice
+ * @end_block: one past the last height of the slice, -1 for the chain tip
+ * @flows: totals per account id, one more than users for the ALU account
+ * @unowned: amount received by addresses no account owns
+ * @transactions: number of transactions scanned
+ * @volume: amount transferred
+ * @fees: transaction fees paid to miners
+ * @pruned: number of pruned blocks whose transactions were not scanned
+ * @role_balance: balances held per role, the last entry for unknown roles
+ * @role_users: users per role
+ * @top: ids of the largest balances of the slice, largest first
+ * @nb_top: number of ids in top
+ * @limit: size of top
+ * @failed: 1 if the chain could not be read
+ */
+typedef struct rich_part_s {
+    user_t **users;
+    int first_user;
+    int end_user;
+    const account_key_t *keys;
+    int nb_keys;
+    long first_block;
+    long end_block;
+    account_flow_t *flows;
+    int64_t unowned;
+    uint64_t transactions;
+    int64_t volume;
+    int64_t fees;
+    long pruned;
+    int64_t role_balance[ROLE_COUNT + 1];
+    long role_users[ROLE_COUNT + 1];
+    int *top;
+    int nb_top;
+    int limit;
+    int failed;
+} rich_part_t;
+
 /**
  * lusers - list of users(nodes) in blockchain
  * @head: first user in linked list
@@ -141,6 +734,475 @@ typedef struct lusers {
     int length;
 } lusers;
 
+/**
+ * struct node_frame_s - header of a message on the node socket, fields in
+ * network byte order
+ * @magic: NODE_MAGIC
+ * @type: NodeRequest in requests, 1 on success or 0 on failure in responses
+ * @length: number of payload bytes that follow
+ */
+typedef struct node_frame_s {
+    uint32_t magic;
+    uint32_t type;
+    uint32_t length;
+} node_frame_t;
+
+/**
+ * struct file_stamp_s - identity of a file's contents, compared by alu_noded
+ * to notice writes made behind its back
+ * @mtime: modification time in nanoseconds, 0 if the file is missing
+ * @size: file size
+ * @inode: inode number, changes when the file is replaced
+ */
+typedef struct file_stamp_s {
+    int64_t mtime;
+    int64_t size;
+    uint64_t inode;
+} file_stamp_t;
+
+/**
+ * struct node_conn_s - client connection of the node event loop
+ * @fd: socket, -1 once closed; the connection is released after the
+ * events already received for it and its job are done
+ * @events: epoll events currently watched
+ * @busy: whether a request of this connection is with the job threads;
+ * pipelined requests behind it wait so responses keep request order
+ * @in: bytes received, read position at the first unparsed frame
+ * @out: bytes to send, read position at the first unsent byte
+ * @remote: whether this is a TCP link to another node, which only carries
+ * peer messages
+ * @worker: whether this is a TCP link to a pool worker, which only
+ * carries pool messages
+ * @hello: whether the peer introduced itself
+ * @peer_height: last tip height the peer announced
+ * @peer: configured peer the link was opened to, NULL if it was accepted
+ * @prev: previous connection
+ * @next: next connection
+ */
+typedef struct node_conn_s {
+    int fd;
+    uint32_t events;
+    int busy;
+    buffer_t in;
+    buffer_t out;
+    int remote;
+    int worker;
+    int hello;
+    long peer_height;
+    struct node_peer_s *peer;
+    struct node_conn_s *prev;
+    struct node_conn_s *next;
+} node_conn_t;
+
+/**
+ * struct node_job_s - request handed to the job threads
+ * @conn: connection to answer
+ * @type: request type
+ * @request: request payload
+ * @response: captured stdout and stderr followed by the result bytes; for
+ * peer messages, the frames to send back instead
+ * @status: 1 on success else 0
+ * @announce: peer frames to relay to every other peer
+ * @height: tip height a peer message showed the peer has, -1 if none
+ * @blocks: downloaded blocks to commit, already checked against the header
+ * chain; set for the jobs of no connection
+ * @difficulty: difficulty the block template of a pool job is mined at
+ * @out: stream what the job prints to stdout goes to while it runs
+ * @err: stream what the job prints to stderr goes to while it runs
+ * @next: next job in its queue
+ */
+typedef struct node_job_s {
+    node_conn_t *conn;
+    uint32_t type;
+    buffer_t request;
+    buffer_t response;
+    int status;
+    buffer_t announce;
+    long height;
+    Block *blocks;
+    int difficulty;
+    FILE *out;
+    FILE *err;
+    struct node_job_s *next;
+} node_job_t;
+
+/**
+ * struct node_reply_s - response kept to answer a read-only request again
+ * @valid: whether @response is set
+ * @status: response status
+ * @users_stamp: stamp of the users file the response was built from
+ * @session_stamp: stamp of the session file the response was built from
+ * @response: response payload
+ */
+typedef struct node_reply_s {
+    int valid;
+    int status;
+    file_stamp_t users_stamp;
+    file_stamp_t session_stamp;
+    buffer_t response;
+} node_reply_t;
+
+/**
+ * struct node_peer_s - node a daemon keeps a link to, reconnecting when
+ * the link drops
+ * @addr: peer address
+ * @name: HOST:PORT as configured
+ * @conn: open link, NULL while disconnected
+ * @retry_at: monotonic time in seconds of the next connection attempt
+ */
+typedef struct node_peer_s {
+    struct sockaddr_in addr;
+    char name[64];
+    struct node_conn_s *conn;
+    time_t retry_at;
+} node_peer_t;
+
+/**
+ * struct sync_window_s - range of blocks downloaded from one peer while
+ * syncing; requested while @conn is set, verified once @blocks is
+ * @first: first height
+ * @count: number of blocks
+ * @conn: peer asked for the blocks, NULL once answered or gone
+ * @asked: request number, peers answer their requests in order
+ * @blocks: verified blocks linked through next
+ * @next: window of the next heights
+ */
+typedef struct sync_window_s {
+    long first;
+    int count;
+    struct node_conn_s *conn;
+    unsigned long asked;
+    Block *blocks;
+    struct sync_window_s *next;
+} sync_window_t;
+
+/**
+ * struct node_sync_s - headers-first catch-up of a lagging node
+ * The header chain is fetched from the tallest peer and checked first;
+ * bodies are then downloaded in windows from every peer, verified against
+ * their headers as they arrive and committed in height order
+ * @base: height the header chain extends, -1 when not syncing
+ * @base_hash: hash of the block at @base
+ * @time: timestamp of the last verified header, or of the block at @base
+ * @difficulty: difficulty the next header has to meet
+ * @hashes: verified header hashes, the first one at height @base + 1
+ * @nb_headers: number of verified headers
+ * @cap: number of hashes @hashes holds
+ * @header_conn: peer headers are being fetched from, NULL if none
+ * @next: first height no window covers yet
+ * @committed: last height handed to the job threads
+ * @committing: 1 while a commit job runs, kept across resets
+ * @asked: requests sent so far
+ * @windows: windows in height order
+ * @start: monotonic time the catch-up started
+ */
+typedef struct node_sync_s {
+    long base;
+    unsigned char base_hash[SHA256_DIGEST_LENGTH];
+    int64_t time;
+    int difficulty;
+    unsigned char (*hashes)[SHA256_DIGEST_LENGTH];
+    long nb_headers;
+    long cap;
+    struct node_conn_s *header_conn;
+    long next;
+    long committed;
+    int committing;
+    unsigned long asked;
+    sync_window_t *windows;
+    struct timespec start;
+} node_sync_t;
+
+/**
+ * struct node_client_s - connection of the node_bench load generator
+ * @fd: socket
+ * @sent: requests sent
+ * @received: responses received
+ * @sent_at: send time of each request in flight, indexed by number modulo
+ * the pipeline depth
+ * @in: bytes received
+ * @out: bytes to send, read position at the first unsent byte
+ */
+typedef struct node_client_s {
+    int fd;
+    int sent;
+    int received;
+    struct timespec *sent_at;
+    buffer_t in;
+    buffer_t out;
+} node_client_t;
+
+/**
+ * struct compact_block_s - block a peer announced by its header and the
+ * short IDs of its transactions, rebuilt from the pool
+ * @block: header of the block and the address credited its fees, no
+ * transactions attached
+ * @ids: PEER_SHORT_ID_SIZE bytes per transaction
+ * @statuses: status per transaction
+ * @txs: transaction per position, NULL while missing
+ * @nb_trans: number of transactions
+ * @missing: number of transactions still missing
+ * @next: next compact block waiting for transactions
+ */
+typedef struct compact_block_s {
+    Block *block;
+    unsigned char *ids;
+    unsigned char *statuses;
+    Transaction **txs;
+    int nb_trans;
+    int missing;
+    struct compact_block_s *next;
+} compact_block_t;
+
+/**
+ * struct tx_seen_entry_s - transaction a node heard of from a peer
+ * @used: whether the slot holds a transaction
+ * @len: bytes of @tx, 0 while the transaction is asked for
+ * @id: transaction ID
+ * @tx: PEER_TX payload, served to peers that ask for it
+ */
+typedef struct tx_seen_entry_s {
+    unsigned char used;
+    unsigned char len;
+    unsigned char id[TXID_SIZE];
+    unsigned char tx[PEER_TX_SIZE_MAX];
+} tx_seen_entry_t;
+
+/**
+ * struct tx_seen_s - bounded set of the transactions a node heard of
+ * lately, so each one is fetched and checked once however many peers
+ * announce it
+ * Two open addressing tables of 2 * PEER_SEEN_TXS slots take turns: once
+ * the current one holds PEER_SEEN_TXS entries the other one is emptied
+ * and takes over, so the latest PEER_SEEN_TXS transactions at least are
+ * remembered
+ * @gens: the two tables, NULL until the first transaction
+ * @current: index of the table taking new entries
+ * @count: entries in the current table
+ */
+typedef struct tx_seen_s {
+    tx_seen_entry_t *gens[2];
+    int current;
+    uint32_t count;
+} tx_seen_t;
+
+/**
+ * struct pool_work_s - nonce range of a block template a pool worker mines
+ * @job: number of the template, quoted by the shares found in the range
+ * @difficulty: leading zero bytes a share needs
+ * @timestamp: block timestamp of the range; the coordinator moves it on
+ * once the nonces of one timestamp are handed out, so it is the extra nonce
+ * @first: first nonce
+ * @count: number of nonces
+ * @block: template, NULL when there is no work
+ */
+typedef struct pool_work_s {
+    uint64_t job;
+    int difficulty;
+    int64_t timestamp;
+    uint32_t first;
+    uint32_t count;
+    Block *block;
+} pool_work_t;
+
+/**
+ * struct pool_share_s - nonce a pool worker found solving a template
+ * @job: number of the template
+ * @timestamp: block timestamp of the range the nonce belongs to
+ * @nonce: the nonce
+ * @hashes: hashes the worker tried since its last message
+ */
+typedef struct pool_share_s {
+    uint64_t job;
+    int64_t timestamp;
+    uint32_t nonce;
+    uint64_t hashes;
+} pool_share_t;
+
+/**
+ * struct mining_pool_s - block template a node has its pool workers mine
+ * Workers are handed disjoint nonce ranges of the template; the first
+ * share solving it is added and relayed like a block mined locally
+ * @fd: TCP socket accepting workers, -1 if the node runs no pool
+ * @nb_workers: connected workers
+ * @work: template and the range handed out last, its block NULL while
+ * there is nothing to mine or the solved block is being added, its miner
+ * the address credited the fees
+ * @next_nonce: first nonce of @work.timestamp not handed out yet
+ * @started: timestamp the template was built at
+ * @hashes: hashes the workers reported since the pool started
+ * @busy: microseconds the workers had a template to mine since, which
+ * @hashes is the aggregate hash rate over
+ * @building: whether a template job is with the job threads
+ * @stale: set when the template has to be built again
+ */
+typedef struct mining_pool_s {
+    int fd;
+    int nb_workers;
+    pool_work_t work;
+    uint64_t next_nonce;
+    int64_t started;
+    uint64_t hashes;
+    int64_t busy;
+    int building;
+    int stale;
+} mining_pool_t;
+
+/**
+ * struct tx_ring_record_s - transaction submitted through the ring, laid
+ * out the same in every process
+ * @sender: sender address
+ * @receiver: receiver address
+ * @amount: amount of the transaction
+ * @sequence: sender's sequence number, -1 for the next one
+ */
+typedef struct tx_ring_record_s {
+    unsigned char sender[ADDRESS_SIZE];
+    unsigned char receiver[ADDRESS_SIZE];
+    int32_t amount;
+    int64_t sequence;
+} tx_ring_record_t;
+
+/**
+ * struct tx_ring_slot_s - slot of the submission ring
+ * @turn: position the slot is at: equal to it while a producer may claim
+ * the slot, one more once the record is published, and the position one
+ * lap later once the node released it or gave up on it
+ * @record: submitted transaction
+ */
+typedef struct tx_ring_slot_s {
+    _Atomic uint64_t turn;
+    tx_ring_record_t record;
+} tx_ring_slot_t;
+
+/**
+ * struct tx_ring_s - ring of submissions in POSIX shared memory, filled
+ * without locks by any number of processes and drained by the node
+ * Producers claim positions by compare and swap on @head and publish
+ * through the turn of the slot. The node reads in position order and
+ * frees slots only once their records are in the pool log; a slot left
+ * unpublished past TX_RING_STALL_MS is skipped. A producer stopped that
+ * long that resumes after its slot was claimed again writes over the
+ * newer record, which the node then checks like any other
+ * @magic: TX_RING_MAGIC once the ring is set up, 0 once it is retired
+ * @head: next position a producer claims
+ * @tail: positions before it are in the pool log, or were dropped
+ * @slots: TX_RING_SLOTS slots, a position uses the slot of its low bits
+ */
+typedef struct tx_ring_s {
+    _Atomic uint32_t magic;
+    _Alignas(64) _Atomic uint64_t head;
+    _Alignas(64) _Atomic uint64_t tail;
+    _Alignas(64) tx_ring_slot_t slots[TX_RING_SLOTS];
+} tx_ring_t;
+
+/**
+ * struct node_state_s - state alu_noded keeps in memory between requests
+ * Each cache is reloaded when the stamp of its file changes
+ * @chain: loaded blockchain, NULL until loaded
+ * @chain_stamp: stamp of the blockchain file @chain was loaded from
+ * @chain_failed: last validation result of @chain, -2 if not validated yet
+ * @pool: loaded pool of unspent transactions
+ * @pool_stamp: stamp of the pool file
+ * @users: loaded users
+ * @users_stamp: stamp of the users file
+ * @account: loaded ALU account
+ * @account_stamp: stamp of the ALU account file
+ * @session: logged in user, only role, name and index are set
+ * @has_session: whether @session was read
+ * @session_stamp: stamp of the session file
+ * @saved_out: daemon stdout, what is printed outside of jobs goes there
+ * @saved_err: daemon stderr, what is printed outside of jobs goes there
+ * @state: held by the job running, guards the caches, the chain and the
+ * journal; a job mining a block lets it go while grinding the nonce
+ * @lock: guards the job queues, @balance and the published tip
+ * @ready: signalled when a job is queued or the node stops
+ * @queue: jobs waiting for the job threads, oldest first
+ * @queue_tail: last queued job
+ * @done: jobs finished by the job threads, handed back to the event loop
+ * @wake_fd: eventfd the job threads signal when @done is not empty
+ * @stopping: set once the job threads have to exit after the queue
+ * @balance: last balance response, answered again while its files are
+ * unchanged
+ * @conns: connections, closed ones included until they are released
+ * @nb_closed: closed connections not released yet
+ * @height: tip height, published by the job threads under @lock
+ * @tip: tip hash, published with @height
+ * @tip_time: tip timestamp, published with @height
+ * @difficulty: difficulty of the block after the tip, published with
+ * @height
+ * @peer_fd: TCP socket accepting peers, -1 if the node does not listen
+ * @peers: configured peers
+ * @nb_peers: number of configured peers
+ * @sync: catch-up from peers
+ * @resync: set when a peer the node was syncing from went away
+ * @tree: blocks of @chain and of the side branches peers relayed
+ * @full_blocks: set to relay blocks with their transactions instead of
+ * compact blocks
+ * @pending: compact blocks waiting for the transactions asked for, newest
+ * first
+ * @seen: transactions announced by peers or relayed lately
+ * @tx_batch: PEER_TX payloads received while a batch is being checked,
+ * handed to the job threads together once it is done
+ * @tx_checking: whether a batch of transactions is with the job threads
+ * @mining: pool of workers mining blocks for the node
+ * @ring: submission ring local clients push transactions to, NULL if it
+ * could not be set up
+ * @ring_fd: descriptor holding the node's lock on the ring
+ * @ring_draining: whether drained submissions are with the job threads
+ * @ring_read: next ring position to read, back at the ring's tail when a
+ * batch could not be added
+ * @ring_stalled: time the slot at @ring_read was found unpublished, or 0
+ */
+typedef struct node_state_s {
+    Blockchain *chain;
+    file_stamp_t chain_stamp;
+    int chain_failed;
+    utxo_t *pool;
+    file_stamp_t pool_stamp;
+    lusers *users;
+    file_stamp_t users_stamp;
+    struct alu_account_s *account;
+    file_stamp_t account_stamp;
+    user_t session;
+    int has_session;
+    file_stamp_t session_stamp;
+    int saved_out;
+    int saved_err;
+    pthread_mutex_t state;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    struct node_job_s *queue;
+    struct node_job_s *queue_tail;
+    struct node_job_s *done;
+    int wake_fd;
+    int stopping;
+    node_reply_t balance;
+    struct node_conn_s *conns;
+    int nb_closed;
+    long height;
+    unsigned char tip[SHA256_DIGEST_LENGTH];
+    int64_t tip_time;
+    int difficulty;
+    int peer_fd;
+    node_peer_t peers[PEERS_MAX];
+    int nb_peers;
+    node_sync_t sync;
+    int resync;
+    block_tree_t tree;
+    int full_blocks;
+    compact_block_t *pending;
+    tx_seen_t seen;
+    buffer_t tx_batch;
+    int tx_checking;
+    mining_pool_t mining;
+    tx_ring_t *ring;
+    int ring_fd;
+    int ring_draining;
+    uint64_t ring_read;
+    int64_t ring_stalled;
+} node_state_t;
+
 /**
  * Token: university token structure
  * @token_name: token name
@@ -169,7 +1231,10 @@ typedef struct alu_account_s
 
 int serialize_utxo(utxo_t *unspent);
 utxo_t *deserialize_utxo(void);
-int add_transaction(unsigned char *sender, unsigned char *receiver, int amount);
+int pool_add(utxo_t *pool, unsigned char *sender, unsigned char *receiver, int amount, long sequence,
+             unsigned char *id);
+int pool_add_list(utxo_t *pool, utxo_t *txs);
+int add_transaction(unsigned char *sender, unsigned char *receiver, int amount, long sequence, unsigned char *id);
 void free_transactions(utxo_t *transactions);
 int verify_transaction(unsigned char *sender, unsigned char *receiver);
 
@@ -184,6 +1249,7 @@ void print_wallet(Wallet *wallet);
 /* USER FUNCTIONS */
 
 void print_current_user(void);
+int save_session(user_t *user);
 int load_user(const char *name, int idx);
 int create_user(const char *name, int role);
 int serialize_users(lusers *users);
@@ -203,19 +1269,249 @@ void mine_block(Block *block, int difficulty);
 void calculate_hash(Block *block, unsigned char *hash);
 int is_valid_hash(unsigned char *hash, int difficulty);
 void hash_to_hex(unsigned char *hash, char *output);
+void bytes_to_hex(const unsigned char *bytes, size_t len, char *output);
 int finalize_mining(Block *block);
-utxo_t *tx_for_mining(utxo_t *total_unpsent);
+int apply_block(lusers *users, Block *block);
+utxo_t *tx_for_mining(utxo_t *total_unpsent, utxo_t *failed);
+Block *mine_template(Blockchain *blockchain, utxo_t *failed);
+int mine_commit(Blockchain *blockchain, Block *block, utxo_t *failed);
+int mine_pending(Blockchain *blockchain);
+int check_block(Block *block, Block *tip, int difficulty);
+int accept_blocks(Blockchain *blockchain, Block *blocks);
+void free_blocks(Block *blocks);
+int rewind_chain(Blockchain *blockchain, Block *last, Block **removed);
+
+/* UNDO RECORD FUNCTIONS */
+
+void undo_init(undo_log_t *log);
+int undo_capture(undo_log_t *log, lusers *users, Block *block);
+int undo_save(undo_log_t *log);
+void undo_free(undo_log_t *log);
+int undo_rewind(lusers *users, Block *removed, Block *last);
+
+/* BLOCK TREE FUNCTIONS */
+
+int block_tree_update(block_tree_t *tree, Blockchain *blockchain);
+block_node_t *block_tree_find(block_tree_t *tree, const unsigned char *hash);
+block_node_t *block_tree_add(block_tree_t *tree, block_node_t *parent, Block *block);
+int reorganize_chain(Blockchain *blockchain, block_tree_t *tree, block_node_t *tip);
+void block_tree_free(block_tree_t *tree);
 
 /* BLOCKCHAIN FUNCTIONS */
 
 Blockchain *deserialize_blockchain(void);
+int store_blockchain(Blockchain *blockchain);
 int serialize_blockchain(Blockchain *blockchain); // backup_blockchain?
+int truncate_blockchain(Blockchain *blockchain, Block *last, Block **removed);
 Blockchain *init_blockchain(void);
 int validate_chain(Blockchain *blockchain);
+int validate_chain_parallel(Blockchain *blockchain, int nb_threads);
+int load_checkpoint(checkpoint_t *checkpoint);
+int save_checkpoint(Blockchain *blockchain);
+int validate_tip(Blockchain *blockchain);
+int validate_full(Blockchain *blockchain);
 void print_blockchain(Blockchain *blockchain);
 void free_blockchain(Blockchain *blockchain);
 utxo_t *create_genesis_transaction(unsigned char *sender, unsigned char *receiver, int amount);
-int adjust_difficulty(uint64_t prevTime, uint64_t currentTime, int currentDifficulty);
+int adjust_difficulty(int64_t prevTime, int64_t currentTime, int currentDifficulty);
+int next_difficulty(Block *previous, Block *block, int difficulty);
+int chain_difficulty(Blockchain *blockchain);
+int64_t block_timestamp(Block *previous);
+int valid_timestamp(int64_t timestamp, int64_t previous);
+int64_t current_timestamp(void);
+void format_timestamp(int64_t timestamp, char *output);
+Blockchain *synthetic_blockchain(int nb_blocks, int nb_addresses, unsigned int seed);
+
+/* RECORD I/O FUNCTIONS */
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t len);
+void buffer_init(buffer_t *buffer);
+void buffer_free(buffer_t *buffer);
+int buffer_reserve(buffer_t *buffer, size_t len);
+int buffer_put(buffer_t *buffer, const void *data, size_t len);
+int buffer_get(buffer_t *buffer, void *data, size_t len);
+int write_record(FILE *file, buffer_t *buffer);
+int read_record(FILE *file, buffer_t *buffer);
+int truncate_torn_tail(const char *path, long offset);
+int buffer_put_varint(buffer_t *buffer, uint64_t value);
+int buffer_get_varint(buffer_t *buffer, uint64_t *value);
+int buffer_put_svarint(buffer_t *buffer, int64_t value);
+int buffer_get_svarint(buffer_t *buffer, int64_t *value);
+
+/* JOURNAL FUNCTIONS */
+
+int journal_begin(void);
+int journal_active(void);
+int journal_write(const char *path, long offset, int truncate, const void *data, size_t len);
+int journal_commit(void);
+void journal_abort(void);
+int journal_recover(void);
+int journal_lock(void);
+void journal_unlock(void);
+
+/* GENERATION FUNCTIONS */
+
+int generation_file(const char *path);
+int generation_prefix(const char *path);
+int generation_copy(const char *path, char *copy, size_t size);
+int generation_publish(void);
+int generation_pin(void);
+int generation_pinned(void);
+const char *generation_path(const char *path);
+long generation_length(const char *path);
+
+/* BLOCK CODEC FUNCTIONS */
+
+void codec_state_init(codec_state_t *state);
+void codec_state_free(codec_state_t *state);
+int encode_block_fixed(Block *block, buffer_t *buffer);
+Block *decode_block_fixed(buffer_t *buffer);
+int encode_block_compact(Block *block, buffer_t *buffer, codec_state_t *state);
+Block *decode_block_compact(buffer_t *buffer, codec_state_t *state);
+Block *decode_block_filtered(buffer_t *buffer, codec_state_t *state, const unsigned char *address, int *skipped);
+void block_bloom(Block *block, unsigned char *bloom, unsigned int size);
+int bloom_contains(const unsigned char *bloom, unsigned int size, const unsigned char *address);
+
+/* SNAPSHOT FUNCTIONS */
+
+int export_snapshot(const char *path, unsigned char *content_hash);
+int import_snapshot(const char *path, const unsigned char *expected_hash, unsigned char *content_hash);
+
+/* PRUNING FUNCTIONS */
+
+int prune_blockchain(Blockchain *blockchain, int depth, int archive);
+
+/* TIME INDEX FUNCTIONS */
+
+int block_reader_open(block_reader_t *reader, int64_t key, int by_height);
+Block *block_reader_next(block_reader_t *reader);
+void block_reader_close(block_reader_t *reader);
+Blockchain *blocks_between(int64_t from, int64_t to, int *nb_read);
+int time_index_rewind(long height);
+
+/* EXPORT FUNCTIONS */
+
+int out_init(out_buffer_t *out, FILE *file);
+int out_flush(out_buffer_t *out);
+int out_free(out_buffer_t *out);
+void out_bytes(out_buffer_t *out, const char *data, size_t len);
+void out_str(out_buffer_t *out, const char *str);
+void out_i64(out_buffer_t *out, int64_t value);
+void out_hex(out_buffer_t *out, const unsigned char *bytes, size_t len);
+long export_chain(FILE *file, ExportFormat format, long from, long to);
+
+/* COLUMN EXPORT FUNCTIONS */
+
+long export_columns(const char *dir);
+int load_columns(const char *dir, ledger_columns_t *columns);
+void free_columns(ledger_columns_t *columns);
+int64_t columns_volume(const ledger_columns_t *columns, int64_t from, int64_t to, uint64_t *count);
+void columns_by_address(const ledger_columns_t *columns, int64_t from, int64_t to, int64_t *sent,
+                        int64_t *received);
+void columns_buckets(const ledger_columns_t *columns, int64_t from, int64_t width, long nb_buckets,
+                     int64_t *volume, uint64_t *count);
+
+/* BALANCE ANALYTICS FUNCTIONS */
+
+int print_rich_list(int limit, int nb_threads);
+
+/* CHAIN STATISTICS FUNCTIONS */
+
+uint64_t block_work(Block *block);
+int stats_update(Blockchain *blockchain);
+int stats_rewind(long height);
+int stats_read(long height, chain_stats_t *stats);
+long stats_height(void);
+
+/* DISK TABLE FUNCTIONS */
+
+int disk_table_load(disk_table_t *table, const char *path, uint32_t key_size);
+void disk_table_clear(disk_table_t *table);
+int disk_table_get(disk_table_t *table, const unsigned char *key, uint64_t *value);
+int disk_table_put(disk_table_t *table, const unsigned char *key, uint64_t value);
+int disk_table_save(disk_table_t *table);
+void disk_table_free(disk_table_t *table);
+int disk_table_lookup(const char *path, const unsigned char *key, uint32_t key_size, uint64_t *value);
+int disk_table_store(const char *path, const unsigned char *key, uint32_t key_size, uint64_t value);
+
+/* TRANSACTION ID FUNCTIONS */
+
+void transaction_id(const Transaction *trans, unsigned char *id);
+int txid_rebuild(void);
+long txid_next_sequence(const unsigned char *sender);
+int txid_submit(Transaction *trans, long sequence, unsigned char *id);
+int txid_submit_list(utxo_t *txs);
+int txid_record_block(Block *block, utxo_t *failed);
+int txid_revert_block(Block *block);
+int txid_status(const unsigned char *id, Status *status, long *height, int *position);
+
+/* TRANSACTION HISTORY FUNCTIONS */
+
+int history_update(Blockchain *blockchain);
+int history_rewind(Block *removed, Block *last);
+long history_head(const unsigned char *address);
+int history_read(long cursor, history_posting_t *postings, int max, long *next);
+int history_scan(const unsigned char *address, history_posting_t *postings, int max,
+                 int *nb_blocks, int *nb_skipped);
+
+/* NODE FUNCTIONS */
+
+int node_connect(void);
+int node_send(int fd, uint32_t type, const buffer_t *payload);
+int node_receive(int fd, uint32_t *type, buffer_t *payload);
+int node_frame_put(buffer_t *out, uint32_t type, const buffer_t *payload);
+int node_frame_parse(buffer_t *in, uint32_t max, uint32_t *type, uint32_t *len);
+int node_call(NodeRequest type, const buffer_t *request, buffer_t *result);
+
+/* PEER FUNCTIONS */
+
+int peer_address(const char *spec, struct sockaddr_in *addr);
+int peer_listen(const struct sockaddr_in *addr);
+int peer_connect(const struct sockaddr_in *addr);
+int peer_put_hello(buffer_t *out, long height, const unsigned char *tip);
+int peer_put_block(buffer_t *payload, Block *block);
+Block *peer_get_block(buffer_t *payload);
+int peer_put_header(buffer_t *payload, const Block *block);
+int peer_get_header(buffer_t *payload, Block *header);
+int peer_put_transaction(buffer_t *payload, const Transaction *trans);
+int peer_get_transaction(buffer_t *payload, Transaction *trans);
+
+/* COMPACT BLOCK FUNCTIONS */
+
+void short_tx_id(const unsigned char *block_hash, const Transaction *trans, unsigned char *id);
+int compact_put(buffer_t *payload, Block *block);
+compact_block_t *compact_get(buffer_t *payload);
+int compact_match(compact_block_t *compact, utxo_t *pool);
+int compact_put_request(buffer_t *payload, compact_block_t *compact);
+int compact_put_txs(buffer_t *payload, Block *block, buffer_t *request);
+int compact_fill(compact_block_t *compact, buffer_t *payload);
+Block *compact_finish(compact_block_t *compact);
+void compact_free(compact_block_t *compact);
+
+/* TRANSACTION GOSSIP FUNCTIONS */
+
+tx_seen_entry_t *tx_seen_find(tx_seen_t *seen, const unsigned char *id);
+tx_seen_entry_t *tx_seen_add(tx_seen_t *seen, const unsigned char *id);
+void tx_seen_free(tx_seen_t *seen);
+int inv_put(buffer_t *frames, uint32_t type, const unsigned char *ids, size_t count);
+
+/* MINING POOL FUNCTIONS */
+
+int pool_put_work(buffer_t *payload, const pool_work_t *work);
+int pool_get_work(buffer_t *payload, pool_work_t *work);
+int pool_put_share(buffer_t *payload, const pool_share_t *share);
+int pool_get_share(buffer_t *payload, pool_share_t *share);
+
+/* SUBMISSION RING FUNCTIONS */
+
+tx_ring_t *tx_ring_create(int *fd);
+tx_ring_t *tx_ring_open(void);
+int tx_ring_push(tx_ring_t *ring, const tx_ring_record_t *record, uint64_t *pos);
+int tx_ring_wait(tx_ring_t *ring, uint64_t pos);
+int tx_ring_pop(tx_ring_t *ring, uint64_t *pos, tx_ring_record_t *record, int64_t *stalled);
+void tx_ring_release(tx_ring_t *ring, uint64_t end);
+void tx_ring_retire(tx_ring_t *ring, int fd);
+void tx_ring_close(tx_ring_t *ring);
 
 /* ALU ACCOUNT FUNCTIONS */
 
@@ -6,6 +6,13 @@
  */
 int main(void)
 {
+    int status = node_call(NODE_INFO, NULL, NULL);
+
+    if (status >= 0)
+        return status ? 0 : EXIT_FAILURE;
+
+    /* The chain and the account are read as one generation, while blocks are mined */
+    generation_pin();
     Blockchain *blockchain = deserialize_blockchain();
     if (!blockchain)
     {
@@ -17,6 +24,14 @@ int main(void)
         printf("Blockchain is empty\n");
         return 0;
     }
+    int failed = validate_chain_parallel(blockchain, VALIDATION_THREADS);
+    if (failed == -1)
+        printf("Blockchain is valid (%d blocks)\n\n", blockchain->length);
+    else if (failed == VALIDATION_ERROR)
+        fprintf(stderr, "Could not validate blockchain\n\n");
+    else
+        fprintf(stderr, "Blockchain is not valid: first bad block at height %d\n\n", failed);
+
     alu_account *account = deserialize_alu_account();
     if (!account)
     {
@@ -0,0 +1,55 @@
+#include "blockchain.h"
+
+/**
+ * parse_time - parses epoch seconds, with an optional fraction
+ * @text: text to parse
+ * @timestamp: where to store the timestamp
+ * Return: 1 on success else 0
+ */
+static int parse_time(const char *text, int64_t *timestamp)
+{
+    char *end;
+    double seconds = strtod(text, &end);
+
+    if (end == text || *end != '\0')
+        return 0;
+    *timestamp = (int64_t)(seconds * TIMESTAMP_RESOLUTION);
+    return 1;
+}
+
+/**
+ * main - lists the blocks mined between two times
+ * @argc: argument count
+ * @argv: first and last time of the range, in seconds since the epoch
+ * Return: 0 on success else 1
+ */
+int main(int argc, char **argv)
+{
+    int64_t from, to;
+    char timestamp[32];
+    int nb_read;
+
+    if (argc != 3 || !parse_time(argv[1], &from) || !parse_time(argv[2], &to))
+    {
+        fprintf(stderr, "Usage: %s <from> <to> (seconds since the epoch)\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    Blockchain *range = blocks_between(from, to, &nb_read);
+    if (!range)
+    {
+        fprintf(stderr, "Could not read blocks\n");
+        exit(EXIT_FAILURE);
+    }
+    for (Block *block = range->head; block; block = block->next)
+    {
+        format_timestamp(block->timestamp, timestamp);
+        if (block->pruned)
+            printf("Block %u  %s  transactions pruned\n", block->index, timestamp);
+        else
+            printf("Block %u  %s  %d transactions\n", block->index, timestamp, block->transactions->nb_trans);
+    }
+    printf("%d blocks in range, %d block records read\n", range->length, nb_read);
+    free_blockchain(range);
+    return 0;
+}
@@ -0,0 +1,181 @@
+#include "blockchain.h"
+
+#define BENCH_QUERIES 20
+
+/**
+ * elapsed - seconds between two monotonic clock readings
+ * @start: first reading
+ * @end: second reading
+ * Return: elapsed seconds
+ */
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * scan_records - decodes every record looking for one address
+ * @encoded: length-prefixed compact records
+ * @address: address to look for
+ * @nb_skipped: where to add the number of blocks skipped by their filter
+ * @nb_false: where to add the number of decoded blocks without a match
+ * Return: number of matching transactions, or -1 on a decode error
+ */
+static long scan_records(buffer_t *encoded, const unsigned char *address, long *nb_skipped, long *nb_false)
+{
+    buffer_t record;
+    codec_state_t state;
+    long matches = 0;
+    int skipped;
+
+    buffer_init(&record);
+    codec_state_init(&state);
+    encoded->pos = 0;
+    while (encoded->pos < encoded->len)
+    {
+        uint32_t len;
+        buffer_get(encoded, &len, sizeof(len));
+        record.data = encoded->data + encoded->pos;
+        record.len = len;
+        record.pos = 0;
+        encoded->pos += len;
+
+        Block *block = decode_block_filtered(&record, &state, address, &skipped);
+        if (!block)
+        {
+            matches = -1;
+            break;
+        }
+        int found = 0;
+        for (Transaction *trans = block->transactions->head; trans; trans = trans->next)
+        {
+            if (memcmp(trans->sender, address, ADDRESS_SIZE) == 0 ||
+                memcmp(trans->receiver, address, ADDRESS_SIZE) == 0)
+                found++;
+        }
+        matches += found;
+        *nb_skipped += skipped;
+        *nb_false += !skipped && !found;
+        free_transactions(block->transactions);
+        free(block);
+    }
+    record.data = NULL;
+    codec_state_free(&state);
+    return matches;
+}
+
+/**
+ * bench_filter - encodes the chain with one filter size and scans it for a
+ * set of addresses
+ * @blockchain: chain to encode
+ * @bloom_bytes: filter size, 0 for no filter
+ * @targets: addresses to scan for
+ * @expected: match counts of an unfiltered scan, filled when bloom_bytes is 0
+ * @baseline: unfiltered scan time, filled when bloom_bytes is 0
+ * Return: 1 if every scan found the expected matches, else 0
+ */
+static int bench_filter(Blockchain *blockchain, int bloom_bytes, unsigned char (*targets)[ADDRESS_SIZE],
+                        long *expected, double *baseline)
+{
+    struct timespec t0, t1;
+    buffer_t encoded, record;
+    codec_state_t state;
+    long nb_skipped = 0, nb_false = 0;
+    int ok = 1;
+
+    buffer_init(&encoded);
+    buffer_init(&record);
+    codec_state_init(&state);
+    state.bloom_bytes = bloom_bytes;
+    for (Block *block = blockchain->head; block; block = block->next)
+    {
+        uint32_t len;
+        record.len = 0;
+        if (!encode_block_compact(block, &record, &state))
+            break;
+        len = (uint32_t)record.len;
+        buffer_put(&encoded, &len, sizeof(len));
+        buffer_put(&encoded, record.data, record.len);
+    }
+    codec_state_free(&state);
+    buffer_free(&record);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < BENCH_QUERIES; i++)
+    {
+        long matches = scan_records(&encoded, targets[i], &nb_skipped, &nb_false);
+        if (bloom_bytes == 0)
+            expected[i] = matches;
+        else if (matches != expected[i])
+            ok = 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double scan = elapsed(&t0, &t1) / BENCH_QUERIES;
+    long scanned = (long)blockchain->length * BENCH_QUERIES;
+    if (bloom_bytes == 0)
+        *baseline = scan;
+    printf("%5d bytes %8.1f bytes/block  skipped %6.2f%%  false positives %6.3f%%  %8.2f ms/scan  %5.2fx\n",
+           bloom_bytes, (double)encoded.len / blockchain->length, 100.0 * nb_skipped / scanned,
+           100.0 * nb_false / scanned, scan * 1e3, *baseline / scan);
+    buffer_free(&encoded);
+    return ok;
+}
+
+/**
+ * main - measures how well per-block address filters let scans skip blocks
+ * @argc: argument count
+ * @argv: optional number of blocks, number of addresses and one filter size
+ * Return: 0 on success else 1
+ */
+int main(int argc, char **argv)
+{
+    int nb_blocks = argc > 1 ? atoi(argv[1]) : 100000;
+    int nb_addresses = argc > 2 ? atoi(argv[2]) : 10000;
+    int sizes[] = {8, 16, 32, 64}, nb_sizes = sizeof(sizes) / sizeof(*sizes);
+    unsigned char targets[BENCH_QUERIES][ADDRESS_SIZE];
+    long expected[BENCH_QUERIES];
+    double baseline = 0;
+    char name[32];
+
+    if (argc > 3)
+    {
+        sizes[0] = atoi(argv[3]);
+        nb_sizes = 1;
+    }
+    for (int i = 0; i < nb_sizes; i++)
+    {
+        if (sizes[i] < 1 || sizes[i] > BLOOM_FILTER_BYTES_MAX)
+        {
+            fprintf(stderr, "Filter size must be between 1 and %d bytes\n", BLOOM_FILTER_BYTES_MAX);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    Blockchain *blockchain = synthetic_blockchain(nb_blocks, nb_addresses, 42);
+    if (!blockchain)
+    {
+        fprintf(stderr, "Could not build synthetic blockchain\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < BENCH_QUERIES; i++)
+    {
+        snprintf(name, sizeof(name), "user%d", i * (nb_addresses / BENCH_QUERIES));
+        unsigned char digest[SHA256_DIGEST_LENGTH];
+        get_address(name, digest);
+        memcpy(targets[i], digest, ADDRESS_SIZE);
+    }
+    printf("%d blocks, %d transactions per block, %d addresses, %d hashes per address, %d scans\n",
+           nb_blocks, TRANSACTION_VOLUME, nb_addresses, BLOOM_HASHES, BENCH_QUERIES);
+
+    int ok = bench_filter(blockchain, 0, targets, expected, &baseline);
+    for (int i = 0; ok && i < nb_sizes; i++)
+        ok = bench_filter(blockchain, sizes[i], targets, expected, &baseline);
+    free_blockchain(blockchain);
+    if (!ok)
+    {
+        fprintf(stderr, "Filtered scan missed transactions\n");
+        exit(EXIT_FAILURE);
+    }
+    return 0;
+}
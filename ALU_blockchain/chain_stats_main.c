@@ -0,0 +1,67 @@
+#include "blockchain.h"
+
+static const char *role_names[] = {"Students", "Faculty", "Vendors", "Other"};
+
+/**
+ * print_range - prints the totals of the blocks after one cumulative
+ * record up to another
+ * @start: totals before the range, all zero to start at genesis
+ * @end: totals at the end of the range
+ * @nb_blocks: number of blocks in the range
+ * @first_time: timestamp the first block interval starts at
+ */
+static void print_range(chain_stats_t *start, chain_stats_t *end, long nb_blocks, int64_t first_time)
+{
+    printf("Transactions: %lu\n", (unsigned long)(end->transactions - start->transactions));
+    printf("Volume: %ld\n", (long)(end->volume - start->volume));
+    printf("Fees: %ld\n", (long)(end->fees - start->fees));
+    for (int i = 0; i <= ROLE_COUNT; i++)
+        printf("Volume sent by %s: %ld\n", role_names[i], (long)(end->role_volume[i] - start->role_volume[i]));
+    printf("Work: %lu\n", (unsigned long)(end->work - start->work));
+    if (nb_blocks > 1)
+        printf("Average block time: %.3f seconds\n",
+               (double)(end->timestamp - first_time) / TIMESTAMP_RESOLUTION / (nb_blocks - 1));
+}
+
+/**
+ * main - prints chain statistics from the cumulative records, reading at
+ * most three of them whatever the chain length
+ * @argc: argument count
+ * @argv: optional first and last height of a range
+ * Return: 0 on success else 1
+ */
+int main(int argc, char **argv)
+{
+    chain_stats_t start, end, first, validated;
+    checkpoint_t checkpoint;
+
+    journal_recover();
+    long tip = stats_height();
+    if (tip < 0)
+    {
+        fprintf(stderr, "No chain statistics yet, mine a block to build them\n");
+        exit(EXIT_FAILURE);
+    }
+    long from = argc > 1 ? atol(argv[1]) : 0;
+    long to = argc > 2 ? atol(argv[2]) : tip;
+    if (from < 0 || to > tip || from > to)
+    {
+        fprintf(stderr, "Range must be within heights 0 to %ld\n", tip);
+        exit(EXIT_FAILURE);
+    }
+
+    memset(&start, 0, sizeof(start));
+    if (!stats_read(to, &end) || !stats_read(from, &first) || (from > 0 && !stats_read(from - 1, &start)))
+    {
+        fprintf(stderr, "Could not read chain statistics\n");
+        exit(EXIT_FAILURE);
+    }
+    if (load_checkpoint(&checkpoint) && checkpoint.height <= tip &&
+        stats_read(checkpoint.height, &validated) &&
+        memcmp(validated.hash, checkpoint.hash, SHA256_DIGEST_LENGTH) != 0)
+        fprintf(stderr, "Statistics do not match the validated chain, mine a block to rebuild them\n");
+
+    printf("Blocks %ld to %ld of %ld\n", from, to, tip + 1);
+    print_range(&start, &end, to - from + 1, first.timestamp);
+    return 0;
+}
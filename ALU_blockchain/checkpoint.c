@@ -0,0 +1,120 @@
+#include "blockchain.h"
+
+/**
+ * load_checkpoint - reads the last validated height and hash
+ * @checkpoint: pointer to checkpoint to fill
+ * Return: 1 on success else 0 if there is no usable checkpoint
+ */
+int load_checkpoint(checkpoint_t *checkpoint)
+{
+    journal_recover();
+    FILE *file = fopen(CHECKPOINT_DATABASE, "rb");
+    if (!file)
+        return 0;
+
+    if (fread(&checkpoint->height, sizeof(checkpoint->height), 1, file) != 1 ||
+        fread(checkpoint->hash, SHA256_DIGEST_LENGTH, 1, file) != 1)
+    {
+        fclose(file);
+        return 0;
+    }
+    fclose(file);
+    return 1;
+}
+
+/**
+ * save_checkpoint - records the blockchain tip as validated, staged in the
+ * open journal group so it lands with the block it names, else committed
+ * on its own
+ * @blockchain: pointer to a blockchain validated up to its tail
+ * Return: 1 on success else 0 on failure
+ */
+int save_checkpoint(Blockchain *blockchain)
+{
+    unsigned char record[sizeof(int) + SHA256_DIGEST_LENGTH];
+    int height;
+
+    if (!blockchain || !blockchain->tail)
+        return 0;
+
+    height = blockchain->length - 1;
+    memcpy(record, &height, sizeof(height));
+    memcpy(record + sizeof(height), blockchain->tail->current_hash, SHA256_DIGEST_LENGTH);
+    if (!journal_write(CHECKPOINT_DATABASE, 0, 1, record, sizeof(record)))
+    {
+        fprintf(stderr, "Failed to write checkpoint\n");
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * validate_tip - validates only the blocks appended since the checkpoint
+ * Falls back to full validation when the checkpoint is missing, does not
+ * match the chain, or when the new tail lands on a full validation interval
+ * @blockchain: pointer to blockchain to validate
+ * Return: 1 if valid, or 0 if invalid
+ */
+int validate_tip(Blockchain *blockchain)
+{
+    checkpoint_t checkpoint;
+    unsigned char calculatedHash[SHA256_DIGEST_LENGTH];
+    Block *current;
+    int height = 0, difficulty;
+
+    if (!blockchain || !blockchain->head)
+        return 0;
+
+    if (!load_checkpoint(&checkpoint) || checkpoint.height < 0 ||
+        checkpoint.height >= blockchain->length ||
+        (blockchain->length - 1) % FULL_VALIDATION_INTERVAL == 0)
+        return validate_full(blockchain);
+
+    /* Walk to the checkpoint without hashing anything, following the difficulty */
+    current = blockchain->head;
+    difficulty = next_difficulty(NULL, current, INITIAL_DIFFICULTY);
+    while (current && height < checkpoint.height)
+    {
+        if (current->next)
+            difficulty = next_difficulty(current, current->next, difficulty);
+        current = current->next;
+        height++;
+    }
+    if (!current || memcmp(current->current_hash, checkpoint.hash, SHA256_DIGEST_LENGTH) != 0)
+    {
+        fprintf(stderr, "Checkpoint does not match chain, running full validation\n");
+        return validate_full(blockchain);
+    }
+
+    /* Only the blocks after the checkpoint need hashing */
+    while (current->next)
+    {
+        Block *next = current->next;
+        calculate_hash(next, calculatedHash);
+        if (next->pruned ||
+            memcmp(next->current_hash, calculatedHash, SHA256_DIGEST_LENGTH) != 0 ||
+            memcmp(next->previous_hash, current->current_hash, SHA256_DIGEST_LENGTH) != 0 ||
+            !is_valid_hash(next->current_hash, difficulty))
+            return 0;
+        difficulty = next_difficulty(current, next, difficulty);
+        current = next;
+    }
+
+    /* The chain is valid whether or not the checkpoint moves */
+    save_checkpoint(blockchain);
+    return 1;
+}
+
+/**
+ * validate_full - re-validates the whole chain from genesis and moves the
+ * checkpoint to the tip
+ * @blockchain: pointer to blockchain to validate
+ * Return: 1 if valid, or 0 if invalid
+ */
+int validate_full(Blockchain *blockchain)
+{
+    if (!validate_chain(blockchain))
+        return 0;
+    save_checkpoint(blockchain);
+    return 1;
+}
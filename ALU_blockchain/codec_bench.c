@@ -0,0 +1,99 @@
+#include "blockchain.h"
+
+/**
+ * elapsed - seconds between two monotonic clock readings
+ * @start: first reading
+ * @end: second reading
+ * Return: elapsed seconds
+ */
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * bench_codec - encodes and decodes a whole chain with one codec
+ * @blockchain: chain to encode
+ * @compact: 1 for the compact codec, 0 for the fixed-width codec
+ * Return: 1 if every block decoded back, else 0
+ */
+static int bench_codec(Blockchain *blockchain, int compact)
+{
+    struct timespec t0, t1, t2;
+    buffer_t encoded, record;
+    codec_state_t state;
+    int decoded = 0;
+
+    buffer_init(&encoded);
+    buffer_init(&record);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    codec_state_init(&state);
+    for (Block *block = blockchain->head; block; block = block->next)
+    {
+        uint32_t len;
+        record.len = 0;
+        if (!(compact ? encode_block_compact(block, &record, &state) : encode_block_fixed(block, &record)))
+            break;
+        len = (uint32_t)record.len;
+        buffer_put(&encoded, &len, sizeof(len));
+        buffer_put(&encoded, record.data, record.len);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    codec_state_free(&state);
+    while (encoded.pos < encoded.len)
+    {
+        uint32_t len;
+        buffer_get(&encoded, &len, sizeof(len));
+        record.len = 0;
+        record.pos = 0;
+        buffer_put(&record, encoded.data + encoded.pos, len);
+        encoded.pos += len;
+        Block *block = compact ? decode_block_compact(&record, &state) : decode_block_fixed(&record);
+        if (!block)
+            break;
+        free_transactions(block->transactions);
+        free(block);
+        decoded++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+
+    printf("%-8s %12zu bytes %7.1f bytes/block  encode %7.2f Mblocks/s  decode %7.2f Mblocks/s\n",
+           compact ? "compact" : "fixed", encoded.len, (double)encoded.len / blockchain->length,
+           blockchain->length / elapsed(&t0, &t1) / 1e6, decoded / elapsed(&t1, &t2) / 1e6);
+    buffer_free(&encoded);
+    buffer_free(&record);
+    codec_state_free(&state);
+    return decoded == blockchain->length;
+}
+
+/**
+ * main - compares size and throughput of the block record codecs
+ * @argc: argument count
+ * @argv: optional number of blocks and number of addresses
+ * Return: 0 on success else 1
+ */
+int main(int argc, char **argv)
+{
+    int nb_blocks = argc > 1 ? atoi(argv[1]) : 100000;
+    int nb_addresses = argc > 2 ? atoi(argv[2]) : 1000;
+
+    Blockchain *blockchain = synthetic_blockchain(nb_blocks, nb_addresses, 42);
+    if (!blockchain)
+    {
+        fprintf(stderr, "Could not build synthetic blockchain\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("%d blocks, %d transactions per block, %d addresses\n",
+           nb_blocks, TRANSACTION_VOLUME, nb_addresses);
+
+    int ok = bench_codec(blockchain, 0) && bench_codec(blockchain, 1);
+    free_blockchain(blockchain);
+    if (!ok)
+    {
+        fprintf(stderr, "Round trip failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return 0;
+}
@@ -0,0 +1,457 @@
+#include "blockchain.h"
+#include <errno.h>
+#include <sys/stat.h>
+
+static const char *column_names[] = {"height", "timestamp", "sender", "receiver", "amount", "status"};
+static const size_t column_widths[] = {sizeof(uint32_t), sizeof(int64_t), sizeof(uint32_t),
+                                       sizeof(uint32_t), sizeof(int32_t), sizeof(uint8_t)};
+
+/**
+ * column_path - builds the path of a file in the columns directory
+ * @dir: columns directory
+ * @name: file name without extension
+ * @path: buffer of JOURNAL_PATH_MAX bytes
+ */
+static void column_path(const char *dir, const char *name, char *path)
+{
+    snprintf(path, JOURNAL_PATH_MAX, "%s/%s.col", dir, name);
+}
+
+/**
+ * column_data - pointer to the array of one column
+ * @columns: columns
+ * @column: column number, in the order of column_names
+ * Return: address of the column pointer
+ */
+static void **column_data(ledger_columns_t *columns, int column)
+{
+    void **data[] = {(void **)&columns->height, (void **)&columns->timestamp, (void **)&columns->sender,
+                     (void **)&columns->receiver, (void **)&columns->amount, (void **)&columns->status};
+
+    return data[column];
+}
+
+/**
+ * address_slot - first probe slot of an address in the id table
+ * @address: address
+ * @mask: number of slots minus one
+ * Return: slot
+ */
+static uint32_t address_slot(const unsigned char *address, uint32_t mask)
+{
+    return ((uint32_t)address[0] << 24 | (uint32_t)address[1] << 16 | (uint32_t)address[2] << 8 | address[3]) & mask;
+}
+
+/**
+ * address_id - dictionary id of an address, adding it on first use
+ * @columns: columns being built, with an open addressing table of ids
+ * @address: address to look up
+ * Return: id, or -1 on allocation failure
+ */
+static int64_t address_id(ledger_columns_t *columns, const unsigned char *address)
+{
+    uint32_t mask = columns->nb_slots - 1, slot;
+
+    for (slot = address_slot(address, mask); columns->slots[slot] >= 0; slot = (slot + 1) & mask)
+    {
+        if (memcmp(columns->addresses[columns->slots[slot]], address, ADDRESS_SIZE) == 0)
+            return columns->slots[slot];
+    }
+
+    if (columns->nb_addresses == columns->cap_addresses)
+    {
+        uint32_t cap = columns->cap_addresses * 2;
+        void *grown = realloc(columns->addresses, (size_t)cap * ADDRESS_SIZE);
+        int32_t *slots = (int32_t *)malloc(sizeof(int32_t) * cap * 2);
+        if (!grown || !slots)
+        {
+            if (grown)
+                columns->addresses = grown;
+            free(slots);
+            return -1;
+        }
+        columns->addresses = grown;
+        columns->cap_addresses = cap;
+        free(columns->slots);
+        columns->slots = slots;
+        columns->nb_slots = cap * 2;
+        memset(slots, -1, sizeof(int32_t) * columns->nb_slots);
+        mask = columns->nb_slots - 1;
+        for (uint32_t id = 0; id < columns->nb_addresses; id++)
+        {
+            for (slot = address_slot(columns->addresses[id], mask); slots[slot] >= 0; slot = (slot + 1) & mask)
+                ;
+            slots[slot] = (int32_t)id;
+        }
+        return address_id(columns, address);
+    }
+    memcpy(columns->addresses[columns->nb_addresses], address, ADDRESS_SIZE);
+    columns->slots[slot] = (int32_t)columns->nb_addresses;
+    return columns->nb_addresses++;
+}
+
+/**
+ * add_row - appends one transaction to every column and to the chunk stats
+ * @columns: columns being built
+ * @block: block holding the transaction
+ * @trans: transaction
+ * Return: 1 on success else 0
+ */
+static int add_row(ledger_columns_t *columns, Block *block, Transaction *trans)
+{
+    int64_t sender = address_id(columns, trans->sender);
+    int64_t receiver = address_id(columns, trans->receiver);
+    uint64_t row = columns->rows;
+
+    if (sender < 0 || receiver < 0)
+        return 0;
+    if (row == columns->cap_rows)
+    {
+        uint64_t cap = columns->cap_rows * 2;
+        for (int i = 0; i < COLUMN_COUNT; i++)
+        {
+            void **data = column_data(columns, i);
+            void *grown = realloc(*data, cap * column_widths[i]);
+            if (!grown)
+                return 0;
+            *data = grown;
+        }
+        columns->cap_rows = cap;
+    }
+    if (row % COLUMN_CHUNK_ROWS == 0)
+    {
+        column_chunk_t *grown = realloc(columns->chunks, sizeof(*grown) * (columns->nb_chunks + 1));
+        if (!grown)
+            return 0;
+        columns->chunks = grown;
+        column_chunk_t *chunk = &columns->chunks[columns->nb_chunks++];
+        chunk->rows = 0;
+        chunk->reserved = 0;
+        chunk->min_height = chunk->max_height = block->index;
+        chunk->min_time = chunk->max_time = block->timestamp;
+        chunk->min_amount = chunk->max_amount = trans->amount;
+    }
+
+    column_chunk_t *chunk = &columns->chunks[columns->nb_chunks - 1];
+    chunk->rows++;
+    chunk->min_height = block->index < chunk->min_height ? block->index : chunk->min_height;
+    chunk->max_height = block->index > chunk->max_height ? block->index : chunk->max_height;
+    chunk->min_time = block->timestamp < chunk->min_time ? block->timestamp : chunk->min_time;
+    chunk->max_time = block->timestamp > chunk->max_time ? block->timestamp : chunk->max_time;
+    chunk->min_amount = trans->amount < chunk->min_amount ? trans->amount : chunk->min_amount;
+    chunk->max_amount = trans->amount > chunk->max_amount ? trans->amount : chunk->max_amount;
+
+    columns->height[row] = block->index;
+    columns->timestamp[row] = block->timestamp;
+    columns->sender[row] = (uint32_t)sender;
+    columns->receiver[row] = (uint32_t)receiver;
+    columns->amount[row] = trans->amount;
+    columns->status[row] = (uint8_t)trans->status;
+    columns->rows++;
+    return 1;
+}
+
+/**
+ * write_file - writes a whole file
+ * @path: file to write
+ * @data: bytes
+ * @len: number of bytes
+ * Return: 1 on success else 0
+ */
+static int write_file(const char *path, const void *data, size_t len)
+{
+    FILE *file = fopen(path, "wb");
+    int result = file && (len == 0 || fwrite(data, 1, len, file) == len);
+
+    if (file && fclose(file) != 0)
+        result = 0;
+    if (!result)
+        fprintf(stderr, "Failed to write %s\n", path);
+    return result;
+}
+
+/**
+ * export_columns - writes every mined transaction as one typed array per
+ * field, plus an address dictionary and per-chunk min/max statistics
+ * The files are derived data rebuilt on each export, so they are written
+ * directly rather than through the journal
+ * @dir: directory to write the columns to
+ * Return: number of rows exported, or -1 on failure
+ */
+long export_columns(const char *dir)
+{
+    ledger_columns_t columns;
+    block_reader_t reader;
+    char path[JOURNAL_PATH_MAX];
+    Block *block;
+    long pruned = 0;
+    int result = 1;
+
+    memset(&columns, 0, sizeof(columns));
+    columns.cap_rows = COLUMN_CHUNK_ROWS;
+    columns.cap_addresses = 1024;
+    columns.nb_slots = columns.cap_addresses * 2;
+    columns.addresses = malloc((size_t)columns.cap_addresses * ADDRESS_SIZE);
+    columns.slots = (int32_t *)malloc(sizeof(int32_t) * columns.nb_slots);
+    for (int i = 0; i < COLUMN_COUNT; i++)
+    {
+        *column_data(&columns, i) = malloc(columns.cap_rows * column_widths[i]);
+        result = result && *column_data(&columns, i);
+    }
+    if (!result || !columns.addresses || !columns.slots || !block_reader_open(&reader, 0, 1))
+    {
+        fprintf(stderr, "Could not start column export\n");
+        free_columns(&columns);
+        return -1;
+    }
+    memset(columns.slots, -1, sizeof(int32_t) * columns.nb_slots);
+
+    while (result && (block = block_reader_next(&reader)))
+    {
+        pruned += block->pruned;
+        for (Transaction *trans = block->transactions->head; result && trans; trans = trans->next)
+            result = add_row(&columns, block, trans);
+        free_transactions(block->transactions);
+        free(block);
+    }
+    block_reader_close(&reader);
+    if (pruned)
+        fprintf(stderr, "Warning: %ld pruned blocks have no transactions to export\n", pruned);
+
+    columns_meta_t meta = {COLUMNS_MAGIC, COLUMN_CHUNK_ROWS, columns.rows, columns.nb_chunks, columns.nb_addresses};
+    if (result && mkdir(dir, 0755) != 0 && errno != EEXIST)
+    {
+        perror("Failed to create columns directory");
+        result = 0;
+    }
+    for (int i = 0; result && i < COLUMN_COUNT; i++)
+    {
+        column_path(dir, column_names[i], path);
+        result = write_file(path, *column_data(&columns, i), columns.rows * column_widths[i]);
+    }
+    column_path(dir, "addresses", path);
+    result = result && write_file(path, columns.addresses, (size_t)columns.nb_addresses * ADDRESS_SIZE);
+    column_path(dir, "chunks", path);
+    result = result && write_file(path, columns.chunks, sizeof(column_chunk_t) * columns.nb_chunks);
+    /* The meta file goes last, readers check its row count against the columns */
+    column_path(dir, "meta", path);
+    result = result && write_file(path, &meta, sizeof(meta));
+
+    long rows = result ? (long)columns.rows : -1;
+    free_columns(&columns);
+    return rows;
+}
+
+/**
+ * read_file - reads a whole file of an expected size
+ * @path: file to read
+ * @len: expected size
+ * Return: buffer holding the file, or NULL on failure
+ */
+static void *read_file(const char *path, size_t len)
+{
+    struct stat st;
+    void *data = malloc(len ? len : 1);
+    FILE *file = fopen(path, "rb");
+
+    if (!data || !file || fstat(fileno(file), &st) != 0 || (size_t)st.st_size != len ||
+        (len && fread(data, 1, len, file) != len))
+    {
+        fprintf(stderr, "Column file %s is missing or does not match the export\n", path);
+        free(data);
+        data = NULL;
+    }
+    if (file)
+        fclose(file);
+    return data;
+}
+
+/**
+ * load_columns - reads a column export into memory
+ * @dir: columns directory
+ * @columns: columns to fill
+ * Return: 1 on success else 0
+ */
+int load_columns(const char *dir, ledger_columns_t *columns)
+{
+    char path[JOURNAL_PATH_MAX];
+    columns_meta_t *meta;
+    int result = 1;
+
+    memset(columns, 0, sizeof(*columns));
+    column_path(dir, "meta", path);
+    meta = read_file(path, sizeof(*meta));
+    if (!meta || meta->magic != COLUMNS_MAGIC || meta->chunk_rows != COLUMN_CHUNK_ROWS)
+    {
+        fprintf(stderr, "No usable column export in %s, run export_columns\n", dir);
+        free(meta);
+        return 0;
+    }
+    columns->rows = columns->cap_rows = meta->rows;
+    columns->nb_chunks = meta->nb_chunks;
+    columns->nb_addresses = columns->cap_addresses = meta->nb_addresses;
+    free(meta);
+
+    for (int i = 0; result && i < COLUMN_COUNT; i++)
+    {
+        column_path(dir, column_names[i], path);
+        result = (*column_data(columns, i) = read_file(path, columns->rows * column_widths[i])) != NULL;
+    }
+    column_path(dir, "addresses", path);
+    result = result && (columns->addresses = read_file(path, (size_t)columns->nb_addresses * ADDRESS_SIZE));
+    column_path(dir, "chunks", path);
+    result = result && (columns->chunks = read_file(path, sizeof(column_chunk_t) * columns->nb_chunks));
+    if (!result)
+        free_columns(columns);
+    return result;
+}
+
+/**
+ * free_columns - frees loaded or partly built columns
+ * @columns: columns to free
+ */
+void free_columns(ledger_columns_t *columns)
+{
+    for (int i = 0; i < COLUMN_COUNT; i++)
+    {
+        free(*column_data(columns, i));
+        *column_data(columns, i) = NULL;
+    }
+    free(columns->addresses);
+    free(columns->slots);
+    free(columns->chunks);
+    columns->addresses = NULL;
+    columns->slots = NULL;
+    columns->chunks = NULL;
+}
+
+/**
+ * chunk_in_range - tells how a chunk overlaps a time range
+ * @chunk: chunk statistics
+ * @from: first timestamp of the range
+ * @to: last timestamp of the range
+ * Return: 0 if no row can match, 2 if every row matches, 1 otherwise
+ */
+static int chunk_in_range(const column_chunk_t *chunk, int64_t from, int64_t to)
+{
+    if (chunk->max_time < from || chunk->min_time > to)
+        return 0;
+    return chunk->min_time >= from && chunk->max_time <= to ? 2 : 1;
+}
+
+/**
+ * columns_volume - sums the amounts transferred in a time range
+ * Chunks are skipped or taken whole from their min/max statistics, and
+ * the remaining rows are filtered with a branchless mask so the loops
+ * vectorize
+ * @columns: loaded columns
+ * @from: first timestamp of the range
+ * @to: last timestamp of the range
+ * @count: where to store the number of matching transactions
+ * Return: total amount
+ */
+int64_t columns_volume(const ledger_columns_t *columns, int64_t from, int64_t to, uint64_t *count)
+{
+    int64_t volume = 0;
+    uint64_t start = 0, matched = 0;
+
+    for (uint32_t c = 0; c < columns->nb_chunks; start += columns->chunks[c++].rows)
+    {
+        const int32_t *amount = columns->amount + start;
+        const int64_t *timestamp = columns->timestamp + start;
+        uint32_t rows = columns->chunks[c].rows;
+        int overlap = chunk_in_range(&columns->chunks[c], from, to);
+
+        if (overlap == 2)
+        {
+            for (uint32_t i = 0; i < rows; i++)
+                volume += amount[i];
+            matched += rows;
+        }
+        else if (overlap == 1)
+        {
+            for (uint32_t i = 0; i < rows; i++)
+            {
+                int64_t in = timestamp[i] >= from && timestamp[i] <= to;
+                volume += amount[i] & -in;
+                matched += in;
+            }
+        }
+    }
+    *count = matched;
+    return volume;
+}
+
+/**
+ * columns_by_address - totals the amounts sent and received per address
+ * in a time range
+ * @columns: loaded columns
+ * @from: first timestamp of the range
+ * @to: last timestamp of the range
+ * @sent: nb_addresses totals, indexed by address id
+ * @received: nb_addresses totals, indexed by address id
+ */
+void columns_by_address(const ledger_columns_t *columns, int64_t from, int64_t to, int64_t *sent,
+                        int64_t *received)
+{
+    uint64_t start = 0;
+
+    memset(sent, 0, sizeof(int64_t) * columns->nb_addresses);
+    memset(received, 0, sizeof(int64_t) * columns->nb_addresses);
+    for (uint32_t c = 0; c < columns->nb_chunks; start += columns->chunks[c++].rows)
+    {
+        int overlap = chunk_in_range(&columns->chunks[c], from, to);
+
+        for (uint64_t i = start; overlap && i < start + columns->chunks[c].rows; i++)
+        {
+            if (overlap == 2 || (columns->timestamp[i] >= from && columns->timestamp[i] <= to))
+            {
+                sent[columns->sender[i]] += columns->amount[i];
+                received[columns->receiver[i]] += columns->amount[i];
+            }
+        }
+    }
+}
+
+/**
+ * columns_buckets - totals the amounts transferred per fixed time bucket
+ * @columns: loaded columns
+ * @from: first timestamp of the first bucket
+ * @width: bucket width, in timestamp units
+ * @nb_buckets: number of buckets, rows past the last one are ignored
+ * @volume: nb_buckets totals
+ * @count: nb_buckets transaction counts
+ */
+void columns_buckets(const ledger_columns_t *columns, int64_t from, int64_t width, long nb_buckets,
+                     int64_t *volume, uint64_t *count)
+{
+    int64_t to = from + width * nb_buckets - 1;
+    uint64_t start = 0;
+
+    memset(volume, 0, sizeof(int64_t) * nb_buckets);
+    memset(count, 0, sizeof(uint64_t) * nb_buckets);
+    for (uint32_t c = 0; c < columns->nb_chunks; start += columns->chunks[c++].rows)
+    {
+        const column_chunk_t *chunk = &columns->chunks[c];
+
+        if (!chunk_in_range(chunk, from, to))
+            continue;
+        /* A chunk within one bucket is summed without per-row division */
+        int64_t first = (chunk->min_time - from) / width, last = (chunk->max_time - from) / width;
+        if (chunk->min_time >= from && first == last && last < nb_buckets)
+        {
+            for (uint32_t i = 0; i < chunk->rows; i++)
+                volume[first] += columns->amount[start + i];
+            count[first] += chunk->rows;
+            continue;
+        }
+        for (uint64_t i = start; i < start + chunk->rows; i++)
+        {
+            if (columns->timestamp[i] < from || columns->timestamp[i] > to)
+                continue;
+            long bucket = (long)((columns->timestamp[i] - from) / width);
+            volume[bucket] += columns->amount[i];
+            count[bucket]++;
+        }
+    }
+}
@@ -0,0 +1,290 @@
+#include "blockchain.h"
+
+/**
+ * short_tx_id - short ID of a transaction in a compact block
+ * The ID is keyed by the block hash, so transactions colliding in one
+ * block do not collide in the next
+ * @block_hash: hash of the block holding the transaction
+ * @trans: transaction
+ * @id: PEER_SHORT_ID_SIZE bytes to fill
+ */
+void short_tx_id(const unsigned char *block_hash, const Transaction *trans, unsigned char *id)
+{
+    unsigned char data[SHA256_DIGEST_LENGTH + TXID_SIZE], hash[SHA256_DIGEST_LENGTH];
+
+    memcpy(data, block_hash, SHA256_DIGEST_LENGTH);
+    transaction_id(trans, data + SHA256_DIGEST_LENGTH);
+    SHA256(data, sizeof(data), hash);
+    memcpy(id, hash, PEER_SHORT_ID_SIZE);
+}
+
+/**
+ * compact_put - appends a compact block to a peer message: the miner, the
+ * header and the short ID and status of each transaction
+ * @payload: message to append to
+ * @block: block to announce
+ * Return: 1 on success else 0
+ */
+int compact_put(buffer_t *payload, Block *block)
+{
+    unsigned char id[PEER_SHORT_ID_SIZE], status;
+    int result = buffer_put(payload, block->miner, ADDRESS_SIZE) && peer_put_header(payload, block) &&
+                 buffer_put_varint(payload, block->transactions->nb_trans);
+
+    for (Transaction *trans = block->transactions->head; result && trans; trans = trans->next)
+    {
+        short_tx_id(block->current_hash, trans, id);
+        status = (unsigned char)trans->status;
+        result = buffer_put(payload, id, sizeof(id)) && buffer_put(payload, &status, sizeof(status));
+    }
+    return result;
+}
+
+/**
+ * compact_get - reads a compact block written by compact_put, with every
+ * transaction missing
+ * @payload: message
+ * Return: compact block or NULL if the message is malformed
+ */
+compact_block_t *compact_get(buffer_t *payload)
+{
+    compact_block_t *compact = (compact_block_t *)calloc(1, sizeof(compact_block_t));
+    uint64_t nb_trans;
+    int result;
+
+    result = compact && (compact->block = (Block *)calloc(1, sizeof(Block))) &&
+             buffer_get(payload, compact->block->miner, ADDRESS_SIZE) && peer_get_header(payload, compact->block) &&
+             buffer_get_varint(payload, &nb_trans) &&
+             nb_trans <= (payload->len - payload->pos) / (PEER_SHORT_ID_SIZE + 1);
+    if (result)
+    {
+        compact->nb_trans = compact->missing = (int)nb_trans;
+        compact->ids = (unsigned char *)malloc(nb_trans * PEER_SHORT_ID_SIZE + 1);
+        compact->statuses = (unsigned char *)malloc(nb_trans + 1);
+        compact->txs = (Transaction **)calloc(nb_trans + 1, sizeof(Transaction *));
+        result = compact->ids && compact->statuses && compact->txs;
+    }
+    for (int i = 0; result && i < compact->nb_trans; i++)
+    {
+        result = buffer_get(payload, compact->ids + i * PEER_SHORT_ID_SIZE, PEER_SHORT_ID_SIZE) &&
+                 buffer_get(payload, compact->statuses + i, 1) && compact->statuses[i] <= FAILED;
+    }
+    if (!result || payload->pos != payload->len)
+    {
+        compact_free(compact);
+        return NULL;
+    }
+    return compact;
+}
+
+/**
+ * id_slot - home slot of a short ID in a position table
+ * @id: short ID, uniform since it is a hash
+ * @mask: number of slots minus one
+ * Return: slot index
+ */
+static uint32_t id_slot(const unsigned char *id, uint32_t mask)
+{
+    uint32_t slot;
+
+    memcpy(&slot, id, sizeof(slot));
+    return slot & mask;
+}
+
+/**
+ * compact_match - fills the missing transactions of a compact block with
+ * the pool transactions whose short IDs it lists
+ * The positions are hashed by short ID, so the pool is read once
+ * @compact: compact block
+ * @pool: pool of unspent transactions, may be NULL
+ * Return: 1 on success else 0
+ */
+int compact_match(compact_block_t *compact, utxo_t *pool)
+{
+    unsigned char id[PEER_SHORT_ID_SIZE];
+    uint32_t mask = 1, slot;
+    Transaction *copy;
+    int *slots, position;
+
+    while (mask < (uint32_t)compact->nb_trans * 2)
+        mask <<= 1;
+    slots = (int *)calloc(mask--, sizeof(int));
+    if (!slots)
+        return 0;
+    /* A slot holds a position plus one, 0 when empty */
+    for (int i = 0; i < compact->nb_trans; i++)
+    {
+        for (slot = id_slot(compact->ids + i * PEER_SHORT_ID_SIZE, mask); slots[slot]; slot = (slot + 1) & mask)
+            ;
+        slots[slot] = i + 1;
+    }
+
+    for (Transaction *trans = pool ? pool->head : NULL; compact->missing > 0 && trans; trans = trans->next)
+    {
+        short_tx_id(compact->block->current_hash, trans, id);
+        for (slot = id_slot(id, mask);
+             slots[slot] && memcmp(compact->ids + (slots[slot] - 1) * PEER_SHORT_ID_SIZE, id, sizeof(id)) != 0;
+             slot = (slot + 1) & mask)
+            ;
+        position = slots[slot] - 1;
+        if (position < 0 || compact->txs[position])
+            continue;
+        copy = (Transaction *)malloc(sizeof(Transaction));
+        if (!copy)
+        {
+            free(slots);
+            return 0;
+        }
+        *copy = *trans;
+        copy->status = (Status)compact->statuses[position];
+        copy->next = NULL;
+        compact->txs[position] = copy;
+        compact->missing--;
+    }
+    free(slots);
+    return 1;
+}
+
+/**
+ * compact_put_request - appends the request for the missing transactions
+ * of a compact block to a peer message: the block hash and their positions
+ * @payload: message to append to
+ * @compact: compact block
+ * Return: 1 on success else 0
+ */
+int compact_put_request(buffer_t *payload, compact_block_t *compact)
+{
+    int result = buffer_put(payload, compact->block->current_hash, SHA256_DIGEST_LENGTH) &&
+                 buffer_put_varint(payload, compact->missing);
+
+    for (int i = 0; result && i < compact->nb_trans; i++)
+    {
+        if (!compact->txs[i])
+            result = buffer_put_varint(payload, i);
+    }
+    return result;
+}
+
+/**
+ * compact_put_txs - appends the transactions a peer asked for to a peer
+ * message: the block hash and each transaction in its fixed-width record
+ * layout, in the order asked
+ * @payload: message to append to
+ * @block: block the transactions belong to
+ * @request: request, read position past the block hash
+ * Return: 1 on success else 0 if the request is malformed
+ */
+int compact_put_txs(buffer_t *payload, Block *block, buffer_t *request)
+{
+    Transaction **txs = (Transaction **)malloc((block->transactions->nb_trans + 1) * sizeof(Transaction *));
+    uint64_t count, position;
+    int nb_trans = 0, result;
+
+    for (Transaction *trans = block->transactions->head; txs && trans; trans = trans->next)
+        txs[nb_trans++] = trans;
+    result = txs && buffer_get_varint(request, &count) && count <= (uint64_t)nb_trans &&
+             buffer_put(payload, block->current_hash, SHA256_DIGEST_LENGTH) && buffer_put_varint(payload, count);
+    for (uint64_t i = 0; result && i < count; i++)
+    {
+        result = buffer_get_varint(request, &position) && position < (uint64_t)nb_trans &&
+                 buffer_put(payload, &txs[position]->index, sizeof(txs[position]->index)) &&
+                 buffer_put(payload, txs[position]->sender, ADDRESS_SIZE) &&
+                 buffer_put(payload, txs[position]->receiver, ADDRESS_SIZE) &&
+                 buffer_put(payload, &txs[position]->amount, sizeof(txs[position]->amount)) &&
+                 buffer_put(payload, &txs[position]->status, sizeof(txs[position]->status));
+    }
+    free(txs);
+    return result;
+}
+
+/**
+ * compact_fill - fills the missing transactions of a compact block with
+ * the ones a peer sent
+ * @compact: compact block
+ * @payload: message, read position past the block hash
+ * Return: 1 on success else 0 if the message is malformed
+ */
+int compact_fill(compact_block_t *compact, buffer_t *payload)
+{
+    uint64_t count;
+    int result = buffer_get_varint(payload, &count) && count == (uint64_t)compact->missing;
+    Transaction *trans;
+
+    for (int i = 0; result && i < compact->nb_trans; i++)
+    {
+        if (compact->txs[i])
+            continue;
+        trans = (Transaction *)calloc(1, sizeof(Transaction));
+        result = trans && buffer_get(payload, &trans->index, sizeof(trans->index)) &&
+                 buffer_get(payload, trans->sender, ADDRESS_SIZE) &&
+                 buffer_get(payload, trans->receiver, ADDRESS_SIZE) &&
+                 buffer_get(payload, &trans->amount, sizeof(trans->amount)) &&
+                 buffer_get(payload, &trans->status, sizeof(trans->status));
+        if (!result)
+        {
+            free(trans);
+            break;
+        }
+        compact->txs[i] = trans;
+        compact->missing--;
+    }
+    return result && payload->pos == payload->len;
+}
+
+/**
+ * compact_finish - builds the block of a compact block with no missing
+ * transaction and checks it hashes to its header
+ * A short ID matching the wrong pool transaction shows as a hash mismatch;
+ * the transactions are then dropped, to be asked for again
+ * @compact: compact block, freed on success
+ * Return: the block or NULL if it does not match its header
+ */
+Block *compact_finish(compact_block_t *compact)
+{
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    utxo_t *transactions = (utxo_t *)calloc(1, sizeof(utxo_t));
+    Block *block = compact->block;
+
+    if (!transactions)
+        return NULL;
+    for (int i = 0; i < compact->nb_trans; i++)
+    {
+        if (transactions->tail)
+            transactions->tail->next = compact->txs[i];
+        else
+            transactions->head = compact->txs[i];
+        transactions->tail = compact->txs[i];
+        transactions->nb_trans++;
+    }
+    block->transactions = transactions;
+    calculate_hash(block, hash);
+    if (memcmp(hash, block->current_hash, SHA256_DIGEST_LENGTH) != 0)
+    {
+        block->transactions = NULL;
+        free_transactions(transactions);
+        memset(compact->txs, 0, compact->nb_trans * sizeof(Transaction *));
+        compact->missing = compact->nb_trans;
+        return NULL;
+    }
+    compact->block = NULL;
+    memset(compact->txs, 0, compact->nb_trans * sizeof(Transaction *));
+    compact_free(compact);
+    return block;
+}
+
+/**
+ * compact_free - frees a compact block and the transactions it holds
+ * @compact: compact block, may be NULL
+ */
+void compact_free(compact_block_t *compact)
+{
+    if (!compact)
+        return;
+    for (int i = 0; compact->txs && i < compact->nb_trans; i++)
+        free(compact->txs[i]);
+    free(compact->txs);
+    free(compact->ids);
+    free(compact->statuses);
+    free(compact->block);
+    free(compact);
+}
@@ -0,0 +1,86 @@
+#include "blockchain.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define CRC32C_HW 1
+#endif
+
+#define CRC32C_POLY 0x82F63B78 /* Castagnoli, reflected */
+
+static uint32_t crc32c_table[256];
+static int crc32c_mode = -1; /* -1 unknown, 0 software, 1 hardware */
+
+/**
+ * crc32c_init - picks the crc32 instruction when the CPU has it, otherwise
+ * builds the lookup table for the software fallback
+ */
+static void crc32c_init(void)
+{
+#ifdef CRC32C_HW
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        crc32c_mode = 1;
+        return;
+    }
+#endif
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (CRC32C_POLY & (0 - (crc & 1)));
+        crc32c_table[i] = crc;
+    }
+    crc32c_mode = 0;
+}
+
+#ifdef CRC32C_HW
+/**
+ * crc32c_hw - CRC32C using the SSE4.2 crc32 instruction, 8 bytes at a time
+ * @crc: running (inverted) crc
+ * @data: bytes to checksum
+ * @len: number of bytes
+ * Return: updated running crc
+ */
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char *data, size_t len)
+{
+    uint64_t crc64 = crc;
+    uint64_t word;
+
+    while (len >= sizeof(word))
+    {
+        memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        data += sizeof(word);
+        len -= sizeof(word);
+    }
+    crc = (uint32_t)crc64;
+    while (len--)
+        crc = _mm_crc32_u8(crc, *data++);
+    return crc;
+}
+#endif
+
+/**
+ * crc32c - computes the CRC32C (Castagnoli) checksum of a buffer
+ * @crc: crc of the preceding bytes, 0 to start a new checksum
+ * @data: bytes to checksum
+ * @len: number of bytes
+ * Return: checksum
+ */
+uint32_t crc32c(uint32_t crc, const void *data, size_t len)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+
+    if (crc32c_mode < 0)
+        crc32c_init();
+    crc = ~crc;
+#ifdef CRC32C_HW
+    if (crc32c_mode == 1)
+        return ~crc32c_hw(crc, bytes, len);
+#endif
+    while (len--)
+        crc = (crc >> 8) ^ crc32c_table[(crc ^ *bytes++) & 0xff];
+    return ~crc;
+}
@@ -0,0 +1,341 @@
+#include "blockchain.h"
+#include <fcntl.h>
+
+/**
+ * key_hash - FNV-1a hash of a table key
+ * @key: key bytes
+ * @key_size: number of key bytes
+ * Return: 64-bit hash
+ */
+static uint64_t key_hash(const unsigned char *key, uint32_t key_size)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (uint32_t i = 0; i < key_size; i++)
+    {
+        hash ^= key[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/**
+ * find_slot - linear probe for a key in an in-memory slot array
+ * @slots: slot array
+ * @nb_slots: number of slots, a power of two
+ * @key: key to find
+ * @key_size: number of key bytes
+ * Return: slot holding the key, or the empty slot where it belongs
+ */
+static uint32_t find_slot(unsigned char *slots, uint32_t nb_slots, const unsigned char *key, uint32_t key_size)
+{
+    size_t slot_size = key_size + sizeof(uint64_t);
+    uint32_t slot = key_hash(key, key_size) & (nb_slots - 1);
+    uint64_t value;
+
+    while (1)
+    {
+        unsigned char *entry = slots + slot * slot_size;
+        memcpy(&value, entry + key_size, sizeof(value));
+        if (value == 0 || memcmp(entry, key, key_size) == 0)
+            return slot;
+        slot = (slot + 1) & (nb_slots - 1);
+    }
+}
+
+/**
+ * disk_table_load - loads a table file, or starts an empty table
+ * @table: table to fill
+ * @path: table file
+ * @key_size: size of the keys stored in the table
+ * Return: 1 on success else 0
+ */
+int disk_table_load(disk_table_t *table, const char *path, uint32_t key_size)
+{
+    size_t slot_size = key_size + sizeof(uint64_t);
+    uint32_t header[4];
+    FILE *file = fopen(path, "rb");
+
+    snprintf(table->path, sizeof(table->path), "%s", path);
+    table->key_size = key_size;
+    table->nb_slots = DISK_TABLE_MIN_SLOTS;
+    table->count = 0;
+    table->rewrite = 1;
+    if (file && fread(header, sizeof(header), 1, file) == 1 &&
+        header[0] == DISK_TABLE_MAGIC && header[1] == key_size &&
+        header[2] >= DISK_TABLE_MIN_SLOTS && (header[2] & (header[2] - 1)) == 0)
+    {
+        table->nb_slots = header[2];
+        table->count = header[3];
+        table->rewrite = 0;
+    }
+
+    table->slots = (unsigned char *)calloc(table->nb_slots, slot_size);
+    table->dirty = (unsigned char *)calloc(table->nb_slots, 1);
+    if (!table->slots || !table->dirty)
+    {
+        fprintf(stderr, "Failed to allocate table %s\n", path);
+        if (file)
+            fclose(file);
+        disk_table_free(table);
+        return 0;
+    }
+    if (!table->rewrite && fread(table->slots, slot_size, table->nb_slots, file) != table->nb_slots)
+    {
+        fprintf(stderr, "Table %s is truncated, rebuilding it\n", path);
+        memset(table->slots, 0, table->nb_slots * slot_size);
+        table->count = 0;
+        table->rewrite = 1;
+    }
+    if (file)
+        fclose(file);
+    return 1;
+}
+
+/**
+ * disk_table_clear - empties a loaded table, the next save stages a
+ * truncating rewrite of the whole file instead of deleting it
+ * @table: loaded table
+ */
+void disk_table_clear(disk_table_t *table)
+{
+    memset(table->slots, 0, table->nb_slots * (table->key_size + sizeof(uint64_t)));
+    table->count = 0;
+    table->rewrite = 1;
+}
+
+/**
+ * disk_table_get - looks up a key in a loaded table
+ * @table: loaded table
+ * @key: key to find
+ * @value: where to store the value
+ * Return: 1 if found else 0
+ */
+int disk_table_get(disk_table_t *table, const unsigned char *key, uint64_t *value)
+{
+    uint32_t slot = find_slot(table->slots, table->nb_slots, key, table->key_size);
+
+    memcpy(value, table->slots + slot * (table->key_size + sizeof(uint64_t)) + table->key_size, sizeof(*value));
+    return *value != 0;
+}
+
+/**
+ * grow_table - doubles the slot array and rehashes every key
+ * @table: loaded table
+ * Return: 1 on success else 0
+ */
+static int grow_table(disk_table_t *table)
+{
+    size_t slot_size = table->key_size + sizeof(uint64_t);
+    uint32_t nb_slots = table->nb_slots * 2;
+    unsigned char *slots = (unsigned char *)calloc(nb_slots, slot_size);
+    unsigned char *dirty = (unsigned char *)calloc(nb_slots, 1);
+    uint64_t value;
+
+    if (!slots || !dirty)
+    {
+        free(slots);
+        free(dirty);
+        return 0;
+    }
+    for (uint32_t i = 0; i < table->nb_slots; i++)
+    {
+        unsigned char *entry = table->slots + i * slot_size;
+        memcpy(&value, entry + table->key_size, sizeof(value));
+        if (value != 0)
+            memcpy(slots + find_slot(slots, nb_slots, entry, table->key_size) * slot_size, entry, slot_size);
+    }
+    free(table->slots);
+    free(table->dirty);
+    table->slots = slots;
+    table->dirty = dirty;
+    table->nb_slots = nb_slots;
+    table->rewrite = 1;
+    return 1;
+}
+
+/**
+ * disk_table_put - inserts or updates a key, growing the table past half
+ * full
+ * @table: loaded table
+ * @key: key to store
+ * @value: value to store, must not be 0
+ * Return: 1 on success else 0
+ */
+int disk_table_put(disk_table_t *table, const unsigned char *key, uint64_t value)
+{
+    size_t slot_size = table->key_size + sizeof(uint64_t);
+    uint64_t old;
+
+    if ((table->count + 1) * 2 > table->nb_slots && !grow_table(table))
+    {
+        fprintf(stderr, "Failed to grow table %s\n", table->path);
+        return 0;
+    }
+
+    uint32_t slot = find_slot(table->slots, table->nb_slots, key, table->key_size);
+    unsigned char *entry = table->slots + slot * slot_size;
+    memcpy(&old, entry + table->key_size, sizeof(old));
+    if (old == 0)
+    {
+        memcpy(entry, key, table->key_size);
+        table->count++;
+    }
+    memcpy(entry + table->key_size, &value, sizeof(value));
+    table->dirty[slot] = 1;
+    return 1;
+}
+
+/**
+ * disk_table_save - stages the table changes in the journal
+ * Only the header and changed slots are written unless the table is new
+ * or was resized
+ * @table: loaded table
+ * Return: 1 on success else 0
+ */
+int disk_table_save(disk_table_t *table)
+{
+    size_t slot_size = table->key_size + sizeof(uint64_t);
+    uint32_t header[4] = {DISK_TABLE_MAGIC, table->key_size, table->nb_slots, table->count};
+    int result = 1;
+
+    if (table->rewrite)
+    {
+        size_t size = sizeof(header) + (size_t)table->nb_slots * slot_size;
+        unsigned char *data = (unsigned char *)malloc(size);
+        if (!data)
+            return 0;
+        memcpy(data, header, sizeof(header));
+        memcpy(data + sizeof(header), table->slots, size - sizeof(header));
+        result = journal_write(table->path, 0, 1, data, size);
+        free(data);
+    }
+    else
+    {
+        for (uint32_t i = 0; result && i < table->nb_slots; i++)
+        {
+            if (table->dirty[i])
+                result = journal_write(table->path, sizeof(header) + i * slot_size, 0,
+                                       table->slots + i * slot_size, slot_size);
+        }
+        result = result && journal_write(table->path, 0, 0, header, sizeof(header));
+    }
+    if (result)
+    {
+        memset(table->dirty, 0, table->nb_slots);
+        table->rewrite = 0;
+    }
+    return result;
+}
+
+/**
+ * disk_table_free - frees a loaded table
+ * @table: loaded table
+ */
+void disk_table_free(disk_table_t *table)
+{
+    free(table->slots);
+    free(table->dirty);
+    table->slots = table->dirty = NULL;
+}
+
+/**
+ * probe_file - linear probe for a key straight in a table file
+ * @fd: open table file
+ * @key: key to find
+ * @key_size: size of the keys stored in the table
+ * @header: where to store the table header
+ * @slot: where to store the slot holding the key, or the empty slot where
+ * it belongs
+ * @value: where to store the value, 0 for an empty slot
+ * Return: 1 if found, 0 if not, or -1 if the table cannot be read
+ */
+static int probe_file(int fd, const unsigned char *key, uint32_t key_size, uint32_t *header,
+                      uint32_t *slot, uint64_t *value)
+{
+    size_t slot_size = key_size + sizeof(uint64_t);
+    unsigned char entry[DISK_TABLE_KEY_MAX + sizeof(uint64_t)];
+
+    if (key_size > DISK_TABLE_KEY_MAX ||
+        pread(fd, header, 4 * sizeof(uint32_t), 0) != (ssize_t)(4 * sizeof(uint32_t)) ||
+        header[0] != DISK_TABLE_MAGIC || header[1] != key_size || header[2] == 0 ||
+        (header[2] & (header[2] - 1)) != 0)
+        return -1;
+
+    *slot = key_hash(key, key_size) & (header[2] - 1);
+    for (uint32_t probes = 0; probes < header[2]; probes++)
+    {
+        if (pread(fd, entry, slot_size, 4 * sizeof(uint32_t) + *slot * slot_size) != (ssize_t)slot_size)
+            return -1;
+        memcpy(value, entry + key_size, sizeof(*value));
+        if (*value == 0)
+            return 0;
+        if (memcmp(entry, key, key_size) == 0)
+            return 1;
+        *slot = (*slot + 1) & (header[2] - 1);
+    }
+    return -1;
+}
+
+/**
+ * disk_table_lookup - looks up one key straight from the table file,
+ * reading only the probed slots
+ * @path: table file
+ * @key: key to find
+ * @key_size: size of the keys stored in the table
+ * @value: where to store the value
+ * Return: 1 if found, 0 if not, or -1 if the table cannot be read
+ */
+int disk_table_lookup(const char *path, const unsigned char *key, uint32_t key_size, uint64_t *value)
+{
+    uint32_t header[4], slot;
+    int fd = open(path, O_RDONLY), found;
+
+    if (fd < 0)
+        return -1;
+    found = probe_file(fd, key, key_size, header, &slot, value);
+    close(fd);
+    return found;
+}
+
+/**
+ * disk_table_store - inserts or updates one key straight in the table file,
+ * staging only the probed slot and the header in the journal
+ * The whole table is loaded instead when the file is missing or the key
+ * would take it past half full. Probes read the file, so a key stored
+ * earlier in the same journal group is not seen
+ * @path: table file
+ * @key: key to store
+ * @key_size: size of the keys stored in the table
+ * @value: value to store, must not be 0
+ * Return: 1 on success else 0
+ */
+int disk_table_store(const char *path, const unsigned char *key, uint32_t key_size, uint64_t value)
+{
+    unsigned char entry[DISK_TABLE_KEY_MAX + sizeof(uint64_t)];
+    uint32_t header[4], slot;
+    uint64_t old;
+    disk_table_t table;
+    int fd = open(path, O_RDONLY), found = -1, result;
+
+    if (fd >= 0)
+    {
+        found = probe_file(fd, key, key_size, header, &slot, &old);
+        close(fd);
+    }
+    if (found == 1 || (found == 0 && (header[3] + 1) * 2 <= header[2]))
+    {
+        memcpy(entry, key, key_size);
+        memcpy(entry + key_size, &value, sizeof(value));
+        header[3] += found == 0;
+        return journal_write(path, sizeof(header) + slot * (key_size + sizeof(uint64_t)), 0,
+                             entry, key_size + sizeof(uint64_t)) &&
+               (found == 1 || journal_write(path, 0, 0, header, sizeof(header)));
+    }
+
+    if (!disk_table_load(&table, path, key_size))
+        return 0;
+    result = disk_table_put(&table, key, value) && disk_table_save(&table);
+    disk_table_free(&table);
+    return result;
+}
@@ -0,0 +1,273 @@
+#include "blockchain.h"
+
+static const char *status_names[] = {"INITIATED", "SUCCESS", "FAILED"};
+
+/**
+ * out_init - sets up a buffered writer over a stream
+ * @out: writer to set up
+ * @file: stream to write to
+ * Return: 1 on success else 0
+ */
+int out_init(out_buffer_t *out, FILE *file)
+{
+    out->data = (char *)malloc(EXPORT_BUFFER_SIZE);
+    out->len = 0;
+    out->file = file;
+    out->failed = out->data == NULL;
+    return !out->failed;
+}
+
+/**
+ * out_flush - writes the buffered bytes to the stream
+ * @out: writer
+ * Return: 1 on success else 0
+ */
+int out_flush(out_buffer_t *out)
+{
+    if (out->len && !out->failed && fwrite(out->data, 1, out->len, out->file) != out->len)
+        out->failed = 1;
+    out->len = 0;
+    return !out->failed;
+}
+
+/**
+ * out_free - flushes and releases a writer
+ * @out: writer
+ * Return: 1 if every write succeeded else 0
+ */
+int out_free(out_buffer_t *out)
+{
+    int result = out->data && out_flush(out) && fflush(out->file) == 0;
+
+    free(out->data);
+    out->data = NULL;
+    return result;
+}
+
+/**
+ * out_reserve - makes room for bytes, flushing when the buffer is full
+ * @out: writer
+ * @len: number of bytes about to be written, at most EXPORT_BUFFER_SIZE
+ * Return: pointer to write at
+ */
+static char *out_reserve(out_buffer_t *out, size_t len)
+{
+    if (out->len + len > EXPORT_BUFFER_SIZE)
+        out_flush(out);
+    return out->data + out->len;
+}
+
+/**
+ * out_bytes - appends raw bytes
+ * @out: writer
+ * @data: bytes
+ * @len: number of bytes
+ */
+void out_bytes(out_buffer_t *out, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        size_t chunk = len < EXPORT_BUFFER_SIZE ? len : EXPORT_BUFFER_SIZE;
+        memcpy(out_reserve(out, chunk), data, chunk);
+        out->len += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+/**
+ * out_str - appends a NUL terminated string
+ * @out: writer
+ * @str: string
+ */
+void out_str(out_buffer_t *out, const char *str)
+{
+    out_bytes(out, str, strlen(str));
+}
+
+/**
+ * out_i64 - appends a signed decimal number
+ * @out: writer
+ * @value: number
+ */
+void out_i64(out_buffer_t *out, int64_t value)
+{
+    char digits[20], *at = out_reserve(out, 21);
+    uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+    int n = 0;
+
+    if (value < 0)
+        *at++ = '-';
+    do
+    {
+        digits[n++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    while (n)
+        *at++ = digits[--n];
+    out->len = at - out->data;
+}
+
+/**
+ * out_hex - appends bytes as hex digits
+ * @out: writer
+ * @bytes: bytes to encode
+ * @len: number of bytes, at most EXPORT_BUFFER_SIZE / 2
+ */
+void out_hex(out_buffer_t *out, const unsigned char *bytes, size_t len)
+{
+    bytes_to_hex(bytes, len, out_reserve(out, len * 2));
+    out->len += len * 2;
+}
+
+/**
+ * export_text - writes a block in the print_blockchain() layout
+ * @out: writer
+ * @block: pointer to block
+ */
+static void export_text(out_buffer_t *out, Block *block)
+{
+    char timestamp[32];
+
+    format_timestamp(block->timestamp, timestamp);
+    out_str(out, "Block ");
+    out_i64(out, block->index);
+    out_str(out, "\nTimestamp: ");
+    out_str(out, timestamp);
+    out_str(out, block->pruned ? "\n\tTransactions pruned\n" : "\n");
+    for (Transaction *trans = block->transactions->head; trans; trans = trans->next)
+    {
+        out_str(out, "\tTransaction ");
+        out_i64(out, trans->index);
+        out_str(out, ": ");
+        out_hex(out, trans->sender, ADDRESS_SIZE);
+        out_str(out, " -> ");
+        out_hex(out, trans->receiver, ADDRESS_SIZE);
+        out_str(out, " Amount: ");
+        out_i64(out, trans->amount);
+        out_str(out, "\n");
+    }
+    out_str(out, "Previous Hash: ");
+    out_hex(out, block->previous_hash, SHA256_DIGEST_LENGTH);
+    out_str(out, "\nCurrent Hash: ");
+    out_hex(out, block->current_hash, SHA256_DIGEST_LENGTH);
+    out_str(out, "\n\n");
+}
+
+/**
+ * export_json - writes a block as one JSON object on its own line
+ * @out: writer
+ * @block: pointer to block
+ */
+static void export_json(out_buffer_t *out, Block *block)
+{
+    out_str(out, "{\"height\":");
+    out_i64(out, block->index);
+    out_str(out, ",\"timestamp\":");
+    out_i64(out, block->timestamp);
+    out_str(out, ",\"nonce\":");
+    out_i64(out, block->nonce);
+    out_str(out, ",\"previous_hash\":\"");
+    out_hex(out, block->previous_hash, SHA256_DIGEST_LENGTH);
+    out_str(out, "\",\"hash\":\"");
+    out_hex(out, block->current_hash, SHA256_DIGEST_LENGTH);
+    out_str(out, block->pruned ? "\",\"pruned\":true,\"transactions\":[" : "\",\"pruned\":false,\"transactions\":[");
+    for (Transaction *trans = block->transactions->head; trans; trans = trans->next)
+    {
+        out_str(out, trans == block->transactions->head ? "{\"index\":" : ",{\"index\":");
+        out_i64(out, trans->index);
+        out_str(out, ",\"sender\":\"");
+        out_hex(out, trans->sender, ADDRESS_SIZE);
+        out_str(out, "\",\"receiver\":\"");
+        out_hex(out, trans->receiver, ADDRESS_SIZE);
+        out_str(out, "\",\"amount\":");
+        out_i64(out, trans->amount);
+        out_str(out, ",\"status\":\"");
+        out_str(out, status_names[trans->status]);
+        out_str(out, "\"}");
+    }
+    out_str(out, "]}\n");
+}
+
+/**
+ * export_csv - writes one CSV row per transaction of a block
+ * @out: writer
+ * @block: pointer to block
+ */
+static void export_csv(out_buffer_t *out, Block *block)
+{
+    for (Transaction *trans = block->transactions->head; trans; trans = trans->next)
+    {
+        out_i64(out, block->index);
+        out_str(out, ",");
+        out_i64(out, block->timestamp);
+        out_str(out, ",");
+        out_hex(out, block->current_hash, SHA256_DIGEST_LENGTH);
+        out_str(out, ",");
+        out_i64(out, trans->index);
+        out_str(out, ",");
+        out_hex(out, trans->sender, ADDRESS_SIZE);
+        out_str(out, ",");
+        out_hex(out, trans->receiver, ADDRESS_SIZE);
+        out_str(out, ",");
+        out_i64(out, trans->amount);
+        out_str(out, ",");
+        out_str(out, status_names[trans->status]);
+        out_str(out, "\n");
+    }
+}
+
+/**
+ * export_chain - streams a height range of the block file to a stream,
+ * decoding one block at a time from the segment holding the first height
+ * @file: stream to write to
+ * @format: EXPORT_TEXT, EXPORT_JSON (one object per line) or EXPORT_CSV
+ * (one row per transaction)
+ * @from: first height to export
+ * @to: last height to export, negative for the tip
+ * Return: number of blocks exported, or -1 on failure
+ */
+long export_chain(FILE *file, ExportFormat format, long from, long to)
+{
+    block_reader_t reader;
+    out_buffer_t out;
+    Block *block;
+    long count = 0;
+
+    if (!block_reader_open(&reader, from, 1))
+        return -1;
+    if (!out_init(&out, file))
+    {
+        fprintf(stderr, "Failed to allocate output buffer\n");
+        block_reader_close(&reader);
+        return -1;
+    }
+    if (format == EXPORT_CSV)
+        out_str(&out, "height,timestamp,block_hash,tx_index,sender,receiver,amount,status\n");
+
+    while (!out.failed && (block = block_reader_next(&reader)))
+    {
+        int past = to >= 0 && block->index > to;
+        if (!past && block->index >= from)
+        {
+            if (format == EXPORT_JSON)
+                export_json(&out, block);
+            else if (format == EXPORT_CSV)
+                export_csv(&out, block);
+            else
+                export_text(&out, block);
+            count++;
+        }
+        free_transactions(block->transactions);
+        free(block);
+        if (past)
+            break;
+    }
+    block_reader_close(&reader);
+    if (!out_free(&out))
+    {
+        fprintf(stderr, "Failed to write export\n");
+        return -1;
+    }
+    return count;
+}
@@ -0,0 +1,24 @@
+#include "blockchain.h"
+
+/**
+ * main - writes the ledger as typed column files for ledger_query
+ * @argc: argument count
+ * @argv: optional output directory, COLUMNS_DIR by default
+ * Return: 0 on success else 1
+ */
+int main(int argc, char **argv)
+{
+    const char *dir = argc > 1 ? argv[1] : COLUMNS_DIR;
+
+    if (argc > 2)
+    {
+        fprintf(stderr, "Usage: %s [directory]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    long rows = export_columns(dir);
+    if (rows < 0)
+        exit(EXIT_FAILURE);
+    printf("Exported %ld transactions to %s\n", rows, dir);
+    return 0;
+}
@@ -0,0 +1,38 @@
+#include "blockchain.h"
+
+/**
+ * main - streams the ledger to standard output for other tools
+ * @argc: argument count
+ * @argv: --format=text|json|csv, --from=HEIGHT and --to=HEIGHT
+ * Return: 0 on success else 1
+ */
+int main(int argc, char **argv)
+{
+    ExportFormat format = EXPORT_TEXT;
+    long from = 0, to = -1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--format=text") == 0)
+            format = EXPORT_TEXT;
+        else if (strcmp(argv[i], "--format=json") == 0)
+            format = EXPORT_JSON;
+        else if (strcmp(argv[i], "--format=csv") == 0)
+            format = EXPORT_CSV;
+        else if (strncmp(argv[i], "--from=", 7) == 0)
+            from = atol(argv[i] + 7);
+        else if (strncmp(argv[i], "--to=", 5) == 0)
+            to = atol(argv[i] + 5);
+        else
+        {
+            fprintf(stderr, "Usage: %s [--format=text|json|csv] [--from=HEIGHT] [--to=HEIGHT]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (from < 0)
+        from = 0;
+
+    if (export_chain(stdout, format, from, to) < 0)
+        exit(EXIT_FAILURE);
+    return 0;
+}
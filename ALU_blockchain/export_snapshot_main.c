@@ -0,0 +1,26 @@
+#include "blockchain.h"
+
+/**
+ * main - exports ledger state at the current tip to a snapshot file
+ * @argc: argument count
+ * @argv: optional snapshot file name
+ * Return: 0 on success else 1
+ */
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : SNAPSHOT_FILE;
+    unsigned char content_hash[SHA256_DIGEST_LENGTH];
+    char hex[SHA256_DIGEST_LENGTH * 2 + 1];
+
+    int height = export_snapshot(path, content_hash);
+    if (height < 0)
+    {
+        fprintf(stderr, "Could not export snapshot\n");
+        exit(EXIT_FAILURE);
+    }
+
+    hash_to_hex(content_hash, hex);
+    printf("Snapshot of height %d written to %s\n", height, path);
+    printf("Content hash: %s\n", hex);
+    return 0;
+}
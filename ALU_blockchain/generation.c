@@ -0,0 +1,272 @@
+#include "blockchain.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+
+static const char *generation_files[GENERATION_FILES] = {BLOCKCHAIN_DATABASE, USERS_DATABASE, ALU_ACCOUNT_FILE};
+static char pinned_dir[64];
+static uint64_t pinned_lengths[GENERATION_FILES];
+static int pinned_fd = -1;
+
+/**
+ * read_manifest - reads the generation readers currently start from
+ * @generation: set to the generation, 0 if none was published yet
+ * @lengths: filled with the length of each file of the generation, may be
+ * NULL
+ * Return: 1 on success else 0 if there is no valid manifest
+ */
+static int read_manifest(uint64_t *generation, uint64_t *lengths)
+{
+    FILE *file = fopen(MANIFEST_DATABASE, "rb");
+    uint32_t magic = 0;
+    int result;
+
+    *generation = 0;
+    if (!file)
+        return 0;
+    result = fread(&magic, sizeof(magic), 1, file) == 1 && magic == GENERATION_MAGIC &&
+             fread(generation, sizeof(*generation), 1, file) == 1 &&
+             (!lengths || fread(lengths, sizeof(*lengths), GENERATION_FILES, file) == GENERATION_FILES);
+    fclose(file);
+    return result;
+}
+
+/**
+ * clear_generation - removes a generation directory and its links
+ * @dir: generation directory
+ * Return: 1 on success else 0 if it could not be removed
+ */
+static int clear_generation(const char *dir)
+{
+    char path[JOURNAL_PATH_MAX];
+
+    for (size_t i = 0; i < GENERATION_FILES; i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", dir, generation_files[i]);
+        if (unlink(path) < 0 && errno != ENOENT)
+            return 0;
+    }
+    return rmdir(dir) == 0 || errno == ENOENT;
+}
+
+/**
+ * prune_generations - removes the generations before the current one that
+ * no reader pins, pinned ones are left for a later commit
+ * @current: generation just published
+ */
+static void prune_generations(uint64_t current)
+{
+    char dir[64], *end;
+    struct dirent *entry;
+    uint64_t generation;
+    DIR *generations = opendir(GENERATION_DIR);
+    int fd;
+
+    while (generations && (entry = readdir(generations)))
+    {
+        generation = strtoull(entry->d_name, &end, 10);
+        if (entry->d_name[0] < '0' || entry->d_name[0] > '9' || *end != '\0' || generation >= current)
+            continue;
+        snprintf(dir, sizeof(dir), "%s/%llu", GENERATION_DIR, (unsigned long long)generation);
+        fd = open(dir, O_RDONLY | O_DIRECTORY);
+        if (fd < 0)
+            continue;
+        if (flock(fd, LOCK_EX | LOCK_NB) == 0 && !clear_generation(dir))
+            fprintf(stderr, "Could not remove generation %llu\n", (unsigned long long)generation);
+        close(fd);
+    }
+    if (generations)
+        closedir(generations);
+}
+
+/**
+ * generation_file - tells whether readers see a file through generations
+ * @path: data file
+ * Return: 1 if it is part of every generation else 0
+ */
+int generation_file(const char *path)
+{
+    for (size_t i = 0; i < GENERATION_FILES; i++)
+    {
+        if (strcmp(path, generation_files[i]) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * generation_prefix - tells whether readers pin a prefix of a file of the
+ * generations, so appends to it can go in place
+ * @path: data file
+ * Return: 1 if the file only ever grows between rewrites else 0
+ */
+int generation_prefix(const char *path)
+{
+    return strcmp(path, BLOCKCHAIN_DATABASE) == 0;
+}
+
+/**
+ * generation_copy - copies a file of the generations before it is written,
+ * the writes go to the copy, which then replaces the file: the published
+ * generations keep linking the old contents
+ * @path: data file, a missing one gives an empty copy
+ * @copy: set to the path of the copy
+ * @size: size of @copy
+ * Return: 1 on success else 0
+ */
+int generation_copy(const char *path, char *copy, size_t size)
+{
+    struct stat st;
+    ssize_t sent = 1;
+    off_t offset = 0;
+    int in, out;
+
+    if (snprintf(copy, size, "%s%s", path, GENERATION_COPY_SUFFIX) >= (int)size)
+        return 0;
+    out = open(copy, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    in = open(path, O_RDONLY);
+    if (out < 0 || (in < 0 && errno != ENOENT) || (in >= 0 && fstat(in, &st) < 0))
+        sent = -1;
+    /* Filesystems sharing extents clone the file whatever its size */
+    else if (in >= 0 && ioctl(out, FICLONE, in) == 0)
+        offset = st.st_size;
+    while (in >= 0 && sent > 0 && offset < st.st_size)
+        sent = sendfile(out, in, &offset, (size_t)(st.st_size - offset));
+    if (in >= 0)
+        close(in);
+    if ((out >= 0 && close(out) != 0) || sent < 0)
+    {
+        perror("Failed to copy data file");
+        unlink(copy);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * generation_publish - links the current data files into a new generation
+ * and swaps the manifest to it, then prunes the older ones no reader pins.
+ * The manifest holds the length of every file, a file appended to in
+ * place is read up to it
+ * Called by the journal with its lock held, so one process publishes at a
+ * time
+ * Return: 1 on success else 0, readers then keep the previous generation
+ */
+int generation_publish(void)
+{
+    char fresh[64], dir[64], path[JOURNAL_PATH_MAX];
+    uint64_t generation, lengths[GENERATION_FILES] = {0};
+    struct stat st;
+    FILE *file;
+    uint32_t magic = GENERATION_MAGIC;
+    int result;
+
+    read_manifest(&generation, NULL);
+    generation++;
+    snprintf(fresh, sizeof(fresh), "%s/new", GENERATION_DIR);
+    snprintf(dir, sizeof(dir), "%s/%llu", GENERATION_DIR, (unsigned long long)generation);
+    result = (mkdir(GENERATION_DIR, 0755) == 0 || errno == EEXIST) && clear_generation(fresh) &&
+             clear_generation(dir) && mkdir(fresh, 0755) == 0;
+    for (size_t i = 0; result && i < GENERATION_FILES; i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", fresh, generation_files[i]);
+        result = link(generation_files[i], path) == 0 || errno == ENOENT;
+        if (result && stat(path, &st) == 0)
+            lengths[i] = (uint64_t)st.st_size;
+    }
+    result = result && rename(fresh, dir) == 0;
+
+    /* Readers pick the generation up once the manifest is swapped */
+    snprintf(path, sizeof(path), "%s%s", MANIFEST_DATABASE, GENERATION_COPY_SUFFIX);
+    file = result ? fopen(path, "wb") : NULL;
+    result = file && fwrite(&magic, sizeof(magic), 1, file) == 1 &&
+             fwrite(&generation, sizeof(generation), 1, file) == 1 &&
+             fwrite(lengths, sizeof(*lengths), GENERATION_FILES, file) == GENERATION_FILES;
+    if (file && fclose(file) != 0)
+        result = 0;
+    result = result && rename(path, MANIFEST_DATABASE) == 0;
+    if (!result)
+    {
+        perror("Failed to publish generation");
+        return 0;
+    }
+    prune_generations(generation);
+    return 1;
+}
+
+/**
+ * generation_pin - makes the process read the chain and the accounts from
+ * the current generation for as long as it runs, whatever writers commit
+ * meanwhile; a pinned process only reads
+ * Return: 1 on success else 0 if no generation is published, the live
+ * files are then read
+ */
+int generation_pin(void)
+{
+    uint64_t generation;
+    struct stat st;
+    int fd;
+
+    if (pinned_fd >= 0)
+        return 1;
+    for (int tries = 0; tries < GENERATION_PIN_TRIES && read_manifest(&generation, pinned_lengths); tries++)
+    {
+        snprintf(pinned_dir, sizeof(pinned_dir), "%s/%llu", GENERATION_DIR, (unsigned long long)generation);
+        fd = open(pinned_dir, O_RDONLY | O_DIRECTORY);
+        if (fd < 0)
+            continue;
+        /* A generation pruned before the lock was taken is gone, read the manifest again */
+        if (flock(fd, LOCK_SH) == 0 && fstat(fd, &st) == 0 && st.st_nlink > 0)
+        {
+            pinned_fd = fd;
+            return 1;
+        }
+        close(fd);
+    }
+    return 0;
+}
+
+/**
+ * generation_pinned - tells whether the process reads a pinned generation
+ * Return: 1 if generation_pin succeeded else 0
+ */
+int generation_pinned(void)
+{
+    return pinned_fd >= 0;
+}
+
+/**
+ * generation_path - path a data file is read from
+ * @path: data file
+ * Return: its link in the pinned generation, valid until the next call,
+ * else @path itself
+ */
+const char *generation_path(const char *path)
+{
+    static char pinned[JOURNAL_PATH_MAX];
+
+    if (pinned_fd < 0 || !generation_file(path))
+        return path;
+    snprintf(pinned, sizeof(pinned), "%s/%s", pinned_dir, path);
+    return pinned;
+}
+
+/**
+ * generation_length - length of a file to read from the pinned generation
+ * @path: data file
+ * Return: bytes of it the generation holds, or -1 to read it whole
+ */
+long generation_length(const char *path)
+{
+    for (int i = 0; pinned_fd >= 0 && i < GENERATION_FILES; i++)
+    {
+        if (strcmp(path, generation_files[i]) == 0 && generation_prefix(path))
+            return (long)pinned_lengths[i];
+    }
+    return -1;
+}
@@ -0,0 +1,292 @@
+#include "blockchain.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+
+/* Table slots cannot be emptied, so an address whose postings were all
+ * rewound keeps a head inside the header, which reads as no history */
+#define HISTORY_NO_POSTING 1
+
+/**
+ * add_posting - appends one history entry for an address and points the
+ * address head at it
+ * @table: loaded address head table
+ * @file: memory stream collecting the new postings
+ * @offset: file offset the stream starts at
+ * @address: address the entry belongs to
+ * @posting: entry to append, prev is filled in
+ * Return: 1 on success else 0
+ */
+static int add_posting(disk_table_t *table, FILE *file, long offset,
+                       const unsigned char *address, history_posting_t *posting)
+{
+    uint64_t head = 0;
+
+    if (!disk_table_get(table, address, &head) || head == HISTORY_NO_POSTING)
+        head = 0;
+    posting->prev = head;
+    uint64_t position = offset + ftell(file);
+    return fwrite(posting, sizeof(*posting), 1, file) == 1 &&
+           disk_table_put(table, address, position);
+}
+
+/**
+ * history_update - indexes the blocks appended since the last update
+ * Postings are appended to HISTORY_DATABASE, each pointing back at the
+ * previous posting for its address, and HISTORY_INDEX maps every address to
+ * its newest posting. The index is rebuilt when it no longer matches the
+ * chain; pruned blocks have no bodies and are skipped
+ * @blockchain: pointer to blockchain to index
+ * Return: 1 on success else 0
+ */
+int history_update(Blockchain *blockchain)
+{
+    history_header_t header;
+    disk_table_t table;
+    struct stat st;
+    Block *current = blockchain->head;
+    int reset = 1;
+
+    FILE *file = fopen(HISTORY_DATABASE, "rb");
+    if (file && fread(&header, sizeof(header), 1, file) == 1 && header.magic == HISTORY_MAGIC &&
+        header.indexed <= (uint32_t)blockchain->length && stat(HISTORY_DATABASE, &st) == 0)
+    {
+        for (uint32_t i = 1; current && i < header.indexed; i++)
+            current = current->next;
+        reset = header.indexed > 0 &&
+                (!current || memcmp(current->current_hash, header.tip_hash, SHA256_DIGEST_LENGTH) != 0);
+        if (header.indexed > 0 && current)
+            current = current->next;
+    }
+    if (file)
+        fclose(file);
+    if (reset)
+    {
+        current = blockchain->head;
+        header.magic = HISTORY_MAGIC;
+        header.indexed = 0;
+        st.st_size = 0;
+    }
+    if (!current && !reset)
+        return 1;
+    if (!disk_table_load(&table, HISTORY_INDEX, ADDRESS_SIZE))
+        return 0;
+    if (reset)
+        disk_table_clear(&table);
+
+    char *data = NULL;
+    size_t size = 0;
+    file = open_memstream(&data, &size);
+    int result = file != NULL;
+    /* A rebuild writes the whole file in one go, its header comes first */
+    if (result && reset)
+        result = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (; result && current; current = current->next)
+    {
+        Transaction *trans = current->pruned ? NULL : current->transactions->head;
+        for (uint32_t position = 0; result && trans; trans = trans->next, position++)
+        {
+            history_posting_t posting;
+            memset(&posting, 0, sizeof(posting));
+            posting.height = current->index;
+            posting.position = position;
+            posting.amount = trans->amount;
+            posting.direction = HISTORY_SENT;
+            memcpy(posting.counterparty, trans->receiver, ADDRESS_SIZE);
+            result = add_posting(&table, file, st.st_size, trans->sender, &posting);
+            if (!result || memcmp(trans->sender, trans->receiver, ADDRESS_SIZE) == 0)
+                continue;
+            posting.direction = HISTORY_RECEIVED;
+            memcpy(posting.counterparty, trans->sender, ADDRESS_SIZE);
+            result = add_posting(&table, file, st.st_size, trans->receiver, &posting);
+        }
+        header.indexed = current->index + 1;
+        memcpy(header.tip_hash, current->current_hash, SHA256_DIGEST_LENGTH);
+    }
+    if (file && fclose(file) != 0)
+        result = 0;
+    if (result && reset)
+        memcpy(data, &header, sizeof(header));
+
+    result = result && (size == 0 || journal_write(HISTORY_DATABASE, st.st_size, 1, data, size)) &&
+             disk_table_save(&table) &&
+             (reset || journal_write(HISTORY_DATABASE, 0, 0, &header, sizeof(header)));
+    free(data);
+    disk_table_free(&table);
+    if (!result)
+        fprintf(stderr, "Failed to update transaction history\n");
+    return result;
+}
+
+/**
+ * history_rewind - drops the postings of disconnected blocks, moving the
+ * head of every address they touched back to its previous posting
+ * Postings are appended in height order, so the dropped ones are read from
+ * the end of the file, and each names its transaction by block and
+ * position. Writes are staged in the open journal group
+ * @removed: disconnected blocks linked through next, in height order
+ * @last: block the chain now ends at
+ * Return: 1 on success else 0
+ */
+int history_rewind(Block *removed, Block *last)
+{
+    history_header_t header;
+    history_posting_t posting;
+    disk_table_t table;
+    Transaction *trans;
+    Block *block;
+    struct stat st;
+    long cut;
+    int result = 1, fd = open(HISTORY_DATABASE, O_RDONLY);
+
+    /* Without postings past the cut there is nothing to do, and an index
+     * that does not match is rebuilt by the next update anyway */
+    if (fd < 0)
+        return 1;
+    if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) || header.magic != HISTORY_MAGIC ||
+        header.indexed <= last->index + 1 || fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return 1;
+    }
+    if (!disk_table_load(&table, HISTORY_INDEX, ADDRESS_SIZE))
+    {
+        close(fd);
+        return 0;
+    }
+
+    for (cut = st.st_size; result && cut - (long)sizeof(posting) >= (long)sizeof(header); cut -= sizeof(posting))
+    {
+        result = pread(fd, &posting, sizeof(posting), cut - sizeof(posting)) == (ssize_t)sizeof(posting);
+        if (!result || posting.height <= last->index)
+            break;
+        for (block = removed; block && block->index != posting.height; block = block->next)
+            ;
+        trans = block ? block->transactions->head : NULL;
+        for (uint32_t position = 0; trans && position < posting.position; position++)
+            trans = trans->next;
+        result = trans && disk_table_put(&table, posting.direction == HISTORY_SENT ? trans->sender : trans->receiver,
+                                         posting.prev ? posting.prev : HISTORY_NO_POSTING);
+    }
+    close(fd);
+
+    header.indexed = last->index + 1;
+    memcpy(header.tip_hash, last->current_hash, SHA256_DIGEST_LENGTH);
+    result = result && journal_write(HISTORY_DATABASE, cut, 1, "", 0) && disk_table_save(&table) &&
+             journal_write(HISTORY_DATABASE, 0, 0, &header, sizeof(header));
+    disk_table_free(&table);
+    if (!result)
+        fprintf(stderr, "Failed to rewind transaction history\n");
+    return result;
+}
+
+/**
+ * history_head - finds the newest history entry of an address
+ * @address: address to look up
+ * Return: offset of the newest posting, 0 if the address has no history,
+ * or -1 if there is no index
+ */
+long history_head(const unsigned char *address)
+{
+    uint64_t head;
+    int found = disk_table_lookup(HISTORY_INDEX, address, ADDRESS_SIZE, &head);
+
+    if (found < 0)
+        return -1;
+    return found && head != HISTORY_NO_POSTING ? (long)head : 0;
+}
+
+/**
+ * history_read - reads a page of history entries, newest first
+ * @cursor: offset of the first posting to read
+ * @postings: array to fill
+ * @max: size of array
+ * @next: where to store the cursor of the following page, 0 at the end
+ * Return: number of entries read, or -1 on failure
+ */
+int history_read(long cursor, history_posting_t *postings, int max, long *next)
+{
+    int fd = open(HISTORY_DATABASE, O_RDONLY), count = 0;
+
+    if (fd < 0)
+        return -1;
+    while (cursor >= (long)sizeof(history_header_t) && count < max)
+    {
+        if (pread(fd, &postings[count], sizeof(*postings), cursor) != (ssize_t)sizeof(*postings))
+        {
+            close(fd);
+            return -1;
+        }
+        cursor = (long)postings[count++].prev;
+    }
+    close(fd);
+    *next = cursor >= (long)sizeof(history_header_t) ? cursor : 0;
+    return count;
+}
+
+/**
+ * history_scan - finds the transfers of an address by reading the block
+ * file itself, for when there is no history index. Blocks whose address
+ * filter rules the address out are not decoded past their header
+ * @address: address to look for
+ * @postings: array to fill with the oldest matches
+ * @max: size of array
+ * @nb_blocks: where to store the number of blocks read
+ * @nb_skipped: where to store the number of blocks skipped by their filter
+ * Return: total number of matches, or -1 on failure
+ */
+int history_scan(const unsigned char *address, history_posting_t *postings, int max,
+                 int *nb_blocks, int *nb_skipped)
+{
+    uint32_t magic, version;
+    int difficulty, count = 0, skipped;
+    FILE *file = fopen(BLOCKCHAIN_DATABASE, "rb");
+
+    *nb_blocks = *nb_skipped = 0;
+    if (!file || fread(&magic, sizeof(magic), 1, file) != 1 ||
+        fread(&version, sizeof(version), 1, file) != 1 ||
+        fread(&difficulty, sizeof(difficulty), 1, file) != 1 ||
+        magic != BLOCKCHAIN_MAGIC || version != BLOCKCHAIN_VERSION)
+    {
+        fprintf(stderr, "Cannot scan blockchain file\n");
+        if (file)
+            fclose(file);
+        return -1;
+    }
+
+    buffer_t record;
+    codec_state_t state;
+    buffer_init(&record);
+    codec_state_init(&state);
+    while (read_record(file, &record) == RECORD_OK)
+    {
+        Block *block = decode_block_filtered(&record, &state, address, &skipped);
+        if (!block)
+            break;
+        (*nb_blocks)++;
+        *nb_skipped += skipped;
+
+        uint32_t position = 0;
+        for (Transaction *trans = block->transactions->head; trans; trans = trans->next, position++)
+        {
+            int sent = memcmp(trans->sender, address, ADDRESS_SIZE) == 0;
+            if (!sent && memcmp(trans->receiver, address, ADDRESS_SIZE) != 0)
+                continue;
+            if (count < max)
+            {
+                postings[count].prev = 0;
+                postings[count].height = block->index;
+                postings[count].position = position;
+                postings[count].amount = trans->amount;
+                postings[count].direction = sent ? HISTORY_SENT : HISTORY_RECEIVED;
+                memcpy(postings[count].counterparty, sent ? trans->receiver : trans->sender, ADDRESS_SIZE);
+            }
+            count++;
+        }
+        free_transactions(block->transactions);
+        free(block);
+    }
+    buffer_free(&record);
+    codec_state_free(&state);
+    fclose(file);
+    return count;
+}
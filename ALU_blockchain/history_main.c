@@ -0,0 +1,109 @@
+#include "blockchain.h"
+#include <errno.h>
+
+/**
+ * print_postings - prints history entries
+ * @postings: entries to print
+ * @count: number of entries
+ */
+static void print_postings(history_posting_t *postings, int count)
+{
+    char hex[ADDRESS_SIZE * 2 + 1];
+
+    hex[ADDRESS_SIZE * 2] = '\0';
+    for (int i = 0; i < count; i++)
+    {
+        bytes_to_hex(postings[i].counterparty, ADDRESS_SIZE, hex);
+        printf("Block %u, transaction %u: %s %d %s %s\n", postings[i].height, postings[i].position,
+               postings[i].direction == HISTORY_SENT ? "sent" : "received", postings[i].amount,
+               postings[i].direction == HISTORY_SENT ? "to" : "from", hex);
+    }
+}
+
+/**
+ * scan_history - lists the oldest transfers of an address straight from
+ * the block file when there is no index
+ * @address: address to look for
+ * Return: 1 on success else 0
+ */
+static int scan_history(const unsigned char *address)
+{
+    history_posting_t postings[HISTORY_PAGE_SIZE];
+    int nb_blocks, nb_skipped;
+
+    int count = history_scan(address, postings, HISTORY_PAGE_SIZE, &nb_blocks, &nb_skipped);
+    if (count < 0)
+        return 0;
+    print_postings(postings, count < HISTORY_PAGE_SIZE ? count : HISTORY_PAGE_SIZE);
+    if (count > HISTORY_PAGE_SIZE)
+        printf("%d more transfers, mine a block to build the history index\n", count - HISTORY_PAGE_SIZE);
+    printf("Scanned %d blocks, %d skipped by their address filter\n", nb_blocks, nb_skipped);
+    return 1;
+}
+
+/**
+ * main - pages through the transfers involving an address, newest first
+ * @argc: argument count
+ * @argv: address (hex) and optional cursor returned by a previous page
+ * Return: 0 on success else 1
+ */
+int main(int argc, char **argv)
+{
+    unsigned char address[ADDRESS_SIZE];
+    history_posting_t postings[HISTORY_PAGE_SIZE];
+    long cursor, next;
+    char *end;
+
+    if (argc < 2 || strlen(argv[1]) != ADDRESS_SIZE * 2)
+    {
+        fprintf(stderr, "Usage: %s <address> [cursor]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < ADDRESS_SIZE; i++)
+    {
+        if (sscanf(argv[1] + i * 2, "%2hhx", &address[i]) != 1)
+        {
+            fprintf(stderr, "Invalid hex address\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (argc > 2)
+    {
+        errno = 0;
+        cursor = strtol(argv[2], &end, 10);
+        if (end == argv[2] || *end != '\0' || errno == ERANGE || cursor < 0)
+        {
+            fprintf(stderr, "Invalid cursor: %s\n", argv[2]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    journal_recover();
+    if (argc <= 2)
+        cursor = history_head(address);
+    if (cursor < 0)
+    {
+        if (!scan_history(address))
+            exit(EXIT_FAILURE);
+        return 0;
+    }
+    if (cursor == 0)
+    {
+        printf("No transfers for this address\n");
+        return 0;
+    }
+
+    int count = history_read(cursor, postings, HISTORY_PAGE_SIZE, &next);
+    if (count < 0)
+    {
+        fprintf(stderr, "Could not read transaction history\n");
+        exit(EXIT_FAILURE);
+    }
+    print_postings(postings, count);
+    if (next)
+        printf("Next page: %s %s %ld\n", argv[0], argv[1], next);
+    else
+        printf("End of history\n");
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include "blockchain.h"
+
+/**
+ * main - bootstraps the local ledger from a snapshot file
+ * @argc: argument count
+ * @argv: snapshot file name and trusted content hash (hex), or
+ * SNAPSHOT_UNVERIFIED to import without one
+ * Return: 0 on success else 1
+ */
+int main(int argc, char **argv)
+{
+    unsigned char content_hash[SHA256_DIGEST_LENGTH], expected[SHA256_DIGEST_LENGTH];
+    char hex[SHA256_DIGEST_LENGTH * 2 + 1];
+
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s <snapshot file> <trusted content hash|%s>\n", argv[0], SNAPSHOT_UNVERIFIED);
+        exit(EXIT_FAILURE);
+    }
+    int verified = strcmp(argv[2], SNAPSHOT_UNVERIFIED) != 0;
+    if (verified && strlen(argv[2]) != SHA256_DIGEST_LENGTH * 2)
+    {
+        fprintf(stderr, "Invalid content hash length\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; verified && i < SHA256_DIGEST_LENGTH; i++)
+    {
+        if (sscanf(argv[2] + i * 2, "%2hhx", &expected[i]) != 1)
+        {
+            fprintf(stderr, "Invalid content hash\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (!verified)
+    {
+        fprintf(stderr, "WARNING: importing %s WITHOUT a trusted content hash\n", argv[1]);
+        fprintf(stderr, "WARNING: its balances are only as honest as whoever handed it to you\n");
+    }
+
+    int height = import_snapshot(argv[1], verified ? expected : NULL, content_hash);
+    if (height < 0)
+    {
+        fprintf(stderr, "Could not import snapshot\n");
+        exit(EXIT_FAILURE);
+    }
+
+    hash_to_hex(content_hash, hex);
+    printf("Imported %s snapshot of height %d, content hash: %s\n", verified ? "verified" : "UNVERIFIED",
+           height, hex);
+    printf("Only blocks after height %d will be validated\n", height);
+    return 0;
+}
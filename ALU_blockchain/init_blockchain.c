@@ -12,11 +12,12 @@ int main(void)
         fprintf(stderr, "Could not initialize blockchain\n");
         exit(EXIT_FAILURE);
     }
-    if (!serialize_blockchain(blockchain))
+    journal_begin();
+    save_checkpoint(blockchain);
+    if (!serialize_blockchain(blockchain) || !journal_commit())
     {
         fprintf(stderr, "Could not serialize created blockchain\n");
         fflush(stdout);
-        free_blockchain(blockchain);
         exit(EXIT_FAILURE);
     }
 
@@ -0,0 +1,829 @@
+#include "blockchain.h"
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+static journal_entry_t *staged_head;
+static journal_entry_t *staged_tail;
+static int group_open;
+static int recovered;
+static int held_fd = -1;
+static int held_depth;
+
+/**
+ * free_entries - frees a list of journal entries
+ * @entry: first entry in list
+ */
+static void free_entries(journal_entry_t *entry)
+{
+    while (entry)
+    {
+        journal_entry_t *next = entry->next;
+        free(entry->data);
+        free(entry);
+        entry = next;
+    }
+}
+
+/**
+ * new_entry - copies a write into a new journal entry
+ * @path: file the write targets
+ * @offset: position of the write in the file
+ * @truncate: 1 to cut the file right after the write
+ * @data: bytes to write
+ * @len: number of bytes
+ * Return: pointer to entry or NULL on failure
+ */
+static journal_entry_t *new_entry(const char *path, long offset, int truncate, const void *data, size_t len)
+{
+    journal_entry_t *entry = (journal_entry_t *)malloc(sizeof(journal_entry_t));
+    if (!entry || strlen(path) >= JOURNAL_PATH_MAX)
+    {
+        fprintf(stderr, "Could not stage journal write to %s\n", path);
+        free(entry);
+        return NULL;
+    }
+    entry->data = (unsigned char *)malloc(len ? len : 1);
+    if (!entry->data)
+    {
+        fprintf(stderr, "Failed to allocate memory for journal write\n");
+        free(entry);
+        return NULL;
+    }
+    strcpy(entry->path, path);
+    entry->offset = offset;
+    entry->truncate = truncate;
+    memcpy(entry->data, data, len);
+    entry->len = len;
+    entry->next = NULL;
+    return entry;
+}
+
+/**
+ * side_entry - writes the whole new contents of a file to a synced side
+ * file and stages its replacement, which keeps the group small whatever
+ * the size of the file
+ * @path: file the contents replace
+ * @data: new contents
+ * @len: number of bytes
+ * Return: pointer to entry or NULL on failure
+ */
+static journal_entry_t *side_entry(const char *path, const void *data, size_t len)
+{
+    static unsigned int count;
+    char side[JOURNAL_PATH_MAX * 2];
+    struct timespec now;
+    journal_entry_t *entry;
+    size_t done = 0;
+    ssize_t wrote;
+    int fd, result;
+
+    /* The name is never reused, a side file left by a crash cannot pass for a new one */
+    clock_gettime(CLOCK_REALTIME, &now);
+    snprintf(side, sizeof(side), "%s.%ld.%lld.%u%s", path, (long)getpid(),
+             (long long)now.tv_sec * 1000000000LL + now.tv_nsec, count++, JOURNAL_SIDE_SUFFIX);
+    fd = open(side, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    while (fd >= 0 && done < len && (wrote = write(fd, (const unsigned char *)data + done, len - done)) > 0)
+        done += (size_t)wrote;
+    result = fd >= 0 && done == len && fsync(fd) == 0;
+    if (fd >= 0 && close(fd) != 0)
+        result = 0;
+    entry = result ? new_entry(path, 0, JOURNAL_REPLACE, side, strlen(side)) : NULL;
+    if (!entry)
+    {
+        perror("Failed to write side file");
+        unlink(side);
+    }
+    return entry;
+}
+
+/**
+ * side_path - reads the side file name of a replacing entry
+ * @entry: entry with truncate set to JOURNAL_REPLACE
+ * @side: buffer to store the name
+ * @size: size of @side
+ * Return: @side
+ */
+static char *side_path(journal_entry_t *entry, char *side, size_t size)
+{
+    size_t len = entry->len < size ? entry->len : size - 1;
+
+    memcpy(side, entry->data, len);
+    side[len] = '\0';
+    return side;
+}
+
+/**
+ * apply_side - moves the side file of a replacing entry into place
+ * @path: file to replace, the target of the entry or a copy of it
+ * @entry: entry with truncate set to JOURNAL_REPLACE
+ * Return: 1 on success else 0
+ */
+static int apply_side(const char *path, journal_entry_t *entry)
+{
+    char side[JOURNAL_PATH_MAX * 2];
+
+    if (rename(side_path(entry, side, sizeof(side)), path) != 0)
+    {
+        perror("Failed to move side file into place");
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * sync_directory - makes the names in the data directory durable
+ * Return: 1 on success else 0
+ */
+static int sync_directory(void)
+{
+    int fd = open(".", O_RDONLY | O_DIRECTORY), result;
+
+    result = fd >= 0 && fsync(fd) == 0;
+    if (fd >= 0)
+        close(fd);
+    return result;
+}
+
+/**
+ * lock_journal - opens the journal and takes its exclusive lock, so only one
+ * process commits or recovers at a time
+ * Return: file descriptor or -1 on failure
+ */
+static int lock_journal(void)
+{
+    /* A descriptor shares the lock of the one it duplicates */
+    if (held_fd >= 0)
+        return dup(held_fd);
+    int fd = open(JOURNAL_DATABASE, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0)
+    {
+        perror("Failed to open journal");
+        return -1;
+    }
+    if (flock(fd, LOCK_EX) != 0)
+    {
+        perror("Failed to lock journal");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * read_boot_id - reads the kernel boot ID
+ * @boot_id: JOURNAL_BOOT_ID_SIZE bytes to fill, zeroed when unknown
+ * Return: 1 on success else 0
+ */
+static int read_boot_id(char *boot_id)
+{
+    FILE *file = fopen(JOURNAL_BOOT_ID, "r");
+    int result = file && fgets(boot_id, JOURNAL_BOOT_ID_SIZE, file) != NULL;
+
+    if (file)
+        fclose(file);
+    if (!result)
+        memset(boot_id, 0, JOURNAL_BOOT_ID_SIZE);
+    return result;
+}
+
+/**
+ * applied_end - tells where the groups not applied yet start
+ * Applied writes that were never synced survive a crashed process but not
+ * a reboot, so the mark only counts during the boot that wrote it
+ * @fd: locked journal file descriptor
+ * Return: journal offset past the last applied group, 0 to replay them all
+ */
+static long applied_end(int fd)
+{
+    journal_applied_t applied;
+    char boot_id[JOURNAL_BOOT_ID_SIZE];
+    FILE *file = fopen(JOURNAL_APPLIED, "rb");
+    int result = file && fread(&applied, sizeof(applied), 1, file) == 1 && read_boot_id(boot_id) &&
+                 memcmp(applied.boot_id, boot_id, JOURNAL_BOOT_ID_SIZE) == 0 &&
+                 applied.end <= (uint64_t)lseek(fd, 0, SEEK_END);
+
+    if (file)
+        fclose(file);
+    return result ? (long)applied.end : 0;
+}
+
+/**
+ * mark_applied - records that the groups up to an offset are applied
+ * The mark is not synced, losing it only replays more on recovery
+ * @end: journal offset past the last applied group
+ */
+static void mark_applied(long end)
+{
+    journal_applied_t applied;
+    int fd = open(JOURNAL_APPLIED, O_WRONLY | O_CREAT, 0644);
+
+    memset(&applied, 0, sizeof(applied));
+    read_boot_id(applied.boot_id);
+    applied.end = (uint64_t)end;
+    if (fd < 0 || pwrite(fd, &applied, sizeof(applied), 0) != (ssize_t)sizeof(applied))
+        fprintf(stderr, "Failed to mark the journal applied\n");
+    if (fd >= 0)
+        close(fd);
+}
+
+/**
+ * apply_entry - performs a journaled write without syncing it
+ * @path: file to write, the target of the write or a copy of it
+ * @entry: write to apply
+ * Return: 1 on success else 0
+ */
+static int apply_entry(const char *path, journal_entry_t *entry)
+{
+    int fd = open(path, O_WRONLY | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        perror("Failed to open journaled file");
+        return 0;
+    }
+    int result = pwrite(fd, entry->data, entry->len, entry->offset) == (ssize_t)entry->len &&
+                 (!entry->truncate || ftruncate(fd, entry->offset + (off_t)entry->len) == 0);
+    if (close(fd) != 0 || !result)
+    {
+        fprintf(stderr, "Failed to apply journaled write to %s\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * appends_only - tells whether the writes of a group to a file only add
+ * bytes past its current end
+ * @entries: writes of the group
+ * @path: file
+ * Return: 1 if every write lands past the end of the file else 0
+ */
+static int appends_only(journal_entry_t *entries, const char *path)
+{
+    struct stat st;
+    off_t size = stat(path, &st) == 0 ? st.st_size : 0;
+
+    for (journal_entry_t *entry = entries; entry; entry = entry->next)
+    {
+        if (strcmp(entry->path, path) == 0 && (entry->truncate == JOURNAL_REPLACE || entry->offset < size))
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * apply_file - performs the writes of a group on a file readers see
+ * through generations
+ * Appends to a file readers pin a prefix of go in place. Any other writes
+ * go to a copy, synced and renamed over the file, so the published
+ * generations keep linking the old contents
+ * @entries: writes of the group, the ones to @path are applied
+ * @path: file
+ * Return: 1 on success else 0
+ */
+static int apply_file(journal_entry_t *entries, const char *path)
+{
+    char copy[JOURNAL_PATH_MAX + sizeof(GENERATION_COPY_SUFFIX)];
+    journal_entry_t *entry = entries;
+    int result = 1, fd;
+
+    if (generation_prefix(path) && appends_only(entries, path))
+    {
+        for (; result && entry; entry = entry->next)
+            result = strcmp(entry->path, path) != 0 || apply_entry(path, entry);
+        return result;
+    }
+    while (strcmp(entry->path, path) != 0)
+        entry = entry->next;
+    /* A side file becomes the copy, there is nothing to copy first */
+    snprintf(copy, sizeof(copy), "%s%s", path, GENERATION_COPY_SUFFIX);
+    result = entry->truncate == JOURNAL_REPLACE || generation_copy(path, copy, sizeof(copy));
+    for (; result && entry; entry = entry->next)
+    {
+        if (strcmp(entry->path, path) == 0)
+            result = entry->truncate == JOURNAL_REPLACE ? apply_side(copy, entry) : apply_entry(copy, entry);
+    }
+    fd = result ? open(copy, O_RDONLY) : -1;
+    result = fd >= 0 && fsync(fd) == 0;
+    if (fd >= 0)
+        close(fd);
+    if (!result || rename(copy, path) != 0)
+    {
+        perror("Failed to replace journaled file");
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * apply_group - performs the writes of a group on their files, without
+ * syncing them, then publishes a new generation if readers see any of
+ * them through generations
+ * @entries: writes to apply, in order
+ * Return: 1 on success else 0
+ */
+static int apply_group(journal_entry_t *entries)
+{
+    journal_entry_t *entry, *seen;
+    int published = 0, result = 1;
+
+    for (entry = entries; result && entry; entry = entry->next)
+    {
+        if (!generation_file(entry->path))
+        {
+            result = entry->truncate == JOURNAL_REPLACE ? apply_side(entry->path, entry)
+                                                        : apply_entry(entry->path, entry);
+            continue;
+        }
+        /* All the writes to a file are applied with its first one */
+        for (seen = entries; seen != entry && strcmp(seen->path, entry->path) != 0; seen = seen->next)
+            ;
+        if (seen == entry)
+            result = apply_file(entries, entry->path);
+        published = 1;
+    }
+    /* The files are already written, readers only miss the newest state */
+    if (result && published)
+        generation_publish();
+    return result;
+}
+
+/**
+ * read_group - parses the entries of one journal group
+ * @group: group record payload
+ * Return: list of entries in write order, or NULL if malformed or empty
+ */
+static journal_entry_t *read_group(buffer_t *group)
+{
+    journal_entry_t *head = NULL, *tail = NULL;
+    uint32_t magic;
+    uint64_t nb_entries, path_len, offset, truncate, len;
+    char path[JOURNAL_PATH_MAX];
+
+    if (!buffer_get(group, &magic, sizeof(magic)) || magic != JOURNAL_MAGIC ||
+        !buffer_get_varint(group, &nb_entries))
+        return NULL;
+    for (uint64_t i = 0; i < nb_entries; i++)
+    {
+        journal_entry_t *entry = NULL;
+        if (buffer_get_varint(group, &path_len) && path_len < JOURNAL_PATH_MAX &&
+            buffer_get(group, path, path_len) &&
+            buffer_get_varint(group, &offset) &&
+            buffer_get_varint(group, &truncate) &&
+            buffer_get_varint(group, &len) && len <= group->len - group->pos)
+        {
+            path[path_len] = '\0';
+            entry = new_entry(path, (long)offset, (int)truncate, group->data + group->pos, len);
+            group->pos += len;
+        }
+        if (!entry)
+        {
+            free_entries(head);
+            return NULL;
+        }
+        if (!head)
+            head = entry;
+        else
+            tail->next = entry;
+        tail = entry;
+    }
+    return head;
+}
+
+/**
+ * read_journal - loads the complete groups of the journal from an offset
+ * A torn trailing group was never applied, so it is dropped
+ * @fd: journal file descriptor
+ * @from: offset of the first group to load, a group boundary
+ * Return: list of entries in commit order, NULL if empty
+ */
+static journal_entry_t *read_journal(int fd, long from)
+{
+    journal_entry_t *head = NULL, *tail = NULL, *entries;
+    FILE *file = fdopen(dup(fd), "rb");
+    buffer_t group;
+    long good_offset = from;
+    int status;
+
+    if (!file)
+        return NULL;
+    fseek(file, from, SEEK_SET);
+    buffer_init(&group);
+    while ((status = read_record(file, &group)) == RECORD_OK)
+    {
+        entries = read_group(&group);
+        if (!entries)
+        {
+            status = RECORD_CORRUPT;
+            break;
+        }
+        if (!head)
+            head = entries;
+        else
+            tail->next = entries;
+        for (tail = entries; tail->next; tail = tail->next)
+            ;
+        good_offset = ftell(file);
+    }
+    buffer_free(&group);
+    fclose(file);
+
+    if (status == RECORD_CORRUPT)
+        truncate_torn_tail(JOURNAL_DATABASE, good_offset);
+    return head;
+}
+
+/**
+ * read_file - reads a whole file into a buffer
+ * @path: file to read
+ * @buffer: buffer receiving the contents, empty if the file is missing
+ * Return: 1 on success else 0
+ */
+static int read_file(const char *path, buffer_t *buffer)
+{
+    unsigned char chunk[65536];
+    size_t got;
+    FILE *file = fopen(path, "rb");
+
+    buffer->len = 0;
+    if (!file)
+        return 1;
+    while ((got = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        if (!buffer_put(buffer, chunk, got))
+        {
+            fclose(file);
+            return 0;
+        }
+    }
+    fclose(file);
+    return 1;
+}
+
+/**
+ * recover_file - replays every journaled write of one file on top of its
+ * current contents and rewrites it if the result differs
+ * Writes are idempotent, so replaying already applied ones is harmless.
+ * Only the writes after the last replacement of the file are replayed, on
+ * top of its side file while that was not moved into place yet
+ * @path: file to recover
+ * @entries: all journal entries
+ * Return: 1 on success else 0
+ */
+static int recover_file(const char *path, journal_entry_t *entries)
+{
+    char side[JOURNAL_PATH_MAX * 2];
+    journal_entry_t *start = entries, *replaced = NULL;
+    buffer_t current, expected;
+    int result = 1;
+
+    for (journal_entry_t *entry = entries; entry; entry = entry->next)
+    {
+        if (strcmp(entry->path, path) != 0 || entry->truncate != JOURNAL_REPLACE)
+            continue;
+        /* A later replacement supersedes a side file that is still around */
+        if (replaced)
+            unlink(side_path(replaced, side, sizeof(side)));
+        replaced = entry;
+        start = entry->next;
+    }
+    if (replaced)
+        side_path(replaced, side, sizeof(side));
+
+    buffer_init(&current);
+    buffer_init(&expected);
+    if (!read_file(path, &current))
+        result = 0;
+    else if (replaced && access(side, F_OK) == 0)
+        result = read_file(side, &expected);
+    else
+        result = buffer_put(&expected, current.data, current.len);
+
+    for (journal_entry_t *entry = start; result && entry; entry = entry->next)
+    {
+        size_t end = (size_t)entry->offset + entry->len;
+        if (strcmp(entry->path, path) != 0)
+            continue;
+        if (end > expected.len)
+        {
+            result = buffer_reserve(&expected, end - expected.len);
+            if (!result)
+                break;
+            memset(expected.data + expected.len, 0, end - expected.len);
+            expected.len = end;
+        }
+        memcpy(expected.data + entry->offset, entry->data, entry->len);
+        if (entry->truncate)
+            expected.len = end;
+    }
+
+    if (result && (current.len != expected.len ||
+                   (current.len && memcmp(current.data, expected.data, current.len) != 0)))
+    {
+        journal_entry_t rewrite;
+        strcpy(rewrite.path, path);
+        rewrite.offset = 0;
+        rewrite.truncate = 1;
+        rewrite.data = expected.data;
+        rewrite.len = expected.len;
+        rewrite.next = NULL;
+        fprintf(stderr, "Recovering %s from journal\n", path);
+        result = apply_group(&rewrite);
+    }
+    if (result && replaced)
+        unlink(side);
+    buffer_free(&current);
+    buffer_free(&expected);
+    return result;
+}
+
+/**
+ * checkpoint_journal - makes every journaled file durable, then empties the
+ * journal so it does not grow without bound
+ * @fd: locked journal file descriptor
+ * @entries: all journal entries
+ * Return: 1 on success else 0
+ */
+static int checkpoint_journal(int fd, journal_entry_t *entries)
+{
+    for (journal_entry_t *entry = entries; entry; entry = entry->next)
+    {
+        journal_entry_t *seen = entries;
+        while (seen != entry && strcmp(seen->path, entry->path) != 0)
+            seen = seen->next;
+        if (seen != entry)
+            continue;
+
+        int file_fd = open(entry->path, O_RDONLY);
+        if (file_fd < 0 || fsync(file_fd) != 0)
+        {
+            fprintf(stderr, "Failed to sync %s, keeping journal\n", entry->path);
+            if (file_fd >= 0)
+                close(file_fd);
+            return 0;
+        }
+        close(file_fd);
+    }
+    /* Copies and side files replaced their targets by rename, kept in the directory */
+    if (!sync_directory())
+    {
+        fprintf(stderr, "Failed to sync the data directory, keeping journal\n");
+        return 0;
+    }
+    /* Cleared first, a stale mark past the end would skip the next groups */
+    mark_applied(0);
+    return ftruncate(fd, 0) == 0 && fsync(fd) == 0;
+}
+
+/**
+ * journal_recover - brings the data files in line with the journal after a
+ * crash. Runs once per process, before the first file is read; a process
+ * reading a pinned generation leaves it to the writers. Only the groups
+ * past the applied mark are replayed, all of them after a reboot
+ * Return: 1 on success else 0
+ */
+int journal_recover(void)
+{
+    journal_entry_t *entries;
+    int fd, result = 1;
+    long end;
+
+    if (recovered || generation_pinned())
+        return 1;
+    recovered = 1;
+    if (access(JOURNAL_DATABASE, F_OK) != 0)
+        return 1;
+
+    fd = lock_journal();
+    if (fd < 0)
+        return 0;
+    entries = read_journal(fd, applied_end(fd));
+    for (journal_entry_t *entry = entries; entry && result; entry = entry->next)
+    {
+        journal_entry_t *seen = entries;
+        while (seen != entry && strcmp(seen->path, entry->path) != 0)
+            seen = seen->next;
+        if (seen == entry)
+            result = recover_file(entry->path, entries);
+    }
+    free_entries(entries);
+    end = lseek(fd, 0, SEEK_END);
+    if (result && end > JOURNAL_CHECKPOINT_SIZE)
+    {
+        entries = read_journal(fd, 0);
+        checkpoint_journal(fd, entries);
+        free_entries(entries);
+    }
+    else if (result && end > 0)
+        mark_applied(end);
+    close(fd);
+    return result;
+}
+
+/**
+ * journal_lock - holds the journal lock until journal_unlock, so a read of
+ * the data files and the group built from it commit before any other
+ * process writes. Calls nest
+ * Return: 1 on success else 0
+ */
+int journal_lock(void)
+{
+    if (held_depth == 0)
+    {
+        held_fd = lock_journal();
+        if (held_fd < 0)
+            return 0;
+    }
+    held_depth++;
+    return 1;
+}
+
+/**
+ * journal_unlock - releases the lock taken by the matching journal_lock
+ */
+void journal_unlock(void)
+{
+    if (held_depth > 0 && --held_depth == 0)
+    {
+        close(held_fd);
+        held_fd = -1;
+    }
+}
+
+/**
+ * journal_begin - opens a group of writes that commit together
+ * Return: 1 on success else 0
+ */
+int journal_begin(void)
+{
+    if (group_open)
+    {
+        fprintf(stderr, "Journal group already open\n");
+        return 0;
+    }
+    journal_recover();
+    group_open = 1;
+    return 1;
+}
+
+/**
+ * journal_active - tells whether a group is open
+ * Return: 1 if writes are currently being grouped, else 0
+ */
+int journal_active(void)
+{
+    return group_open;
+}
+
+/**
+ * close_group - frees the staged writes and closes the group
+ * @drop_sides: 1 to remove the side files of the group, which only a
+ * group that never reached the journal may do
+ */
+static void close_group(int drop_sides)
+{
+    char side[JOURNAL_PATH_MAX * 2];
+
+    for (journal_entry_t *entry = staged_head; drop_sides && entry; entry = entry->next)
+    {
+        if (entry->truncate == JOURNAL_REPLACE)
+            unlink(side_path(entry, side, sizeof(side)));
+    }
+    free_entries(staged_head);
+    staged_head = staged_tail = NULL;
+    group_open = 0;
+}
+
+/**
+ * journal_abort - drops the open group, nothing is written
+ */
+void journal_abort(void)
+{
+    close_group(1);
+}
+
+/**
+ * journal_write - stages a write in the open group. Without an open group
+ * the write is committed on its own. A write replacing a whole file past
+ * JOURNAL_INLINE_MAX goes to a synced side file renamed into place on
+ * commit, so groups stay below RECORD_SIZE_MAX
+ * @path: file the write targets
+ * @offset: position of the write in the file
+ * @truncate: 1 to cut the file right after the write
+ * @data: bytes to write
+ * @len: number of bytes
+ * Return: 1 on success else 0
+ */
+int journal_write(const char *path, long offset, int truncate, const void *data, size_t len)
+{
+    int own_group = !group_open;
+
+    if (own_group && !journal_begin())
+        return 0;
+    journal_entry_t *entry = offset == 0 && truncate == 1 && len > JOURNAL_INLINE_MAX
+                                 ? side_entry(path, data, len)
+                                 : new_entry(path, offset, truncate, data, len);
+    if (!entry)
+    {
+        if (own_group)
+            journal_abort();
+        return 0;
+    }
+    if (!staged_head)
+        staged_head = entry;
+    else
+        staged_tail->next = entry;
+    staged_tail = entry;
+
+    return own_group ? journal_commit() : 1;
+}
+
+/**
+ * journal_commit - appends the open group to the journal as one CRC32C
+ * framed record, syncs the journal once, then applies the writes to their
+ * files without syncing them and publishes the generation readers pin.
+ * The files are synced together when the journal is checkpointed
+ * Return: 1 on success else 0
+ */
+int journal_commit(void)
+{
+    buffer_t group;
+    uint32_t magic = JOURNAL_MAGIC;
+    uint64_t nb_entries = 0;
+    journal_entry_t *entry;
+    int fd, result, sides = 0, written = 0;
+
+    if (!group_open)
+    {
+        fprintf(stderr, "No journal group to commit\n");
+        return 0;
+    }
+    for (entry = staged_head; entry; entry = entry->next)
+        nb_entries++;
+    if (nb_entries == 0)
+    {
+        journal_abort();
+        return 1;
+    }
+
+    buffer_init(&group);
+    result = buffer_put(&group, &magic, sizeof(magic)) && buffer_put_varint(&group, nb_entries);
+    for (entry = staged_head; result && entry; entry = entry->next)
+    {
+        result = buffer_put_varint(&group, strlen(entry->path)) &&
+                 buffer_put(&group, entry->path, strlen(entry->path)) &&
+                 buffer_put_varint(&group, (uint64_t)entry->offset) &&
+                 buffer_put_varint(&group, (uint64_t)entry->truncate) &&
+                 buffer_put_varint(&group, entry->len) &&
+                 buffer_put(&group, entry->data, entry->len);
+        sides |= entry->truncate == JOURNAL_REPLACE;
+    }
+    if (result && group.len > RECORD_SIZE_MAX)
+    {
+        fprintf(stderr, "Journal group too large\n");
+        result = 0;
+    }
+    /* The group names its side files, their names have to survive a crash first */
+    if (result && sides && !sync_directory())
+    {
+        perror("Failed to sync side files");
+        result = 0;
+    }
+
+    fd = result ? lock_journal() : -1;
+    if (fd >= 0)
+    {
+        /* Only a journal applied up to this group may be marked applied past it */
+        long start = lseek(fd, 0, SEEK_END);
+        int applied = start == 0 || applied_end(fd) == start;
+        uint32_t len = (uint32_t)group.len;
+        uint32_t crc = crc32c(0, group.data, group.len);
+        result = write(fd, &len, sizeof(len)) == sizeof(len) &&
+                 write(fd, &crc, sizeof(crc)) == sizeof(crc) &&
+                 write(fd, group.data, group.len) == (ssize_t)group.len &&
+                 fdatasync(fd) == 0;
+        if (!result)
+            perror("Failed to commit journal group");
+        written = result;
+
+        /* The group is durable: a crash from here on is replayed on startup */
+        result = result && apply_group(staged_head);
+
+        if (result && lseek(fd, 0, SEEK_END) > JOURNAL_CHECKPOINT_SIZE)
+        {
+            journal_entry_t *entries = read_journal(fd, 0);
+            checkpoint_journal(fd, entries);
+            free_entries(entries);
+        }
+        else if (result && applied)
+            mark_applied(lseek(fd, 0, SEEK_END));
+        close(fd);
+    }
+    else
+        result = 0;
+
+    buffer_free(&group);
+    /* Once in the journal, recovery may still need the side files */
+    close_group(!written);
+    return result;
+}
@@ -0,0 +1,179 @@
+#include "blockchain.h"
+
+/**
+ * parse_time - parses epoch seconds, with an optional fraction
+ * @text: text to parse
+ * @timestamp: where to store the timestamp
+ * Return: 1 on success else 0
+ */
+static int parse_time(const char *text, int64_t *timestamp)
+{
+    char *end;
+    double seconds = strtod(text, &end);
+
+    if (end == text || *end != '\0')
+        return 0;
+    *timestamp = (int64_t)(seconds * TIMESTAMP_RESOLUTION);
+    return 1;
+}
+
+static const int64_t *sort_volume;
+
+/**
+ * compare_volume - orders address ids by decreasing volume
+ * @a: first id
+ * @b: second id
+ * Return: comparison result for qsort
+ */
+static int compare_volume(const void *a, const void *b)
+{
+    int64_t va = sort_volume[*(const uint32_t *)a], vb = sort_volume[*(const uint32_t *)b];
+
+    return (va < vb) - (va > vb);
+}
+
+/**
+ * query_top - prints the addresses that moved the most funds
+ * @columns: loaded columns
+ * @from: first timestamp
+ * @to: last timestamp
+ * @limit: number of addresses to print
+ * Return: 1 on success else 0
+ */
+static int query_top(const ledger_columns_t *columns, int64_t from, int64_t to, long limit)
+{
+    int64_t *sent = malloc(sizeof(int64_t) * (columns->nb_addresses + 1));
+    int64_t *received = malloc(sizeof(int64_t) * (columns->nb_addresses + 1));
+    uint32_t *ids = malloc(sizeof(uint32_t) * (columns->nb_addresses + 1));
+    char hex[ADDRESS_SIZE * 2 + 1];
+
+    if (!sent || !received || !ids)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        free(sent), free(received), free(ids);
+        return 0;
+    }
+    columns_by_address(columns, from, to, sent, received);
+    for (uint32_t id = 0; id < columns->nb_addresses; id++)
+    {
+        ids[id] = id;
+        received[id] += sent[id];
+    }
+    sort_volume = received;
+    qsort(ids, columns->nb_addresses, sizeof(uint32_t), compare_volume);
+    for (uint32_t i = 0; i < columns->nb_addresses && i < limit && received[ids[i]]; i++)
+    {
+        uint32_t id = ids[i];
+        bytes_to_hex(columns->addresses[id], ADDRESS_SIZE, hex);
+        printf("%s  sent %ld  received %ld\n", hex, (long)sent[id], (long)(received[id] - sent[id]));
+    }
+    free(sent), free(received), free(ids);
+    return 1;
+}
+
+/**
+ * query_buckets - prints the volume of each time bucket
+ * @columns: loaded columns
+ * @from: first timestamp, the earliest transaction if before it
+ * @to: last timestamp, the latest transaction if after it
+ * @width: bucket width, in timestamp units
+ * Return: 1 on success else 0
+ */
+static int query_buckets(const ledger_columns_t *columns, int64_t from, int64_t to, int64_t width)
+{
+    int64_t first = INT64_MAX, last = INT64_MIN;
+    char timestamp[32];
+
+    for (uint32_t c = 0; c < columns->nb_chunks; c++)
+    {
+        first = columns->chunks[c].min_time < first ? columns->chunks[c].min_time : first;
+        last = columns->chunks[c].max_time > last ? columns->chunks[c].max_time : last;
+    }
+    from = from > first ? from : first;
+    to = to < last ? to : last;
+    if (!columns->nb_chunks || from > to)
+        return 1;
+    /* Buckets start on multiples of the width so runs line up */
+    from -= from % width;
+
+    long nb_buckets = (long)((to - from) / width + 1);
+    int64_t *volume = malloc(sizeof(int64_t) * nb_buckets);
+    uint64_t *count = malloc(sizeof(uint64_t) * nb_buckets);
+    if (!volume || !count)
+    {
+        fprintf(stderr, "Too many buckets, use a wider bucket\n");
+        free(volume), free(count);
+        return 0;
+    }
+    columns_buckets(columns, from, width, nb_buckets, volume, count);
+    for (long i = 0; i < nb_buckets; i++)
+    {
+        if (!count[i])
+            continue;
+        format_timestamp(from + i * width, timestamp);
+        printf("%s  %lu transactions  volume %ld\n", timestamp, (unsigned long)count[i], (long)volume[i]);
+    }
+    free(volume), free(count);
+    return 1;
+}
+
+/**
+ * usage - prints how to call ledger_query and exits
+ * @name: program name
+ */
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [--dir=DIR] [--from=SECONDS] [--to=SECONDS] total | top [N] | buckets SECONDS\n", name);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * main - answers aggregate queries over a column export
+ * @argc: argument count
+ * @argv: options, then the query
+ * Return: 0 on success else 1
+ */
+int main(int argc, char **argv)
+{
+    const char *dir = COLUMNS_DIR;
+    int64_t from = INT64_MIN, to = INT64_MAX, width = 0;
+    ledger_columns_t columns;
+    struct timespec start, end;
+    long limit = 10;
+    int i = 1, result = 1;
+
+    for (; i < argc && strncmp(argv[i], "--", 2) == 0; i++)
+    {
+        if (strncmp(argv[i], "--dir=", 6) == 0)
+            dir = argv[i] + 6;
+        else if (strncmp(argv[i], "--from=", 7) != 0 && strncmp(argv[i], "--to=", 5) != 0)
+            usage(argv[0]);
+        else if (!parse_time(strchr(argv[i], '=') + 1, argv[i][2] == 'f' ? &from : &to))
+            usage(argv[0]);
+    }
+    if (i >= argc || (strcmp(argv[i], "total") == 0 && argc != i + 1) ||
+        (strcmp(argv[i], "top") == 0 && (argc > i + 2 || (argc == i + 2 && (limit = atol(argv[i + 1])) <= 0))) ||
+        (strcmp(argv[i], "buckets") == 0 && (argc != i + 2 || !parse_time(argv[i + 1], &width) || width <= 0)) ||
+        (strcmp(argv[i], "total") != 0 && strcmp(argv[i], "top") != 0 && strcmp(argv[i], "buckets") != 0))
+        usage(argv[0]);
+
+    if (!load_columns(dir, &columns))
+        exit(EXIT_FAILURE);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (strcmp(argv[i], "total") == 0)
+    {
+        uint64_t count;
+        int64_t volume = columns_volume(&columns, from, to, &count);
+        printf("%lu transactions  volume %ld\n", (unsigned long)count, (long)volume);
+    }
+    else if (strcmp(argv[i], "top") == 0)
+        result = query_top(&columns, from, to, limit);
+    else
+        result = query_buckets(&columns, from, to, width);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fprintf(stderr, "Scanned %lu rows in %.3f ms\n", (unsigned long)columns.rows,
+            (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+
+    free_columns(&columns);
+    return result ? 0 : 1;
+}
@@ -7,7 +7,8 @@
 int main(void)
 {
     char name[DATASIZE_MAX];
-    int userID;
+    buffer_t request;
+    int userID, status;
     printf("Enter Your full name: ");
     if (!fgets(name, sizeof(name), stdin))
     {
@@ -25,7 +26,14 @@ int main(void)
     /* Removing newlines */
     name[strcspn(name, "\n")] = '\0';
 
-    if (!load_user(name, userID))
+    buffer_init(&request);
+    status = buffer_put_svarint(&request, userID) && buffer_put(&request, name, strlen(name))
+                 ? node_call(NODE_LOGIN, &request, NULL)
+                 : -1;
+    buffer_free(&request);
+    if (status < 0)
+        status = load_user(name, userID);
+    if (!status)
     {
         fprintf(stderr, "Login failed\n");
         exit(EXIT_FAILURE);
@@ -1,5 +1,22 @@
 #include "blockchain.h"
 
+static const char hex_digits[] = "0123456789abcdef";
+
+/**
+ * bytes_to_hex - converts bytes to lowercase hex digits by table lookup
+ * @bytes: pointer to bytes
+ * @len: number of bytes
+ * @output: buffer of at least 2 * len characters, not NUL terminated
+ */
+void bytes_to_hex(const unsigned char *bytes, size_t len, char *output)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        output[i * 2] = hex_digits[bytes[i] >> 4];
+        output[i * 2 + 1] = hex_digits[bytes[i] & 0x0f];
+    }
+}
+
 /**
  * hash_to_hex - converts binary hash to hex string
  * @hash: pointer to hash
@@ -8,9 +25,7 @@
  */
 void hash_to_hex(unsigned char *hash, char *output)
 {
-    for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        sprintf(output + (i * 2), "%02x", hash[i]);
-    }
+    bytes_to_hex(hash, SHA256_DIGEST_LENGTH, output);
     output[SHA256_DIGEST_LENGTH * 2] = '\0';
 }
 
@@ -54,10 +69,13 @@ void calculate_hash(Block *block, unsigned char *hash)
 
     /* Hash Block metadata */
     uint32_t index_be = htonl(block->index);
+    uint32_t timestamp_be[2] = {htonl((uint32_t)((uint64_t)block->timestamp >> 32)),
+                                htonl((uint32_t)block->timestamp)};
     if (EVP_DigestUpdate(ctx, &index_be, sizeof(index_be)) != 1 ||
-        EVP_DigestUpdate(ctx, block->timestamp, sizeof(block->timestamp)) != 1 ||
+        EVP_DigestUpdate(ctx, timestamp_be, sizeof(timestamp_be)) != 1 ||
         EVP_DigestUpdate(ctx, block->previous_hash, SHA256_DIGEST_LENGTH) != 1 ||
-        EVP_DigestUpdate(ctx, &block->nonce, sizeof(block->nonce)) != 1)
+        EVP_DigestUpdate(ctx, &block->nonce, sizeof(block->nonce)) != 1 ||
+        EVP_DigestUpdate(ctx, block->miner, ADDRESS_SIZE) != 1)
     {
         fprintf(stderr, "Failed to update hash with block metadata\n");
         EVP_MD_CTX_free(ctx);
@@ -72,6 +90,7 @@ void calculate_hash(Block *block, unsigned char *hash)
             if (EVP_DigestUpdate(ctx, current_trans->sender, ADDRESS_SIZE) != 1 ||
                 EVP_DigestUpdate(ctx, current_trans->receiver, ADDRESS_SIZE) != 1 ||
                 EVP_DigestUpdate(ctx, &current_trans->amount, sizeof(current_trans->amount)) != 1 ||
+                EVP_DigestUpdate(ctx, &current_trans->index, sizeof(current_trans->index)) != 1 ||
                 EVP_DigestUpdate(ctx, &current_trans->status, sizeof(current_trans->status)) != 1)
             {
                 fprintf(stderr, "Failed to update hash with transaction data\n");
@@ -118,57 +137,99 @@ void mine_block(Block *block, int difficulty)
 }
 
 /**
- * finalize_transaction - accounting updates, utxo updates
- * @block: pointer to mined block
- * Return: 1 on success else 0
+ * find_wallet_owner - looks up the user owning a wallet address in a list
+ * @users: list of users
+ * @address: wallet address
+ * Return: pointer to user in list else NULL
  */
-int finalize_mining(Block *block)
+static user_t *find_wallet_owner(lusers *users, unsigned char *address)
 {
-    if (!block || !block->transactions)
-    {
-        fprintf(stderr, "Invalid block or not transaction in block\n");
-        return 0;
-    }
-    user_t *miner = get_user(NULL);
-    if (!miner || !miner->wallet)
+    for (user_t *user = users->head; user; user = user->next)
     {
-        fprintf(stderr, "Could next get miner details\n");
-        return 0;
+        if (user->wallet && memcmp(user->wallet->address, address, ADDRESS_SIZE) == 0)
+            return user;
     }
-    Transaction *trans = block->transactions->head;
-    while (trans)
+    return NULL;
+}
+
+/**
+ * apply_block - moves the amounts and fees of a block's transactions
+ * between loaded users
+ * The users file is the membership list every node starts with and is not
+ * replicated, so a transaction naming an address no user owns makes the
+ * whole block invalid, as it makes a peer's loose transaction invalid.
+ * Each sender has to hold the amount and the fee, counting the
+ * transactions before it in the block, the rule tx_for_mining picks by.
+ * Fees of a block whose miner is no user are credited to nobody
+ * @users: loaded users, left partly updated on failure
+ * @block: block to apply
+ * Return: 1 on success else 0 if the block is invalid
+ */
+int apply_block(lusers *users, Block *block)
+{
+    user_t *owner = find_wallet_owner(users, block->miner);
+
+    for (Transaction *trans = block->transactions->head; trans; trans = trans->next)
     {
-        user_t *sender = get_user(trans->sender);
-        if (!sender)
+        user_t *sender = find_wallet_owner(users, trans->sender);
+        user_t *receiver = find_wallet_owner(users, trans->receiver);
+        if (!sender || !receiver)
         {
-            fprintf(stderr, "Could not get sender details\n");
+            fprintf(stderr, "Block %u names an unknown %s\n", block->index, sender ? "receiver" : "sender");
             return 0;
         }
-        user_t *receiver = get_user(trans->receiver);
-        if (!receiver)
+        if (trans->amount <= 0 || sender->wallet->balance < trans->amount + TRANSACTION_FEE)
         {
-            fprintf(stderr, "Could not get receiver details\n");
-            free_user(sender);
+            fprintf(stderr, "Block %u overdraws the balance of %s\n", block->index, sender->name);
             return 0;
         }
         sender->wallet->balance -= trans->amount + TRANSACTION_FEE;
         receiver->wallet->balance += trans->amount;
-        miner->wallet->balance += TRANSACTION_FEE;
-        trans = trans->next;
+        if (owner)
+            owner->wallet->balance += TRANSACTION_FEE;
     }
     return 1;
 }
 
+/**
+ * finalize_mining - accounting updates, utxo updates
+ * Balances are updated on one loaded copy of the users and saved with
+ * serialize_users(), so they commit in the same journal group as the block
+ * @block: pointer to mined block, its miner credited the fees
+ * Return: 1 on success else 0
+ */
+int finalize_mining(Block *block)
+{
+    if (!block || !block->transactions)
+    {
+        fprintf(stderr, "Invalid block or not transaction in block\n");
+        return 0;
+    }
+    lusers *users = deserialize_users();
+    if (!users || !apply_block(users, block))
+    {
+        free_users(users);
+        return 0;
+    }
+    return serialize_users(users);
+}
+
 /**
  * tx_for_mining - get transactions to add to block for mining
+ * Transactions moved to the block are marked SUCCESS, the ones dropped for
+ * insufficient balance or an unknown address are marked FAILED and moved
+ * to failed. Balances carry over from one picked transaction to the next,
+ * as apply_block checks them
  * @total_unpsent: all unspent transactions in pool
+ * @failed: list collecting dropped transactions
  * Return: pointer to transactions else NULL on failure
  */
-utxo_t *tx_for_mining(utxo_t *total_unspent)
+utxo_t *tx_for_mining(utxo_t *total_unspent, utxo_t *failed)
 {
     int max = 0;
     utxo_t *block_transactions;
     Transaction *curr, *prev = NULL, *next;
+    lusers *users;
     if (!total_unspent)
     {
         fprintf(stderr, "total unspent is null\n");
@@ -189,6 +250,13 @@ utxo_t *tx_for_mining(utxo_t *total_unspent)
     }
     block_transactions->head = block_transactions->tail = NULL;
     block_transactions->nb_trans = 0;
+    users = deserialize_users();
+    if (!users)
+    {
+        fprintf(stderr, "Could not load users for mining\n");
+        free(block_transactions);
+        return NULL;
+    }
 
     curr = total_unspent->head;
     
@@ -196,19 +264,17 @@ utxo_t *tx_for_mining(utxo_t *total_unspent)
     {
         next = curr->next;  // Store next transaction before potential removal
         
-        user_t *sender = get_user(curr->sender);
-        if (!sender)
-        {
-            fprintf(stderr, "Could not get sender details\n");
-            prev = curr;
-            curr = next;
-            continue;
-        }
+        user_t *sender = find_wallet_owner(users, curr->sender);
+        user_t *receiver = find_wallet_owner(users, curr->receiver);
 
-        /* Check if sender has enough balance */
-        if (sender->wallet->balance < (curr->amount + TRANSACTION_FEE))
+        /* Check the addresses are known and the sender has enough balance left */
+        if (!sender || !receiver || curr->amount <= 0 ||
+            sender->wallet->balance < (curr->amount + TRANSACTION_FEE))
         {
-            fprintf(stderr, "Insufficient balance for transaction from %s\n", sender->name);
+            if (!sender || !receiver)
+                fprintf(stderr, "Transaction names an unknown address\n");
+            else
+                fprintf(stderr, "Insufficient balance for transaction from %s\n", sender->name);
 
             /* Remove transaction from total_unspent */
             if (prev)
@@ -219,13 +285,30 @@ utxo_t *tx_for_mining(utxo_t *total_unspent)
             if (!next)
                 total_unspent->tail = prev;
 
-            free(curr); 
+            curr->status = FAILED;
+            curr->next = NULL;
+            if (!failed->head)
+                failed->head = failed->tail = curr;
+            else
+            {
+                failed->tail->next = curr;
+                failed->tail = curr;
+            }
+            failed->nb_trans++;
             total_unspent->nb_trans--;
             curr = next;
             continue;
         }
 
-        /* Add transaction to block_transactions */
+        /* Move transaction from total_unspent to block_transactions */
+        if (prev)
+            prev->next = next;
+        else
+            total_unspent->head = next;
+        if (!next)
+            total_unspent->tail = prev;
+
+        curr->status = SUCCESS;
         curr->next = NULL;
         if (!block_transactions->head)
             block_transactions->head = block_transactions->tail = curr;
@@ -238,10 +321,12 @@ utxo_t *tx_for_mining(utxo_t *total_unspent)
         block_transactions->nb_trans++;
         total_unspent->nb_trans--;
         max++;
+        sender->wallet->balance -= curr->amount + TRANSACTION_FEE;
+        receiver->wallet->balance += curr->amount;
 
-        prev = curr;
         curr = next;
     }
+    free_users(users);
     serialize_utxo(total_unspent);
     return block_transactions;
 }
\ No newline at end of file
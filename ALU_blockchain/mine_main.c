@@ -2,14 +2,17 @@
 
 /**
  * main - mines new block and adds it to blockchain
- * return: 0 always
+ * A running node mines into the chain it holds in memory, otherwise the
+ * blockchain is loaded from file
+ * return: 0 on success
  */
 int main(void)
 {
     Blockchain *blockchain;
-    Block *newBlock;
-    uint64_t startTime, endTime;
-    utxo_t *unspent;
+    int status = node_call(NODE_MINE, NULL, NULL);
+
+    if (status >= 0)
+        return status ? 0 : EXIT_FAILURE;
 
     blockchain = deserialize_blockchain();
     if (!blockchain)
@@ -25,83 +28,7 @@ int main(void)
         blockchain = init_blockchain();
     }
 
-    unspent = deserialize_utxo();
-    if (!unspent)
-    {
-        fprintf(stderr, "Could not deserialize unspent transactions\n");
-        free_blockchain(blockchain);
-        exit(EXIT_FAILURE);
-    }
-
-    if (unspent->nb_trans == 0)
-    {
-        fprintf(stderr, "No transactions to mine\n");
-        free_blockchain(blockchain);
-        free_transactions(unspent);
-        exit(EXIT_FAILURE);
-    }
-
-    utxo_t *block_txs = tx_for_mining(unspent);
-    if (!block_txs)
-    {
-        fprintf(stderr, "Error getting transactions for mining\n");
-        free_blockchain(blockchain);
-        free_transactions(unspent);
-        exit(EXIT_FAILURE);
-    }
-
-    printf("------MINING BLOCK------\n");
-    startTime = (uint64_t)time(NULL);
-
-    newBlock = create_block(blockchain->length, block_txs, blockchain->tail ? blockchain->tail->current_hash : NULL, blockchain->difficulty);
-    if (!newBlock)
-    {
-        fprintf(stderr, "Could not create new block\n");
-        free_blockchain(blockchain);
-        free_transactions(block_txs);
-        exit(EXIT_FAILURE);
-    }
-
-    int result = finalize_mining(newBlock);
-    if (!result)
-    {
-        fprintf(stderr, "Could not finish mining\n");
-        free_blockchain(blockchain);
-        free_transactions(block_txs);
-        exit(EXIT_FAILURE);
-    }
-
-    endTime = (uint64_t)time(NULL);
-    add_block(blockchain, newBlock);
-    printf("Time taken to mine block: %lu seconds\n", (endTime - startTime));
-    printf("\n\n");
-    
-
-    blockchain->difficulty = adjust_difficulty(startTime, endTime, blockchain->difficulty);
-    printf("New Difficulty Level: %d\n", blockchain->difficulty);
-
-    printf("\n------VERIFYING BLOCKCHAIN INTERGRITY-------\n");
-    if (!validate_chain(blockchain))
-    {
-        fprintf(stderr, "Blockchain is not valid\n");
-        free_blockchain(blockchain);
-        free_transactions(block_txs);
-        exit(EXIT_FAILURE);
-    }
-
-    printf("Blockchain is valid\n");
-
-    if (!serialize_blockchain(blockchain))
-    {
-        fprintf(stderr, "Blockchain with new block could not be serialized\n");
-        free_blockchain(blockchain);
-        free_transactions(block_txs);
-        exit(EXIT_FAILURE);
-    }
-
-    printf("Serialized new blockchain\n");
-
-
-    printf("MINING COMPLETE. NEW BLOCK ADDED TO BLOCKCHAIN\n");
-    return 0;
-}
\ No newline at end of file
+    status = mine_pending(blockchain);
+    free_blockchain(blockchain);
+    return status ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,504 @@
+#include "blockchain.h"
+
+/**
+ * free_list_nodes - frees the transactions of a list kept on the stack
+ * @list: list to empty
+ */
+static void free_list_nodes(utxo_t *list)
+{
+    Transaction *next;
+
+    for (Transaction *trans = list->head; trans; trans = next)
+    {
+        next = trans->next;
+        free(trans);
+    }
+    list->head = list->tail = NULL;
+    list->nb_trans = 0;
+}
+
+/**
+ * record_undo - saves the undo record of a block mined from the pool
+ * Balances staged by finalize_mining are not visible before the journal
+ * group commits, so the users read here are the ones before the block
+ * @block: block being committed
+ * Return: 1 on success else 0
+ */
+static int record_undo(Block *block)
+{
+    lusers *users = deserialize_users();
+    undo_log_t undo;
+    int result;
+
+    if (!users)
+        return 0;
+    undo_init(&undo);
+    result = undo_capture(&undo, users, block) && undo_save(&undo);
+    undo_free(&undo);
+    free_users(users);
+    return result;
+}
+
+/**
+ * compare_ids - orders transaction IDs
+ * @a: first ID
+ * @b: second ID
+ * Return: comparison result for qsort and bsearch
+ */
+static int compare_ids(const void *a, const void *b)
+{
+    return memcmp(a, b, TXID_SIZE);
+}
+
+/**
+ * drop_included - removes from the pool the transactions blocks include
+ * The IDs of the block transactions are hashed once and sorted, so each
+ * pool transaction is hashed once and looked up
+ * @pool: pool of unspent transactions
+ * @blocks: blocks, linked through next
+ * @dropped: more transactions to remove, may be NULL
+ * Return: number of transactions removed, or -1 on failure
+ */
+static int drop_included(utxo_t *pool, Block *blocks, utxo_t *dropped)
+{
+    unsigned char id[TXID_SIZE], *ids;
+    Transaction *trans, *prev = NULL, *next;
+    size_t nb_ids = dropped ? dropped->nb_trans : 0;
+    int removed = 0;
+
+    for (Block *block = blocks; block; block = block->next)
+        nb_ids += block->transactions->nb_trans;
+    ids = (unsigned char *)malloc(nb_ids * TXID_SIZE + 1);
+    if (!ids)
+    {
+        fprintf(stderr, "Failed to allocate transaction IDs\n");
+        return -1;
+    }
+    nb_ids = 0;
+    for (Block *block = blocks; block; block = block->next)
+    {
+        for (Transaction *other = block->transactions->head; other; other = other->next)
+            transaction_id(other, ids + nb_ids++ * TXID_SIZE);
+    }
+    for (trans = dropped ? dropped->head : NULL; trans; trans = trans->next)
+        transaction_id(trans, ids + nb_ids++ * TXID_SIZE);
+    qsort(ids, nb_ids, TXID_SIZE, compare_ids);
+
+    for (trans = pool->head; trans; trans = next)
+    {
+        next = trans->next;
+        transaction_id(trans, id);
+        if (!bsearch(id, ids, nb_ids, TXID_SIZE, compare_ids))
+        {
+            prev = trans;
+            continue;
+        }
+        if (prev)
+            prev->next = next;
+        else
+            pool->head = next;
+        if (pool->tail == trans)
+            pool->tail = prev;
+        pool->nb_trans--;
+        free(trans);
+        removed++;
+    }
+    free(ids);
+    return removed;
+}
+
+/**
+ * mine_template - picks the pending transactions of the next block and
+ * builds it on the tip, without its proof of work
+ * The logged in user is credited the fees, the proof of work covers the
+ * address. Nothing is written, the pool only changes once the block is
+ * committed
+ * @blockchain: loaded blockchain
+ * @failed: list collecting the transactions dropped for insufficient
+ * balance, removed from the pool with the block
+ * Return: block to mine or NULL if there is nothing to mine
+ */
+Block *mine_template(Blockchain *blockchain, utxo_t *failed)
+{
+    user_t *session = get_user(NULL);
+    unsigned char miner[ADDRESS_SIZE];
+    utxo_t *unspent, *block_txs;
+    Block *block;
+
+    if (!session || !session->wallet)
+    {
+        fprintf(stderr, "Could not get miner details\n");
+        free_user(session);
+        return NULL;
+    }
+    memcpy(miner, session->wallet->address, ADDRESS_SIZE);
+    free_user(session);
+    if (!txid_rebuild())
+        fprintf(stderr, "Transaction ID index could not be rebuilt\n");
+    unspent = deserialize_utxo();
+    if (!unspent)
+    {
+        fprintf(stderr, "Could not deserialize unspent transactions\n");
+        return NULL;
+    }
+
+    if (unspent->nb_trans == 0)
+    {
+        fprintf(stderr, "No transactions to mine\n");
+        free_transactions(unspent);
+        return NULL;
+    }
+
+    /* tx_for_mining saves the pool without the picked transactions, that write is dropped */
+    journal_begin();
+    block_txs = tx_for_mining(unspent, failed);
+    journal_abort();
+    free_transactions(unspent);
+    if (!block_txs)
+    {
+        fprintf(stderr, "Error getting transactions for mining\n");
+        free_list_nodes(failed);
+        return NULL;
+    }
+
+    block = (Block *)calloc(1, sizeof(Block));
+    if (!block)
+    {
+        fprintf(stderr, "Could not create new block\n");
+        free_transactions(block_txs);
+        free_list_nodes(failed);
+        return NULL;
+    }
+    /* The block timestamp is taken right before proof of work starts */
+    block->index = blockchain->length;
+    block->timestamp = block_timestamp(blockchain->tail);
+    memcpy(block->miner, miner, ADDRESS_SIZE);
+    if (blockchain->tail)
+        memcpy(block->previous_hash, blockchain->tail->current_hash, SHA256_DIGEST_LENGTH);
+    block->transactions = block_txs;
+    return block;
+}
+
+/**
+ * mine_commit - appends a block built by mine_template and mined since to
+ * the loaded blockchain it extends
+ * Pool, balances, indexes and block commit together as one journal group.
+ * On failure nothing is written, but the blockchain may still hold the
+ * unsaved block and has to be reloaded before it is used again
+ * @blockchain: pointer to blockchain, its tip still the one the block
+ * was built on
+ * @block: mined block, owned by the blockchain once added
+ * @failed: transactions mine_template dropped, emptied
+ * Return: 1 on success else 0
+ */
+int mine_commit(Blockchain *blockchain, Block *block, utxo_t *failed)
+{
+    int64_t endTime = current_timestamp();
+    Block *previous = blockchain->tail;
+    utxo_t *pool;
+    int dropped;
+
+    journal_begin();
+    pool = deserialize_utxo();
+    if (!pool || (dropped = drop_included(pool, block, failed)) < 0 || (dropped > 0 && !serialize_utxo(pool)) ||
+        !finalize_mining(block))
+    {
+        fprintf(stderr, "Could not finish mining\n");
+        journal_abort();
+        free_transactions(pool);
+        free_blocks(block);
+        free_list_nodes(failed);
+        return 0;
+    }
+    free_transactions(pool);
+    if (!record_undo(block))
+        fprintf(stderr, "Undo record not saved, the block cannot be disconnected\n");
+
+    add_block(blockchain, block);
+    printf("Time taken to mine block: %.3f seconds\n", (double)(endTime - block->timestamp) / TIMESTAMP_RESOLUTION);
+    printf("\n\n");
+
+    blockchain->difficulty = next_difficulty(previous, block, blockchain->difficulty);
+    printf("New Difficulty Level: %d\n", blockchain->difficulty);
+
+    printf("\n------VERIFYING BLOCKCHAIN INTERGRITY-------\n");
+    if (!validate_tip(blockchain))
+    {
+        fprintf(stderr, "Blockchain is not valid\n");
+        journal_abort();
+        free_list_nodes(failed);
+        return 0;
+    }
+
+    printf("Blockchain is valid\n");
+
+    if (!txid_record_block(block, failed))
+        fprintf(stderr, "Transaction ID index not updated\n");
+    free_list_nodes(failed);
+    if (!history_update(blockchain))
+        fprintf(stderr, "Transaction history index not updated\n");
+    if (!stats_update(blockchain))
+        fprintf(stderr, "Chain statistics not updated\n");
+
+    if (!store_blockchain(blockchain))
+    {
+        fprintf(stderr, "Blockchain with new block could not be serialized\n");
+        journal_abort();
+        return 0;
+    }
+
+    if (!journal_commit())
+    {
+        fprintf(stderr, "Could not commit mined block\n");
+        return 0;
+    }
+    printf("Serialized new blockchain\n");
+
+
+    printf("MINING COMPLETE. NEW BLOCK ADDED TO BLOCKCHAIN\n");
+    return 1;
+}
+
+/**
+ * mine_pending - mines a block from the pending pool and appends it to a
+ * loaded blockchain
+ * On failure nothing is written, but the blockchain may still hold the
+ * unsaved block and has to be reloaded before it is used again
+ * @blockchain: pointer to blockchain, kept loaded
+ * Return: 1 on success else 0
+ */
+int mine_pending(Blockchain *blockchain)
+{
+    utxo_t failed = {NULL, NULL, 0};
+    Block *block = mine_template(blockchain, &failed);
+
+    if (!block)
+        return 0;
+    printf("------MINING BLOCK------\n");
+    mine_block(block, blockchain->difficulty);
+    return mine_commit(blockchain, block, &failed);
+}
+
+/**
+ * check_block - checks a block received from a peer extends a tip
+ * @block: block to check
+ * @tip: block it has to extend
+ * @difficulty: difficulty the schedule sets for the block's height
+ * Return: 1 if the block is valid else 0; its timestamp has to be after
+ * the tip's and not too far ahead of the clock
+ */
+int check_block(Block *block, Block *tip, int difficulty)
+{
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+
+    if (block->index != tip->index + 1 || block->pruned ||
+        memcmp(block->previous_hash, tip->current_hash, SHA256_DIGEST_LENGTH) != 0)
+    {
+        fprintf(stderr, "Block %u does not extend block %u\n", block->index, tip->index);
+        return 0;
+    }
+    if (!valid_timestamp(block->timestamp, tip->timestamp))
+    {
+        fprintf(stderr, "Block %u has an invalid timestamp\n", block->index);
+        return 0;
+    }
+    calculate_hash(block, hash);
+    if (memcmp(hash, block->current_hash, SHA256_DIGEST_LENGTH) != 0 || !is_valid_hash(hash, difficulty))
+    {
+        fprintf(stderr, "Block %u has an invalid hash\n", block->index);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * free_blocks - frees a list of blocks linked through next
+ * @blocks: first block
+ */
+void free_blocks(Block *blocks)
+{
+    Block *next;
+
+    for (Block *block = blocks; block; block = next)
+    {
+        next = block->next;
+        free_transactions(block->transactions);
+        free(block);
+    }
+}
+
+/**
+ * accept_blocks - appends blocks received from a peer to a loaded blockchain
+ * Each block has to extend the one before it with a correct hash meeting
+ * the difficulty the schedule sets for its height. Balances, pool, indexes, undo records and blocks
+ * commit as one journal group, and the difficulty moves on to the one the
+ * new tip sets
+ * @blockchain: loaded blockchain with at least its genesis block
+ * @blocks: blocks in height order linked through next, owned by the
+ * blockchain on success and freed when rejected
+ * Return: number of blocks added, 0 if they were rejected and nothing
+ * changed, or -1 if the commit failed and the blockchain has to be reloaded
+ */
+int accept_blocks(Blockchain *blockchain, Block *blocks)
+{
+    Block *tip = blockchain->tail, *last = NULL;
+    lusers *users = NULL;
+    undo_log_t undo;
+    utxo_t *pool;
+    int count = 0, result = 1, dropped, difficulty = blockchain->difficulty;
+
+    for (Block *block = blocks; result && block; block = block->next, count++)
+    {
+        result = check_block(block, last ? last : tip, difficulty);
+        difficulty = next_difficulty(last ? last : tip, block, difficulty);
+        last = block;
+    }
+    if (result)
+        users = deserialize_users();
+    result = result && users;
+    undo_init(&undo);
+    for (Block *block = blocks; result && block; block = block->next)
+        result = undo_capture(&undo, users, block) && apply_block(users, block);
+    if (!result)
+    {
+        if (users)
+            free_users(users);
+        undo_free(&undo);
+        free_blocks(blocks);
+        return 0;
+    }
+
+    journal_begin();
+    result = serialize_users(users) && undo_save(&undo);
+    undo_free(&undo);
+    if (result && access(UTXO_DATABASE, F_OK) == 0)
+    {
+        pool = deserialize_utxo();
+        result = pool && (dropped = drop_included(pool, blocks, NULL)) >= 0 && (dropped == 0 || serialize_utxo(pool));
+        free_transactions(pool);
+    }
+    if (!result)
+    {
+        journal_abort();
+        free_blocks(blocks);
+        return 0;
+    }
+
+    tip->next = blocks;
+    blockchain->tail = last;
+    blockchain->length += count;
+    blockchain->difficulty = difficulty;
+    if (!txid_record_block(blocks, NULL))
+        fprintf(stderr, "Transaction ID index not updated\n");
+    if (!history_update(blockchain))
+        fprintf(stderr, "Transaction history index not updated\n");
+    if (!stats_update(blockchain))
+        fprintf(stderr, "Chain statistics not updated\n");
+    if (!result || !store_blockchain(blockchain) || !journal_commit())
+    {
+        fprintf(stderr, "Could not commit received blocks\n");
+        if (journal_active())
+            journal_abort();
+        return -1;
+    }
+    return count;
+}
+
+/**
+ * return_to_pool - puts the transactions of disconnected blocks back in
+ * front of the pool, pending again and in chain order
+ * @pool: pool of unspent transactions
+ * @blocks: disconnected blocks, linked through next
+ * Return: 1 on success else 0
+ */
+static int return_to_pool(utxo_t *pool, Block *blocks)
+{
+    Transaction *head = NULL, *tail = NULL, *copy;
+    int count = 0;
+
+    for (Block *block = blocks; block; block = block->next)
+    {
+        for (Transaction *trans = block->transactions->head; trans; trans = trans->next)
+        {
+            copy = (Transaction *)malloc(sizeof(Transaction));
+            if (!copy)
+            {
+                for (; head; head = copy)
+                {
+                    copy = head->next;
+                    free(head);
+                }
+                return 0;
+            }
+            *copy = *trans;
+            copy->status = INITIATED;
+            copy->next = NULL;
+            if (tail)
+                tail->next = copy;
+            else
+                head = copy;
+            tail = copy;
+            count++;
+        }
+    }
+    if (!head)
+        return 1;
+    tail->next = pool->head;
+    if (!pool->head)
+        pool->tail = tail;
+    pool->head = head;
+    pool->nb_trans += count;
+    return 1;
+}
+
+/**
+ * rewind_chain - disconnects the blocks after a block of a loaded
+ * blockchain, as one journal group
+ * Balances come back from the undo records of the disconnected blocks,
+ * their transactions go back to the pool and every index is cut after
+ * @last, so the cost depends on the number of blocks disconnected only
+ * @blockchain: loaded blockchain
+ * @last: block of the chain to end at
+ * @removed: where to store the disconnected blocks, linked through next
+ * and owned by the caller
+ * Return: number of blocks disconnected, 0 if nothing changed, or -1 if
+ * the commit failed and the blockchain has to be reloaded
+ */
+int rewind_chain(Blockchain *blockchain, Block *last, Block **removed)
+{
+    lusers *users;
+    utxo_t *pool;
+    int count = 0, result;
+
+    *removed = NULL;
+    for (Block *block = last->next; block; block = block->next)
+        count++;
+    if (count == 0)
+        return 0;
+    users = deserialize_users();
+    pool = access(UTXO_DATABASE, F_OK) == 0 ? deserialize_utxo() : (utxo_t *)calloc(1, sizeof(utxo_t));
+    result = users && pool && return_to_pool(pool, last->next);
+
+    /* The chain is only cut in memory once everything else is staged */
+    journal_begin();
+    result = result && undo_rewind(users, last->next, last);
+    if (users)
+        result = result ? serialize_users(users) : (free_users(users), 0);
+    result = result && serialize_utxo(pool) && txid_revert_block(last->next) &&
+             history_rewind(last->next, last) && stats_rewind(last->index) &&
+             truncate_blockchain(blockchain, last, removed);
+    free_transactions(pool);
+    if (!result)
+    {
+        fprintf(stderr, "Could not disconnect blocks after block %u\n", last->index);
+        journal_abort();
+        return 0;
+    }
+    save_checkpoint(blockchain);
+    if (!journal_commit())
+    {
+        fprintf(stderr, "Could not commit disconnected blocks\n");
+        return -1;
+    }
+    return count;
+}
@@ -0,0 +1,219 @@
+#include "blockchain.h"
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/**
+ * write_all - writes a whole buffer to a socket
+ * @fd: socket
+ * @data: bytes to write
+ * @len: number of bytes
+ * Return: 1 on success else 0
+ */
+static int write_all(int fd, const void *data, size_t len)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+
+    while (len > 0)
+    {
+        ssize_t written = write(fd, bytes, len);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return 0;
+        bytes += written;
+        len -= (size_t)written;
+    }
+    return 1;
+}
+
+/**
+ * read_all - reads exactly len bytes from a socket
+ * @fd: socket
+ * @data: where to store the bytes
+ * @len: number of bytes
+ * Return: 1 on success else 0 on error or end of stream
+ */
+static int read_all(int fd, void *data, size_t len)
+{
+    unsigned char *bytes = (unsigned char *)data;
+
+    while (len > 0)
+    {
+        ssize_t got = read(fd, bytes, len);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            return 0;
+        bytes += got;
+        len -= (size_t)got;
+    }
+    return 1;
+}
+
+/**
+ * node_connect - connects to the node daemon of the current directory
+ * Return: connected socket, or -1 if no daemon is listening
+ */
+int node_connect(void)
+{
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0)
+        return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, NODE_SOCKET, sizeof(addr.sun_path) - 1);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * node_send - sends one framed message
+ * @fd: socket
+ * @type: request type or response status
+ * @payload: message payload, may be NULL
+ * Return: 1 on success else 0
+ */
+int node_send(int fd, uint32_t type, const buffer_t *payload)
+{
+    node_frame_t frame;
+    size_t len = payload ? payload->len : 0;
+
+    frame.magic = htonl(NODE_MAGIC);
+    frame.type = htonl(type);
+    frame.length = htonl((uint32_t)len);
+    return write_all(fd, &frame, sizeof(frame)) && (len == 0 || write_all(fd, payload->data, len));
+}
+
+/**
+ * node_frame_put - appends one framed message to an output buffer
+ * @out: buffer to append to
+ * @type: request type or response status
+ * @payload: message payload, may be NULL
+ * Return: 1 on success else 0
+ */
+int node_frame_put(buffer_t *out, uint32_t type, const buffer_t *payload)
+{
+    node_frame_t frame;
+    size_t len = payload ? payload->len : 0;
+
+    frame.magic = htonl(NODE_MAGIC);
+    frame.type = htonl(type);
+    frame.length = htonl((uint32_t)len);
+    return buffer_put(out, &frame, sizeof(frame)) && (len == 0 || buffer_put(out, payload->data, len));
+}
+
+/**
+ * node_frame_parse - finds the next complete frame in received bytes
+ * @in: received bytes, read position moved to the payload when a whole
+ * frame is there
+ * @max: largest payload accepted
+ * @type: where to store the request type or response status
+ * @len: where to store the payload length
+ * Return: 1 if a frame is complete, 0 if more bytes are needed, or -1 if
+ * the bytes are not a valid frame
+ */
+int node_frame_parse(buffer_t *in, uint32_t max, uint32_t *type, uint32_t *len)
+{
+    node_frame_t frame;
+
+    if (in->len - in->pos < sizeof(frame))
+        return 0;
+    memcpy(&frame, in->data + in->pos, sizeof(frame));
+    if (ntohl(frame.magic) != NODE_MAGIC || ntohl(frame.length) > max)
+        return -1;
+    if (in->len - in->pos - sizeof(frame) < ntohl(frame.length))
+        return 0;
+    in->pos += sizeof(frame);
+    *type = ntohl(frame.type);
+    *len = ntohl(frame.length);
+    return 1;
+}
+
+/**
+ * node_receive - receives one framed response
+ * @fd: socket
+ * @type: where to store the request type or response status
+ * @payload: buffer replaced with the payload, read position at its start
+ * Return: 1 on success else 0
+ */
+int node_receive(int fd, uint32_t *type, buffer_t *payload)
+{
+    node_frame_t frame;
+    uint32_t len;
+
+    if (!read_all(fd, &frame, sizeof(frame)) || ntohl(frame.magic) != NODE_MAGIC)
+        return 0;
+    len = ntohl(frame.length);
+    if (len > NODE_RESPONSE_MAX)
+        return 0;
+    payload->len = payload->pos = 0;
+    if (!buffer_reserve(payload, len) || !read_all(fd, payload->data, len))
+        return 0;
+    payload->len = len;
+    *type = ntohl(frame.type);
+    return 1;
+}
+
+/**
+ * print_captured - prints output the daemon captured while serving a request
+ * @response: response payload, read position at the captured output
+ * @stream: stream to print to
+ * Return: 1 on success else 0 if the payload is malformed
+ */
+static int print_captured(buffer_t *response, FILE *stream)
+{
+    uint64_t len;
+
+    if (!buffer_get_varint(response, &len) || len > response->len - response->pos)
+        return 0;
+    fwrite(response->data + response->pos, 1, len, stream);
+    fflush(stream);
+    response->pos += len;
+    return 1;
+}
+
+/**
+ * node_call - sends a request to the node daemon and prints the output it
+ * produced, so a thin client looks exactly like the direct file access path
+ * @type: request type
+ * @request: request payload, may be NULL
+ * @result: buffer filled with the result bytes of the handler, may be NULL
+ * Return: 1 on success, 0 on failure, or -1 if no daemon is running and
+ * the caller has to access the files itself
+ */
+int node_call(NodeRequest type, const buffer_t *request, buffer_t *result)
+{
+    buffer_t response;
+    uint32_t status;
+    int fd = node_connect();
+
+    if (fd < 0)
+        return -1;
+    /* Prompts printed so far go out before the captured output */
+    fflush(stdout);
+    buffer_init(&response);
+    if (!node_send(fd, type, request) || !node_receive(fd, &status, &response) ||
+        !print_captured(&response, stdout) || !print_captured(&response, stderr))
+    {
+        fprintf(stderr, "Lost connection to node, the request may not have been applied\n");
+        buffer_free(&response);
+        close(fd);
+        return 0;
+    }
+    close(fd);
+    if (result)
+    {
+        result->len = result->pos = 0;
+        if (!buffer_put(result, response.data + response.pos, response.len - response.pos))
+            status = 0;
+    }
+    buffer_free(&response);
+    return status ? 1 : 0;
+}
@@ -0,0 +1,355 @@
+#include "blockchain.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+/**
+ * elapsed - seconds between two monotonic clock readings
+ * @start: first reading
+ * @end: second reading
+ * Return: elapsed seconds
+ */
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * compare_doubles - orders latencies
+ * @a: first latency
+ * @b: second latency
+ * Return: comparison result for qsort
+ */
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * top_up - queues requests until the client has a full pipeline in flight
+ * @client: client
+ * @type: request type
+ * @request: request payload
+ * @nb_requests: requests each client sends
+ * @depth: pipeline depth
+ */
+static void top_up(node_client_t *client, NodeRequest type, buffer_t *request, int nb_requests, int depth)
+{
+    while (client->sent < nb_requests && client->sent - client->received < depth &&
+           node_frame_put(&client->out, type, request))
+    {
+        clock_gettime(CLOCK_MONOTONIC, &client->sent_at[client->sent % depth]);
+        client->sent++;
+    }
+}
+
+/**
+ * client_io - sends pending requests and reads the responses of a client
+ * @client: client
+ * @latencies: latency of every response, in seconds
+ * @nb_latencies: number of latencies recorded, updated
+ * @depth: pipeline depth
+ * @failed: number of failed responses, updated
+ * Return: 1 on success else 0 if the connection failed
+ */
+static int client_io(node_client_t *client, double *latencies, long *nb_latencies, int depth, long *failed)
+{
+    struct timespec now;
+    uint32_t status, len;
+    ssize_t done;
+    int found;
+
+    while (client->out.pos < client->out.len)
+    {
+        done = write(client->fd, client->out.data + client->out.pos, client->out.len - client->out.pos);
+        if (done < 0 && (errno == EAGAIN || errno == EINTR))
+            break;
+        if (done <= 0)
+            return 0;
+        client->out.pos += (size_t)done;
+    }
+    if (client->out.pos == client->out.len)
+        client->out.len = client->out.pos = 0;
+
+    while (1)
+    {
+        if (!buffer_reserve(&client->in, 65536))
+            return 0;
+        done = read(client->fd, client->in.data + client->in.len, client->in.cap - client->in.len);
+        if (done < 0 && (errno == EAGAIN || errno == EINTR))
+            break;
+        if (done <= 0)
+            return 0;
+        client->in.len += (size_t)done;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    while ((found = node_frame_parse(&client->in, NODE_RESPONSE_MAX, &status, &len)) == 1)
+    {
+        client->in.pos += len;
+        latencies[(*nb_latencies)++] = elapsed(&client->sent_at[client->received % depth], &now);
+        *failed += status != 1;
+        client->received++;
+    }
+    memmove(client->in.data, client->in.data + client->in.pos, client->in.len - client->in.pos);
+    client->in.len -= client->in.pos;
+    client->in.pos = 0;
+    return found == 0;
+}
+
+/**
+ * build_request - builds the payload of the benchmarked request
+ * Submissions send 1 token from the logged in user to themself
+ * @type: request type
+ * @request: buffer to fill
+ * Return: 1 on success else 0
+ */
+static int build_request(NodeRequest type, buffer_t *request)
+{
+    user_t *user;
+
+    if (type != NODE_SUBMIT)
+        return 1;
+    user = get_user(NULL);
+    if (!user || !user->wallet)
+    {
+        fprintf(stderr, "Log in a user with a wallet to benchmark submissions\n");
+        return 0;
+    }
+    return buffer_put(request, user->wallet->address, ADDRESS_SIZE) &&
+           buffer_put(request, user->wallet->address, ADDRESS_SIZE) && buffer_put_svarint(request, 1) &&
+           buffer_put_svarint(request, -1);
+}
+
+/**
+ * bench_ring - pushes submissions to the node's ring from concurrent
+ * processes and measures the push latency, then how long the node takes
+ * to take all of them off the ring
+ * Submissions send 1 token from the logged in user to themself
+ * @nb_clients: processes pushing at once
+ * @nb_requests: submissions each process pushes
+ * Return: 0 on success else 1
+ */
+static int bench_ring(int nb_clients, int nb_requests)
+{
+    long total = (long)nb_clients * nb_requests, nb_full = 0;
+    size_t size = sizeof(double) * total + sizeof(long) * nb_clients;
+    struct timespec start, end, drained, before, after;
+    tx_ring_t *ring = tx_ring_open();
+    user_t *user = get_user(NULL);
+    tx_ring_record_t record;
+    uint64_t pos;
+    double *latencies;
+    long *fulls;
+    pid_t pid;
+
+    if (!ring)
+    {
+        fprintf(stderr, "No submission ring, is alu_noded running?\n");
+        return 1;
+    }
+    if (!user || !user->wallet)
+    {
+        fprintf(stderr, "Log in a user with a wallet to benchmark submissions\n");
+        return 1;
+    }
+    memset(&record, 0, sizeof(record));
+    memcpy(record.sender, user->wallet->address, ADDRESS_SIZE);
+    memcpy(record.receiver, user->wallet->address, ADDRESS_SIZE);
+    record.amount = 1;
+    record.sequence = -1;
+    /* The pushing processes write their latencies where the parent reads them */
+    latencies = (double *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (latencies == MAP_FAILED)
+    {
+        fprintf(stderr, "Could not set up the benchmark\n");
+        return 1;
+    }
+    fulls = (long *)(latencies + total);
+    memset(fulls, 0, sizeof(long) * nb_clients);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int c = 0; c < nb_clients; c++)
+    {
+        pid = fork();
+        if (pid < 0)
+        {
+            fprintf(stderr, "Could not start client %d\n", c + 1);
+            nb_clients = c;
+            break;
+        }
+        if (pid > 0)
+            continue;
+        for (int r = 0; r < nb_requests; r++)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &before);
+            /* A full ring waits for the node to drain it */
+            while (!tx_ring_push(ring, &record, &pos))
+            {
+                fulls[c]++;
+                usleep(100);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &after);
+            latencies[(long)c * nb_requests + r] = elapsed(&before, &after);
+        }
+        _exit(0);
+    }
+    while (wait(NULL) > 0)
+        ;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    while (atomic_load(&ring->tail) != atomic_load(&ring->head))
+        usleep(1000);
+    clock_gettime(CLOCK_MONOTONIC, &drained);
+
+    total = (long)nb_clients * nb_requests;
+    for (int c = 0; c < nb_clients; c++)
+        nb_full += fulls[c];
+    qsort(latencies, total, sizeof(double), compare_doubles);
+    printf("ring: %d clients x %d submissions\n", nb_clients, nb_requests);
+    printf("%ld submissions in %.3f s: %.0f submissions/s\n", total, elapsed(&start, &end),
+           total / elapsed(&start, &end));
+    if (total)
+        printf("push latency p50 %.3f us  p99 %.3f us  max %.3f ms\n", latencies[total / 2] * 1e6,
+               latencies[total * 99 / 100] * 1e6, latencies[total - 1] * 1e3);
+    printf("ring full: %ld times\n", nb_full);
+    printf("logged by the node %.3f s after the last push\n", elapsed(&end, &drained));
+    munmap(latencies, size);
+    tx_ring_close(ring);
+    return 0;
+}
+
+/**
+ * main - opens many concurrent connections to the node and measures
+ * request throughput and latency
+ * @argc: argument count
+ * @argv: ping, balance, submit or ring, --clients=N, --requests=N per
+ * client and --pipeline=N requests in flight per client; ring pushes
+ * submissions to the shared memory ring, the pipeline does not apply
+ * Return: 0 on success else 1
+ */
+int main(int argc, char **argv)
+{
+    const char *names[] = {NULL, "ping", "login", "balance", "submit"};
+    int nb_clients = 100, nb_requests = 100, depth = 1, nb_events;
+    NodeRequest type = NODE_BALANCE;
+    struct epoll_event event, events[NODE_EVENTS_MAX];
+    struct timespec start, end;
+    struct rlimit limit;
+    node_client_t *clients;
+    buffer_t request;
+    double *latencies;
+    long nb_latencies = 0, failed = 0, total;
+    int epoll_fd, open_clients, ring = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--clients=", 10) == 0 && atoi(argv[i] + 10) > 0)
+            nb_clients = atoi(argv[i] + 10);
+        else if (strncmp(argv[i], "--requests=", 11) == 0 && atoi(argv[i] + 11) > 0)
+            nb_requests = atoi(argv[i] + 11);
+        else if (strncmp(argv[i], "--pipeline=", 11) == 0 && atoi(argv[i] + 11) > 0)
+            depth = atoi(argv[i] + 11);
+        else if (strcmp(argv[i], "ring") == 0)
+            ring = 1;
+        else if (strcmp(argv[i], "ping") == 0 || strcmp(argv[i], "balance") == 0 || strcmp(argv[i], "submit") == 0)
+            type = argv[i][0] == 'p' ? NODE_PING : argv[i][0] == 'b' ? NODE_BALANCE : NODE_SUBMIT;
+        else
+        {
+            fprintf(stderr, "Usage: %s [ping|balance|submit|ring] [--clients=N] [--requests=N] [--pipeline=N]\n",
+                    argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (ring)
+        return bench_ring(nb_clients, nb_requests);
+
+    /* Every client holds a descriptor */
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    buffer_init(&request);
+    total = (long)nb_clients * nb_requests;
+    clients = (node_client_t *)calloc(nb_clients, sizeof(node_client_t));
+    latencies = (double *)malloc(sizeof(double) * total);
+    epoll_fd = epoll_create1(0);
+    if (!clients || !latencies || epoll_fd < 0 || !build_request(type, &request))
+    {
+        fprintf(stderr, "Could not set up the benchmark\n");
+        exit(EXIT_FAILURE);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int c = 0; c < nb_clients; c++)
+    {
+        clients[c].fd = node_connect();
+        clients[c].sent_at = (struct timespec *)malloc(sizeof(struct timespec) * depth);
+        if (clients[c].fd < 0 || !clients[c].sent_at)
+        {
+            fprintf(stderr, "Could not open connection %d, is alu_noded running?\n", c + 1);
+            exit(EXIT_FAILURE);
+        }
+        fcntl(clients[c].fd, F_SETFL, O_NONBLOCK);
+        event.events = EPOLLIN | EPOLLOUT;
+        event.data.ptr = &clients[c];
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, clients[c].fd, &event);
+        top_up(&clients[c], type, &request, nb_requests, depth);
+    }
+
+    open_clients = nb_clients;
+    while (open_clients > 0)
+    {
+        nb_events = epoll_wait(epoll_fd, events, NODE_EVENTS_MAX, -1);
+        for (int i = 0; i < nb_events; i++)
+        {
+            node_client_t *client = (node_client_t *)events[i].data.ptr;
+
+            if (!client_io(client, latencies, &nb_latencies, depth, &failed))
+            {
+                fprintf(stderr, "Connection lost after %d of %d responses\n", client->received, nb_requests);
+                failed += nb_requests - client->received;
+                client->received = nb_requests;
+            }
+            else
+                top_up(client, type, &request, nb_requests, depth);
+            if (client->received == nb_requests)
+            {
+                close(client->fd);
+                open_clients--;
+                continue;
+            }
+            event.events = EPOLLIN | (client->out.len > client->out.pos ? EPOLLOUT : 0);
+            event.data.ptr = client;
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->fd, &event);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    qsort(latencies, nb_latencies, sizeof(double), compare_doubles);
+    printf("%s: %d clients x %d requests, pipeline %d\n", names[type], nb_clients, nb_requests, depth);
+    printf("%ld requests in %.3f s: %.0f requests/s\n", total, elapsed(&start, &end), total / elapsed(&start, &end));
+    if (nb_latencies)
+        printf("latency p50 %.3f ms  p99 %.3f ms  max %.3f ms\n", latencies[nb_latencies / 2] * 1e3,
+               latencies[nb_latencies * 99 / 100] * 1e3, latencies[nb_latencies - 1] * 1e3);
+    printf("failed: %ld\n", failed);
+
+    for (int c = 0; c < nb_clients; c++)
+    {
+        free(clients[c].sent_at);
+        buffer_free(&clients[c].in);
+        buffer_free(&clients[c].out);
+    }
+    free(clients);
+    free(latencies);
+    buffer_free(&request);
+    close(epoll_fd);
+    return failed ? 1 : 0;
+}
@@ -67,7 +67,7 @@ int create_user(const char *name, int role)
 }
 
 /**
- * serialize_users - Serializes user data to a file
+ * serialize_users - Serializes user data to a file through the journal
  * @users: List of users
  * Return: 1 on success, 0 on failure
  */
@@ -79,7 +79,9 @@ int serialize_users(lusers *users)
         return 0;
     }
 
-    FILE *file = fopen(USERS_DATABASE, "wb");
+    char *data = NULL;
+    size_t size = 0;
+    FILE *file = open_memstream(&data, &size);
     if (!file)
     {
         perror("Failed to open file for serialization");
@@ -109,7 +111,9 @@ int serialize_users(lusers *users)
 
     fclose(file);
     free_users(users);
-    return 1;
+    int result = journal_write(USERS_DATABASE, 0, 1, data, size);
+    free(data);
+    return result;
 }
 
 /**
@@ -118,7 +122,8 @@ int serialize_users(lusers *users)
  */
 lusers *deserialize_users(void)
 {
-    FILE *file = fopen(USERS_DATABASE, "rb");
+    journal_recover();
+    FILE *file = fopen(generation_path(USERS_DATABASE), "rb");
     if (!file)
     {
         fprintf(stderr, "Failed to open users file\n");
@@ -192,6 +197,25 @@ lusers *deserialize_users(void)
     return users;
 }
 
+/**
+ * save_session - records a user as the session user
+ * @user: user signing in
+ * Return: 1 on success else 0
+ */
+int save_session(user_t *user)
+{
+    FILE *file = fopen(SESSION_USER, "wb");
+    if (!file)
+    {
+        fprintf(stderr, "Failed to open current user file for serialization\n");
+        return 0;
+    }
+    fwrite(&user->role, sizeof(user->role), 1, file);
+    fwrite(&user->index, sizeof(user->index), 1, file);
+    fwrite(user->name, sizeof(user->name), 1, file);
+    return fclose(file) == 0;
+}
+
 /**
  * load_user - sign in user
  * @name: user name
@@ -200,7 +224,6 @@ lusers *deserialize_users(void)
  */
 int load_user(const char *name, int idx)
 {
-    FILE *file;
     if (!name)
     {
         fprintf(stderr, "Name not valid\n");
@@ -217,19 +240,9 @@ int load_user(const char *name, int idx)
     {
         if (strcmp(curr->name, name) == 0 && curr->index == idx)
         {
-            file = fopen(SESSION_USER, "wb");
-            if (!file)
-            {
-                fprintf(stderr, "Failed to open current user file for serialization\n");
-                free_users(all_users);
-                return 0;
-            }
-            fwrite(&curr->role, sizeof(curr->role), 1, file);
-            fwrite(&curr->index, sizeof(curr->index), 1, file);
-            fwrite(curr->name, sizeof(curr->name), 1, file);
-
-            fclose(file);
-            return 1;
+            int result = save_session(curr);
+            free_users(all_users);
+            return result;
         }
         curr = curr->next;
     }
@@ -0,0 +1,209 @@
+#include "blockchain.h"
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+/**
+ * peer_address - resolves a HOST:PORT peer address
+ * @spec: host name or IPv4 address, a colon and a port
+ * @addr: where to store the address
+ * Return: 1 on success else 0
+ */
+int peer_address(const char *spec, struct sockaddr_in *addr)
+{
+    struct addrinfo hints, *found;
+    char host[64];
+    const char *colon = strrchr(spec, ':');
+    int port;
+
+    if (!colon || colon == spec || (size_t)(colon - spec) >= sizeof(host) ||
+        (port = atoi(colon + 1)) <= 0 || port > 65535)
+    {
+        fprintf(stderr, "Peer address %s is not HOST:PORT\n", spec);
+        return 0;
+    }
+    memcpy(host, spec, colon - spec);
+    host[colon - spec] = '\0';
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, NULL, &hints, &found) != 0)
+    {
+        fprintf(stderr, "Could not resolve peer host %s\n", host);
+        return 0;
+    }
+    memcpy(addr, found->ai_addr, sizeof(*addr));
+    addr->sin_port = htons((uint16_t)port);
+    freeaddrinfo(found);
+    return 1;
+}
+
+/**
+ * peer_listen - opens the TCP socket other nodes connect to
+ * @addr: address to listen on
+ * Return: non-blocking listening socket or -1 on failure
+ */
+int peer_listen(const struct sockaddr_in *addr)
+{
+    int one = 1, fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (fd < 0)
+    {
+        perror("Failed to create peer socket");
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (const struct sockaddr *)addr, sizeof(*addr)) < 0 || listen(fd, NODE_BACKLOG) < 0)
+    {
+        perror("Failed to listen for peers");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * peer_connect - starts connecting to a peer without waiting for it
+ * Small announcements go out at once instead of waiting to be coalesced
+ * @addr: peer address
+ * Return: non-blocking socket, writable once connected, or -1 on failure
+ */
+int peer_connect(const struct sockaddr_in *addr)
+{
+    int one = 1, fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (fd < 0)
+        return -1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) < 0 && errno != EINPROGRESS)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * peer_put_hello - appends the frame a node introduces itself with
+ * @out: buffer to append to
+ * @height: tip height
+ * @tip: tip hash
+ * Return: 1 on success else 0
+ */
+int peer_put_hello(buffer_t *out, long height, const unsigned char *tip)
+{
+    buffer_t payload;
+    int result;
+
+    buffer_init(&payload);
+    result = buffer_put_varint(&payload, (uint64_t)height) && buffer_put(&payload, tip, SHA256_DIGEST_LENGTH) &&
+             node_frame_put(out, PEER_HELLO, &payload);
+    buffer_free(&payload);
+    return result;
+}
+
+/**
+ * peer_put_block - appends a block to a peer message in its fixed-width
+ * record layout, which carries the address credited its fees
+ * @payload: message to append to
+ * @block: block to send
+ * Return: 1 on success else 0
+ */
+int peer_put_block(buffer_t *payload, Block *block)
+{
+    buffer_t record;
+    int result;
+
+    buffer_init(&record);
+    result = encode_block_fixed(block, &record) &&
+             buffer_put_varint(payload, record.len) && buffer_put(payload, record.data, record.len);
+    buffer_free(&record);
+    return result;
+}
+
+/**
+ * peer_get_block - reads a block written by peer_put_block
+ * @payload: message, read position moved past the block
+ * Return: decoded block or NULL if the message is malformed
+ */
+Block *peer_get_block(buffer_t *payload)
+{
+    buffer_t record;
+    uint64_t len;
+
+    if (!buffer_get_varint(payload, &len) || len > payload->len - payload->pos)
+        return NULL;
+    record.data = payload->data + payload->pos;
+    record.len = record.cap = (size_t)len;
+    record.pos = 0;
+    payload->pos += (size_t)len;
+    return decode_block_fixed(&record);
+}
+
+/**
+ * peer_put_header - appends the header of a block to a peer message
+ * Pruned blocks keep their header, so it can always be sent
+ * @payload: message to append to
+ * @block: block
+ * Return: 1 on success else 0
+ */
+int peer_put_header(buffer_t *payload, const Block *block)
+{
+    return buffer_put(payload, &block->index, sizeof(block->index)) &&
+           buffer_put(payload, &block->timestamp, sizeof(block->timestamp)) &&
+           buffer_put(payload, &block->nonce, sizeof(block->nonce)) &&
+           buffer_put(payload, block->previous_hash, SHA256_DIGEST_LENGTH) &&
+           buffer_put(payload, block->current_hash, SHA256_DIGEST_LENGTH);
+}
+
+/**
+ * peer_get_header - reads a header written by peer_put_header
+ * @payload: message, read position moved past the header
+ * @header: block whose header fields are filled
+ * Return: 1 on success else 0 if the message is malformed
+ */
+int peer_get_header(buffer_t *payload, Block *header)
+{
+    return buffer_get(payload, &header->index, sizeof(header->index)) &&
+           buffer_get(payload, &header->timestamp, sizeof(header->timestamp)) &&
+           buffer_get(payload, &header->nonce, sizeof(header->nonce)) &&
+           buffer_get(payload, header->previous_hash, SHA256_DIGEST_LENGTH) &&
+           buffer_get(payload, header->current_hash, SHA256_DIGEST_LENGTH);
+}
+
+/**
+ * peer_put_transaction - appends a pending transaction to a peer message,
+ * in the layout of a node submit request
+ * @payload: message to append to
+ * @trans: transaction, its index is the sender's sequence number
+ * Return: 1 on success else 0
+ */
+int peer_put_transaction(buffer_t *payload, const Transaction *trans)
+{
+    return buffer_put(payload, trans->sender, ADDRESS_SIZE) && buffer_put(payload, trans->receiver, ADDRESS_SIZE) &&
+           buffer_put_svarint(payload, trans->amount) && buffer_put_svarint(payload, trans->index);
+}
+
+/**
+ * peer_get_transaction - reads a pending transaction written by
+ * peer_put_transaction
+ * @payload: message
+ * @trans: transaction to fill, its index set to the sequence number and
+ * its status to INITIATED
+ * Return: 1 on success else 0 if the transaction is malformed
+ */
+int peer_get_transaction(buffer_t *payload, Transaction *trans)
+{
+    int64_t amount, sequence;
+
+    if (!buffer_get(payload, trans->sender, ADDRESS_SIZE) || !buffer_get(payload, trans->receiver, ADDRESS_SIZE) ||
+        !buffer_get_svarint(payload, &amount) || !buffer_get_svarint(payload, &sequence) || amount <= 0 ||
+        amount > INT32_MAX || sequence < 0 || sequence > INT32_MAX)
+        return 0;
+    trans->amount = (int)amount;
+    trans->index = (int)sequence;
+    trans->status = INITIATED;
+    trans->next = NULL;
+    return 1;
+}
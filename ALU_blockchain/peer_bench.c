@@ -0,0 +1,798 @@
+#include "blockchain.h"
+#include <ctype.h>
+#include <dirent.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+/**
+ * elapsed - seconds between two monotonic clock readings
+ * @start: first reading
+ * @end: second reading
+ * Return: elapsed seconds
+ */
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * compare_doubles - orders latencies
+ * @a: first latency
+ * @b: second latency
+ * Return: comparison result for qsort
+ */
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * print_latencies - prints the spread of a set of latencies
+ * @label: what was measured
+ * @latencies: latencies in seconds, sorted in place
+ * @count: number of latencies
+ */
+static void print_latencies(const char *label, double *latencies, int count)
+{
+    qsort(latencies, count, sizeof(double), compare_doubles);
+    printf("%-24s p50 %.3f ms  p99 %.3f ms  max %.3f ms\n", label, latencies[count / 2] * 1e3,
+           latencies[count * 99 / 100] * 1e3, latencies[count - 1] * 1e3);
+}
+
+/**
+ * mine_on - builds a block on a tip, grinding the nonce until the hash
+ * meets the difficulty peers expect at its height
+ * @height: height of the block
+ * @tip: hash of the tip it extends
+ * @timestamp: block timestamp
+ * @difficulty: difficulty the schedule sets for the block
+ * @txs: transactions of the block, owned by it, NULL for none
+ * Return: block or NULL on failure
+ */
+static Block *mine_on(long height, const unsigned char *tip, int64_t timestamp, int difficulty, utxo_t *txs)
+{
+    Block *block = (Block *)calloc(1, sizeof(Block));
+
+    if (!block || !(block->transactions = txs ? txs : (utxo_t *)calloc(1, sizeof(utxo_t))))
+    {
+        free(block);
+        free_transactions(txs);
+        return NULL;
+    }
+    block->index = (unsigned int)height;
+    block->timestamp = timestamp;
+    memcpy(block->previous_hash, tip, SHA256_DIGEST_LENGTH);
+    do
+    {
+        calculate_hash(block, block->current_hash);
+    } while (!is_valid_hash(block->current_hash, difficulty) && ++block->nonce);
+    return block;
+}
+
+/**
+ * join_node - connects to a node as a peer and reads its tip
+ * @addr: node peer address
+ * @height: where to store the node's tip height
+ * @tip: SHA256_DIGEST_LENGTH bytes to fill with the node's tip hash
+ * Return: blocking socket or -1 on failure
+ */
+static int join_node(const struct sockaddr_in *addr, long *height, unsigned char *tip)
+{
+    static const unsigned char no_tip[SHA256_DIGEST_LENGTH];
+    buffer_t payload;
+    uint64_t value;
+    uint32_t type = 0;
+    int one = 1, fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (fd < 0 || connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) < 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    /* Introduced at height 0, so no node ever asks the benchmark for blocks */
+    buffer_init(&payload);
+    if (!buffer_put_varint(&payload, 0) || !buffer_put(&payload, no_tip, sizeof(no_tip)) ||
+        !node_send(fd, PEER_HELLO, &payload) || !node_receive(fd, &type, &payload) || type != PEER_HELLO ||
+        !buffer_get_varint(&payload, &value) || !buffer_get(&payload, tip, SHA256_DIGEST_LENGTH))
+    {
+        buffer_free(&payload);
+        close(fd);
+        return -1;
+    }
+    buffer_free(&payload);
+    *height = (long)value;
+    return fd;
+}
+
+/**
+ * tip_schedule - replays the difficulty schedule over the headers of a
+ * node's chain
+ * @fd: node socket
+ * @height: tip height of the node
+ * @timestamp: where to store the tip timestamp
+ * @difficulty: where to store the difficulty of the block after the tip
+ * Return: 1 on success else 0
+ */
+static int tip_schedule(int fd, long height, int64_t *timestamp, int *difficulty)
+{
+    Block header, previous = {0};
+    buffer_t payload;
+    uint64_t count;
+    uint32_t type;
+    long next = 0;
+    int result = 1;
+
+    *difficulty = INITIAL_DIFFICULTY;
+    buffer_init(&payload);
+    while (result && next <= height)
+    {
+        payload.len = payload.pos = 0;
+        result = buffer_put_varint(&payload, (uint64_t)next) && buffer_put_varint(&payload, PEER_HEADERS_MAX) &&
+                 node_send(fd, PEER_GET_HEADERS, &payload);
+        /* Announcements the node relays meanwhile are skipped */
+        do
+            result = result && node_receive(fd, &type, &payload);
+        while (result && type != PEER_HEADERS);
+        result = result && buffer_get_varint(&payload, &count) && count > 0;
+        for (uint64_t i = 0; result && i < count; i++)
+        {
+            result = peer_get_header(&payload, &header) && (long)header.index == next;
+            if (result)
+                *difficulty = next_difficulty(next ? &previous : NULL, &header, *difficulty);
+            previous = header;
+            next++;
+        }
+    }
+    buffer_free(&payload);
+    *timestamp = previous.timestamp;
+    return result;
+}
+
+/**
+ * pick_accounts - chooses the accounts the benchmark transactions move
+ * tokens between, from the users of the node directory it runs in; the
+ * transaction indexes are built there first if they are missing
+ * @sender: ADDRESS_SIZE bytes to fill with the richest wallet
+ * @receiver: ADDRESS_SIZE bytes to fill with another wallet
+ * @sequence: where to store the next sequence number of the sender
+ * Return: 1 on success else 0
+ */
+static int pick_accounts(unsigned char *sender, unsigned char *receiver, long *sequence)
+{
+    lusers *users = deserialize_users();
+    user_t *richest = NULL, *other = NULL;
+    uint64_t next = 0;
+
+    for (user_t *user = users ? users->head : NULL; user; user = user->next)
+    {
+        if (!user->wallet)
+            continue;
+        if (!richest || user->wallet->balance > richest->wallet->balance)
+        {
+            other = richest;
+            richest = user;
+        }
+        else if (!other)
+            other = user;
+    }
+    if (!richest || !other || !txid_rebuild() ||
+        disk_table_lookup(TX_SEQUENCE_INDEX, richest->wallet->address, ADDRESS_SIZE, &next) < 0)
+    {
+        if (users)
+            free_users(users);
+        return 0;
+    }
+    memcpy(sender, richest->wallet->address, ADDRESS_SIZE);
+    memcpy(receiver, other->wallet->address, ADDRESS_SIZE);
+    *sequence = (long)next;
+    free_users(users);
+    return 1;
+}
+
+/**
+ * inv_count - number of transaction IDs a peer frame announces
+ * @type: frame type
+ * @frame: frame payload
+ * Return: number of IDs, 0 if the frame is no PEER_INV
+ */
+static uint64_t inv_count(uint32_t type, buffer_t *frame)
+{
+    uint64_t count = 0;
+
+    if (type != PEER_INV || !buffer_get_varint(frame, &count) || frame->len - frame->pos != count * TXID_SIZE)
+        return 0;
+    return count;
+}
+
+/**
+ * spread_txs - submits transactions to the first node and waits until
+ * every other node announced them, so they sit in every pool before a
+ * block holding them is announced
+ * @fds: node sockets
+ * @nb_nodes: number of nodes
+ * @sender: sender address
+ * @receiver: receiver address
+ * @sequence: next sequence number of the sender, moved past the new ones
+ * @nb_txs: number of transactions
+ * Return: the transactions, confirmed as a block holds them, or NULL on
+ * timeout or error
+ */
+static utxo_t *spread_txs(int *fds, int nb_nodes, const unsigned char *sender, const unsigned char *receiver,
+                          long *sequence, int nb_txs)
+{
+    utxo_t *txs = (utxo_t *)calloc(1, sizeof(utxo_t));
+    struct pollfd polls[PEERS_MAX];
+    int received[PEERS_MAX] = {0}, pending = nb_nodes - 1, result = txs != NULL;
+    buffer_t frame;
+    uint32_t type;
+    Transaction *trans;
+
+    buffer_init(&frame);
+    for (int i = 0; result && i < nb_txs; i++)
+    {
+        trans = (Transaction *)calloc(1, sizeof(Transaction));
+        result = trans != NULL;
+        if (!result)
+            break;
+        memcpy(trans->sender, sender, ADDRESS_SIZE);
+        memcpy(trans->receiver, receiver, ADDRESS_SIZE);
+        trans->amount = 1;
+        trans->index = (int)(*sequence)++;
+        trans->status = SUCCESS;
+        if (txs->tail)
+            txs->tail->next = trans;
+        else
+            txs->head = trans;
+        txs->tail = trans;
+        txs->nb_trans++;
+        frame.len = frame.pos = 0;
+        result = peer_put_transaction(&frame, trans) && node_send(fds[0], PEER_TX, &frame);
+    }
+    for (int i = 1; i < nb_nodes; i++)
+    {
+        polls[i].fd = fds[i];
+        polls[i].events = POLLIN;
+    }
+    while (result && pending > 0)
+    {
+        result = poll(polls + 1, nb_nodes - 1, 5000) > 0;
+        for (int i = 1; result && i < nb_nodes; i++)
+        {
+            if (!(polls[i].revents & POLLIN))
+                continue;
+            result = node_receive(fds[i], &type, &frame);
+            if (result && (received[i] += inv_count(type, &frame)) >= nb_txs && polls[i].fd >= 0)
+            {
+                polls[i].fd = -1;
+                pending--;
+            }
+        }
+    }
+    buffer_free(&frame);
+    if (!result)
+    {
+        free_transactions(txs);
+        return NULL;
+    }
+    return txs;
+}
+
+/**
+ * frame_height - height of the block a block announcement carries
+ * @type: PEER_BLOCK or PEER_COMPACT_BLOCK
+ * @frame: announcement payload
+ * Return: block height or -1 if the frame is no block announcement
+ */
+static long frame_height(uint32_t type, buffer_t *frame)
+{
+    compact_block_t *compact;
+    Block *block;
+    long height = -1;
+
+    if (type == PEER_BLOCK && (block = peer_get_block(frame)))
+    {
+        height = block->index;
+        free_transactions(block->transactions);
+        free(block);
+    }
+    else if (type == PEER_COMPACT_BLOCK && (compact = compact_get(frame)))
+    {
+        height = compact->block->index;
+        compact_free(compact);
+    }
+    return height;
+}
+
+/**
+ * wait_block - waits until every other node relayed a block to the
+ * benchmark, recording when each one did and how many bytes it took
+ * @fds: node sockets, the block was announced to the first
+ * @nb_nodes: number of nodes
+ * @height: height of the block
+ * @start: time the block was announced
+ * @latencies: filled with the arrival latency per node, index 0 unused
+ * @bytes: incremented by the size of each announcement
+ * Return: 1 once every node relayed it else 0 on timeout or error
+ */
+static int wait_block(int *fds, int nb_nodes, long height, struct timespec *start, double *latencies,
+                      size_t *bytes)
+{
+    struct pollfd polls[PEERS_MAX];
+    struct timespec now;
+    buffer_t frame;
+    uint32_t type;
+    int pending = nb_nodes - 1, result = 1;
+    size_t len;
+
+    buffer_init(&frame);
+    for (int i = 1; i < nb_nodes; i++)
+    {
+        polls[i].fd = fds[i];
+        polls[i].events = POLLIN;
+    }
+    while (result && pending > 0)
+    {
+        result = poll(polls + 1, nb_nodes - 1, 5000) > 0;
+        for (int i = 1; result && i < nb_nodes; i++)
+        {
+            if (!(polls[i].revents & POLLIN))
+                continue;
+            result = node_receive(fds[i], &type, &frame);
+            len = frame.len;
+            if (result && frame_height(type, &frame) == height && polls[i].fd >= 0)
+            {
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                latencies[i] = elapsed(start, &now);
+                *bytes += len;
+                /* A negative descriptor is no longer polled */
+                polls[i].fd = -1;
+                pending--;
+            }
+        }
+    }
+    buffer_free(&frame);
+    return result;
+}
+
+/**
+ * node_pid - finds the local process listening on a TCP port through the
+ * socket table and the descriptors /proc lists
+ * @port: port in host order
+ * Return: process ID or -1 if no process the benchmark can see listens on
+ * it
+ */
+static long node_pid(int port)
+{
+    char line[512], path[600], link[64], socket_name[64];
+    unsigned int local_port, state;
+    unsigned long inode = 0, candidate;
+    struct dirent *process, *entry;
+    FILE *file = fopen("/proc/net/tcp", "r");
+    DIR *processes, *fds;
+    ssize_t len;
+    long pid = -1;
+
+    while (file && !inode && fgets(line, sizeof(line), file))
+    {
+        /* Listening sockets are in state 0A */
+        if (sscanf(line, " %*d: %*x:%x %*x:%*x %x %*s %*s %*s %*s %*s %lu", &local_port, &state, &candidate) == 3 &&
+            (int)local_port == port && state == 0x0A)
+            inode = candidate;
+    }
+    if (file)
+        fclose(file);
+    if (!inode)
+        return -1;
+    snprintf(socket_name, sizeof(socket_name), "socket:[%lu]", inode);
+    processes = opendir("/proc");
+    while (processes && pid < 0 && (process = readdir(processes)))
+    {
+        if (!isdigit((unsigned char)process->d_name[0]))
+            continue;
+        snprintf(path, sizeof(path), "/proc/%s/fd", process->d_name);
+        fds = opendir(path);
+        while (fds && pid < 0 && (entry = readdir(fds)))
+        {
+            snprintf(path, sizeof(path), "/proc/%s/fd/%s", process->d_name, entry->d_name);
+            len = readlink(path, link, sizeof(link) - 1);
+            if (len > 0 && (link[len] = '\0', strcmp(link, socket_name) == 0))
+                pid = atol(process->d_name);
+        }
+        if (fds)
+            closedir(fds);
+    }
+    if (processes)
+        closedir(processes);
+    return pid;
+}
+
+/**
+ * cpu_seconds - processor time a process used so far, user and system
+ * @pid: process ID, -1 for none
+ * Return: seconds or -1 if unknown
+ */
+static double cpu_seconds(long pid)
+{
+    char path[64], line[1024], *end;
+    unsigned long user, system;
+    FILE *file;
+    int found;
+
+    snprintf(path, sizeof(path), "/proc/%ld/stat", pid);
+    file = pid > 0 ? fopen(path, "r") : NULL;
+    found = file && fgets(line, sizeof(line), file) && (end = strrchr(line, ')')) &&
+            sscanf(end + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &user, &system) == 2;
+    if (file)
+        fclose(file);
+    return found ? (double)(user + system) / sysconf(_SC_CLK_TCK) : -1;
+}
+
+/**
+ * tx_position - position of a benchmark transaction by ID
+ * @slots: position plus one per slot, 0 when empty
+ * @mask: number of slots minus one
+ * @ids: TXID_SIZE bytes per transaction
+ * @id: transaction ID
+ * Return: position or -1 if the benchmark did not submit it
+ */
+static int tx_position(int *slots, uint32_t mask, const unsigned char *ids, const unsigned char *id)
+{
+    uint32_t slot;
+
+    memcpy(&slot, id, sizeof(slot));
+    for (slot &= mask; slots[slot] && memcmp(ids + (slots[slot] - 1) * TXID_SIZE, id, TXID_SIZE) != 0;
+         slot = (slot + 1) & mask)
+        ;
+    return slots[slot] - 1;
+}
+
+/**
+ * gossip_txs - submits transactions to the first node at a steady rate
+ * and times when every node announces each of them
+ * Gives up five seconds after the last submission
+ * @fds: node sockets
+ * @nb_nodes: number of nodes
+ * @trans: first transaction, the next ones take the next sequence numbers
+ * @ids: TXID_SIZE bytes per transaction
+ * @nb_txs: number of transactions
+ * @rate: transactions per second
+ * @latencies: nb_txs per node, filled with the announce latency of each
+ * transaction, -1 if the node never announced it
+ * Return: number of announcements received, -1 on error
+ */
+static long gossip_txs(int *fds, int nb_nodes, Transaction *trans, const unsigned char *ids, int nb_txs, int rate,
+                       double *latencies)
+{
+    struct timespec start, now, *sent_at = (struct timespec *)malloc(nb_txs * sizeof(struct timespec));
+    struct pollfd polls[PEERS_MAX];
+    uint32_t mask = 1, slot, type;
+    long received = 0;
+    int *slots, sent = 0, due, position, result;
+    buffer_t frame, tx;
+    uint64_t count;
+
+    while (mask < (uint32_t)nb_txs * 2)
+        mask <<= 1;
+    slots = (int *)calloc(mask--, sizeof(int));
+    result = sent_at && slots;
+    for (int i = 0; result && i < nb_txs; i++)
+    {
+        memcpy(&slot, ids + i * TXID_SIZE, sizeof(slot));
+        for (slot &= mask; slots[slot]; slot = (slot + 1) & mask)
+            ;
+        slots[slot] = i + 1;
+    }
+    for (int i = 0; i < nb_txs * nb_nodes; i++)
+        latencies[i] = -1;
+    for (int i = 0; i < nb_nodes; i++)
+    {
+        polls[i].fd = fds[i];
+        polls[i].events = POLLIN;
+    }
+
+    buffer_init(&frame);
+    buffer_init(&tx);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    now = start;
+    while (result && received < (long)nb_txs * nb_nodes)
+    {
+        due = (int)(elapsed(&start, &now) * rate) + 1;
+        for (; result && sent < nb_txs && sent < due; sent++, trans->index++)
+        {
+            tx.len = 0;
+            sent_at[sent] = now;
+            result = peer_put_transaction(&tx, trans) && node_send(fds[0], PEER_TX, &tx);
+        }
+        if (sent == nb_txs && elapsed(&sent_at[nb_txs - 1], &now) > 5)
+            break;
+        result = result && poll(polls, nb_nodes, sent < nb_txs ? 1 : 100) >= 0;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        for (int i = 0; result && i < nb_nodes; i++)
+        {
+            if (!(polls[i].revents & POLLIN))
+                continue;
+            result = node_receive(fds[i], &type, &frame);
+            count = result ? inv_count(type, &frame) : 0;
+            for (uint64_t j = 0; j < count; j++)
+            {
+                position = tx_position(slots, mask, ids, frame.data + frame.pos + j * TXID_SIZE);
+                if (position >= 0 && position < sent && latencies[i * nb_txs + position] < 0)
+                {
+                    latencies[i * nb_txs + position] = elapsed(&sent_at[position], &now);
+                    received++;
+                }
+            }
+        }
+    }
+    buffer_free(&frame);
+    buffer_free(&tx);
+    free(sent_at);
+    free(slots);
+    return result ? received : -1;
+}
+
+/**
+ * bench_gossip - measures how fast transactions submitted to one node
+ * reach every node's pool, and what gossiping them costs each node
+ * @fds: node sockets
+ * @addrs: node peer addresses
+ * @nb_nodes: number of nodes
+ * @rate: transactions per second
+ * @seconds: seconds of load
+ * Return: 0 on success else 1
+ */
+static int bench_gossip(int *fds, struct sockaddr_in *addrs, int nb_nodes, int rate, int seconds)
+{
+    unsigned char sender[ADDRESS_SIZE] = {0}, receiver[ADDRESS_SIZE] = {0}, *ids;
+    int nb_txs = rate * seconds, count, complete = 0;
+    double *latencies, *slowest, before[PEERS_MAX], after;
+    struct timespec start, end;
+    long pids[PEERS_MAX], sequence, received;
+    Transaction trans;
+    char label[64];
+
+    if (!pick_accounts(sender, receiver, &sequence))
+    {
+        fprintf(stderr, "Transactions need the accounts of a node directory\n");
+        return 1;
+    }
+    ids = (unsigned char *)malloc((size_t)nb_txs * TXID_SIZE);
+    latencies = (double *)malloc(sizeof(double) * nb_txs * nb_nodes);
+    slowest = (double *)malloc(sizeof(double) * nb_txs);
+    if (!ids || !latencies || !slowest)
+    {
+        fprintf(stderr, "Could not set up the benchmark\n");
+        return 1;
+    }
+    memcpy(trans.sender, sender, ADDRESS_SIZE);
+    memcpy(trans.receiver, receiver, ADDRESS_SIZE);
+    trans.amount = 1;
+    for (int i = 0; i < nb_txs; i++)
+    {
+        trans.index = (int)sequence + i;
+        transaction_id(&trans, ids + i * TXID_SIZE);
+    }
+    trans.index = (int)sequence;
+    for (int i = 0; i < nb_nodes; i++)
+    {
+        pids[i] = node_pid(ntohs(addrs[i].sin_port));
+        before[i] = cpu_seconds(pids[i]);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    received = gossip_txs(fds, nb_nodes, &trans, ids, nb_txs, rate, latencies);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (received < 0)
+    {
+        fprintf(stderr, "Lost a node while gossiping\n");
+        return 1;
+    }
+
+    /* A transaction counts for all nodes once the last one announced it */
+    for (int t = 0; t < nb_txs; t++)
+    {
+        slowest[complete] = 0;
+        for (int i = 0; i < nb_nodes && slowest[complete] >= 0; i++)
+        {
+            if (latencies[i * nb_txs + t] < 0 || latencies[i * nb_txs + t] > slowest[complete])
+                slowest[complete] = latencies[i * nb_txs + t];
+        }
+        if (slowest[complete] >= 0)
+            complete++;
+    }
+    printf("%d transactions at %d tx/s gossiped through %d nodes: %d reached every node\n", nb_txs, rate, nb_nodes,
+           complete);
+    for (int i = 0; i < nb_nodes; i++)
+    {
+        count = 0;
+        for (int t = 0; t < nb_txs; t++)
+        {
+            if (latencies[i * nb_txs + t] >= 0)
+                latencies[i * nb_txs + count++] = latencies[i * nb_txs + t];
+        }
+        snprintf(label, sizeof(label), "node %d:", i + 1);
+        if (count > 0)
+            print_latencies(label, latencies + i * nb_txs, count);
+        after = cpu_seconds(pids[i]);
+        snprintf(label, sizeof(label), "node %d cpu:", i + 1);
+        if (before[i] >= 0 && after >= 0)
+            printf("%-24s %.1f%% of a core\n", label, (after - before[i]) * 100 / elapsed(&start, &end));
+        else
+            printf("%-24s not a local process\n", label);
+    }
+    if (complete > 0)
+        print_latencies("all nodes:", slowest, complete);
+    free(ids);
+    free(latencies);
+    free(slowest);
+    return 0;
+}
+
+/**
+ * main - measures how fast a block announced to one node reaches the others
+ * The benchmark joins every node as a peer, mines blocks on their common
+ * tip, announces each to the first node and times its relay by every other
+ * node, counting the bytes each relay took. With transactions, they are
+ * spread to every pool before the block holding them is announced, as
+ * happens when a miner confirms pending transactions. With a rate, it
+ * submits transactions to the first node instead and times when every node
+ * announces each one, reporting the processor time of the local nodes.
+ * Transactions need the benchmark to run in the directory of one of the
+ * nodes to find their accounts
+ * @argc: argument count
+ * @argv: --peer=HOST:PORT per node, at least two, the first one receiving
+ * the blocks or transactions, --blocks=N blocks to announce and --txs=N
+ * transactions per block, or --rate=N transactions per second for
+ * --seconds=N seconds
+ * Return: 0 on success else 1
+ */
+int main(int argc, char **argv)
+{
+    unsigned char tip[SHA256_DIGEST_LENGTH], other_tip[SHA256_DIGEST_LENGTH];
+    unsigned char sender[ADDRESS_SIZE] = {0}, receiver[ADDRESS_SIZE] = {0};
+    struct sockaddr_in addrs[PEERS_MAX];
+    struct timespec start, begin, end;
+    double *latencies, *slowest, arrival[PEERS_MAX], spreading = 0;
+    int fds[PEERS_MAX], nb_nodes = 0, nb_blocks = 100, nb_txs = 0, rate = 0, seconds = 10, status;
+    long height, other_height, sequence = 0;
+    int64_t timestamp, previous, before = 0;
+    int difficulty;
+    size_t bytes = 0;
+    utxo_t *txs = NULL;
+    buffer_t payload;
+    char label[64];
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--peer=", 7) == 0 && nb_nodes < PEERS_MAX && peer_address(argv[i] + 7, &addrs[nb_nodes]))
+            nb_nodes++;
+        else if (strncmp(argv[i], "--blocks=", 9) == 0 && atoi(argv[i] + 9) > 0)
+            nb_blocks = atoi(argv[i] + 9);
+        else if (strncmp(argv[i], "--txs=", 6) == 0 && atoi(argv[i] + 6) >= 0)
+            nb_txs = atoi(argv[i] + 6);
+        else if (strncmp(argv[i], "--rate=", 7) == 0 && atoi(argv[i] + 7) > 0)
+            rate = atoi(argv[i] + 7);
+        else if (strncmp(argv[i], "--seconds=", 10) == 0 && atoi(argv[i] + 10) > 0)
+            seconds = atoi(argv[i] + 10);
+        else
+            nb_nodes = -PEERS_MAX;
+    }
+    if (nb_nodes < 2)
+    {
+        fprintf(stderr, "Usage: %s --peer=HOST:PORT --peer=HOST:PORT... [--blocks=N] [--txs=N] [--rate=N [--seconds=N]]\n",
+                argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (nb_txs > 0 && rate == 0 && !pick_accounts(sender, receiver, &sequence))
+    {
+        fprintf(stderr, "Transactions need the accounts of a node directory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < nb_nodes; i++)
+    {
+        fds[i] = join_node(&addrs[i], i ? &other_height : &height, i ? other_tip : tip);
+        if (fds[i] < 0)
+        {
+            fprintf(stderr, "Could not join node %d as a peer\n", i + 1);
+            exit(EXIT_FAILURE);
+        }
+        if (i && (other_height != height || memcmp(other_tip, tip, sizeof(tip)) != 0))
+        {
+            fprintf(stderr, "Node %d is at height %ld, not on the tip of node 1 at %ld; let them sync first\n", i + 1,
+                    other_height, height);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (rate > 0)
+    {
+        status = bench_gossip(fds, addrs, nb_nodes, rate, seconds);
+        for (int i = 0; i < nb_nodes; i++)
+            close(fds[i]);
+        return status;
+    }
+
+    latencies = (double *)malloc(sizeof(double) * nb_blocks * nb_nodes);
+    slowest = (double *)malloc(sizeof(double) * nb_blocks);
+    if (!latencies || !slowest || !tip_schedule(fds[0], height, &timestamp, &difficulty))
+    {
+        fprintf(stderr, "Could not set up the benchmark\n");
+        exit(EXIT_FAILURE);
+    }
+    buffer_init(&payload);
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (int b = 0; b < nb_blocks; b++)
+    {
+        Block *block;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (nb_txs > 0 && !(txs = spread_txs(fds, nb_nodes, sender, receiver, &sequence, nb_txs)))
+        {
+            fprintf(stderr, "Transactions for block %ld did not reach every node\n", height + 1);
+            exit(EXIT_FAILURE);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        spreading += elapsed(&start, &end);
+        /* Spaced so the difficulty holds however fast the blocks come,
+         * and no earlier than the clock so the run stays within the drift
+         * peers accept as long as it can */
+        previous = timestamp;
+        timestamp += (int64_t)PEER_BENCH_INTERVAL * TIMESTAMP_RESOLUTION;
+        if (timestamp < current_timestamp())
+            timestamp = current_timestamp();
+        if (b > 0)
+            difficulty = adjust_difficulty(before, previous, difficulty);
+        before = previous;
+        block = mine_on(height + 1, tip, timestamp, difficulty, txs);
+
+        payload.len = payload.pos = 0;
+        if (!block || !peer_put_block(&payload, block))
+        {
+            fprintf(stderr, "Could not build block %ld\n", height + 1);
+            exit(EXIT_FAILURE);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (!node_send(fds[0], PEER_BLOCK, &payload) ||
+            !wait_block(fds, nb_nodes, height + 1, &start, arrival, &bytes))
+        {
+            fprintf(stderr, "Block %ld did not reach every node\n", height + 1);
+            exit(EXIT_FAILURE);
+        }
+        height++;
+        memcpy(tip, block->current_hash, sizeof(tip));
+        free_transactions(block->transactions);
+        free(block);
+
+        slowest[b] = 0;
+        for (int i = 1; i < nb_nodes; i++)
+        {
+            latencies[(i - 1) * nb_blocks + b] = arrival[i];
+            if (arrival[i] > slowest[b])
+                slowest[b] = arrival[i];
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    printf("%d blocks of %d transactions relayed through %d nodes in %.3f s: %.0f blocks/s\n", nb_blocks,
+           nb_txs, nb_nodes, elapsed(&begin, &end) - spreading, nb_blocks / (elapsed(&begin, &end) - spreading));
+    printf("%-24s %.0f bytes per block\n", "relayed:", (double)bytes / nb_blocks / (nb_nodes - 1));
+    for (int i = 1; i < nb_nodes; i++)
+    {
+        snprintf(label, sizeof(label), "node %d:", i + 1);
+        print_latencies(label, latencies + (i - 1) * nb_blocks, nb_blocks);
+    }
+    print_latencies("all nodes:", slowest, nb_blocks);
+
+    for (int i = 0; i < nb_nodes; i++)
+        close(fds[i]);
+    free(latencies);
+    free(slowest);
+    buffer_free(&payload);
+    return 0;
+}
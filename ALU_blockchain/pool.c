@@ -0,0 +1,79 @@
+#include "blockchain.h"
+
+/**
+ * pool_put_work - appends a nonce range to a pool message: the template
+ * number, the difficulty, the timestamp and the range, then the template;
+ * no work leaves the message empty
+ * @payload: message to append to
+ * @work: range to hand out, its block NULL for no work
+ * Return: 1 on success else 0
+ */
+int pool_put_work(buffer_t *payload, const pool_work_t *work)
+{
+    if (!work->block)
+        return 1;
+    return buffer_put_varint(payload, work->job) && buffer_put_varint(payload, (uint64_t)work->difficulty) &&
+           buffer_put_svarint(payload, work->timestamp) && buffer_put_varint(payload, work->first) &&
+           buffer_put_varint(payload, work->count) && peer_put_block(payload, work->block);
+}
+
+/**
+ * pool_get_work - reads a nonce range written by pool_put_work
+ * @payload: message
+ * @work: range to fill, its block decoded, or NULL if there is no work
+ * Return: 1 on success else 0 if the message is malformed
+ */
+int pool_get_work(buffer_t *payload, pool_work_t *work)
+{
+    uint64_t difficulty, first, count;
+
+    memset(work, 0, sizeof(*work));
+    if (payload->pos == payload->len)
+        return 1;
+    if (!buffer_get_varint(payload, &work->job) || !buffer_get_varint(payload, &difficulty) ||
+        !buffer_get_svarint(payload, &work->timestamp) || !buffer_get_varint(payload, &first) ||
+        !buffer_get_varint(payload, &count) || difficulty > SHA256_DIGEST_LENGTH || first > UINT32_MAX ||
+        count > UINT32_MAX - first)
+        return 0;
+    work->difficulty = (int)difficulty;
+    work->first = (uint32_t)first;
+    work->count = (uint32_t)count;
+    work->block = peer_get_block(payload);
+    if (work->block && payload->pos != payload->len)
+    {
+        free_transactions(work->block->transactions);
+        free(work->block);
+        work->block = NULL;
+    }
+    return work->block != NULL;
+}
+
+/**
+ * pool_put_share - appends a share to a pool message
+ * @payload: message to append to
+ * @share: share found
+ * Return: 1 on success else 0
+ */
+int pool_put_share(buffer_t *payload, const pool_share_t *share)
+{
+    return buffer_put_varint(payload, share->job) && buffer_put_svarint(payload, share->timestamp) &&
+           buffer_put_varint(payload, share->nonce) && buffer_put_varint(payload, share->hashes);
+}
+
+/**
+ * pool_get_share - reads a share written by pool_put_share
+ * @payload: message
+ * @share: share to fill
+ * Return: 1 on success else 0 if the message is malformed
+ */
+int pool_get_share(buffer_t *payload, pool_share_t *share)
+{
+    uint64_t nonce;
+
+    if (!buffer_get_varint(payload, &share->job) || !buffer_get_svarint(payload, &share->timestamp) ||
+        !buffer_get_varint(payload, &nonce) || !buffer_get_varint(payload, &share->hashes) || nonce > UINT32_MAX ||
+        payload->pos != payload->len)
+        return 0;
+    share->nonce = (uint32_t)nonce;
+    return 1;
+}
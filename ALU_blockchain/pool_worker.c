@@ -0,0 +1,184 @@
+#include "blockchain.h"
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+/**
+ * join_pool - connects to the node running the pool
+ * @addr: pool address of the node
+ * Return: blocking socket or -1 on failure
+ */
+static int join_pool(const struct sockaddr_in *addr)
+{
+    int one = 1, fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (fd < 0 || connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) < 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+/**
+ * drop_work - frees the template of a range
+ * @work: range, its block set to NULL
+ */
+static void drop_work(pool_work_t *work)
+{
+    if (!work->block)
+        return;
+    free_transactions(work->block->transactions);
+    free(work->block);
+    work->block = NULL;
+}
+
+/**
+ * mine_range - tries the nonces of a range until one solves the template,
+ * checking for new work every POOL_POLL_HASHES hashes
+ * @fd: pool link
+ * @work: range to mine, its block keeps the nonce of a share
+ * @hashes: incremented with every hash tried
+ * Return: 1 if a nonce solves the template, 0 once the range is used up,
+ * or -1 if the node sent new work
+ */
+static int mine_range(int fd, pool_work_t *work, uint64_t *hashes)
+{
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    struct pollfd poll_fd = {fd, POLLIN, 0};
+    Block *block = work->block;
+
+    block->timestamp = work->timestamp;
+    for (uint32_t i = 0; i < work->count; i++)
+    {
+        if (i > 0 && i % POOL_POLL_HASHES == 0 && poll(&poll_fd, 1, 0) > 0)
+            return -1;
+        block->nonce = work->first + i;
+        calculate_hash(block, hash);
+        (*hashes)++;
+        if (is_valid_hash(hash, work->difficulty))
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * send_share - tells the node a nonce solves its template
+ * @fd: pool link
+ * @work: range the nonce was found in
+ * @hashes: hashes tried since the last message
+ * Return: 1 on success else 0
+ */
+static int send_share(int fd, pool_work_t *work, uint64_t hashes)
+{
+    pool_share_t share = {work->job, work->timestamp, work->block->nonce, hashes};
+    buffer_t payload;
+    int result;
+
+    buffer_init(&payload);
+    result = pool_put_share(&payload, &share) && node_send(fd, POOL_SHARE, &payload);
+    buffer_free(&payload);
+    return result;
+}
+
+/**
+ * send_get_work - asks the node for the next range
+ * @fd: pool link
+ * @hashes: hashes tried since the last message
+ * Return: 1 on success else 0
+ */
+static int send_get_work(int fd, uint64_t hashes)
+{
+    buffer_t payload;
+    int result;
+
+    buffer_init(&payload);
+    result = buffer_put_varint(&payload, hashes) && node_send(fd, POOL_GET_WORK, &payload);
+    buffer_free(&payload);
+    return result;
+}
+
+/**
+ * main - mines the block templates of a node's pool over TCP, the nonce
+ * ranges the node hands out one after the other, until the node goes away
+ * or the time is up
+ * Work the node sends while a range is mined replaces it: the tip moved or
+ * the block was solved
+ * @argc: number of arguments
+ * @argv: HOST:PORT the node accepts pool workers on, then --seconds=N to
+ * stop after N seconds
+ * Return: EXIT_SUCCESS or EXIT_FAILURE
+ */
+int main(int argc, char **argv)
+{
+    struct sockaddr_in addr;
+    struct timespec start, now;
+    pool_work_t work = {0, 0, 0, 0, 0, NULL};
+    uint64_t hashes = 0, reported = 0;
+    int fd, seconds = 0, found = -1, result, nb_shares = 0;
+    struct pollfd poll_fd;
+    buffer_t payload;
+    uint32_t type;
+    double taken;
+
+    if (argc > 3 || argc < 2 || !peer_address(argv[1], &addr) ||
+        (argc == 3 && (strncmp(argv[2], "--seconds=", 10) != 0 || (seconds = atoi(argv[2] + 10)) <= 0)))
+    {
+        fprintf(stderr, "Usage: %s HOST:PORT [--seconds=N]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    fd = join_pool(&addr);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Could not reach the pool at %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    poll_fd.fd = fd;
+    poll_fd.events = POLLIN;
+    buffer_init(&payload);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    result = send_get_work(fd, 0);
+    while (result)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        taken = (double)(now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+        if (seconds > 0 && taken >= seconds)
+            break;
+        /* Waiting for work, or new work is there */
+        if (found < 0 || !work.block)
+        {
+            if (poll(&poll_fd, 1, 1000) <= 0)
+                continue;
+            drop_work(&work);
+            result = node_receive(fd, &type, &payload) && type == POOL_WORK && pool_get_work(&payload, &work);
+            found = 0;
+            continue;
+        }
+        found = mine_range(fd, &work, &hashes);
+        if (found == 1)
+        {
+            printf("Share for block %u with nonce %u\n", work.block->index, work.block->nonce);
+            nb_shares++;
+            result = send_share(fd, &work, hashes - reported);
+            reported = hashes;
+        }
+        if (found >= 0)
+        {
+            result = result && send_get_work(fd, hashes - reported);
+            reported = hashes;
+            found = -1;
+        }
+    }
+    if (!result)
+        fprintf(stderr, "Lost the pool at %s\n", argv[1]);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    taken = (double)(now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%llu hashes in %.1f s, %.0f hashes/s, %d shares\n", (unsigned long long)hashes, taken,
+           taken > 0 ? (double)hashes / taken : 0.0, nb_shares);
+    drop_work(&work);
+    buffer_free(&payload);
+    close(fd);
+    return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,91 @@
+#include "blockchain.h"
+#include <sys/stat.h>
+
+/**
+ * archive_block - encodes a block body as a self-contained archive record
+ * Each record starts its own codec segment so any record can be decoded on
+ * its own when auditing
+ * @block: pointer to block to archive
+ * @file: memory stream collecting the archive records
+ * Return: 1 on success else 0
+ */
+static int archive_block(Block *block, FILE *file)
+{
+    codec_state_t state;
+    buffer_t record;
+
+    codec_state_init(&state);
+    buffer_init(&record);
+    int result = encode_block_compact(block, &record, &state) && write_record(file, &record);
+    buffer_free(&record);
+    codec_state_free(&state);
+    return result;
+}
+
+/**
+ * prune_blockchain - drops the transaction bodies of blocks buried deeper
+ * than depth, keeping their headers so linkage can still be validated
+ * The bodies are appended to the archive file in the open journal group
+ * (or one of its own) unless they are discarded; the caller must then
+ * serialize the blockchain, which is rewritten in full
+ * @blockchain: pointer to blockchain to prune
+ * @depth: number of most recent blocks whose bodies are kept
+ * @archive: 1 to move bodies to ARCHIVE_DATABASE, 0 to discard them
+ * Return: number of blocks pruned, or -1 on failure
+ */
+int prune_blockchain(Blockchain *blockchain, int depth, int archive)
+{
+    int limit = blockchain->length - 1 - depth, nb_pruned = 0;
+    char *data = NULL;
+    size_t size = 0;
+    FILE *file = NULL;
+
+    if (depth < 0)
+    {
+        fprintf(stderr, "Invalid pruning depth\n");
+        return -1;
+    }
+    if (archive && !(file = open_memstream(&data, &size)))
+    {
+        fprintf(stderr, "Failed to open archive stream\n");
+        return -1;
+    }
+
+    int result = 1;
+    Block *current = blockchain->head;
+    for (; result && current && (int)current->index < limit; current = current->next)
+    {
+        if (current->pruned)
+            continue;
+        result = !file || archive_block(current, file);
+        nb_pruned++;
+    }
+    if (file && fclose(file) != 0)
+        result = 0;
+
+    if (result && archive && size > 0)
+    {
+        struct stat st;
+        off_t offset = stat(ARCHIVE_DATABASE, &st) == 0 ? st.st_size : 0;
+        result = journal_write(ARCHIVE_DATABASE, offset, 1, data, size);
+    }
+    free(data);
+    if (!result)
+    {
+        fprintf(stderr, "Failed to archive transaction bodies\n");
+        return -1;
+    }
+
+    /* Drop the bodies only once the archive write is staged */
+    for (current = blockchain->head; current && (int)current->index < limit; current = current->next)
+    {
+        if (current->pruned)
+            continue;
+        free_transactions(current->transactions);
+        current->transactions = (utxo_t *)calloc(1, sizeof(utxo_t));
+        current->pruned = 1;
+    }
+    if (nb_pruned > 0)
+        blockchain->stored = 0;
+    return nb_pruned;
+}
@@ -0,0 +1,61 @@
+#include "blockchain.h"
+
+/**
+ * main - prunes transaction bodies older than a given depth
+ * @argc: argument count
+ * @argv: optional depth and --discard to drop bodies instead of archiving
+ * Return: 0 on success else 1
+ */
+int main(int argc, char **argv)
+{
+    int depth = PRUNE_DEPTH, archive = 1;
+    long value;
+    char *end;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--discard") == 0)
+        {
+            archive = 0;
+            continue;
+        }
+        value = strtol(argv[i], &end, 10);
+        if (end == argv[i] || *end != '\0' || value < 0 || value > INT32_MAX)
+        {
+            fprintf(stderr, "Usage: %s [depth] [--discard]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+        depth = (int)value;
+    }
+
+    Blockchain *blockchain = deserialize_blockchain();
+    if (!blockchain)
+    {
+        fprintf(stderr, "Could not deserialize blockchain\n");
+        exit(EXIT_FAILURE);
+    }
+
+    journal_begin();
+    int nb_pruned = prune_blockchain(blockchain, depth, archive);
+    if (nb_pruned < 0)
+    {
+        journal_abort();
+        free_blockchain(blockchain);
+        exit(EXIT_FAILURE);
+    }
+    if (nb_pruned == 0)
+    {
+        journal_abort();
+        printf("Nothing to prune below depth %d\n", depth);
+        free_blockchain(blockchain);
+        return 0;
+    }
+
+    if (!serialize_blockchain(blockchain) || !journal_commit())
+    {
+        fprintf(stderr, "Could not save pruned blockchain\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("Pruned %d blocks, bodies %s\n", nb_pruned, archive ? "moved to " ARCHIVE_DATABASE : "discarded");
+    return 0;
+}
@@ -0,0 +1,218 @@
+#include "blockchain.h"
+
+/**
+ * buffer_init - sets up an empty growable buffer
+ * @buffer: pointer to buffer
+ */
+void buffer_init(buffer_t *buffer)
+{
+    buffer->data = NULL;
+    buffer->len = 0;
+    buffer->cap = 0;
+    buffer->pos = 0;
+}
+
+/**
+ * buffer_free - releases buffer memory
+ * @buffer: pointer to buffer
+ */
+void buffer_free(buffer_t *buffer)
+{
+    free(buffer->data);
+    buffer_init(buffer);
+}
+
+/**
+ * buffer_reserve - makes room for at least len more bytes
+ * @buffer: pointer to buffer
+ * @len: number of bytes needed
+ * Return: 1 on success else 0
+ */
+int buffer_reserve(buffer_t *buffer, size_t len)
+{
+    if (buffer->len + len <= buffer->cap)
+        return 1;
+
+    size_t cap = buffer->cap ? buffer->cap : 256;
+    while (cap < buffer->len + len)
+        cap *= 2;
+    unsigned char *data = (unsigned char *)realloc(buffer->data, cap);
+    if (!data)
+    {
+        fprintf(stderr, "Failed to grow buffer\n");
+        return 0;
+    }
+    buffer->data = data;
+    buffer->cap = cap;
+    return 1;
+}
+
+/**
+ * buffer_put - appends bytes to buffer
+ * @buffer: pointer to buffer
+ * @data: bytes to append
+ * @len: number of bytes
+ * Return: 1 on success else 0
+ */
+int buffer_put(buffer_t *buffer, const void *data, size_t len)
+{
+    if (!buffer_reserve(buffer, len))
+        return 0;
+    memcpy(buffer->data + buffer->len, data, len);
+    buffer->len += len;
+    return 1;
+}
+
+/**
+ * buffer_get - reads bytes at the buffer read position
+ * @buffer: pointer to buffer
+ * @data: destination
+ * @len: number of bytes to read
+ * Return: 1 on success else 0 if the buffer is too short
+ */
+int buffer_get(buffer_t *buffer, void *data, size_t len)
+{
+    if (buffer->len - buffer->pos < len)
+        return 0;
+    memcpy(data, buffer->data + buffer->pos, len);
+    buffer->pos += len;
+    return 1;
+}
+
+/**
+ * write_record - writes a buffer framed with its length and CRC32C
+ * @file: file to write to
+ * @buffer: record payload
+ * Return: 1 on success else 0
+ */
+int write_record(FILE *file, buffer_t *buffer)
+{
+    uint32_t len = (uint32_t)buffer->len;
+    uint32_t crc = crc32c(0, buffer->data, buffer->len);
+
+    if (fwrite(&len, sizeof(len), 1, file) != 1 ||
+        fwrite(&crc, sizeof(crc), 1, file) != 1 ||
+        (len && fwrite(buffer->data, len, 1, file) != 1))
+    {
+        fprintf(stderr, "Failed to write record\n");
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * read_record - reads the next length + CRC32C framed record
+ * @file: file to read from
+ * @buffer: buffer receiving the payload, read position is reset
+ * Return: RECORD_OK, RECORD_EOF at a clean end of file, or RECORD_CORRUPT
+ * for a short, oversized or checksum-failing record
+ */
+int read_record(FILE *file, buffer_t *buffer)
+{
+    uint32_t len, crc;
+    size_t got = fread(&len, 1, sizeof(len), file);
+
+    if (got == 0 && feof(file))
+        return RECORD_EOF;
+    if (got != sizeof(len) || fread(&crc, sizeof(crc), 1, file) != 1 ||
+        len > RECORD_SIZE_MAX)
+        return RECORD_CORRUPT;
+
+    buffer->len = 0;
+    buffer->pos = 0;
+    if (!buffer_reserve(buffer, len))
+        return RECORD_CORRUPT;
+    if (len && fread(buffer->data, len, 1, file) != 1)
+        return RECORD_CORRUPT;
+    buffer->len = len;
+    if (crc32c(0, buffer->data, len) != crc)
+        return RECORD_CORRUPT;
+    return RECORD_OK;
+}
+
+/**
+ * truncate_torn_tail - cuts a file back to its last complete record
+ * @path: path of file to truncate
+ * @offset: end of the last good record
+ * Return: 1 on success else 0
+ */
+int truncate_torn_tail(const char *path, long offset)
+{
+    fprintf(stderr, "%s: torn or corrupt record at offset %ld, truncating\n", path, offset);
+    if (truncate(path, offset) != 0)
+    {
+        perror("Failed to truncate torn tail");
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * buffer_put_varint - appends an unsigned LEB128 varint
+ * @buffer: pointer to buffer
+ * @value: value to encode
+ * Return: 1 on success else 0
+ */
+int buffer_put_varint(buffer_t *buffer, uint64_t value)
+{
+    unsigned char bytes[10];
+    size_t len = 0;
+
+    while (value >= 0x80)
+    {
+        bytes[len++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    bytes[len++] = (unsigned char)value;
+    return buffer_put(buffer, bytes, len);
+}
+
+/**
+ * buffer_get_varint - reads an unsigned LEB128 varint
+ * @buffer: pointer to buffer
+ * @value: pointer to store decoded value
+ * Return: 1 on success else 0 if truncated or overlong
+ */
+int buffer_get_varint(buffer_t *buffer, uint64_t *value)
+{
+    uint64_t result = 0;
+
+    for (int shift = 0; shift < 64 && buffer->pos < buffer->len; shift += 7)
+    {
+        unsigned char byte = buffer->data[buffer->pos++];
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            *value = result;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * buffer_put_svarint - appends a signed value as a zigzag varint
+ * @buffer: pointer to buffer
+ * @value: value to encode
+ * Return: 1 on success else 0
+ */
+int buffer_put_svarint(buffer_t *buffer, int64_t value)
+{
+    return buffer_put_varint(buffer, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+/**
+ * buffer_get_svarint - reads a zigzag varint
+ * @buffer: pointer to buffer
+ * @value: pointer to store decoded value
+ * Return: 1 on success else 0
+ */
+int buffer_get_svarint(buffer_t *buffer, int64_t *value)
+{
+    uint64_t raw;
+
+    if (!buffer_get_varint(buffer, &raw))
+        return 0;
+    *value = (int64_t)(raw >> 1) ^ -(int64_t)(raw & 1);
+    return 1;
+}
@@ -0,0 +1,30 @@
+#include "blockchain.h"
+
+/**
+ * main - lists the largest balances, balances per role and checks them
+ * against the circulating token supply
+ * @argc: argument count
+ * @argv: optional number of balances, and --threads=N
+ * Return: 0 on success else 1
+ */
+int main(int argc, char **argv)
+{
+    int limit = RICH_LIST_SIZE, nb_threads = ANALYTICS_THREADS;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--threads=", 10) == 0 && atoi(argv[i] + 10) > 0)
+            nb_threads = atoi(argv[i] + 10);
+        else if (argv[i][0] != '-' && atoi(argv[i]) > 0)
+            limit = atoi(argv[i]);
+        else
+        {
+            fprintf(stderr, "Usage: %s [count] [--threads=N]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (!print_rich_list(limit, nb_threads))
+        exit(EXIT_FAILURE);
+    return 0;
+}
@@ -22,8 +22,11 @@ void setup_blockchain(void)
             printf("Could not create wallet for %s\n", names[i]);
         else
             printf("Wallet created for %s.\n", users->tail->name);
+        /* Token supply and the user's balance commit together */
+        journal_begin();
         transfer_tokens(account, users->tail);
         serialize_users(users);
+        journal_commit();
     }
     free_alu_account(account);
 }
\ No newline at end of file
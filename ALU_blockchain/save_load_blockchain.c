@@ -1,66 +1,193 @@
 #include "blockchain.h"
+#include <sys/stat.h>
 
 /**
- * serialize_blockchain - serializes(backs up) a blockchain to a file
- * @blockchain: pointer to blockchain to serialize
+ * store_blockchain - writes a blockchain to the block file and keeps it
+ * Every block is written as one compact record framed with length + CRC32C.
+ * When the leading blocks are already on disk only the new records are
+ * appended, otherwise the file is replaced; either way the writes go
+ * through the journal. Appends leave the header alone, so readers of an
+ * older generation keep a valid prefix: its difficulty is only refreshed by
+ * a rewrite, the chain's own follows the schedule. The first record of every codec segment
+ * decodes on its own and is listed in the sparse time index. On success
+ * the blockchain records what is stored so the next call appends again
+ * @blockchain: pointer to blockchain to write
  * Return: 1 on success else 0 on failure
  */
-int serialize_blockchain(Blockchain *blockchain)
+int store_blockchain(Blockchain *blockchain)
 {
-    FILE *file = fopen(BLOCKCHAIN_DATABASE, "wb");
+    char *data = NULL;
+    size_t size = 0;
+    FILE *file = open_memstream(&data, &size);
     if (!file)
     {
         fprintf(stderr, "Failed to open file for serialization\n");
         return 0;
     }
 
+    uint32_t magic = BLOCKCHAIN_MAGIC, version = BLOCKCHAIN_VERSION;
+    fwrite(&magic, sizeof(magic), 1, file);
+    fwrite(&version, sizeof(version), 1, file);
     fwrite(&blockchain->difficulty, sizeof(blockchain->difficulty), 1, file);
+    long header_size = ftell(file);
 
+    int append = blockchain->codec && blockchain->stored > 0 &&
+                 blockchain->stored <= blockchain->length;
+    codec_state_t fresh, *state = append ? blockchain->codec : &fresh;
     Block *current = blockchain->head;
-    while (current) {
-        fwrite(&current->index, sizeof(current->index), 1, file);
-        fwrite(current->timestamp, sizeof(current->timestamp), 1, file);
-        fwrite(&current->nonce, sizeof(current->nonce), 1, file);
-        fwrite(current->previous_hash, SHA256_DIGEST_LENGTH, 1, file);
-        fwrite(current->current_hash, SHA256_DIGEST_LENGTH, 1, file);
-
-         if (current->transactions)
-        {
-            fwrite(&current->transactions->nb_trans, sizeof(current->transactions->nb_trans), 1, file);
-
-            Transaction *trans = current->transactions->head;
-            while (trans)
-            {
-                fwrite(&trans->index, sizeof(trans->index), 1, file);
-                fwrite(trans->sender, sizeof(trans->sender), 1, file);
-                fwrite(trans->receiver, sizeof(trans->receiver), 1, file);
-                fwrite(&trans->amount, sizeof(trans->amount), 1, file);
-                fwrite(&trans->status, sizeof(trans->status), 1, file);
-                trans = trans->next;
-            }
-        }
-        else
+    if (append)
+    {
+        for (int i = 0; i < blockchain->stored; i++)
+            current = current->next;
+    }
+    else
+        codec_state_init(&fresh);
+
+    buffer_t record, index;
+    buffer_init(&record);
+    buffer_init(&index);
+    int result = 1;
+    while (current && result)
+    {
+        time_index_entry_t entry;
+        entry.offset = append ? blockchain->stored_size + ftell(file) - header_size : ftell(file);
+        record.len = 0;
+        result = encode_block_compact(current, &record, state) && write_record(file, &record);
+        if (result && (record.data[0] & CODEC_NEW_SEGMENT))
         {
-            int zero_trans = 0;
-            fwrite(&zero_trans, sizeof(zero_trans), 1, file);
+            entry.timestamp = current->timestamp;
+            entry.height = current->index;
+            result = buffer_put(&index, &entry, sizeof(entry));
         }
-
         current = current->next;
     }
+    buffer_free(&record);
+
+    if (fclose(file) != 0)
+        result = 0;
+    if (result)
+    {
+        struct stat st;
+        long index_end = append && stat(TIME_INDEX_DATABASE, &st) == 0 ? st.st_size : 0;
+        int own_group = !journal_active() && journal_begin();
+        if (append)
+            result = journal_write(BLOCKCHAIN_DATABASE, blockchain->stored_size, 1, data + header_size,
+                                   size - header_size);
+        else
+            result = journal_write(BLOCKCHAIN_DATABASE, 0, 1, data, size);
+        result = result && (index.len == 0 ||
+                            journal_write(TIME_INDEX_DATABASE, index_end, 1, index.data, index.len));
+        if (own_group)
+            result = result ? journal_commit() : (journal_abort(), 0);
+    }
+    if (result && !append && blockchain->codec)
+        codec_state_free(blockchain->codec);
+    else if (result && !append)
+        blockchain->codec = (codec_state_t *)malloc(sizeof(codec_state_t));
+    if (result && !append && blockchain->codec)
+    {
+        *blockchain->codec = fresh;
+        blockchain->stored_size = size;
+    }
+    else if (!append)
+        codec_state_free(&fresh);
+    if (result && append)
+        blockchain->stored_size += size - header_size;
+    /* A failed append already advanced the encoder, the next write starts over */
+    if (!result && append)
+    {
+        codec_state_free(blockchain->codec);
+        free(blockchain->codec);
+        blockchain->codec = NULL;
+    }
+    blockchain->stored = result && blockchain->codec ? blockchain->length : 0;
+    buffer_free(&index);
+    free(data);
+    return result;
+}
+
+/**
+ * serialize_blockchain - serializes(backs up) a blockchain to a file and
+ * frees it
+ * @blockchain: pointer to blockchain to serialize
+ * Return: 1 on success else 0 on failure
+ */
+int serialize_blockchain(Blockchain *blockchain)
+{
+    int result = store_blockchain(blockchain);
 
-    fclose(file);
     free_blockchain(blockchain);
-    return 1;
+    return result;
 }
 
 
+/**
+ * truncate_blockchain - cuts a stored blockchain after one of its blocks
+ * The block file and its time index are cut in the open journal group.
+ * The encoder state after the kept block is decoded again from the start
+ * of its segment, so blocks are appended in place after the cut
+ * @blockchain: stored blockchain
+ * @last: block of the chain to keep as the new tail
+ * @removed: where to store the blocks cut, linked through next
+ * Return: 1 on success else 0 if nothing changed
+ */
+int truncate_blockchain(Blockchain *blockchain, Block *last, Block **removed)
+{
+    block_reader_t reader;
+    codec_state_t *codec;
+    Block *block = NULL;
+    long offset = -1;
+
+    if (!block_reader_open(&reader, last->index, 1))
+        return 0;
+    while (offset < 0 && (block = block_reader_next(&reader)))
+    {
+        if (block->index == last->index)
+            offset = ftell(reader.file);
+        free_transactions(block->transactions);
+        free(block);
+    }
+    codec = (codec_state_t *)malloc(sizeof(codec_state_t));
+    if (offset < 0 || !codec || !journal_write(BLOCKCHAIN_DATABASE, offset, 1, "", 0) ||
+        !time_index_rewind(last->index))
+    {
+        fprintf(stderr, "Could not cut the block file after block %u\n", last->index);
+        free(codec);
+        block_reader_close(&reader);
+        return 0;
+    }
+    /* The reader owns the file and the record, the state moves to the chain */
+    *codec = reader.state;
+    codec_state_init(&reader.state);
+    block_reader_close(&reader);
+
+    if (blockchain->codec)
+    {
+        codec_state_free(blockchain->codec);
+        free(blockchain->codec);
+    }
+    blockchain->codec = codec;
+    *removed = last->next;
+    last->next = NULL;
+    blockchain->tail = last;
+    blockchain->length = last->index + 1;
+    blockchain->stored = blockchain->length;
+    blockchain->stored_size = offset;
+    blockchain->difficulty = chain_difficulty(blockchain);
+    return 1;
+}
+
 /**
  * deserialize_blockchain - deserializes blockchain from a file
+ * A torn or corrupt trailing record is dropped and the file truncated to
+ * the last complete block. A pinned generation is read up to the length it
+ * published, the blocks appended since are not part of it
  * Return: pointer to blockchain or NULL on failure
  */
 Blockchain *deserialize_blockchain(void)
 {
-    FILE *file = fopen(BLOCKCHAIN_DATABASE, "rb");
+    journal_recover();
+    FILE *file = fopen(generation_path(BLOCKCHAIN_DATABASE), "rb");
     if (!file)
     {
         perror("Failed to open blockchain file, initializing a new blockchain...");
@@ -77,6 +204,27 @@ Blockchain *deserialize_blockchain(void)
 
     blockchain->head = blockchain->tail = NULL;
     blockchain->length = 0;
+    blockchain->stored = 0;
+    blockchain->stored_size = 0;
+    blockchain->codec = NULL;
+
+    uint32_t magic = 0, version = 0;
+    if (fread(&magic, sizeof(magic), 1, file) != 1 ||
+        fread(&version, sizeof(version), 1, file) != 1 ||
+        magic != BLOCKCHAIN_MAGIC || version != BLOCKCHAIN_VERSION)
+    {
+        /* Earlier formats hash other block fields, their proofs of work do
+         * not carry over and there is nothing to convert; see the README */
+        if (magic == BLOCKCHAIN_MAGIC)
+            fprintf(stderr, "Blockchain file format %u is not supported, this build reads format %d\n", version,
+                    BLOCKCHAIN_VERSION);
+        else
+            fprintf(stderr, "Blockchain file has no format header, it predates format 1\n");
+        fprintf(stderr, "Move %s aside and run init_blockchain to start a new ledger\n", BLOCKCHAIN_DATABASE);
+        free(blockchain);
+        fclose(file);
+        return NULL;
+    }
 
     if (fread(&blockchain->difficulty, sizeof(blockchain->difficulty), 1, file) != 1)
     {
@@ -86,90 +234,48 @@ Blockchain *deserialize_blockchain(void)
         return NULL;
     }
 
-    Block *prevBlock = NULL;
-    while (1)
+    buffer_t record;
+    codec_state_t state;
+    buffer_init(&record);
+    codec_state_init(&state);
+    long good_offset = ftell(file), length = generation_length(BLOCKCHAIN_DATABASE);
+    while ((length < 0 || good_offset < length) && read_record(file, &record) == RECORD_OK)
     {
-        Block *block = (Block *)malloc(sizeof(Block));
+        Block *block = decode_block_compact(&record, &state);
         if (!block)
-        {
-            perror("Failed to allocate memory for block");
-            break;
-        }
-
-        if (fread(&block->index, sizeof(block->index), 1, file) != 1)
-        {
-            free(block);
             break;
-        }
-
-        fread(block->timestamp, sizeof(block->timestamp), 1, file);
-        fread(&block->nonce, sizeof(block->nonce), 1, file);
-        fread(block->previous_hash, SHA256_DIGEST_LENGTH, 1, file);
-        fread(block->current_hash, SHA256_DIGEST_LENGTH, 1, file);
-
-        utxo_t *transactions = (utxo_t *)malloc(sizeof(utxo_t));
-        if (!transactions)
-        {
-            perror("Failed to allocate memory for transactions");
-            free(block);
-            break;
-        }
-
-        if (fread(&transactions->nb_trans, sizeof(transactions->nb_trans), 1, file) != 1)
-        {
-            free(transactions);
-            free(block);
-            break;
-        }
-
-        transactions->head = transactions->tail = NULL;
-
-        for (int i = 0; i < transactions->nb_trans; i++)
-        {
-            Transaction *trans = (Transaction *)malloc(sizeof(Transaction));
-            if (!trans)
-            {
-                perror("Failed to allocate memory for transaction");
-                break;
-            }
-
-            if (fread(&trans->index, sizeof(trans->index), 1, file) != 1 ||
-                fread(trans->sender, sizeof(trans->sender), 1, file) != 1 ||
-                fread(trans->receiver, sizeof(trans->receiver), 1, file) != 1 ||
-                fread(&trans->amount, sizeof(trans->amount), 1, file) != 1 ||
-                fread(&trans->status, sizeof(trans->status), 1, file) != 1)
-            {
-                free(trans);
-                break;
-            }
-
-            trans->next = NULL;
-            if (transactions->head == NULL)
-            {
-                transactions->head = transactions->tail = trans;
-            }
-            else
-            {
-                transactions->tail->next = trans;
-                transactions->tail = trans;
-            }
-        }
-
-        block->transactions = transactions;
-        block->next = NULL;
 
         if (blockchain->head == NULL)
             blockchain->head = blockchain->tail = block;
         else
         {
-            prevBlock->next = block;
+            blockchain->tail->next = block;
             blockchain->tail = block;
         }
-
-        prevBlock = block;
         blockchain->length++;
+        good_offset = ftell(file);
     }
-
+    buffer_free(&record);
     fclose(file);
+
+    /*
+     * A torn record is a group still being applied, or one journal_recover
+     * replays under the journal lock; the next append overwrites it from
+     * stored_size. Readers never cut the file
+     */
+
+    /* The header only mirrors the schedule, a cut tail changes it */
+    blockchain->difficulty = chain_difficulty(blockchain);
+
+    /* Keep the decoder state so new blocks can be appended in place */
+    blockchain->codec = (codec_state_t *)malloc(sizeof(codec_state_t));
+    if (blockchain->codec)
+    {
+        *blockchain->codec = state;
+        blockchain->stored = blockchain->length;
+        blockchain->stored_size = good_offset;
+    }
+    else
+        codec_state_free(&state);
     return blockchain;
-}
\ No newline at end of file
+}
@@ -0,0 +1,372 @@
+#include "blockchain.h"
+
+static const char *snapshot_files[NB_SNAPSHOT_FILES] = {ALU_ACCOUNT_FILE, USERS_DATABASE, UTXO_DATABASE,
+                                                         STATS_DATABASE};
+static const char *chain_indexes[NB_CHAIN_INDEXES] = {UNDO_DATABASE, UNDO_INDEX, HISTORY_DATABASE,
+                                                      HISTORY_INDEX, TXID_INDEX, TX_SEQUENCE_INDEX,
+                                                      ARCHIVE_DATABASE};
+
+/**
+ * write_snapshot_record - frames a snapshot section and folds it into the
+ * snapshot content hash
+ * @file: snapshot file
+ * @record: section payload
+ * @ctx: running content hash
+ * Return: 1 on success else 0
+ */
+static int write_snapshot_record(FILE *file, buffer_t *record, EVP_MD_CTX *ctx)
+{
+    return EVP_DigestUpdate(ctx, record->data, record->len) == 1 &&
+           write_record(file, record);
+}
+
+/**
+ * read_whole_file - reads a state file into a buffer
+ * @path: file to read
+ * @buffer: buffer to append to
+ * Return: 1 on success (a missing file reads as empty) else 0
+ */
+static int read_whole_file(const char *path, buffer_t *buffer)
+{
+    unsigned char chunk[65536];
+    size_t got;
+    FILE *file = fopen(path, "rb");
+
+    if (!file)
+        return 1;
+    while ((got = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        if (!buffer_put(buffer, chunk, got))
+        {
+            fclose(file);
+            return 0;
+        }
+    }
+    fclose(file);
+    return 1;
+}
+
+/**
+ * export_snapshot - writes the ledger state at the current tip to one file:
+ * ALU account and token supply, user balances, the pending pool, chain
+ * statistics and the header chain, followed by a SHA-256 content hash
+ * @path: snapshot file to create
+ * @content_hash: buffer to store the content hash
+ * Return: height of the snapshot, or -1 on failure
+ */
+int export_snapshot(const char *path, unsigned char *content_hash)
+{
+    Blockchain *blockchain = deserialize_blockchain();
+    if (!blockchain || !blockchain->tail)
+    {
+        fprintf(stderr, "No blockchain to snapshot\n");
+        if (blockchain)
+            free_blockchain(blockchain);
+        return -1;
+    }
+
+    FILE *file = fopen(path, "wb");
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    if (!file || !ctx || EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) != 1)
+    {
+        fprintf(stderr, "Failed to open snapshot file\n");
+        if (file)
+            fclose(file);
+        EVP_MD_CTX_free(ctx);
+        free_blockchain(blockchain);
+        return -1;
+    }
+
+    uint32_t magic = SNAPSHOT_MAGIC, version = SNAPSHOT_VERSION;
+    int height = blockchain->length - 1;
+    unsigned char type;
+    buffer_t record;
+    buffer_init(&record);
+    int result = fwrite(&magic, sizeof(magic), 1, file) == 1 &&
+                 fwrite(&version, sizeof(version), 1, file) == 1;
+
+    /* Chain summary */
+    type = SNAPSHOT_META;
+    result = result && buffer_put(&record, &type, sizeof(type)) &&
+             buffer_put_varint(&record, (uint64_t)blockchain->length) &&
+             buffer_put_svarint(&record, blockchain->difficulty) &&
+             buffer_put(&record, blockchain->tail->current_hash, SHA256_DIGEST_LENGTH) &&
+             write_snapshot_record(file, &record, ctx);
+
+    /* Account state, exactly as stored at the tip */
+    type = SNAPSHOT_STATE_FILE;
+    for (size_t i = 0; result && i < NB_SNAPSHOT_FILES; i++)
+    {
+        record.len = 0;
+        result = buffer_put(&record, &type, sizeof(type)) &&
+                 buffer_put_varint(&record, strlen(snapshot_files[i])) &&
+                 buffer_put(&record, snapshot_files[i], strlen(snapshot_files[i])) &&
+                 read_whole_file(snapshot_files[i], &record) &&
+                 write_snapshot_record(file, &record, ctx);
+    }
+
+    /* Header chain, as compact pruned records batched per section */
+    codec_state_t state;
+    buffer_t header;
+    codec_state_init(&state);
+    buffer_init(&header);
+    type = SNAPSHOT_HEADERS;
+    Block *current = blockchain->head;
+    while (result && current)
+    {
+        record.len = 0;
+        result = buffer_put(&record, &type, sizeof(type));
+        for (int i = 0; result && current && i < SNAPSHOT_HEADERS_PER_RECORD; i++)
+        {
+            Block pruned = *current;
+            pruned.pruned = 1;
+            header.len = 0;
+            result = encode_block_compact(&pruned, &header, &state) &&
+                     buffer_put_varint(&record, header.len) &&
+                     buffer_put(&record, header.data, header.len);
+            current = current->next;
+        }
+        result = result && write_snapshot_record(file, &record, ctx);
+    }
+    buffer_free(&header);
+    codec_state_free(&state);
+
+    /* Content hash over every section above */
+    type = SNAPSHOT_HASH;
+    record.len = 0;
+    result = result && EVP_DigestFinal_ex(ctx, content_hash, NULL) == 1 &&
+             buffer_put(&record, &type, sizeof(type)) &&
+             buffer_put(&record, content_hash, SHA256_DIGEST_LENGTH) &&
+             write_record(file, &record);
+
+    buffer_free(&record);
+    EVP_MD_CTX_free(ctx);
+    if (fclose(file) != 0)
+        result = 0;
+    free_blockchain(blockchain);
+    if (!result)
+    {
+        fprintf(stderr, "Failed to write snapshot\n");
+        remove(path);
+        return -1;
+    }
+    return height;
+}
+
+/**
+ * read_snapshot_headers - appends the pruned headers of one section
+ * @record: section payload, positioned after the type byte
+ * @state: decoder state carried across sections
+ * @blockchain: chain to append to
+ * Return: 1 on success else 0
+ */
+static int read_snapshot_headers(buffer_t *record, codec_state_t *state, Blockchain *blockchain)
+{
+    buffer_t header;
+    uint64_t len;
+
+    buffer_init(&header);
+    while (record->pos < record->len)
+    {
+        if (!buffer_get_varint(record, &len) || len > record->len - record->pos)
+            break;
+        header.len = 0;
+        header.pos = 0;
+        if (!buffer_put(&header, record->data + record->pos, len))
+            break;
+        record->pos += len;
+
+        Block *block = decode_block_compact(&header, state);
+        if (!block || !block->pruned)
+        {
+            if (block)
+            {
+                free_transactions(block->transactions);
+                free(block);
+            }
+            break;
+        }
+        if (!blockchain->head)
+            blockchain->head = block;
+        else
+            blockchain->tail->next = block;
+        blockchain->tail = block;
+        blockchain->length++;
+    }
+    buffer_free(&header);
+    return record->pos == record->len;
+}
+
+/**
+ * read_snapshot_file - keeps the contents of one state file section
+ * Only the files export_snapshot writes are accepted, each once, so a
+ * snapshot cannot name a file anywhere else
+ * @record: section payload, positioned after the type byte
+ * @files: NB_SNAPSHOT_FILES entries in snapshot_files order, the one named
+ * gets the contents
+ * Return: 1 on success else 0
+ */
+static int read_snapshot_file(buffer_t *record, journal_entry_t *files)
+{
+    uint64_t path_len;
+    journal_entry_t *entry = NULL;
+
+    if (!buffer_get_varint(record, &path_len) || path_len > record->len - record->pos)
+        return 0;
+    for (int i = 0; !entry && i < NB_SNAPSHOT_FILES; i++)
+    {
+        if (strlen(snapshot_files[i]) == path_len &&
+            memcmp(snapshot_files[i], record->data + record->pos, path_len) == 0)
+            entry = &files[i];
+    }
+    if (!entry || entry->data)
+    {
+        fprintf(stderr, "Snapshot holds an unknown or repeated state file\n");
+        return 0;
+    }
+    record->pos += path_len;
+    entry->len = record->len - record->pos;
+    entry->data = (unsigned char *)malloc(entry->len ? entry->len : 1);
+    if (!entry->data)
+        return 0;
+    memcpy(entry->data, record->data + record->pos, entry->len);
+    return 1;
+}
+
+/**
+ * snapshot_complete - tells whether every state file was in the snapshot
+ * @files: NB_SNAPSHOT_FILES entries filled by read_snapshot_file
+ * Return: 1 if none is missing else 0
+ */
+static int snapshot_complete(journal_entry_t *files)
+{
+    for (int i = 0; i < NB_SNAPSHOT_FILES; i++)
+    {
+        if (!files[i].data)
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * import_snapshot - bootstraps the local ledger from a snapshot file
+ * The content hash, the state file names, and the linkage and proof of
+ * work of the headers are verified before anything is written; the state
+ * files and the pruned header chain are then committed as one journal
+ * group and the validation checkpoint is moved to the snapshot height, so
+ * only blocks mined after it are ever re-hashed. The same group empties
+ * the indexes of the replaced chain, which are rebuilt when next used
+ * @path: snapshot file to read
+ * @expected_hash: trusted content hash to match, or NULL to accept any
+ * @content_hash: buffer to store the computed content hash
+ * Return: height of the snapshot, or -1 on failure
+ */
+int import_snapshot(const char *path, const unsigned char *expected_hash, unsigned char *content_hash)
+{
+    FILE *file = fopen(path, "rb");
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    Blockchain *blockchain = (Blockchain *)malloc(sizeof(Blockchain));
+    if (!file || !ctx || !blockchain || EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) != 1)
+    {
+        fprintf(stderr, "Failed to open snapshot file\n");
+        if (file)
+            fclose(file);
+        EVP_MD_CTX_free(ctx);
+        free(blockchain);
+        return -1;
+    }
+    blockchain->head = blockchain->tail = NULL;
+    blockchain->length = 0;
+    blockchain->stored = 0;
+    blockchain->stored_size = 0;
+    blockchain->codec = NULL;
+
+    uint32_t magic = 0, version = 0;
+    uint64_t length = 0;
+    int64_t difficulty = INITIAL_DIFFICULTY;
+    unsigned char tip_hash[SHA256_DIGEST_LENGTH], stored_hash[SHA256_DIGEST_LENGTH];
+    unsigned char type;
+    int has_hash = 0, status, result, failed = -1;
+    journal_entry_t files[NB_SNAPSHOT_FILES] = {0};
+    codec_state_t state;
+    buffer_t record;
+    buffer_init(&record);
+    codec_state_init(&state);
+
+    result = fread(&magic, sizeof(magic), 1, file) == 1 &&
+             fread(&version, sizeof(version), 1, file) == 1 &&
+             magic == SNAPSHOT_MAGIC && version == SNAPSHOT_VERSION;
+    while (result && !has_hash && (status = read_record(file, &record)) == RECORD_OK)
+    {
+        if (!buffer_get(&record, &type, sizeof(type)))
+        {
+            result = 0;
+            break;
+        }
+        if (type == SNAPSHOT_HASH)
+        {
+            has_hash = buffer_get(&record, stored_hash, SHA256_DIGEST_LENGTH);
+            break;
+        }
+        result = EVP_DigestUpdate(ctx, record.data, record.len) == 1;
+
+        if (type == SNAPSHOT_META)
+            result = result && buffer_get_varint(&record, &length) &&
+                     buffer_get_svarint(&record, &difficulty) &&
+                     buffer_get(&record, tip_hash, SHA256_DIGEST_LENGTH);
+        else if (type == SNAPSHOT_STATE_FILE)
+            result = result && read_snapshot_file(&record, files);
+        else if (type == SNAPSHOT_HEADERS)
+            result = result && read_snapshot_headers(&record, &state, blockchain);
+        else
+            result = 0;
+    }
+    fclose(file);
+    buffer_free(&record);
+    codec_state_free(&state);
+
+    result = result && has_hash && EVP_DigestFinal_ex(ctx, content_hash, NULL) == 1;
+    EVP_MD_CTX_free(ctx);
+    if (!result || memcmp(content_hash, stored_hash, SHA256_DIGEST_LENGTH) != 0)
+        fprintf(stderr, "Snapshot is truncated or corrupt\n");
+    else if (expected_hash && memcmp(content_hash, expected_hash, SHA256_DIGEST_LENGTH) != 0)
+        fprintf(stderr, "Snapshot content hash does not match the trusted hash\n");
+    else if (!snapshot_complete(files))
+        fprintf(stderr, "Snapshot is missing state files\n");
+    else if ((uint64_t)blockchain->length != length || !blockchain->tail ||
+             memcmp(blockchain->tail->current_hash, tip_hash, SHA256_DIGEST_LENGTH) != 0 ||
+             (failed = validate_chain_parallel(blockchain, VALIDATION_THREADS)) != -1)
+        fprintf(stderr, failed == VALIDATION_ERROR ? "Could not validate snapshot header chain\n"
+                                                   : "Snapshot header chain does not link up\n");
+    else if (difficulty != chain_difficulty(blockchain))
+        fprintf(stderr, "Snapshot difficulty does not follow its header chain\n");
+    else
+        result = 2;
+
+    int height = blockchain->length - 1;
+    if (result == 2)
+    {
+        blockchain->difficulty = (int)difficulty;
+        result = journal_begin();
+        for (int i = 0; result && i < NB_SNAPSHOT_FILES; i++)
+            result = journal_write(snapshot_files[i], 0, 1, files[i].data, files[i].len);
+        /* The old chain's indexes are emptied with it, the next run rebuilds them */
+        for (int i = 0; result && i < NB_CHAIN_INDEXES; i++)
+            result = journal_write(chain_indexes[i], 0, 1, "", 0);
+        result = result && save_checkpoint(blockchain) && serialize_blockchain(blockchain);
+        if (result)
+            result = journal_commit();
+        else if (journal_active())
+            journal_abort();
+        if (!result)
+            fprintf(stderr, "Could not write snapshot state\n");
+    }
+    else
+    {
+        free_blockchain(blockchain);
+        result = 0;
+    }
+    for (int i = 0; i < NB_SNAPSHOT_FILES; i++)
+        free(files[i].data);
+    return result ? height : -1;
+}
@@ -0,0 +1,159 @@
+#include "blockchain.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+
+/**
+ * block_work - expected number of hashes behind a block, from the zero
+ * bytes leading its hash
+ * @block: pointer to block
+ * Return: work of the block
+ */
+uint64_t block_work(Block *block)
+{
+    int zeros = 0;
+
+    while (zeros < STATS_WORK_BYTES_MAX && block->current_hash[zeros] == 0)
+        zeros++;
+    return (uint64_t)1 << (8 * zeros);
+}
+
+/**
+ * find_role - role of the user owning a wallet address
+ * @users: list of users, may be NULL
+ * @address: wallet address
+ * Return: role of owner, or ROLE_COUNT if no user owns the address
+ */
+static int find_role(lusers *users, unsigned char *address)
+{
+    for (user_t *user = users ? users->head : NULL; user; user = user->next)
+    {
+        if (user->wallet && memcmp(user->wallet->address, address, ADDRESS_SIZE) == 0)
+            return user->role;
+    }
+    return ROLE_COUNT;
+}
+
+/**
+ * stats_add_block - folds a block into the running totals
+ * @stats: cumulative totals up to the previous block, updated in place
+ * @block: pointer to block
+ * @users: list of users used to attribute volume to roles
+ */
+static void stats_add_block(chain_stats_t *stats, Block *block, lusers *users)
+{
+    stats->timestamp = block->timestamp;
+    stats->work += block_work(block);
+    memcpy(stats->hash, block->current_hash, SHA256_DIGEST_LENGTH);
+    if (block->pruned)
+        return;
+    for (Transaction *trans = block->transactions->head; trans; trans = trans->next)
+    {
+        stats->transactions++;
+        stats->volume += trans->amount;
+        stats->role_volume[find_role(users, trans->sender)] += trans->amount;
+        /* The genesis transfer is minted, not mined */
+        if (block->index > 0)
+            stats->fees += TRANSACTION_FEE;
+    }
+}
+
+/**
+ * stats_update - appends the cumulative totals of blocks added since the
+ * last update to STATS_DATABASE, one fixed-size record per height
+ * Records are recomputed from genesis if the file no longer matches the
+ * chain; pruned blocks only add their work
+ * @blockchain: pointer to blockchain
+ * Return: 1 on success else 0
+ */
+int stats_update(Blockchain *blockchain)
+{
+    chain_stats_t stats;
+    struct stat st;
+    Block *current = blockchain->head;
+    long height = 0;
+
+    memset(&stats, 0, sizeof(stats));
+    if (stat(STATS_DATABASE, &st) == 0 && st.st_size % sizeof(stats) == 0)
+        height = st.st_size / sizeof(stats);
+    if (height > blockchain->length)
+        height = 0;
+    if (height > 0)
+    {
+        for (long i = 1; i < height; i++)
+            current = current->next;
+        if (!stats_read(height - 1, &stats) ||
+            memcmp(stats.hash, current->current_hash, SHA256_DIGEST_LENGTH) != 0)
+        {
+            memset(&stats, 0, sizeof(stats));
+            height = 0;
+            current = blockchain->head;
+        }
+        else
+            current = current->next;
+    }
+    if (!current)
+        return 1;
+
+    lusers *users = deserialize_users();
+    buffer_t records;
+    buffer_init(&records);
+    int result = 1;
+    for (; result && current; current = current->next)
+    {
+        stats_add_block(&stats, current, users);
+        result = buffer_put(&records, &stats, sizeof(stats));
+    }
+    free_users(users);
+    result = result && journal_write(STATS_DATABASE, height * sizeof(stats), 1, records.data, records.len);
+    buffer_free(&records);
+    if (!result)
+        fprintf(stderr, "Failed to update chain statistics\n");
+    return result;
+}
+
+/**
+ * stats_rewind - drops the totals past a height, staged in the open journal
+ * group, so the next update only adds the blocks connected after it
+ * @height: height of the last block kept
+ * Return: 1 on success else 0
+ */
+int stats_rewind(long height)
+{
+    long last = stats_height();
+
+    return last <= height || journal_write(STATS_DATABASE, (height + 1) * sizeof(chain_stats_t), 1, "", 0);
+}
+
+/**
+ * stats_read - reads the cumulative totals at a height
+ * @height: block height
+ * @stats: where to store the totals
+ * Return: 1 on success else 0 if there is no record for that height
+ */
+int stats_read(long height, chain_stats_t *stats)
+{
+    int fd = open(STATS_DATABASE, O_RDONLY);
+
+    if (fd < 0 || height < 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        return 0;
+    }
+    ssize_t got = pread(fd, stats, sizeof(*stats), height * sizeof(*stats));
+    close(fd);
+    return got == (ssize_t)sizeof(*stats);
+}
+
+/**
+ * stats_height - height of the last block with statistics
+ * Return: height, or -1 if there are none
+ */
+long stats_height(void)
+{
+    struct stat st;
+
+    if (stat(STATS_DATABASE, &st) != 0)
+        return -1;
+    return st.st_size / sizeof(chain_stats_t) - 1;
+}
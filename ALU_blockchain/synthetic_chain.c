@@ -0,0 +1,105 @@
+#include "blockchain.h"
+
+/**
+ * synthetic_blockchain - builds a linked, correctly hashed chain in memory
+ * for benchmarks, without proof of work or touching any database file
+ * @nb_blocks: number of blocks including genesis
+ * @nb_addresses: number of distinct wallet addresses to draw from
+ * @seed: random seed, the same seed gives the same chain
+ * Return: pointer to blockchain or NULL on failure
+ */
+Blockchain *synthetic_blockchain(int nb_blocks, int nb_addresses, unsigned int seed)
+{
+    unsigned char (*addresses)[SHA256_DIGEST_LENGTH];
+    unsigned char previous[SHA256_DIGEST_LENGTH] = {0};
+    char name[32];
+    time_t start = time(NULL) - (time_t)nb_blocks * 30;
+
+    if (nb_blocks < 1 || nb_addresses < 2)
+        return NULL;
+    Blockchain *blockchain = (Blockchain *)malloc(sizeof(Blockchain));
+    addresses = malloc(sizeof(*addresses) * nb_addresses);
+    if (!blockchain || !addresses)
+    {
+        fprintf(stderr, "Failed to allocate memory for synthetic blockchain\n");
+        free(blockchain);
+        free(addresses);
+        return NULL;
+    }
+    blockchain->head = blockchain->tail = NULL;
+    blockchain->length = 0;
+    blockchain->difficulty = INITIAL_DIFFICULTY;
+    blockchain->stored = 0;
+    blockchain->stored_size = 0;
+    blockchain->codec = NULL;
+
+    for (int i = 0; i < nb_addresses; i++)
+    {
+        snprintf(name, sizeof(name), "user%d", i);
+        get_address(name, addresses[i]);
+    }
+
+    srand(seed);
+    for (int height = 0; height < nb_blocks; height++)
+    {
+        Block *block = (Block *)malloc(sizeof(Block));
+        utxo_t *transactions = (utxo_t *)malloc(sizeof(utxo_t));
+        if (!block || !transactions)
+        {
+            fprintf(stderr, "Failed to allocate memory for synthetic block\n");
+            free(block);
+            free(transactions);
+            free_blockchain(blockchain);
+            free(addresses);
+            return NULL;
+        }
+        transactions->head = transactions->tail = NULL;
+        transactions->nb_trans = 0;
+
+        for (int i = 0; i < TRANSACTION_VOLUME; i++)
+        {
+            Transaction *trans = (Transaction *)malloc(sizeof(Transaction));
+            if (!trans)
+                break;
+            int sender = rand() % nb_addresses;
+            int receiver = (sender + 1 + rand() % (nb_addresses - 1)) % nb_addresses;
+            trans->index = i;
+            memcpy(trans->sender, addresses[sender], ADDRESS_SIZE);
+            memcpy(trans->receiver, addresses[receiver], ADDRESS_SIZE);
+            trans->amount = 1 + rand() % 5000;
+            trans->status = SUCCESS;
+            trans->next = NULL;
+            if (!transactions->head)
+                transactions->head = transactions->tail = trans;
+            else
+            {
+                transactions->tail->next = trans;
+                transactions->tail = trans;
+            }
+            transactions->nb_trans++;
+        }
+
+        block->index = height;
+        block->timestamp = ((int64_t)start + (int64_t)height * 30) * TIMESTAMP_RESOLUTION +
+                           rand() % TIMESTAMP_RESOLUTION;
+        block->nonce = (unsigned int)rand();
+        memcpy(block->miner, addresses[rand() % nb_addresses], ADDRESS_SIZE);
+        block->transactions = transactions;
+        memcpy(block->previous_hash, previous, SHA256_DIGEST_LENGTH);
+        calculate_hash(block, block->current_hash);
+        memcpy(previous, block->current_hash, SHA256_DIGEST_LENGTH);
+        block->pruned = 0;
+        block->bloom_size = 0;
+        block->next = NULL;
+
+        if (!blockchain->head)
+            blockchain->head = block;
+        else
+            blockchain->tail->next = block;
+        blockchain->tail = block;
+        blockchain->length++;
+    }
+
+    free(addresses);
+    return blockchain;
+}
@@ -0,0 +1,202 @@
+#include "blockchain.h"
+
+/**
+ * load_time_index - reads the sparse time index
+ * @count: where to store the number of entries
+ * Return: array of entries, or NULL if the index is missing or does not
+ * start at the genesis block
+ */
+static time_index_entry_t *load_time_index(size_t *count)
+{
+    time_index_entry_t *entries = NULL;
+    FILE *file = fopen(TIME_INDEX_DATABASE, "rb");
+    long size;
+
+    *count = 0;
+    if (!file)
+        return NULL;
+    if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) > 0 &&
+        size % sizeof(*entries) == 0 && fseek(file, 0, SEEK_SET) == 0)
+    {
+        *count = size / sizeof(*entries);
+        entries = (time_index_entry_t *)malloc(size);
+        if (entries && fread(entries, sizeof(*entries), *count, file) != *count)
+        {
+            free(entries);
+            entries = NULL;
+        }
+    }
+    fclose(file);
+    if (entries && entries[0].height != 0)
+    {
+        free(entries);
+        entries = NULL;
+    }
+    if (!entries)
+        *count = 0;
+    return entries;
+}
+
+/**
+ * block_reader_open - opens the block file positioned at the codec segment
+ * holding a block, found by binary search in the sparse time index
+ * A missing index positions the reader at the genesis block
+ * @reader: reader to set up
+ * @key: height or timestamp to position at
+ * @by_height: 1 if key is a height, 0 if it is a timestamp
+ * Return: 1 on success else 0
+ */
+int block_reader_open(block_reader_t *reader, int64_t key, int by_height)
+{
+    uint32_t magic, version;
+
+    journal_recover();
+    reader->nb_read = 0;
+    reader->file = fopen(BLOCKCHAIN_DATABASE, "rb");
+    if (!reader->file || fread(&magic, sizeof(magic), 1, reader->file) != 1 ||
+        fread(&version, sizeof(version), 1, reader->file) != 1 ||
+        fread(&reader->difficulty, sizeof(reader->difficulty), 1, reader->file) != 1 ||
+        magic != BLOCKCHAIN_MAGIC || version != BLOCKCHAIN_VERSION)
+    {
+        fprintf(stderr, "Cannot read blockchain file\n");
+        if (reader->file)
+            fclose(reader->file);
+        return 0;
+    }
+    reader->header_size = ftell(reader->file);
+
+    size_t count, low = 0, high;
+    time_index_entry_t *entries = load_time_index(&count);
+    high = count;
+    while (high - low > 1)
+    {
+        size_t mid = low + (high - low) / 2;
+        if ((by_height ? entries[mid].height : entries[mid].timestamp) <= key)
+            low = mid;
+        else
+            high = mid;
+    }
+    reader->expected = entries ? entries[low].height : 0;
+    if (!entries || fseek(reader->file, entries[low].offset, SEEK_SET) != 0)
+    {
+        reader->expected = 0;
+        fseek(reader->file, reader->header_size, SEEK_SET);
+    }
+    free(entries);
+
+    buffer_init(&reader->record);
+    codec_state_init(&reader->state);
+    return 1;
+}
+
+/**
+ * block_reader_next - decodes the next block of the file
+ * If the first block is not the one the index promised, the index is
+ * stale and reading restarts from the genesis block
+ * @reader: open reader
+ * Return: pointer to block, or NULL at the end of the file or on a
+ * corrupt record
+ */
+Block *block_reader_next(block_reader_t *reader)
+{
+    while (read_record(reader->file, &reader->record) == RECORD_OK)
+    {
+        Block *block = decode_block_compact(&reader->record, &reader->state);
+        if (block && reader->nb_read == 0 && block->index != reader->expected)
+        {
+            fprintf(stderr, "Time index is stale, reading the whole chain\n");
+            free_transactions(block->transactions);
+            free(block);
+            if (reader->expected == 0 || fseek(reader->file, reader->header_size, SEEK_SET) != 0)
+                return NULL;
+            codec_state_free(&reader->state);
+            codec_state_init(&reader->state);
+            reader->expected = 0;
+            continue;
+        }
+        if (block)
+            reader->nb_read++;
+        return block;
+    }
+    return NULL;
+}
+
+/**
+ * block_reader_close - closes a reader
+ * @reader: open reader
+ */
+void block_reader_close(block_reader_t *reader)
+{
+    buffer_free(&reader->record);
+    codec_state_free(&reader->state);
+    fclose(reader->file);
+}
+
+/**
+ * blocks_between - collects the blocks mined in a time range
+ * Records are decoded from the last segment starting at or before the
+ * range until a block is past the range; block timestamps are assumed not
+ * to go backwards
+ * @from: first timestamp of the range
+ * @to: last timestamp of the range
+ * @nb_read: where to store the number of block records decoded
+ * Return: list of matching blocks, or NULL on failure
+ */
+Blockchain *blocks_between(int64_t from, int64_t to, int *nb_read)
+{
+    block_reader_t reader;
+    Block *block;
+
+    *nb_read = 0;
+    Blockchain *range = (Blockchain *)malloc(sizeof(Blockchain));
+    if (!range || !block_reader_open(&reader, from, 0))
+    {
+        free(range);
+        return NULL;
+    }
+    range->head = range->tail = NULL;
+    range->length = 0;
+    range->difficulty = reader.difficulty;
+    range->stored = 0;
+    range->stored_size = 0;
+    range->codec = NULL;
+
+    while ((block = block_reader_next(&reader)))
+    {
+        if (block->timestamp > to || block->timestamp < from)
+        {
+            int past = block->timestamp > to;
+            free_transactions(block->transactions);
+            free(block);
+            if (past)
+                break;
+            continue;
+        }
+        if (!range->head)
+            range->head = block;
+        else
+            range->tail->next = block;
+        range->tail = block;
+        range->length++;
+    }
+    *nb_read = reader.nb_read;
+    block_reader_close(&reader);
+    return range;
+}
+
+/**
+ * time_index_rewind - drops the entries of the segments starting past a
+ * height, staged in the open journal group
+ * @height: height of the last block kept
+ * Return: 1 on success else 0
+ */
+int time_index_rewind(long height)
+{
+    size_t count, kept = 0;
+    time_index_entry_t *entries = load_time_index(&count);
+
+    while (kept < count && entries[kept].height <= height)
+        kept++;
+    free(entries);
+    return kept == count || journal_write(TIME_INDEX_DATABASE, kept * sizeof(time_index_entry_t), 1, "", 0);
+}
@@ -2,37 +2,52 @@
 
 /**
  * serialize_utxo - serialize unspent transactions to a file
+ * Every transaction is written as one record framed with length + CRC32C,
+ * and the file is replaced through the journal
  * @unspent: pointer to list of unspent transactions
  * Return: 1 on sucess else 0 on failure
  */
 int serialize_utxo(utxo_t *unspent)
 {
-    FILE *file = fopen(UTXO_DATABASE, "wb");
+    char *data = NULL;
+    size_t size = 0;
+    FILE *file = open_memstream(&data, &size);
     if (!file)
     {
         printf("Failed to open file for serialization\n");
-        fclose(file);
         return 0;
     }
+    buffer_t record;
+    buffer_init(&record);
+    int result = 1;
     Transaction *current = unspent->head;
-    while (current)
+    while (current && result)
     {
-        fwrite(&current->index, sizeof(current->index), 1, file);
-        fwrite(current->sender, sizeof(current->sender), 1, file);
-        fwrite(current->receiver, sizeof(current->receiver), 1, file);
-        fwrite(&current->amount, sizeof(current->amount), 1, file);
+        record.len = 0;
+        result = buffer_put(&record, &current->index, sizeof(current->index)) &&
+                 buffer_put(&record, current->sender, sizeof(current->sender)) &&
+                 buffer_put(&record, current->receiver, sizeof(current->receiver)) &&
+                 buffer_put(&record, &current->amount, sizeof(current->amount)) &&
+                 write_record(file, &record);
         current = current->next;
     }
-    fclose(file);
-    return 1;
+    buffer_free(&record);
+    if (fclose(file) != 0)
+        result = 0;
+    result = result && journal_write(UTXO_DATABASE, 0, 1, data, size);
+    free(data);
+    return result;
 }
 
 /**
  * deserialize_utxo - get unpsent transactions from pool(file)
+ * A torn or corrupt trailing record is dropped and the pool truncated to
+ * the last complete transaction
  * Return: pointer to list of unpsent transactions else exit
  */
 utxo_t *deserialize_utxo(void)
 {
+    journal_recover();
     FILE *file = fopen(UTXO_DATABASE, "rb");
     if (!file) {
         perror("Failed to open file for deserialization of unpsent transactions");
@@ -49,24 +64,30 @@ utxo_t *deserialize_utxo(void)
     unspent_transactions->head = unspent_transactions->tail = NULL;
     unspent_transactions->nb_trans = 0;
 
-    while (!feof(file))
+    buffer_t record;
+    buffer_init(&record);
+    while (read_record(file, &record) == RECORD_OK)
     {
         Transaction *transaction = (Transaction *)malloc(sizeof(Transaction));
         if (!transaction)
         {
             perror("Failed to allocate memory for transaction");
+            buffer_free(&record);
             fclose(file);
-            free(unspent_transactions);
+            free_transactions(unspent_transactions);
             return NULL;
         }
 
-        if (fread(&transaction->index, sizeof(transaction->index), 1, file) != 1) {
+        if (!buffer_get(&record, &transaction->index, sizeof(transaction->index)) ||
+            !buffer_get(&record, transaction->sender, sizeof(transaction->sender)) ||
+            !buffer_get(&record, transaction->receiver, sizeof(transaction->receiver)) ||
+            !buffer_get(&record, &transaction->amount, sizeof(transaction->amount)) ||
+            record.pos != record.len)
+        {
             free(transaction);
             break;
         }
-        fread(transaction->sender, sizeof(transaction->sender), 1, file);
-        fread(transaction->receiver, sizeof(transaction->receiver), 1, file);
-        fread(&transaction->amount, sizeof(transaction->amount), 1, file);
+        transaction->status = INITIATED;
 
         transaction->next = NULL;
         if (unspent_transactions->head == NULL) {
@@ -78,22 +99,143 @@ utxo_t *deserialize_utxo(void)
 
         unspent_transactions->nb_trans++;
     }
-
+    buffer_free(&record);
     fclose(file);
+
+    /* A torn record stops the read, the next pool write replaces the file */
     return unspent_transactions;
 }
 
+/**
+ * pool_add - numbers a transaction and appends it to a loaded pool
+ * The pool and the transaction ID index commit in one journal group; on
+ * failure the pool is left as it was
+ * @pool: loaded pool of unspent transactions
+ * @sender: sender address
+ * @receiver: receiver address
+ * @amount: amount of transaction
+ * @sequence: sender's sequence number for the transaction, -1 for the next
+ * @id: TXID_SIZE bytes to fill with the transaction ID
+ * Return: 1 on success or 0 on failure
+ */
+int pool_add(utxo_t *pool, unsigned char *sender, unsigned char *receiver, int amount, long sequence,
+             unsigned char *id)
+{
+    Transaction *new_trans, *tail = pool->tail;
+    int own_group;
+
+    new_trans = (Transaction *)malloc(sizeof(Transaction));
+    if (!new_trans)
+    {
+        fprintf(stderr, "Failed to allocate memory for new transaction\n");
+        return 0;
+    }
+    memcpy(new_trans->sender, sender, ADDRESS_SIZE);
+    memcpy(new_trans->receiver, receiver, ADDRESS_SIZE);
+    new_trans->amount = amount;
+    new_trans->status = INITIATED;
+    new_trans->next = NULL;
+
+    own_group = !journal_active() && journal_begin();
+    if (!txid_submit(new_trans, sequence, id))
+    {
+        if (own_group)
+            journal_abort();
+        free(new_trans);
+        return 0;
+    }
+
+    if (!pool->head)
+        pool->head = pool->tail = new_trans;
+    else
+    {
+        pool->tail->next = new_trans;
+        pool->tail = new_trans;
+    }
+    pool->nb_trans++;
+
+    if (!serialize_utxo(pool) || (own_group && !journal_commit()))
+    {
+        fprintf(stderr, "Could not serialize unspent with new transaction\n");
+        if (own_group && journal_active())
+            journal_abort();
+        if (tail)
+            tail->next = NULL;
+        else
+            pool->head = NULL;
+        pool->tail = tail;
+        pool->nb_trans--;
+        free(new_trans);
+        return 0;
+    }
+
+    printf("Transaction saved!\n");
+    return 1;
+}
+
+/**
+ * pool_add_list - appends transactions relayed by peers or drained from
+ * the submission ring to a loaded pool in one journal group, so a burst of
+ * them costs a single commit
+ * @pool: loaded pool of unspent transactions
+ * @txs: transactions holding their sequence numbers, a negative one takes
+ * the sender's next; the ones already
+ * known or out of sequence are freed, the others move to the pool and the
+ * list is left naming them
+ * Return: 1 on success else 0, nothing is then written and the list keeps
+ * its transactions
+ */
+int pool_add_list(utxo_t *pool, utxo_t *txs)
+{
+    Transaction *tail = pool->tail;
+
+    journal_begin();
+    if (!txid_submit_list(txs))
+    {
+        journal_abort();
+        return 0;
+    }
+    if (!txs->head)
+    {
+        journal_abort();
+        return 1;
+    }
+    if (tail)
+        tail->next = txs->head;
+    else
+        pool->head = txs->head;
+    pool->tail = txs->tail;
+    pool->nb_trans += txs->nb_trans;
+
+    if (!serialize_utxo(pool) || !journal_commit())
+    {
+        fprintf(stderr, "Could not serialize unspent with new transactions\n");
+        if (journal_active())
+            journal_abort();
+        if (tail)
+            tail->next = NULL;
+        else
+            pool->head = NULL;
+        pool->tail = tail;
+        pool->nb_trans -= txs->nb_trans;
+        return 0;
+    }
+    return 1;
+}
+
 /**
  * add_transaction - adds transaction to unspent transactions pool(file)
  * @sender: sender details
  * @receiver: receiver details
  * @amount: amount of transaction
+ * @sequence: sender's sequence number for the transaction, -1 for the next
+ * @id: TXID_SIZE bytes to fill with the transaction ID
  * Return: 1 on success or 0 on failure
  */
-int add_transaction(unsigned char *sender, unsigned char *receiver, int amount)
+int add_transaction(unsigned char *sender, unsigned char *receiver, int amount, long sequence, unsigned char *id)
 {
     utxo_t *unspent;
-    Transaction *new_trans;
+    int result;
     if (!sender || !receiver || amount <= 0)
     {
         fprintf(stderr, "Wrong details\n");
@@ -107,6 +249,14 @@ int add_transaction(unsigned char *sender, unsigned char *receiver, int amount)
     }
     printf("Details verified\n");
 
+    if (!txid_rebuild())
+    {
+        fprintf(stderr, "Could not rebuild transaction ID index\n");
+        return 0;
+    }
+    /* The pool and the sequence are read and written back under one lock */
+    if (!journal_lock())
+        return 0;
     unspent = deserialize_utxo();
     if (!unspent)
     {
@@ -116,48 +266,17 @@ int add_transaction(unsigned char *sender, unsigned char *receiver, int amount)
         if (!unspent)
         {
             fprintf(stderr, "Could not allocate mmemory for new unspent\n");
+            journal_unlock();
             return 0;
         }
         unspent->head = unspent->tail = NULL;
         unspent->nb_trans = 0;
     }
 
-    new_trans = (Transaction *)malloc(sizeof(Transaction));
-     if (!new_trans)
-    {
-        fprintf(stderr, "Failed to allocate memory for new transaction\n");
-        free(unspent);
-        return 0;
-    }
-    new_trans->index = unspent->nb_trans;
-    unspent->nb_trans++;
-
-    memcpy(new_trans->sender, sender, ADDRESS_SIZE);
-    memcpy(new_trans->receiver, receiver, ADDRESS_SIZE);
-    new_trans->receiver[DATASIZE_MAX - 1] = '\0';
-
-    new_trans->amount = amount;
-    new_trans->next = NULL;
-
-    if (!unspent->head)
-        unspent->head = unspent->tail = new_trans;
-    else
-    {
-        unspent->tail->next = new_trans;
-        unspent->tail = new_trans;
-    }
-
-    if (!serialize_utxo(unspent))
-    {
-        fprintf(stderr, "Could not serialize unspent with new transaction\n");
-        free(new_trans);
-        free(unspent);
-        return 0;
-    }
-
-    printf("Transaction saved!\n");
-    free(unspent);
-    return 1;
+    result = pool_add(unspent, sender, receiver, amount, sequence, id);
+    journal_unlock();
+    free_transactions(unspent);
+    return result;
 }
 
 /**
@@ -19,14 +19,36 @@ int hex_to_bytes(const char *hex, unsigned char *bytes, size_t size)
 
 /**
  * main - Adds transaction to unspent transaction pool for PoW
+ * @argc: argument count
+ * @argv: optional sequence number of the sender's transaction; without
+ * one the sender's next number is looked up here and printed, retrying
+ * with it cannot add the transfer twice
  * Return: 0 always
  */
-int main(void)
+int main(int argc, char **argv)
 {
     char sender[ADDRESS_SIZE * 2 + 2], receiver[ADDRESS_SIZE * 2 + 2];
+    char id_hex[TXID_SIZE * 2 + 1];
     unsigned char converted_sender[ADDRESS_SIZE];
     unsigned char converted_receiver[ADDRESS_SIZE]; 
-    int amount;
+    unsigned char id[TXID_SIZE];
+    tx_ring_record_t record;
+    buffer_t request, result;
+    Transaction trans;
+    tx_ring_t *ring;
+    uint64_t pos;
+    long sequence = -1;
+    char *end;
+    int amount, status, queued = 0;
+
+    if (argc > 1)
+        sequence = strtol(argv[1], &end, 10);
+    if (argc > 2 || (argc > 1 && (*end != '\0' || sequence < 0 || sequence > INT32_MAX)))
+    {
+        fprintf(stderr, "Usage: %s [sequence]\n", argv[0]);
+        fprintf(stderr, "Without a sequence number the sender's next one is used and printed\n");
+        exit(EXIT_FAILURE);
+    }
     printf("Sender: ");
     if (!fgets(sender, sizeof(sender), stdin))
     {
@@ -77,10 +99,71 @@ int main(void)
         return 1;
     }
 
-    if (!add_transaction(converted_sender, converted_receiver, amount))
+    /* Numbered here, a retry names the same transaction and is refused */
+    if (sequence < 0)
+    {
+        sequence = txid_next_sequence(converted_sender);
+        if (sequence < 0)
+            exit(EXIT_FAILURE);
+        printf("Sequence number: %ld, pass it to retry this transfer\n", sequence);
+    }
+
+    /* A running node drains its submission ring without a round trip, its
+     * checks then only show in the node's log. Once the node released the
+     * slot the transaction is in the pool log or was dropped, tx_status
+     * tells which */
+    ring = amount > 0 ? tx_ring_open() : NULL;
+    if (ring)
+    {
+        memcpy(record.sender, converted_sender, ADDRESS_SIZE);
+        memcpy(record.receiver, converted_receiver, ADDRESS_SIZE);
+        record.amount = amount;
+        record.sequence = sequence;
+        queued = tx_ring_push(ring, &record, &pos);
+        /* Not logged in time, the same sequence number makes a resubmission safe */
+        if (queued && !tx_ring_wait(ring, pos))
+        {
+            printf("Node did not log the transaction in time, submitting it again\n");
+            queued = 0;
+        }
+        tx_ring_close(ring);
+    }
+    if (queued)
+    {
+        memset(&trans, 0, sizeof(trans));
+        memcpy(trans.sender, converted_sender, ADDRESS_SIZE);
+        memcpy(trans.receiver, converted_receiver, ADDRESS_SIZE);
+        trans.amount = amount;
+        trans.index = (int)sequence;
+        transaction_id(&trans, id);
+        hash_to_hex(id, id_hex);
+        printf("Transaction logged by the node, tx_status tells whether it passed its checks\n");
+        printf("Transaction ID: %s\n", id_hex);
+        return 0;
+    }
+
+    /* Otherwise it checks and pools the transaction from memory */
+    buffer_init(&request);
+    buffer_init(&result);
+    status = buffer_put(&request, converted_sender, ADDRESS_SIZE) &&
+             buffer_put(&request, converted_receiver, ADDRESS_SIZE) &&
+             buffer_put_svarint(&request, amount) && buffer_put_svarint(&request, sequence)
+                 ? node_call(NODE_SUBMIT, &request, &result)
+                 : -1;
+    if (status == 1 && result.len == TXID_SIZE)
+        memcpy(id, result.data, TXID_SIZE);
+    else if (status == 1)
+        status = 0;
+    else if (status < 0)
+        status = add_transaction(converted_sender, converted_receiver, amount, sequence, id);
+    buffer_free(&request);
+    buffer_free(&result);
+    if (!status)
     {
         fprintf(stderr, "Could not add transactions to unspent pool\n");
         exit(EXIT_FAILURE);
     }
+    hash_to_hex(id, id_hex);
+    printf("Transaction ID: %s\n", id_hex);
     return 0;
 }
\ No newline at end of file
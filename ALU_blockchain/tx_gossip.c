@@ -0,0 +1,115 @@
+#include "blockchain.h"
+
+/* Slots per generation, kept at most half full */
+#define SEEN_SLOTS (PEER_SEEN_TXS * 2)
+
+/**
+ * seen_slot - linear probe for a transaction ID in one generation
+ * @entries: generation table
+ * @id: transaction ID, uniform since it is a hash
+ * Return: slot holding the ID, or the empty slot where it belongs
+ */
+static uint32_t seen_slot(tx_seen_entry_t *entries, const unsigned char *id)
+{
+    uint32_t slot;
+
+    memcpy(&slot, id, sizeof(slot));
+    for (slot &= SEEN_SLOTS - 1; entries[slot].used && memcmp(entries[slot].id, id, TXID_SIZE) != 0;
+         slot = (slot + 1) & (SEEN_SLOTS - 1))
+        ;
+    return slot;
+}
+
+/**
+ * tx_seen_find - looks up a transaction a node heard of
+ * @seen: seen set
+ * @id: transaction ID
+ * Return: its entry or NULL if it was not seen lately
+ */
+tx_seen_entry_t *tx_seen_find(tx_seen_t *seen, const unsigned char *id)
+{
+    tx_seen_entry_t *entries, *entry;
+
+    for (int i = 0; i < 2; i++)
+    {
+        entries = seen->gens[(seen->current + i) & 1];
+        if (entries && (entry = &entries[seen_slot(entries, id)])->used)
+            return entry;
+    }
+    return NULL;
+}
+
+/**
+ * tx_seen_add - remembers a transaction, forgetting the older generation
+ * when the current one is full
+ * @seen: seen set
+ * @id: transaction ID
+ * Return: its entry, a new one with no payload unless it was seen already,
+ * or NULL on allocation failure
+ */
+tx_seen_entry_t *tx_seen_add(tx_seen_t *seen, const unsigned char *id)
+{
+    tx_seen_entry_t *entry = tx_seen_find(seen, id);
+
+    if (entry)
+        return entry;
+    for (int i = 0; i < 2; i++)
+    {
+        if (!seen->gens[i] && !(seen->gens[i] = (tx_seen_entry_t *)calloc(SEEN_SLOTS, sizeof(tx_seen_entry_t))))
+        {
+            fprintf(stderr, "Failed to allocate the seen transactions\n");
+            return NULL;
+        }
+    }
+    if (seen->count >= PEER_SEEN_TXS)
+    {
+        seen->current ^= 1;
+        memset(seen->gens[seen->current], 0, SEEN_SLOTS * sizeof(tx_seen_entry_t));
+        seen->count = 0;
+    }
+    entry = &seen->gens[seen->current][seen_slot(seen->gens[seen->current], id)];
+    entry->used = 1;
+    entry->len = 0;
+    memcpy(entry->id, id, TXID_SIZE);
+    seen->count++;
+    return entry;
+}
+
+/**
+ * tx_seen_free - forgets every transaction
+ * @seen: seen set
+ */
+void tx_seen_free(tx_seen_t *seen)
+{
+    free(seen->gens[0]);
+    free(seen->gens[1]);
+    memset(seen, 0, sizeof(*seen));
+}
+
+/**
+ * inv_put - appends transaction IDs to peer messages, PEER_INV_MAX per
+ * frame: a count followed by the IDs
+ * @frames: buffer to append the frames to
+ * @type: PEER_INV to announce the transactions, PEER_GET_TXS to ask for
+ * them
+ * @ids: TXID_SIZE bytes per transaction
+ * @count: number of transactions
+ * Return: 1 on success else 0
+ */
+int inv_put(buffer_t *frames, uint32_t type, const unsigned char *ids, size_t count)
+{
+    size_t chunk;
+    buffer_t payload;
+    int result = 1;
+
+    buffer_init(&payload);
+    for (size_t i = 0; result && i < count; i += chunk)
+    {
+        chunk = count - i < PEER_INV_MAX ? count - i : PEER_INV_MAX;
+        payload.len = 0;
+        result = buffer_put_varint(&payload, chunk) && buffer_put(&payload, ids + i * TXID_SIZE, chunk * TXID_SIZE) &&
+                 node_frame_put(frames, type, &payload);
+    }
+    buffer_free(&payload);
+    return result;
+}
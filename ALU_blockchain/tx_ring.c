@@ -0,0 +1,260 @@
+#include "blockchain.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * ring_name - names the submission ring of the node directory; shared
+ * memory names are global, so the name holds the directory's device and
+ * inode
+ * @name: buffer to write the name to
+ * @size: size of the buffer
+ */
+static void ring_name(char *name, size_t size)
+{
+    struct stat st;
+
+    if (stat(".", &st) < 0)
+        memset(&st, 0, sizeof(st));
+    snprintf(name, size, "/alu_tx_ring.%lx.%lx", (unsigned long)st.st_dev, (unsigned long)st.st_ino);
+}
+
+/**
+ * ring_map - maps a submission ring
+ * @fd: shared memory descriptor
+ * Return: the ring or NULL on failure
+ */
+static tx_ring_t *ring_map(int fd)
+{
+    void *ring = mmap(NULL, sizeof(tx_ring_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    return ring == MAP_FAILED ? NULL : (tx_ring_t *)ring;
+}
+
+/**
+ * tx_ring_create - sets up the submission ring of the node directory, a
+ * ring left behind by a node that died is started over
+ * The node holds a lock on the ring as long as it runs, which the system
+ * drops whichever way it exits
+ * @fd: set to the descriptor holding the lock, to close once the ring is
+ * retired
+ * Return: the ring, or NULL on failure
+ */
+tx_ring_t *tx_ring_create(int *fd)
+{
+    char name[64];
+    tx_ring_t *ring = NULL;
+
+    ring_name(name, sizeof(name));
+    shm_unlink(name);
+    *fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (*fd >= 0 && ftruncate(*fd, sizeof(tx_ring_t)) == 0 && flock(*fd, LOCK_EX) == 0)
+        ring = ring_map(*fd);
+    if (!ring)
+    {
+        perror("Failed to set up the submission ring");
+        if (*fd >= 0)
+            close(*fd);
+        *fd = -1;
+        shm_unlink(name);
+        return NULL;
+    }
+    /* The new memory is zeroed, only the turns need setting */
+    for (uint64_t i = 0; i < TX_RING_SLOTS; i++)
+        atomic_store_explicit(&ring->slots[i].turn, i, memory_order_relaxed);
+    atomic_store_explicit(&ring->magic, TX_RING_MAGIC, memory_order_release);
+    return ring;
+}
+
+/**
+ * tx_ring_open - maps the submission ring of the node running in the
+ * current directory
+ * Return: the ring, or NULL if no running node set one up
+ */
+tx_ring_t *tx_ring_open(void)
+{
+    char name[64];
+    struct stat st;
+    tx_ring_t *ring;
+    int fd;
+
+    ring_name(name, sizeof(name));
+    fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+        return NULL;
+    /* Taking the lock means the node that set the ring up is gone */
+    if (fstat(fd, &st) < 0 || st.st_size != (off_t)sizeof(tx_ring_t) || flock(fd, LOCK_SH | LOCK_NB) == 0 ||
+        errno != EWOULDBLOCK)
+    {
+        close(fd);
+        return NULL;
+    }
+    ring = ring_map(fd);
+    close(fd);
+    if (ring && atomic_load_explicit(&ring->magic, memory_order_acquire) != TX_RING_MAGIC)
+    {
+        tx_ring_close(ring);
+        return NULL;
+    }
+    return ring;
+}
+
+/**
+ * tx_ring_push - submits a transaction to the node, safe from any number
+ * of processes at once
+ * @ring: submission ring
+ * @record: transaction to submit
+ * @pos: set to the position the record took, for tx_ring_wait
+ * Return: 1 on success else 0 if the ring is full or the node gave up on
+ * the slot before the record was published
+ */
+int tx_ring_push(tx_ring_t *ring, const tx_ring_record_t *record, uint64_t *pos)
+{
+    uint64_t turn;
+    tx_ring_slot_t *slot;
+
+    *pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    for (;;)
+    {
+        slot = &ring->slots[*pos & (TX_RING_SLOTS - 1)];
+        turn = atomic_load_explicit(&slot->turn, memory_order_acquire);
+        if (turn == *pos)
+        {
+            /* A failed swap reloads the position another producer left */
+            if (atomic_compare_exchange_weak_explicit(&ring->head, pos, *pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        }
+        else if (turn < *pos)
+            return 0;
+        else
+            *pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    }
+    slot->record = *record;
+    /* Published by swap, the node may have given up on the slot meanwhile */
+    turn = *pos;
+    return atomic_compare_exchange_strong_explicit(&slot->turn, &turn, *pos + 1, memory_order_release,
+                                                   memory_order_relaxed);
+}
+
+/**
+ * tx_ring_wait - waits for the node to have added a pushed record to the
+ * pool log, or to have checked and dropped it
+ * @ring: submission ring
+ * @pos: position tx_ring_push returned
+ * Return: 1 once the node released the position else 0 after
+ * TX_RING_WAIT_MS
+ */
+int tx_ring_wait(tx_ring_t *ring, uint64_t pos)
+{
+    for (int waited = 0; waited < TX_RING_WAIT_MS; waited++)
+    {
+        if (atomic_load_explicit(&ring->tail, memory_order_acquire) > pos)
+            return 1;
+        usleep(1000);
+    }
+    return 0;
+}
+
+/**
+ * tx_ring_pop - reads the next submission off the ring, only called by
+ * the node; the slot stays taken until tx_ring_release
+ * A slot a producer claimed and did not publish for TX_RING_STALL_MS is
+ * given up on, as the producer died or was stopped: its push then fails
+ * and the client submits another way
+ * @ring: submission ring
+ * @pos: next position to read, moved past the record
+ * @record: filled with the submitted transaction
+ * @stalled: time the slot at @pos was first found claimed and not
+ * published, 0 if it was not
+ * Return: 1 on success, -1 if a slot was given up on, else 0 if the next
+ * submission is not published yet
+ */
+int tx_ring_pop(tx_ring_t *ring, uint64_t *pos, tx_ring_record_t *record, int64_t *stalled)
+{
+    tx_ring_slot_t *slot;
+    uint64_t turn;
+    int64_t now;
+
+    for (;;)
+    {
+        slot = &ring->slots[*pos & (TX_RING_SLOTS - 1)];
+        turn = atomic_load_explicit(&slot->turn, memory_order_acquire);
+        if (turn == *pos + 1)
+        {
+            *record = slot->record;
+            (*pos)++;
+            *stalled = 0;
+            return 1;
+        }
+        /* Given up on when a batch that failed was first read */
+        if (turn >= *pos + TX_RING_SLOTS)
+        {
+            (*pos)++;
+            continue;
+        }
+        if (atomic_load_explicit(&ring->head, memory_order_acquire) <= *pos)
+            return 0;
+        now = current_timestamp();
+        if (!*stalled)
+            *stalled = now;
+        if (now - *stalled < (int64_t)TX_RING_STALL_MS * TIMESTAMP_RESOLUTION / 1000)
+            return 0;
+        /* Freed for the next lap, unless the producer published meanwhile */
+        if (atomic_compare_exchange_strong_explicit(&slot->turn, &turn, *pos + TX_RING_SLOTS, memory_order_acq_rel,
+                                                    memory_order_acquire))
+        {
+            (*pos)++;
+            *stalled = 0;
+            return -1;
+        }
+    }
+}
+
+/**
+ * tx_ring_release - frees the slots read up to a position once what they
+ * held is in the pool log, which tells the clients waiting on them
+ * @ring: submission ring
+ * @end: position past the last record handled
+ */
+void tx_ring_release(tx_ring_t *ring, uint64_t end)
+{
+    uint64_t turn;
+
+    for (uint64_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed); pos < end; pos++)
+    {
+        /* A slot given up on is free already, and may be claimed again */
+        turn = pos + 1;
+        atomic_compare_exchange_strong_explicit(&ring->slots[pos & (TX_RING_SLOTS - 1)].turn, &turn,
+                                                pos + TX_RING_SLOTS, memory_order_release, memory_order_relaxed);
+    }
+    atomic_store_explicit(&ring->tail, end, memory_order_release);
+}
+
+/**
+ * tx_ring_retire - stops clients from opening the ring, what they pushed
+ * already can still be popped
+ * @ring: submission ring set up by tx_ring_create
+ * @fd: descriptor tx_ring_create returned, closed
+ */
+void tx_ring_retire(tx_ring_t *ring, int fd)
+{
+    char name[64];
+
+    atomic_store_explicit(&ring->magic, 0, memory_order_release);
+    ring_name(name, sizeof(name));
+    shm_unlink(name);
+    close(fd);
+}
+
+/**
+ * tx_ring_close - unmaps a submission ring
+ * @ring: ring to unmap, may be NULL
+ */
+void tx_ring_close(tx_ring_t *ring)
+{
+    if (ring)
+        munmap(ring, sizeof(tx_ring_t));
+}
@@ -0,0 +1,49 @@
+#include "blockchain.h"
+
+/**
+ * main - tells whether a transaction is pending, confirmed or failed
+ * @argc: argument count
+ * @argv: transaction ID (hex) printed by initiate_transaction
+ * Return: 0 if the transaction is known else 1
+ */
+int main(int argc, char **argv)
+{
+    unsigned char id[TXID_SIZE];
+    Status status;
+    long height;
+    int position;
+
+    if (argc != 2 || strlen(argv[1]) != TXID_SIZE * 2)
+    {
+        fprintf(stderr, "Usage: %s <transaction id>\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < TXID_SIZE; i++)
+    {
+        if (sscanf(argv[1] + i * 2, "%2hhx", &id[i]) != 1)
+        {
+            fprintf(stderr, "Invalid hex transaction id\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    journal_recover();
+    int found = txid_status(id, &status, &height, &position);
+    if (found < 0)
+    {
+        fprintf(stderr, "No transaction ID index, submit or mine a transaction to build it\n");
+        exit(EXIT_FAILURE);
+    }
+    if (!found)
+    {
+        printf("Unknown transaction\n");
+        exit(EXIT_FAILURE);
+    }
+    if (status == SUCCESS)
+        printf("Confirmed in block %ld, position %d\n", height, position);
+    else if (status == FAILED)
+        printf("Failed, dropped from the pool for insufficient balance\n");
+    else
+        printf("Pending in the transaction pool\n");
+    return 0;
+}
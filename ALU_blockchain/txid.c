@@ -0,0 +1,378 @@
+#include "blockchain.h"
+#include <sys/stat.h>
+
+/* An index value packs the status, the position in the block and the
+ * height plus one, 0 for pending transactions. The status is stored plus
+ * one so a value is never 0, which marks empty table slots */
+#define TXID_STATUS_BITS 4
+#define TXID_POSITION_BITS 24
+
+/**
+ * txid_pack - builds the index value of a transaction
+ * @status: transaction status
+ * @height: height of the block holding it, -1 if not in a block
+ * @position: position in the block
+ * Return: index value
+ */
+static uint64_t txid_pack(Status status, long height, int position)
+{
+    return (uint64_t)(height + 1) << (TXID_STATUS_BITS + TXID_POSITION_BITS) |
+           (uint64_t)position << TXID_STATUS_BITS | (uint64_t)(status + 1);
+}
+
+/**
+ * transaction_id - content hash identifying a transaction
+ * The index is the sender's sequence number, so repeating a transfer gives
+ * a new ID while submitting the same one twice with the same sequence
+ * number does not. A submission without a sequence number takes the next
+ * one, so retrying it is not idempotent and adds a second transfer
+ * @trans: transaction
+ * @id: TXID_SIZE bytes to fill
+ */
+void transaction_id(const Transaction *trans, unsigned char *id)
+{
+    unsigned char data[ADDRESS_SIZE * 2 + 2 * sizeof(uint32_t)];
+    uint32_t amount_be = htonl((uint32_t)trans->amount), index_be = htonl((uint32_t)trans->index);
+
+    memcpy(data, trans->sender, ADDRESS_SIZE);
+    memcpy(data + ADDRESS_SIZE, trans->receiver, ADDRESS_SIZE);
+    memcpy(data + ADDRESS_SIZE * 2, &amount_be, sizeof(amount_be));
+    memcpy(data + ADDRESS_SIZE * 2 + sizeof(amount_be), &index_be, sizeof(index_be));
+    SHA256(data, sizeof(data), id);
+}
+
+/**
+ * index_list - adds a list of transactions to the loaded indexes
+ * @ids: transaction ID table
+ * @sequences: next sequence number per sender
+ * @list: transactions, may be NULL
+ * @height: height of the block holding them, -1 for the pool
+ * Return: 1 on success else 0
+ */
+static int index_list(disk_table_t *ids, disk_table_t *sequences, utxo_t *list, long height)
+{
+    unsigned char id[TXID_SIZE];
+    uint64_t next;
+    int position = 0, result = 1;
+
+    for (Transaction *trans = list ? list->head : NULL; result && trans; trans = trans->next, position++)
+    {
+        transaction_id(trans, id);
+        result = disk_table_put(ids, id, height < 0 ? txid_pack(INITIATED, -1, 0)
+                                                    : txid_pack(SUCCESS, height, position));
+        if (result && trans->index >= 0 && (!disk_table_get(sequences, trans->sender, &next) ||
+                                            next <= (uint64_t)trans->index))
+            result = disk_table_put(sequences, trans->sender, (uint64_t)trans->index + 1);
+    }
+    return result;
+}
+
+/**
+ * txid_rebuild - rebuilds the transaction ID and sequence indexes from the
+ * chain and the pool when either is missing or was emptied
+ * Transactions rejected before the rebuild are no longer known
+ * Return: 1 on success else 0
+ */
+int txid_rebuild(void)
+{
+    disk_table_t ids, sequences;
+    block_reader_t reader;
+    Block *block;
+    struct stat st;
+    int result, own_group;
+
+    journal_recover();
+    if (stat(TXID_INDEX, &st) == 0 && st.st_size > 0 && stat(TX_SEQUENCE_INDEX, &st) == 0 && st.st_size > 0)
+        return 1;
+    fprintf(stderr, "Rebuilding the transaction ID index\n");
+    if (!disk_table_load(&ids, TXID_INDEX, TXID_SIZE))
+        return 0;
+    if (!disk_table_load(&sequences, TX_SEQUENCE_INDEX, ADDRESS_SIZE))
+    {
+        disk_table_free(&ids);
+        return 0;
+    }
+    disk_table_clear(&ids);
+    disk_table_clear(&sequences);
+
+    result = 1;
+    if (access(BLOCKCHAIN_DATABASE, F_OK) == 0)
+    {
+        result = block_reader_open(&reader, 0, 1);
+        while (result && (block = block_reader_next(&reader)))
+        {
+            result = index_list(&ids, &sequences, block->transactions, block->index);
+            free_transactions(block->transactions);
+            free(block);
+        }
+        if (result)
+            block_reader_close(&reader);
+    }
+    if (result && access(UTXO_DATABASE, F_OK) == 0)
+    {
+        utxo_t *pool = deserialize_utxo();
+        result = pool && index_list(&ids, &sequences, pool, -1);
+        free_transactions(pool);
+    }
+
+    /* Both tables are rewritten whole in one group, a crash keeps the old pair */
+    own_group = result && !journal_active() && journal_begin();
+    result = result && disk_table_save(&sequences) && disk_table_save(&ids);
+    if (own_group)
+        result = result ? journal_commit() : (journal_abort(), 0);
+    disk_table_free(&ids);
+    disk_table_free(&sequences);
+    return result;
+}
+
+/**
+ * txid_next_sequence - looks up the sequence number a sender uses next
+ * A client that takes it and submits with it can retry with the same
+ * number, so the transfer is never added twice
+ * @sender: sender address
+ * Return: next sequence number, or -1 if the index cannot be read
+ */
+long txid_next_sequence(const unsigned char *sender)
+{
+    uint64_t next = 0;
+
+    if (!txid_rebuild() || disk_table_lookup(TX_SEQUENCE_INDEX, sender, ADDRESS_SIZE, &next) < 0)
+    {
+        fprintf(stderr, "Transaction ID index is unreadable\n");
+        return -1;
+    }
+    return (long)next;
+}
+
+/**
+ * txid_submit - numbers a new transaction and indexes it as pending
+ * Both lookups and both writes touch a few table slots, whatever the size
+ * of the index. The caller holds journal_lock until the group commits, so
+ * two processes cannot take the same sequence number
+ * @trans: transaction, its index is set to the sender's sequence number
+ * @sequence: sequence number chosen by the submitter, -1 for the next one.
+ * Resubmitting with the same sequence number is rejected as a duplicate,
+ * resubmitting with -1 adds the transfer again
+ * @id: TXID_SIZE bytes to fill with the transaction ID
+ * Return: 1 on success else 0
+ */
+int txid_submit(Transaction *trans, long sequence, unsigned char *id)
+{
+    char hex[TXID_SIZE * 2 + 1];
+    uint64_t next = 0, value;
+    int found;
+
+    if (disk_table_lookup(TX_SEQUENCE_INDEX, trans->sender, ADDRESS_SIZE, &next) < 0)
+    {
+        fprintf(stderr, "Transaction ID index is unreadable\n");
+        return 0;
+    }
+    trans->index = sequence < 0 ? (int)next : (int)sequence;
+    transaction_id(trans, id);
+
+    found = disk_table_lookup(TXID_INDEX, id, TXID_SIZE, &value);
+    if (found < 0)
+    {
+        fprintf(stderr, "Transaction ID index is unreadable\n");
+        return 0;
+    }
+    if (found)
+    {
+        hash_to_hex(id, hex);
+        fprintf(stderr, "Transaction %s was already submitted\n", hex);
+        return 0;
+    }
+    if ((uint64_t)trans->index != next)
+    {
+        fprintf(stderr, "Sequence number %d is not the next one for this sender, expected %lu\n",
+                trans->index, (unsigned long)next);
+        return 0;
+    }
+    return disk_table_store(TXID_INDEX, id, TXID_SIZE, txid_pack(INITIATED, -1, 0)) &&
+           disk_table_store(TX_SEQUENCE_INDEX, trans->sender, ADDRESS_SIZE, next + 1);
+}
+
+/**
+ * txid_submit_list - indexes a batch of transactions as pending, each
+ * numbered and checked as txid_submit does it
+ * Writes staged in a journal group are not visible to lookups, so the
+ * indexes are loaded and the whole list is checked against them
+ * @txs: transactions holding their sequence numbers, a negative one takes
+ * the sender's next; the ones already known or out of sequence are
+ * unlinked and freed
+ * Return: 1 on success else 0 if the indexes cannot be read or written
+ */
+int txid_submit_list(utxo_t *txs)
+{
+    unsigned char id[TXID_SIZE];
+    Transaction *trans, *prev = NULL, *next;
+    disk_table_t ids, sequences;
+    uint64_t value, expected;
+    int result = 1;
+
+    if (!disk_table_load(&ids, TXID_INDEX, TXID_SIZE))
+        return 0;
+    if (!disk_table_load(&sequences, TX_SEQUENCE_INDEX, ADDRESS_SIZE))
+    {
+        disk_table_free(&ids);
+        return 0;
+    }
+    for (trans = txs->head; result && trans; trans = next)
+    {
+        next = trans->next;
+        if (!disk_table_get(&sequences, trans->sender, &expected))
+            expected = 0;
+        if (trans->index < 0)
+            trans->index = (int)expected;
+        transaction_id(trans, id);
+        if (!disk_table_get(&ids, id, &value) && (uint64_t)trans->index == expected)
+        {
+            result = disk_table_put(&ids, id, txid_pack(INITIATED, -1, 0)) &&
+                     disk_table_put(&sequences, trans->sender, expected + 1);
+            prev = trans;
+            continue;
+        }
+        if (prev)
+            prev->next = next;
+        else
+            txs->head = next;
+        if (txs->tail == trans)
+            txs->tail = prev;
+        txs->nb_trans--;
+        free(trans);
+    }
+    result = result && disk_table_save(&sequences) && disk_table_save(&ids);
+    disk_table_free(&ids);
+    disk_table_free(&sequences);
+    return result;
+}
+
+/**
+ * txid_record_block - marks the transactions of new blocks confirmed and
+ * the ones rejected while mining failed
+ * Pending transactions already have a slot, which is updated in place;
+ * anything missing from the index makes the whole table load instead.
+ * Transactions first seen in a block also move their sender's sequence on
+ * @block: first new block, the blocks linked after it are recorded too
+ * @failed: transactions dropped from the pool, may be NULL
+ * Return: 1 on success else 0
+ */
+int txid_record_block(Block *block, utxo_t *failed)
+{
+    unsigned char id[TXID_SIZE];
+    uint64_t value, next;
+    disk_table_t ids, sequences;
+    int position, in_place = 1, result = 1;
+
+    for (Block *current = block; in_place && current; current = current->next)
+    {
+        for (Transaction *trans = current->transactions->head; in_place && trans; trans = trans->next)
+        {
+            transaction_id(trans, id);
+            in_place = disk_table_lookup(TXID_INDEX, id, TXID_SIZE, &value) == 1;
+        }
+    }
+    for (Transaction *trans = failed ? failed->head : NULL; in_place && trans; trans = trans->next)
+    {
+        transaction_id(trans, id);
+        in_place = disk_table_lookup(TXID_INDEX, id, TXID_SIZE, &value) == 1;
+    }
+    if (!in_place && !disk_table_load(&ids, TXID_INDEX, TXID_SIZE))
+        return 0;
+    /* Stores in one group do not see each other, the sequences are staged whole */
+    if (!in_place && !disk_table_load(&sequences, TX_SEQUENCE_INDEX, ADDRESS_SIZE))
+    {
+        disk_table_free(&ids);
+        return 0;
+    }
+
+    for (Block *current = block; result && current; current = current->next)
+    {
+        position = 0;
+        for (Transaction *trans = current->transactions->head; result && trans; trans = trans->next)
+        {
+            transaction_id(trans, id);
+            value = txid_pack(SUCCESS, current->index, position++);
+            result = in_place ? disk_table_store(TXID_INDEX, id, TXID_SIZE, value) : disk_table_put(&ids, id, value);
+            if (result && !in_place && trans->index >= 0 &&
+                (!disk_table_get(&sequences, trans->sender, &next) || next <= (uint64_t)trans->index))
+                result = disk_table_put(&sequences, trans->sender, (uint64_t)trans->index + 1);
+        }
+    }
+    for (Transaction *trans = failed ? failed->head : NULL; result && trans; trans = trans->next)
+    {
+        transaction_id(trans, id);
+        value = txid_pack(FAILED, -1, 0);
+        result = in_place ? disk_table_store(TXID_INDEX, id, TXID_SIZE, value) : disk_table_put(&ids, id, value);
+    }
+    if (!in_place)
+    {
+        result = result && disk_table_save(&sequences) && disk_table_save(&ids);
+        disk_table_free(&ids);
+        disk_table_free(&sequences);
+    }
+    return result;
+}
+
+/**
+ * txid_revert_block - marks the transactions of disconnected blocks
+ * pending again, as they go back to the pool
+ * Sequence numbers stay where they are, the transactions keep theirs.
+ * Like txid_record_block, the table is only loaded whole when a
+ * transaction is missing from it
+ * @block: first disconnected block, the blocks linked after it too
+ * Return: 1 on success else 0
+ */
+int txid_revert_block(Block *block)
+{
+    unsigned char id[TXID_SIZE];
+    uint64_t value = txid_pack(INITIATED, -1, 0), old;
+    disk_table_t ids;
+    int in_place = 1, result = 1;
+
+    for (Block *current = block; in_place && current; current = current->next)
+    {
+        for (Transaction *trans = current->transactions->head; in_place && trans; trans = trans->next)
+        {
+            transaction_id(trans, id);
+            in_place = disk_table_lookup(TXID_INDEX, id, TXID_SIZE, &old) == 1;
+        }
+    }
+    if (!in_place && !disk_table_load(&ids, TXID_INDEX, TXID_SIZE))
+        return 0;
+    for (Block *current = block; result && current; current = current->next)
+    {
+        for (Transaction *trans = current->transactions->head; result && trans; trans = trans->next)
+        {
+            transaction_id(trans, id);
+            result = in_place ? disk_table_store(TXID_INDEX, id, TXID_SIZE, value) : disk_table_put(&ids, id, value);
+        }
+    }
+    if (!in_place)
+    {
+        result = result && disk_table_save(&ids);
+        disk_table_free(&ids);
+    }
+    return result;
+}
+
+/**
+ * txid_status - looks up a transaction by ID
+ * @id: transaction ID
+ * @status: where to store the status, INITIATED while pending
+ * @height: where to store the height of its block, -1 if not in a block
+ * @position: where to store its position in the block
+ * Return: 1 if found, 0 if unknown, or -1 if the index cannot be read
+ */
+int txid_status(const unsigned char *id, Status *status, long *height, int *position)
+{
+    uint64_t value;
+    int found = disk_table_lookup(TXID_INDEX, id, TXID_SIZE, &value);
+
+    if (found != 1)
+        return found;
+    *status = (Status)((value & ((1 << TXID_STATUS_BITS) - 1)) - 1);
+    *position = (int)((value >> TXID_STATUS_BITS) & ((1 << TXID_POSITION_BITS) - 1));
+    *height = (long)(value >> (TXID_STATUS_BITS + TXID_POSITION_BITS)) - 1;
+    return 1;
+}
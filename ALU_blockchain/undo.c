@@ -0,0 +1,225 @@
+#include "blockchain.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+
+/* An undo entry is an address and its balance before the block */
+#define UNDO_ENTRY_SIZE (ADDRESS_SIZE + sizeof(int))
+
+/**
+ * find_owner - user owning a wallet address
+ * @users: loaded users
+ * @address: wallet address
+ * Return: pointer to user in list else NULL
+ */
+static user_t *find_owner(lusers *users, const unsigned char *address)
+{
+    for (user_t *user = users->head; user; user = user->next)
+    {
+        if (user->wallet && memcmp(user->wallet->address, address, ADDRESS_SIZE) == 0)
+            return user;
+    }
+    return NULL;
+}
+
+/**
+ * add_entry - adds the balance of an address to the entries of a record,
+ * once per address
+ * @entries: entries of the record
+ * @users: loaded users, as they are before the block
+ * @address: address the block changes
+ * Return: 1 on success else 0
+ */
+static int add_entry(buffer_t *entries, lusers *users, const unsigned char *address)
+{
+    user_t *owner = find_owner(users, address);
+
+    if (!owner)
+        return 1;
+    for (size_t i = 0; i < entries->len; i += UNDO_ENTRY_SIZE)
+    {
+        if (memcmp(entries->data + i, address, ADDRESS_SIZE) == 0)
+            return 1;
+    }
+    return buffer_put(entries, address, ADDRESS_SIZE) &&
+           buffer_put(entries, &owner->wallet->balance, sizeof(owner->wallet->balance));
+}
+
+/**
+ * undo_init - starts an empty undo log
+ * @log: log to set up
+ */
+void undo_init(undo_log_t *log)
+{
+    log->file = NULL;
+    log->data = NULL;
+    log->size = 0;
+    log->first = -1;
+    buffer_init(&log->offsets);
+}
+
+/**
+ * undo_capture - records the balances a block is about to change
+ * Called for each block in height order, before the block is applied to
+ * the users
+ * @log: undo log of the journal group
+ * @users: loaded users, as they are before the block
+ * @block: block about to be applied, its miner credited the fees
+ * Return: 1 on success else 0
+ */
+int undo_capture(undo_log_t *log, lusers *users, Block *block)
+{
+    buffer_t entries, record;
+    uint64_t offset;
+    int result = 1;
+
+    if (!log->file && !(log->file = open_memstream(&log->data, &log->size)))
+    {
+        fprintf(stderr, "Failed to open undo log\n");
+        return 0;
+    }
+    buffer_init(&entries);
+    for (Transaction *trans = block->transactions->head; result && trans; trans = trans->next)
+    {
+        result = add_entry(&entries, users, trans->sender) && add_entry(&entries, users, trans->receiver) &&
+                 add_entry(&entries, users, block->miner);
+    }
+
+    buffer_init(&record);
+    offset = (uint64_t)ftell(log->file);
+    result = result && buffer_put_varint(&record, block->index) &&
+             buffer_put(&record, block->current_hash, SHA256_DIGEST_LENGTH) &&
+             buffer_put_varint(&record, entries.len / UNDO_ENTRY_SIZE) &&
+             (!entries.len || buffer_put(&record, entries.data, entries.len)) &&
+             write_record(log->file, &record) && buffer_put(&log->offsets, &offset, sizeof(offset));
+    if (result && log->first < 0)
+        log->first = block->index;
+    buffer_free(&record);
+    buffer_free(&entries);
+    return result;
+}
+
+/**
+ * undo_save - appends the captured records to UNDO_DATABASE and points
+ * their heights at them in UNDO_INDEX, staged in the open journal group
+ * An index entry is the record offset plus one, 0 for heights without a
+ * record. The log is emptied
+ * @log: undo log of the journal group
+ * Return: 1 on success else 0
+ */
+int undo_save(undo_log_t *log)
+{
+    uint64_t *offsets = (uint64_t *)log->offsets.data;
+    size_t count = log->offsets.len / sizeof(uint64_t);
+    struct stat st;
+    long base = stat(UNDO_DATABASE, &st) == 0 ? st.st_size : 0;
+    int result;
+
+    if (!log->file)
+        return 1;
+    result = fclose(log->file) == 0;
+    log->file = NULL;
+    for (size_t i = 0; i < count; i++)
+        offsets[i] += base + 1;
+    result = result && journal_write(UNDO_DATABASE, base, 1, log->data, log->size) &&
+             journal_write(UNDO_INDEX, log->first * sizeof(uint64_t), 0, offsets, count * sizeof(uint64_t));
+    if (!result)
+        fprintf(stderr, "Failed to save undo records\n");
+    undo_free(log);
+    undo_init(log);
+    return result;
+}
+
+/**
+ * undo_free - releases an undo log without saving it
+ * @log: undo log
+ */
+void undo_free(undo_log_t *log)
+{
+    if (log->file)
+        fclose(log->file);
+    free(log->data);
+    buffer_free(&log->offsets);
+}
+
+/**
+ * restore_record - sets the balances of one undo record back
+ * @file: open UNDO_DATABASE
+ * @offset: record offset
+ * @block: block the record has to belong to
+ * @users: loaded users, changed in place
+ * Return: 1 on success else 0
+ */
+static int restore_record(FILE *file, long offset, Block *block, lusers *users)
+{
+    unsigned char hash[SHA256_DIGEST_LENGTH], address[ADDRESS_SIZE];
+    uint64_t height, count;
+    buffer_t record;
+    user_t *owner;
+    int balance, result;
+
+    buffer_init(&record);
+    result = fseek(file, offset, SEEK_SET) == 0 && read_record(file, &record) == RECORD_OK &&
+             buffer_get_varint(&record, &height) && height == block->index &&
+             buffer_get(&record, hash, sizeof(hash)) &&
+             memcmp(hash, block->current_hash, SHA256_DIGEST_LENGTH) == 0 && buffer_get_varint(&record, &count);
+    for (uint64_t i = 0; result && i < count; i++)
+    {
+        result = buffer_get(&record, address, ADDRESS_SIZE) && buffer_get(&record, &balance, sizeof(balance));
+        if (result && (owner = find_owner(users, address)))
+            owner->wallet->balance = balance;
+    }
+    buffer_free(&record);
+    return result;
+}
+
+/**
+ * undo_rewind - sets balances back to what they were before disconnected
+ * blocks, newest block first, and drops their undo records in the open
+ * journal group
+ * Only the records of the disconnected blocks are read
+ * @users: loaded users, changed in place
+ * @removed: disconnected blocks linked through next, in height order
+ * @last: block the chain now ends at
+ * Return: 1 on success else 0 if a block has no undo record
+ */
+int undo_rewind(lusers *users, Block *removed, Block *last)
+{
+    long count = 0, i;
+    uint64_t *offsets;
+    Block **blocks;
+    FILE *file;
+    int fd, result;
+
+    if (!removed)
+        return 1;
+    for (Block *block = removed; block; block = block->next)
+        count++;
+    offsets = (uint64_t *)calloc(count, sizeof(uint64_t));
+    blocks = (Block **)malloc(count * sizeof(Block *));
+    fd = open(UNDO_INDEX, O_RDONLY);
+    file = fopen(UNDO_DATABASE, "rb");
+    result = offsets && blocks && fd >= 0 && file;
+    if (result && pread(fd, offsets, count * sizeof(uint64_t), (last->index + 1) * sizeof(uint64_t)) < 0)
+        result = 0;
+    if (!result)
+        fprintf(stderr, "Undo records cannot be read\n");
+    i = 0;
+    for (Block *block = removed; result && block; block = block->next)
+        blocks[i++] = block;
+
+    for (i = count - 1; result && i >= 0; i--)
+    {
+        result = offsets[i] != 0 && restore_record(file, (long)offsets[i] - 1, blocks[i], users);
+        if (!result)
+            fprintf(stderr, "No undo record for block %u\n", blocks[i]->index);
+    }
+    result = result && journal_write(UNDO_DATABASE, (long)offsets[0] - 1, 1, "", 0) &&
+             journal_write(UNDO_INDEX, (last->index + 1) * sizeof(uint64_t), 1, "", 0);
+    if (fd >= 0)
+        close(fd);
+    if (file)
+        fclose(file);
+    free(offsets);
+    free(blocks);
+    return result;
+}
@@ -0,0 +1,34 @@
+#include "blockchain.h"
+
+/**
+ * main - re-validates the whole blockchain on demand
+ * Return: 0 if valid, else 1
+ */
+int main(void)
+{
+    Blockchain *blockchain = deserialize_blockchain();
+    if (!blockchain)
+    {
+        fprintf(stderr, "Could not deserialize blockchain\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int failed = validate_chain_parallel(blockchain, VALIDATION_THREADS);
+    if (failed == VALIDATION_ERROR)
+    {
+        fprintf(stderr, "Could not validate blockchain\n");
+        free_blockchain(blockchain);
+        exit(EXIT_FAILURE);
+    }
+    if (failed != -1)
+    {
+        fprintf(stderr, "Blockchain is not valid: first bad block at height %d\n", failed);
+        free_blockchain(blockchain);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("Blockchain is valid (%d blocks), checkpoint %s\n", blockchain->length,
+           save_checkpoint(blockchain) ? "updated" : "not updated");
+    free_blockchain(blockchain);
+    return 0;
+}